@@ -42,6 +42,8 @@ void ImageControlOpts::DefaultImageOpts()
   acqPrefix = strdup("acq_");
   datPostfix = strdup("dat"); // standard value
   threaded_file_access = true;
+  decode_threads = 4;
+  noise_correct_threads = 1;
   PCATest[0]=0;
   readaheadDat = 0;
 }
@@ -87,6 +89,8 @@ void ImageControlOpts::PrintHelp()
     printf ("     --ignore-checksum-errors            BOOL  ignore checksum errors [false]\n");
     printf ("     --ignore-checksum-errors-1frame     BOOL  ignore checksum errors 1 frame [false]\n");
     printf ("     --no-threaded-file-access           BOOL  no threaded file access [false]\n");
+    printf ("     --img-decode-threads    INT               threads decoding each dat file [4]\n");
+    printf ("     --img-noise-correct-threads INT           threads noise correcting each dat file [1]\n");
     printf ("     --col-doubles-xtalk-correct         BOOL  enable col pair pixel xtalk correction [false]\n");
     printf ("     --nnmask                INT VECTOR OF 2   setup NN inner and outer [1,3]\n");
     printf ("     --nnMask                INT VECTOR OF 2   same as --nnmask [1,3]\n");
@@ -165,6 +169,18 @@ void ImageControlOpts::SetOpts(OptArgs &opts, Json::Value& json_params)
 	readaheadDat = RetrieveParameterInt(opts, json_params, '-', "readaheaddat", 0);
 	bool no_threaded_file_access = RetrieveParameterBool(opts, json_params, '-', "no-threaded-file-access", false);
 	threaded_file_access = !no_threaded_file_access;
+	decode_threads = RetrieveParameterInt(opts, json_params, '-', "img-decode-threads", 4);
+	if(decode_threads < 1)
+	{
+        fprintf ( stderr, "Option Error: img-decode-threads must be at least 1\n" );
+        exit ( EXIT_FAILURE );
+	}
+	noise_correct_threads = RetrieveParameterInt(opts, json_params, '-', "img-noise-correct-threads", 1);
+	if(noise_correct_threads < 1)
+	{
+        fprintf ( stderr, "Option Error: img-noise-correct-threads must be at least 1\n" );
+        exit ( EXIT_FAILURE );
+	}
 	//jz the following comes from CommandLineOpts::GetOpts
 	int maxFramesInput = RetrieveParameterInt(opts, json_params, 'f', "frames", -1);
 	if(maxFramesInput > 0)
@@ -41,6 +41,8 @@ class ImageControlOpts{
   char tikSmoothingInternal[32];  // parameter for internal smoothing matrix (APB)
   int total_timeout; // optional arg for image class, when set will cause the image class to wait this many seconds before giving up
   bool threaded_file_access; // read DAT files for signal processing in image processing threads
+  int decode_threads; // threads decoding each DAT file, 1 to do it on the loading thread
+  int noise_correct_threads; // threads noise correcting each DAT file, 1 to do it on the loading thread
 
   // naming scheme for files
     char *acqPrefix;
@@ -425,7 +425,7 @@ void SystemContext::PrintHelp()
     printf ("     --local-wells-file      BOOL              use local wells file [false]\n");
     printf ("     --well-stat-file        FILE              well stat file name []\n");
     printf ("     --stack-dump-file       FILE              stack dump file name []\n");
-	printf ("     --wells-format          STRING            wells format [hdf5]\n");
+	printf ("     --wells-format          STRING            wells format: hdf5, hdf5-contiguous, blocks, blocks-half [hdf5]\n");
     printf ("     --output-dir            DIRECTORY         wells output directory []\n");
     printf ("     --explog-path           DIRECTORY         explog output directory []\n");
     printf ("     --dat-source-directory  DIRECTORY         dat source input directory, if there is no such option the last argument of command line must be dat source input directory []\n");
@@ -56,6 +56,7 @@ void CreateWellsFileForWriting (RawWells &rawWells, Mask *maskPtr,
   MemUsage ("BeforeWells");
   //rawWells.SetFlowChunkSize(flowChunk);
   rawWells.SetCompression (inception_state.bkg_control.signal_chunks.wellsCompression);
+  rawWells.SetStorageFormat (inception_state.sys_context.wellsFormat);
   rawWells.SetRows (numRows);
   rawWells.SetCols (numCols);
   rawWells.SetFlows (numFlows);
@@ -122,6 +123,12 @@ void WriteFlowDataClass::InternalThreadFunction()
 
   fprintf ( stdout, "SaveWells: saving thread starts\n");
 
+  if ( WellsBlockFile::IsBlockFile ( filePath ) ) {
+    WriteBlocks();
+    fprintf ( stdout, "SaveWells: saving thread exits\n");
+    return;
+  }
+
   H5E_auto2_t old_func;
   void *old_client_data;
   /* Turn off error printing as we're not sure this is actually an hdf5 file. */
@@ -213,6 +220,53 @@ void WriteFlowDataClass::InternalThreadFunction()
 }
 
 
+// Block wells files are written a tile at a time, straight from the chunk's flow data
+void WriteFlowDataClass::WriteBlocks()
+{
+  WellsBlockFile blocks;
+  blocks.OpenForAppend ( filePath );
+  size_t tileRows = blocks.TileRows();
+  size_t tileCols = blocks.TileCols();
+  size_t numRows = blocks.NumRows();
+  ION_ASSERT ( tileRows <= stepSize && tileCols <= stepSize, "Wells tiles don't fit the save buffers." );
+
+  bool quit = false;
+  while(!quit) {
+    ChunkFlowData* chunkData = (writeQueuePtr)->deQueue();
+    if(chunkData == NULL) {
+      continue;
+    }
+
+    quit = chunkData->lastFlow;
+    const WellChunk &chunk = chunkData->wellChunk;
+    size_t flowDepth = chunk.flowDepth;
+    size_t rowEnd = min ( numRows, chunk.rowStart + chunk.rowHeight );
+    size_t colEnd = min ( ( size_t ) numCols, chunk.colStart + chunk.colWidth );
+
+    for ( size_t tileRow = chunk.rowStart - chunk.rowStart % tileRows; tileRow < rowEnd; tileRow += tileRows ) {
+      size_t tileRowEnd = min ( numRows, tileRow + tileRows );
+      for ( size_t tileCol = chunk.colStart - chunk.colStart % tileCols; tileCol < colEnd; tileCol += tileCols ) {
+        size_t tileColEnd = min ( ( size_t ) numCols, tileCol + tileCols );
+        float *dst = chunkData->dsBuffer;
+        for ( size_t row = tileRow; row < tileRowEnd; row++ ) {
+          for ( size_t col = tileCol; col < tileColEnd; col++, dst += flowDepth ) {
+            int32_t index = chunkData->indexes[row * numCols + col];
+            if ( index >= 0 )
+              copy ( chunkData->flowData + ( uint64_t ) index * flowDepth, chunkData->flowData + ( uint64_t ) ( index + 1 ) * flowDepth, dst );
+            else
+              fill ( dst, dst + flowDepth, 0.0f );
+          }
+        }
+        blocks.WriteTile ( tileRow, tileCol, chunk.flowStart, flowDepth, chunkData->dsBuffer );
+      }
+    }
+    (packQueuePtr)->enQueue(chunkData);
+  }
+
+  blocks.Close();
+}
+
+
 bool WriteFlowDataClass::start(){
 
   if(packQueuePtr == NULL || writeQueuePtr == NULL || queueSize == 0) return false;
@@ -42,6 +42,7 @@ class WriteFlowDataClass : public pThreadWrapper {
 protected:
 
   virtual void InternalThreadFunction();
+  void WriteBlocks();
 
 public:
 
@@ -0,0 +1,136 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+// WellsWriteSpeed. Write throughput of the wells storage formats, written flow block by
+// flow block the way Analysis saves wells, hdf5 against block files.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "RawWells.h"
+#include "Utils.h"
+
+using namespace std;
+
+void PrintUsage()
+{
+  printf ("Usage: WellsWriteSpeed [output_dir=.] [rows=1000] [cols=1000] [flows=200] [flow_block=20]\n");
+  printf ("  Writes a simulated rows x cols x flows wells cube with each storage format, one\n");
+  printf ("  flow block at a time through the calls Analysis uses (OpenExistingWellsForOneChunk,\n");
+  printf ("  Set, WriteWells, Close). Reports write throughput of the float values, file size,\n");
+  printf ("  and the largest difference between the values read back and the values written.\n");
+  printf ("  Files are left in output_dir as wells_<format>.wells for WellsReadSpeed.\n");
+}
+
+struct WellsFormat {
+  const char *name;
+  const char *storage;
+  bool        save_as_ushort;
+};
+
+// Simulated signal: a homopolymer length plus noise, in the usual [-5, 28] wells range
+static inline float SimulatedValue(size_t row, size_t col, size_t flow)
+{
+  uint32_t h = (uint32_t)(row * 73856093u) ^ (uint32_t)(col * 19349663u) ^ (uint32_t)(flow * 83492791u);
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  float hp = (float)((h >> 8) % 4);
+  float noise = ((h & 0xff) / 255.0f - 0.5f) * 0.3f;
+  return hp + noise;
+}
+
+static size_t FileSize(const string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+int main(int argc, char* argv[])
+{
+  string output_dir = argc > 1 ? argv[1] : ".";
+  int num_rows = argc > 2 ? atoi(argv[2]) : 1000;
+  int num_cols = argc > 3 ? atoi(argv[3]) : 1000;
+  int num_flows = argc > 4 ? atoi(argv[4]) : 200;
+  int flow_block = argc > 5 ? atoi(argv[5]) : 20;
+  if (num_rows <= 0 or num_cols <= 0 or num_flows <= 0 or flow_block <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  const WellsFormat formats[] = {
+    { "hdf5",        "hdf5",        false },
+    { "hdf5-ushort", "hdf5",        true  },
+    { "blocks",      "blocks",      false },
+    { "blocks-ushort", "blocks",    true  },
+    { "blocks-half", "blocks-half", false },
+  };
+  const int num_formats = sizeof(formats) / sizeof(formats[0]);
+
+  printf ("WellsWriteSpeed: %d x %d wells, %d flows in blocks of %d\n", num_rows, num_cols, num_flows, flow_block);
+  printf ("  %-14s %10s %10s %12s %12s\n", "format", "write s", "MB/s", "file MB", "max|diff|");
+
+  double total_mb = (double)num_rows * num_cols * num_flows * sizeof(float) / (1024.0 * 1024.0);
+  for (int f = 0; f < num_formats; ++f) {
+    string file_name = string("wells_") + formats[f].name + ".wells";
+    double write_time = 0.0;
+    {
+      // Create the file like CreateWellsFileForWriting does
+      RawWells wells (output_dir.c_str(), file_name.c_str(), formats[f].save_as_ushort, -5.0f, 28.0f);
+      wells.SetCompression (0);
+      wells.SetStorageFormat (formats[f].storage);
+      wells.SetRows (num_rows);
+      wells.SetCols (num_cols);
+      wells.SetFlows (num_flows);
+      wells.SetFlowOrder ("TACGTACGTCTGAGCATCGATCGATGTACAGC");
+      Timer timer;
+      wells.OpenForWrite();
+      wells.WriteRanks();
+      wells.WriteInfo();
+      wells.Close();
+      write_time += timer.elapsed();
+
+      // Then stream out flow blocks like ChunkyWells. Filling in the values is not timed.
+      for (int flow_start = 0; flow_start < num_flows; flow_start += flow_block) {
+        int depth = min(flow_block, num_flows - flow_start);
+        timer.restart();
+        wells.OpenExistingWellsForOneChunk(flow_start, depth);
+        write_time += timer.elapsed();
+        for (int row = 0; row < num_rows; ++row)
+          for (int col = 0; col < num_cols; ++col)
+            for (int flow = flow_start; flow < flow_start + depth; ++flow)
+              wells.Set(row, col, flow, SimulatedValue(row, col, flow));
+        timer.restart();
+        wells.WriteWells();
+        wells.Close();
+        write_time += timer.elapsed();
+      }
+    }
+
+    // Read back a strip at a time and compare
+    double max_diff = 0.0;
+    RawWells wells (output_dir.c_str(), file_name.c_str());
+    wells.SetConvertWithCopies(false);
+    wells.OpenForIncrementalRead();
+    for (int row_start = 0; row_start < num_rows; row_start += 50) {
+      int height = min(50, num_rows - row_start);
+      wells.SetChunk(row_start, height, 0, num_cols, 0, num_flows);
+      wells.ReadWells();
+      for (int row = row_start; row < row_start + height; ++row)
+        for (int col = 0; col < num_cols; ++col)
+          for (int flow = 0; flow < num_flows; ++flow)
+            max_diff = max(max_diff, (double)fabs(wells.At(row, col, flow) - SimulatedValue(row, col, flow)));
+    }
+    wells.Close();
+
+    double file_mb = FileSize(output_dir + "/" + file_name) / (1024.0 * 1024.0);
+    printf ("  %-14s %10.3f %10.1f %12.1f %12.6f\n", formats[f].name, write_time, total_mb / max(write_time, 1e-9),
+        file_mb, max_diff);
+  }
+  return EXIT_SUCCESS;
+}
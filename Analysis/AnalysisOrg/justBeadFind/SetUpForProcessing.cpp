@@ -1,5 +1,8 @@
 /* Copyright (C) 2010 Ion Torrent Systems, Inc. All Rights Reserved */
 #include "SetUpForProcessing.h"
+#include "deInterlace.h"
+#include "ComparatorNoiseCorrector.h"
+#include "CorrNoiseCorrector.h"
 #include <fstream>
 #include <iostream>
 
@@ -25,6 +28,9 @@ void SetUpToProcessImages ( ImageSpecClass &my_image_spec, CommandLineOpts &ince
 
   ImageTransformer::CalibrateChannelXTCorrection ( inception_state.sys_context.dat_source_directory,"lsrowimage.dat" );
   strncpy(ImageTransformer::PCATest,inception_state.img_control.PCATest,sizeof(ImageTransformer::PCATest)-1);
+  deInterlaceSetThreads ( inception_state.img_control.decode_threads );
+  ComparatorNoiseCorrector::SetThreads ( inception_state.img_control.noise_correct_threads );
+  CorrNoiseCorrector::SetThreads ( inception_state.img_control.noise_correct_threads );
 
   //@TODO: this mess has nasty side effects on the arguments.
   my_image_spec.DeriveSpecsFromDat ( inception_state.sys_context, inception_state.img_control, inception_state.loc_context ); // dummy - only reads 1 dat file
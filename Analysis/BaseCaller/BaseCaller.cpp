@@ -41,6 +41,7 @@
 #include "BarcodeClassifier.h"
 #include "OrderedDatasetWriter.h"
 #include "TreephaserSSE.h"
+#include "TreephaserVEC.h"
 #include "PhaseEstimator.h"
 #include "PerBaseQual.h"
 #include "BaseCallerFilters.h"
@@ -50,6 +51,7 @@
 #include "MolecularTagTrimmer.h"
 
 #include "BaseCallerParameters.h"
+#include "WellsPrefetcher.h"
 
 using namespace std;
 
@@ -493,6 +495,10 @@ int main (int argc, const char *argv[])
 
     pthread_mutex_init(&bc.mutex, NULL);
 
+    WellsPrefetcher wells_prefetcher;
+    wells_prefetcher.Start(&bc, bc_params.NumThreads(), bc_params.WellsPrefetchDepth());
+    bc.wells_prefetcher = &wells_prefetcher;
+
     pthread_t worker_id[bc_params.NumThreads()];
     for (int worker = 0; worker < bc_params.NumThreads(); worker++)
         if (pthread_create(&worker_id[worker], NULL, BasecallerWorker, &bc)) {
@@ -503,6 +509,8 @@ int main (int argc, const char *argv[])
     for (int worker = 0; worker < bc_params.NumThreads(); worker++)
         pthread_join(worker_id[worker], NULL);
 
+    wells_prefetcher.Stop();
+    bc.wells_prefetcher = NULL;
     pthread_mutex_destroy(&bc.mutex);
 
     time_t basecall_end_time;
@@ -516,6 +524,9 @@ int main (int argc, const char *argv[])
     printf("\n\nBASECALLING: called %d of %u wells in %1.0lf seconds with %d threads\n\n",
            filters.NumWellsCalled(), bc.chip_subset.NumWells(),
            difftime(basecall_end_time,basecall_start_time), bc_params.NumThreads());
+    wells_prefetcher.PrintTimings();
+    wells_prefetcher.SaveTimings(basecaller_json["BaseCaller"]["wells_prefetch_timing"]);
+    basecaller_json["BaseCaller"]["treephaser_backend"] = TreephaserVEC::BackendName(TreephaserVEC::BestBackend());
 
     bc.lib_writer.Close(datasets, end_barcodes.EndBarcodeNames(),
         bc_params.GetFiles().output_directory, "Library");
@@ -593,13 +604,7 @@ void * BasecallerWorker(void *input)
 {
     BaseCallerContext& bc = *static_cast<BaseCallerContext*>(input);
 
-    RawWells wells ("", bc.filename_wells.c_str());
-    pthread_mutex_lock(&bc.mutex);
-    wells.OpenForIncrementalRead();
-    pthread_mutex_unlock(&bc.mutex);
-
-    WellsNormalization wells_norm(&bc.flow_order, bc.wells_norm_method);
-    wells_norm.SetWells(&wells, bc.mask);
+    WellsRegion *wells_region = NULL;                         //!< Wells data of the current region, owned by the prefetcher
     int num_flows =  bc.flow_order.num_flows();
 
     vector<float>     residual(num_flows, 0);
@@ -620,38 +625,37 @@ void * BasecallerWorker(void *input)
     vector<int>       base_to_flow (3*num_flows);             //!< Flow of in-phase incorporation of each base.
     vector<int>       flow_to_base (num_flows,-1);            //!< base pos of each flow, -1 if not available
     vector< vector<float> >  errD_table;
+    NN::NNWorkspace   nn_workspace;                           //!< Per-thread activation buffers for network model QVs
+    BaseCallerMetricBlock metric_block;                       //!< Region-local metrics, handed to the metric saver per region
 
     DPTreephaser      treephaser(bc.flow_order, bc.windowSize);
     treephaser.SetStateProgression(bc.diagonal_state_prog);
     treephaser.SkipRecalDuringNormalization(bc.skip_recal_during_norm);
     
-    // SSE treephaser definition. XXX
-#if defined( __SSE3__ )
-    TreephaserSSE treephaser_sse(bc.flow_order, bc.windowSize);
+    // Vectorized treephaser, using the widest instruction set supported by this CPU
+    TreephaserVEC treephaser_sse(bc.flow_order, bc.windowSize);
     treephaser_sse.SkipRecalDuringNormalization(bc.skip_recal_during_norm);
-#endif
 
 
     while (true) {
 
         //
-        // Step 1. Retrieve next unprocessed region
+        // Step 1. Retrieve next unprocessed region, read by the prefetcher and normalized here
         //
 
-        pthread_mutex_lock(&bc.mutex);
+        wells_region = bc.wells_prefetcher->GetNextRegion(wells_region);
+        if (wells_region == NULL)
+            return NULL;
 
-        int current_region, begin_x, begin_y, end_x, end_y;
-        if (not bc.chip_subset.GetCurrentRegionAndIncrement(current_region, begin_x, end_x, begin_y, end_y)) {
-           wells.Close();
-           pthread_mutex_unlock(&bc.mutex);
-           return NULL;
-        }
+        int current_region   = wells_region->region;
+        int begin_x          = wells_region->begin_x;
+        int begin_y          = wells_region->begin_y;
+        int end_x            = wells_region->end_x;
+        int end_y            = wells_region->end_y;
+        int num_usable_wells = wells_region->num_usable_wells;
+        const RawWells& wells = *wells_region->wells;
 
-        int num_usable_wells = 0;
-        for (int y = begin_y; y < end_y; ++y)
-            for (int x = begin_x; x < end_x; ++x)
-                if (bc.class_map[x + y * bc.chip_subset.GetChipSizeX()] >= 0)
-                    num_usable_wells++;
+        pthread_mutex_lock(&bc.mutex);
 
         if      (begin_x == 0)            printf("\n% 5d/% 5d: ", begin_y, bc.chip_subset.GetChipSizeY());
         if      (num_usable_wells ==   0) printf("  ");
@@ -686,11 +690,8 @@ void * BasecallerWorker(void *input)
             continue;
         }
 
-        wells.SetChunk(begin_y, end_y-begin_y, begin_x, end_x-begin_x, 0, num_flows);
-        wells.ReadWells();
-        //wells.ReadRes();
-        wells_norm.CorrectSignalBias(bc.keys);
-        wells_norm.DoKeyNormalization(bc.keys);
+        if (bc.metric_saver->save_anything())
+            bc.metric_saver->InitBlock(metric_block, begin_x, begin_y, end_x-begin_x, end_y-begin_y);
 
 
         for (int y = begin_y; y < end_y; ++y)
@@ -813,8 +814,7 @@ void * BasecallerWorker(void *input)
                 else
                   treephaser.SetModelParameters(cf, ie, dr);
 
-                // Execute vectorized basecaller version XXX
-#if defined( __SSE3__ )
+                // Execute vectorized basecaller version
                 if (bc.sse_dephaser) {
                   treephaser_sse.SetAsBs(aPtr, bPtr);  // Set/delete recalibration model for this read
                   treephaser_sse.SetModelParameters(cf, ie); // SSE version has no hook for droop.
@@ -840,7 +840,6 @@ void * BasecallerWorker(void *input)
                   treephaser_sse.ComputeQVmetrics_flow(read,flow_to_base,bc.flow_predictors_);
                   compute_base_calls = false;
                 }
-#endif
 
                 // Use CPP code version if we didn't already use vectorized code
                 if (compute_base_calls){
@@ -935,7 +934,8 @@ void * BasecallerWorker(void *input)
                     		homopolymer_rank_flow, // predictor4_flow
                     		//wells_residual, //added
                     		flow_to_base,
-                    		use_flow_predictors);
+                    		use_flow_predictors,
+                    		&nn_workspace);
                     if(bc.quality_generator.toSavePredictors()){
                     	bc.quality_generator.DumpPredictors(read_name, processed_read.filter.n_bases, num_flows,
                     			read.penalty_residual, local_noise, minus_noise_overlap, // <- predictors 1,2,3
@@ -1060,24 +1060,21 @@ void * BasecallerWorker(void *input)
                 }
 
                 //! New mechanism for dumping potentially useful metrics.
+                //! Metrics go to the worker's region block without locking, the saver's writer thread does the HDF5 I/O.
                 if (bc.metric_saver->save_anything() and (is_random_unfiltered or !bc.metric_saver->save_subset_only())) {
-                    pthread_mutex_lock(&bc.mutex);
-
-                    bc.metric_saver->SaveRawMeasurements          (y,x,read.raw_measurements);
-                    bc.metric_saver->SaveAdditiveCorrection       (y,x,read.additive_correction);
-                    bc.metric_saver->SaveMultiplicativeCorrection (y,x,read.multiplicative_correction);
-                    bc.metric_saver->SaveNormalizedMeasurements   (y,x,read.normalized_measurements);
-                    bc.metric_saver->SavePrediction               (y,x,read.prediction);
-                    bc.metric_saver->SaveStateInphase             (y,x,read.state_inphase);
-                    bc.metric_saver->SaveStateTotal               (y,x,read.state_total);
-                    bc.metric_saver->SavePenaltyResidual          (y,x,read.penalty_residual);
-                    bc.metric_saver->SavePenaltyMismatch          (y,x,read.penalty_mismatch);
-                    bc.metric_saver->SaveLocalNoise               (y,x,local_noise);
-                    bc.metric_saver->SaveNoiseOverlap             (y,x,minus_noise_overlap);
-                    bc.metric_saver->SaveHomopolymerRank          (y,x,homopolymer_rank);
-                    bc.metric_saver->SaveNeighborhoodNoise        (y,x,neighborhood_noise);
-
-                    pthread_mutex_unlock(&bc.mutex);
+                    metric_block.SaveRawMeasurements          (y,x,read.raw_measurements);
+                    metric_block.SaveAdditiveCorrection       (y,x,read.additive_correction);
+                    metric_block.SaveMultiplicativeCorrection (y,x,read.multiplicative_correction);
+                    metric_block.SaveNormalizedMeasurements   (y,x,read.normalized_measurements);
+                    metric_block.SavePrediction               (y,x,read.prediction);
+                    metric_block.SaveStateInphase             (y,x,read.state_inphase);
+                    metric_block.SaveStateTotal               (y,x,read.state_total);
+                    metric_block.SavePenaltyResidual          (y,x,read.penalty_residual);
+                    metric_block.SavePenaltyMismatch          (y,x,read.penalty_mismatch);
+                    metric_block.SaveLocalNoise               (y,x,local_noise);
+                    metric_block.SaveNoiseOverlap             (y,x,minus_noise_overlap);
+                    metric_block.SaveHomopolymerRank          (y,x,homopolymer_rank);
+                    metric_block.SaveNeighborhoodNoise        (y,x,neighborhood_noise);
                 }
 
 
@@ -1204,6 +1201,9 @@ void * BasecallerWorker(void *input)
                 }
             }
 
+        if (bc.metric_saver->save_anything())
+            bc.metric_saver->WriteBlock(metric_block);
+
         bc.lib_writer.WriteRegion(current_region, lib_reads);
         if (bc.have_calibration_panel)
             bc.calib_writer.WriteRegion(current_region, calib_reads);
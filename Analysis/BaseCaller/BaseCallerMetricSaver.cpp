@@ -9,6 +9,7 @@
 #include <string>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include "IonErr.h"
 
 
@@ -192,8 +193,194 @@ BaseCallerMetricSaver::BaseCallerMetricSaver(OptArgs& opts, int chip_size_x, int
     H5Pclose(dataset_properties_float);
     H5Pclose(dataset_properties_char);
   }
+
+  // Map block metrics to their datasets
+  bool enabled[BaseCallerMetricBlock::kNumMetrics] = {
+      save_raw_measurements_, save_additive_correction_, save_multiplicative_correction_,
+      save_normalized_measurements_, save_prediction_, save_state_inphase_, save_state_total_,
+      save_penalty_residual_, save_penalty_mismatch_, save_local_noise_, save_noise_overlap_,
+      save_homopolymer_rank_, save_neighborhood_noise_ };
+  hid_t datasets[BaseCallerMetricBlock::kNumMetrics] = {
+      dataset_raw_measurements_, dataset_additive_correction_, dataset_multiplicative_correction_,
+      dataset_normalized_measurements_, dataset_prediction_, dataset_state_inphase_, dataset_state_total_,
+      dataset_penalty_residual_, dataset_penalty_mismatch_, dataset_local_noise_, dataset_noise_overlap_,
+      dataset_homopolymer_rank_, dataset_neighborhood_noise_ };
+  for (int metric = 0; metric < BaseCallerMetricBlock::kNumMetrics; ++metric) {
+    block_enabled_[metric] = save_anything_ and enabled[metric];
+    block_dataset_[metric] = block_enabled_[metric] ? datasets[metric] : -1;
+  }
+
+  // Start the writer stage
+  pthread_mutex_init(&block_mutex_, NULL);
+  pthread_cond_init(&block_ready_cond_, NULL);
+  pthread_cond_init(&block_space_cond_, NULL);
+  writer_done_ = false;
+  writer_running_ = false;
+  if (save_anything_) {
+    if (pthread_create(&writer_thread_, NULL, WriterThread, this))
+      ION_ABORT("Could not start BaseCallerMetricSaver writer thread");
+    writer_running_ = true;
+  }
+}
+
+BaseCallerMetricSaver::~BaseCallerMetricSaver()
+{
+  // Close() normally stops the writer; don't leave it running on the destroyed mutex
+  StopWriter();
+  pthread_cond_destroy(&block_ready_cond_);
+  pthread_cond_destroy(&block_space_cond_);
+  pthread_mutex_destroy(&block_mutex_);
+}
+
+// ----------------------------------------------------------------------------
+// Region blocks
+
+void BaseCallerMetricBlock::Store(int metric, int y, int x, const vector<float>& values)
+{
+  vector<float>& data = data_[metric];
+  if (data.empty())
+    return;
+  int num_values = min(num_flows_, (int)values.size());
+  float *dst = &data[((y - begin_y_) * size_x_ + (x - begin_x_)) * num_flows_];
+  std::copy(values.begin(), values.begin() + num_values, dst);
+  saved_[metric][(y - begin_y_) * size_x_ + (x - begin_x_)] = 1;
+  ++num_saved_;
 }
 
+void BaseCallerMetricBlock::swap(BaseCallerMetricBlock& other)
+{
+  std::swap(begin_x_, other.begin_x_);
+  std::swap(begin_y_, other.begin_y_);
+  std::swap(size_x_, other.size_x_);
+  std::swap(size_y_, other.size_y_);
+  std::swap(num_flows_, other.num_flows_);
+  std::swap(num_saved_, other.num_saved_);
+  for (int metric = 0; metric < kNumMetrics; ++metric) {
+    data_[metric].swap(other.data_[metric]);
+    saved_[metric].swap(other.saved_[metric]);
+  }
+}
+
+void BaseCallerMetricSaver::InitBlock(BaseCallerMetricBlock& block, int begin_x, int begin_y, int size_x, int size_y) const
+{
+  block.begin_x_ = begin_x;
+  block.begin_y_ = begin_y;
+  block.size_x_ = size_x;
+  block.size_y_ = size_y;
+  block.num_flows_ = num_flows_;
+  block.num_saved_ = 0;
+  size_t block_size = (size_t)size_x * size_y * num_flows_;
+  float initializer_float = nan("");
+  for (int metric = 0; metric < BaseCallerMetricBlock::kNumMetrics; ++metric) {
+    if (block_enabled_[metric]) {
+      block.data_[metric].assign(block_size, initializer_float);
+      block.saved_[metric].assign((size_t)size_x * size_y, 0);
+    }
+    else {
+      block.data_[metric].clear();
+      block.saved_[metric].clear();
+    }
+  }
+}
+
+void BaseCallerMetricSaver::WriteBlock(BaseCallerMetricBlock& block)
+{
+  if (!save_anything_ or block.num_saved() == 0)
+    return;
+
+  pthread_mutex_lock(&block_mutex_);
+  while (pending_blocks_.size() >= kMaxPendingBlocks)
+    pthread_cond_wait(&block_space_cond_, &block_mutex_);
+  pending_blocks_.push_back(BaseCallerMetricBlock());
+  pending_blocks_.back().swap(block);
+  if (!recycled_blocks_.empty()) {
+    block.swap(recycled_blocks_.back());
+    recycled_blocks_.pop_back();
+  }
+  pthread_cond_signal(&block_ready_cond_);
+  pthread_mutex_unlock(&block_mutex_);
+}
+
+void * BaseCallerMetricSaver::WriterThread(void *arg)
+{
+  BaseCallerMetricSaver& saver = *static_cast<BaseCallerMetricSaver*>(arg);
+  BaseCallerMetricBlock block;
+
+  pthread_mutex_lock(&saver.block_mutex_);
+  while (true) {
+    while (saver.pending_blocks_.empty() and !saver.writer_done_)
+      pthread_cond_wait(&saver.block_ready_cond_, &saver.block_mutex_);
+    if (saver.pending_blocks_.empty())
+      break;
+    block.swap(saver.pending_blocks_.front());
+    saver.pending_blocks_.pop_front();
+    pthread_cond_signal(&saver.block_space_cond_);
+    pthread_mutex_unlock(&saver.block_mutex_);
+
+    saver.WriteBlockToFile(block);
+
+    pthread_mutex_lock(&saver.block_mutex_);
+    saver.recycled_blocks_.push_back(BaseCallerMetricBlock());
+    saver.recycled_blocks_.back().swap(block);
+  }
+  pthread_mutex_unlock(&saver.block_mutex_);
+  return NULL;
+}
+
+// One write per metric and region instead of one per metric and read
+void BaseCallerMetricSaver::WriteBlockToFile(const BaseCallerMetricBlock& block)
+{
+  hsize_t   block_dims[3] = {(hsize_t)block.size_y_, (hsize_t)block.size_x_, (hsize_t)block.num_flows_};
+  hid_t     dataspace_file = H5Scopy(dataspace_file_);
+  hid_t     dataspace_block = H5Screate_simple(3, block_dims, NULL);
+
+  for (int metric = 0; metric < BaseCallerMetricBlock::kNumMetrics; ++metric) {
+    if (!block_enabled_[metric] or block.data_[metric].empty())
+      continue;
+    if (!SelectSavedWells(block, metric, dataspace_file, dataspace_block))
+      continue;
+    H5Dwrite (block_dataset_[metric], H5T_NATIVE_FLOAT, dataspace_block, dataspace_file,
+           H5P_DEFAULT, &block.data_[metric][0]);
+  }
+  H5Sclose(dataspace_block);
+  H5Sclose(dataspace_file);
+}
+
+// Selects each row's runs of wells saved for the metric, at the same positions in the
+// file and the block dataspaces. With --save-subset-only most wells are left out, and
+// the file only gets chunks for the wells that were saved. False if none was.
+bool BaseCallerMetricSaver::SelectSavedWells(const BaseCallerMetricBlock& block, int metric,
+    hid_t dataspace_file, hid_t dataspace_block) const
+{
+  const vector<char>& saved = block.saved_[metric];
+  bool any_saved = false;
+  H5Sselect_none(dataspace_file);
+  H5Sselect_none(dataspace_block);
+
+  for (int y = 0; y < block.size_y_; ++y) {
+    const char *saved_row = &saved[y * block.size_x_];
+    int x = 0;
+    while (x < block.size_x_) {
+      if (!saved_row[x]) {
+        ++x;
+        continue;
+      }
+      int run_begin = x;
+      while (x < block.size_x_ and saved_row[x])
+        ++x;
+      hsize_t   block_start[3] = {(hsize_t)y, (hsize_t)run_begin, 0};
+      hsize_t   file_start[3] = {(hsize_t)(block.begin_y_ + y), (hsize_t)(block.begin_x_ + run_begin), 0};
+      hsize_t   run_count[3] = {1, (hsize_t)(x - run_begin), (hsize_t)block.num_flows_};
+      H5Sselect_hyperslab (dataspace_block, H5S_SELECT_OR, block_start, NULL, run_count, NULL);
+      H5Sselect_hyperslab (dataspace_file, H5S_SELECT_OR, file_start, NULL, run_count, NULL);
+      any_saved = true;
+    }
+  }
+  return any_saved;
+}
+
+// ----------------------------------------------------------------------------
+
 void BaseCallerMetricSaver::SaveRawMeasurements(int y, int x, const vector<float>& raw_measurements)
 {
   if (!save_raw_measurements_)
@@ -371,8 +558,24 @@ void BaseCallerMetricSaver::SaveNeighborhoodNoise(int y, int x, const vector<flo
 
 
 
+// Writes the blocks still queued and joins the writer thread
+void BaseCallerMetricSaver::StopWriter()
+{
+  if (!writer_running_)
+    return;
+  pthread_mutex_lock(&block_mutex_);
+  writer_done_ = true;
+  pthread_cond_signal(&block_ready_cond_);
+  pthread_mutex_unlock(&block_mutex_);
+  pthread_join(writer_thread_, NULL);
+  writer_running_ = false;
+  recycled_blocks_.clear();
+}
+
 void BaseCallerMetricSaver::Close()
 {
+  StopWriter();
+
   if (!save_anything_)
     return;
 
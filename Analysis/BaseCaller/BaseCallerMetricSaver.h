@@ -9,16 +9,86 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <pthread.h>
 #include "hdf5.h"
 #include "OptArgs.h"
 
 using namespace std;
 
 
+//! @brief    Region-local buffer of per-read metrics owned by one BaseCaller worker
+//! @ingroup  BaseCaller
+//! @details
+//! A worker fills the block for the wells of its current region without any locking
+//! and hands it to BaseCallerMetricSaver::WriteBlock when the region is done.
+//! Only the wells saved into the block are written, so the others keep the dataset
+//! fill value (NaN) and get no chunk in the file.
+
+class BaseCallerMetricBlock {
+public:
+  enum {
+    kRawMeasurements = 0,
+    kAdditiveCorrection,
+    kMultiplicativeCorrection,
+    kNormalizedMeasurements,
+    kPrediction,
+    kStateInphase,
+    kStateTotal,
+    kPenaltyResidual,
+    kPenaltyMismatch,
+    kLocalNoise,
+    kNoiseOverlap,
+    kHomopolymerRank,
+    kNeighborhoodNoise,
+    kNumMetrics
+  };
+
+  BaseCallerMetricBlock() : begin_x_(0), begin_y_(0), size_x_(0), size_y_(0), num_flows_(0), num_saved_(0) {}
+
+  void SaveRawMeasurements          (int y, int x, const vector<float>& v) { Store(kRawMeasurements, y, x, v); }
+  void SaveAdditiveCorrection       (int y, int x, const vector<float>& v) { Store(kAdditiveCorrection, y, x, v); }
+  void SaveMultiplicativeCorrection (int y, int x, const vector<float>& v) { Store(kMultiplicativeCorrection, y, x, v); }
+  void SaveNormalizedMeasurements   (int y, int x, const vector<float>& v) { Store(kNormalizedMeasurements, y, x, v); }
+  void SavePrediction               (int y, int x, const vector<float>& v) { Store(kPrediction, y, x, v); }
+  void SaveStateInphase             (int y, int x, const vector<float>& v) { Store(kStateInphase, y, x, v); }
+  void SaveStateTotal               (int y, int x, const vector<float>& v) { Store(kStateTotal, y, x, v); }
+  void SavePenaltyResidual          (int y, int x, const vector<float>& v) { Store(kPenaltyResidual, y, x, v); }
+  void SavePenaltyMismatch          (int y, int x, const vector<float>& v) { Store(kPenaltyMismatch, y, x, v); }
+  void SaveLocalNoise               (int y, int x, const vector<float>& v) { Store(kLocalNoise, y, x, v); }
+  void SaveNoiseOverlap             (int y, int x, const vector<float>& v) { Store(kNoiseOverlap, y, x, v); }
+  void SaveHomopolymerRank          (int y, int x, const vector<float>& v) { Store(kHomopolymerRank, y, x, v); }
+  void SaveNeighborhoodNoise        (int y, int x, const vector<float>& v) { Store(kNeighborhoodNoise, y, x, v); }
+
+  //! Number of metric vectors saved into the block since it was initialized
+  int  num_saved() const { return num_saved_; }
+
+  //! Exchange contents with another block without copying the buffers
+  void swap(BaseCallerMetricBlock& other);
+
+private:
+  friend class BaseCallerMetricSaver;
+
+  void Store(int metric, int y, int x, const vector<float>& values);
+
+  int             begin_x_;
+  int             begin_y_;
+  int             size_x_;
+  int             size_y_;
+  int             num_flows_;
+  int             num_saved_;
+  vector<float>   data_[kNumMetrics];     //!< size_y x size_x x num_flows per enabled metric, empty otherwise
+  vector<char>    saved_[kNumMetrics];    //!< size_y x size_x per enabled metric, 1 for the wells saved
+};
+
+
 class BaseCallerMetricSaver {
 public:
+  static const unsigned int kMaxPendingBlocks = 4;   //!< Filled blocks queued before WriteBlock waits for the writer
+
   BaseCallerMetricSaver(OptArgs& opts, int chip_size_x, int chip_size_y, int num_flows,
       int region_size_x, int region_size_y, const string& output_directory);
+  ~BaseCallerMetricSaver();
 
   void SaveRawMeasurements          (int y, int x, const vector<float>& raw_measurements);
   void SaveAdditiveCorrection       (int y, int x, const vector<float>& additive_correction);
@@ -35,6 +105,16 @@ public:
   void SaveHomopolymerRank          (int y, int x, const vector<float>& homopolymer_rank);
   void SaveNeighborhoodNoise        (int y, int x, const vector<float>& neighborhood_noise);
 
+  //! @brief  Prepare a worker's block for a new region, filling enabled metrics with NaN.
+  void InitBlock(BaseCallerMetricBlock& block, int begin_x, int begin_y, int size_x, int size_y) const;
+
+  //! @brief  Hand a finished region block to the writer thread.
+  //! @details The block contents are swapped into the writer queue and the caller gets a
+  //!          recycled block back, so buffers are reused. Workers only wait for HDF5 when
+  //!          kMaxPendingBlocks blocks are already queued, which bounds the memory held.
+  void WriteBlock(BaseCallerMetricBlock& block);
+
+  //! Drain the writer queue, stop the writer thread, and close the HDF5 file.
   void Close();
 
   static void PrintHelp();
@@ -88,6 +168,23 @@ protected:
   hid_t   dataset_noise_overlap_;
   hid_t   dataset_homopolymer_rank_;
 
+  // Writer stage for region blocks
+  static void * WriterThread(void *arg);
+  void    StopWriter();
+  void    WriteBlockToFile(const BaseCallerMetricBlock& block);
+  bool    SelectSavedWells(const BaseCallerMetricBlock& block, int metric, hid_t dataspace_file, hid_t dataspace_block) const;
+
+  bool    block_enabled_[BaseCallerMetricBlock::kNumMetrics];   //!< Metric is saved through region blocks
+  hid_t   block_dataset_[BaseCallerMetricBlock::kNumMetrics];   //!< Dataset for each block metric
+
+  pthread_t                       writer_thread_;
+  bool                            writer_running_;
+  bool                            writer_done_;
+  pthread_mutex_t                 block_mutex_;         //!< Protects pending_blocks_, recycled_blocks_, writer_done_
+  pthread_cond_t                  block_ready_cond_;    //!< Signals the writer that blocks are pending
+  pthread_cond_t                  block_space_cond_;    //!< Signals workers that the writer took a block off the queue
+  deque<BaseCallerMetricBlock>    pending_blocks_;      //!< Filled blocks waiting to be written
+  vector<BaseCallerMetricBlock>   recycled_blocks_;     //!< Written blocks whose buffers can be reused
 
 };
 
@@ -116,6 +116,7 @@ void BaseCallerParameters::PrintHelp()
     printf ("     --flow-order            STRING     flow order [retrieved from wells file]\n");
     printf ("     --run-id                STRING     read name prefix [hashed input dir name]\n");
     printf ("  -n,--num-threads           INT        number of worker threads [2*numcores]\n");
+    printf ("     --wells-prefetch        INT        number of wells regions read ahead of the worker threads, 0=off [4]\n");
     printf ("     --compress-bam          BOOL       Output compressed / uncompressed BAM [true]\n");
     printf ("  -f,--flowlimit             INT        basecall only first n flows [all flows]\n");
     printf ("     --keynormalizer         STRING     key normalization algorithm [gain]\n");
@@ -260,6 +261,7 @@ bool BaseCallerParameters::InitContextVarsFromOptArgs(OptArgs& opts){
     context_vars.run_id                      = opts.GetFirstString ('-', "run-id", default_run_id);
 	num_threads_                             = opts.GetFirstInt    ('n', "num-threads", max(2*numCores(), 4));
 	num_bamwriter_threads_                   = opts.GetFirstInt    ('-', "num-threads-bamwriter", 0);
+	wells_prefetch_depth_                    = max(opts.GetFirstInt('-', "wells-prefetch", 4), 0);
 	compress_output_bam_                     = opts.GetFirstBoolean('-', "compress-bam", true);
 
     context_vars.flow_signals_type           = opts.GetFirstString ('-', "flow-signals-type", "none");
@@ -417,6 +419,7 @@ bool BaseCallerParameters::SaveParamsToJson(Json::Value& basecaller_json, const
     basecaller_json["BaseCaller"]["filename_wells"] = bc_files.filename_wells;
     basecaller_json["BaseCaller"]["filename_mask"] = bc_files.filename_mask;
     basecaller_json["BaseCaller"]["num_threads"] = num_threads_;
+    basecaller_json["BaseCaller"]["wells_prefetch"] = wells_prefetch_depth_;
     basecaller_json["BaseCaller"]["dephaser"] = bc.dephaser;
     basecaller_json["BaseCaller"]["keynormalizer"] = bc.keynormalizer;
     basecaller_json["BaseCaller"]["block_row_offset"] = bc.chip_subset.GetRowOffset();
@@ -50,6 +50,7 @@ using namespace std;
 class HistogramCalibration;
 class LinearCalibrationModel;
 class MolecularTagTrimmer;
+class WellsPrefetcher;
 
 //! @brief    Verify path exists and if it does, canonicalize it
 //! @ingroup  BaseCaller
@@ -173,6 +174,7 @@ struct BaseCallerContext {
     HistogramCalibration      *histogram_calibration; //!< Posterior base call and signal adjustment algorithm
     LinearCalibrationModel    *linear_cal_model;      //!< Model estimation of simulated predictions and observed measurements
     MolecularTagTrimmer       *tag_trimmer;           //!< Class for tag accounting within read groups
+    WellsPrefetcher           *wells_prefetcher;      //!< Reads wells regions ahead of the workers
 
     // Threaded processing
     pthread_mutex_t           mutex;                  //!< Shared read/write mutex for BaseCaller worker threads
@@ -198,6 +200,7 @@ public:
     BaseCallerParameters() {
       num_threads_              = 1;
       num_bamwriter_threads_    = 1;
+      wells_prefetch_depth_     = 0;
       compress_output_bam_      = true;
       bc_files.options_set      = false;
       sampling_opts.options_set = false;
@@ -242,11 +245,13 @@ public:
 
     int NumThreads()          const { return num_threads_; };
     int NumBamWriterThreads() const { return num_bamwriter_threads_; };
+    int WellsPrefetchDepth()  const { return wells_prefetch_depth_; };
 
 private:
 
     int                 num_threads_;              //!< Number of worker threads to do base calling
     int                 num_bamwriter_threads_;    //!< Number of threads one bam writer object uses
+    int                 wells_prefetch_depth_;     //!< Number of wells regions read ahead of the workers
     bool                compress_output_bam_;      //!< Switch to output compressed / uncompressed BAM
 
     BaseCallerFiles     bc_files;
@@ -7,6 +7,9 @@
 #include <string>
 #include "IonErr.h"
 #include <hdf5.h>
+#include <malloc.h>
+#include <string.h>
+#include "Vecs.h"
 
 
 #include <Eigen/Dense>
@@ -48,22 +51,59 @@ vector<float> NN::NNModel::CalculateOutput(NN::DataChunk* pred){
 	// last layer
 	vector<float> flat_out = output->GetData();
 	// Default Activation - softmax
-	cout << flat_out[0] <<endl;
-	float sum = 0.0;
-	for(unsigned int j = 0; j < flat_out.size(); j++) {
-		if (flat_out[j] < 10)
-			flat_out[j] = exp(flat_out[j]);
-		else
-			flat_out[j] = exp(10);
-		sum += flat_out[j];
-	}
-	for(unsigned int j = 0; j < flat_out.size(); ++j) {
-		flat_out[j] /= sum;
-	}
+	//cout << flat_out[0] <<endl;
+	NN::SoftMax(flat_out.data(), (int)flat_out.size());
 	delete output;
 	return flat_out;
 }
 
+int NN::NNModel::GetOutputLength() const {
+	return m_Layers.empty() ? 0 : m_Layers.back()->GetOutputLength();
+}
+
+const float* NN::NNModel::CalculateOutputBatch(const float* input, int num_samples, NN::NNWorkspace& workspace) const {
+	int num_out = GetOutputLength();
+	workspace.output.resize((size_t)num_samples * num_out);
+	if (num_samples <= 0 or m_Layers.empty())
+		return workspace.output.data();
+
+	int max_stride = 0;
+	for(unsigned int i = 0; i < m_Layers.size(); ++i)
+		max_stride = max(max_stride, m_Layers[i]->GetOutputStride());
+	workspace.Reserve((size_t)num_samples * max_stride);
+
+	// Ping-pong between the two activation buffers, one layer at a time
+	const float *x = input;
+	int x_stride = GetInputLength();
+	float *y = NULL;
+	for(unsigned int i = 0; i < m_Layers.size(); ++i){
+		y = workspace.Buffer(i & 1);
+		m_Layers[i]->GetOutputBatch(x, x_stride, num_samples, y);
+		x = y;
+		x_stride = m_Layers[i]->GetOutputStride();
+	}
+
+	// Default Activation - softmax
+	float *out = workspace.output.data();
+	for(int s = 0; s < num_samples; ++s){
+		memcpy(out + s * num_out, y + s * x_stride, num_out * sizeof(float));
+		NN::SoftMax(out + s * num_out, num_out);
+	}
+	return out;
+}
+
+void NN::NNWorkspace::Reserve(size_t num_floats){
+	if (num_floats <= capacity_)
+		return;
+	for(int i = 0; i < 2; ++i){
+		free(buffer_[i]);
+		buffer_[i] = (float *) memalign(VEC8F_SIZE_B, sizeof(float) * num_floats);
+		if (buffer_[i] == NULL)
+			ION_ABORT("ERROR: NNWorkspace failed to allocate activation buffer");
+	}
+	capacity_ = num_floats;
+}
+
 void NN::NNModel::LoadWeights(const string &fname) {
 	Layer *l = NULL;
 
@@ -243,6 +283,28 @@ void NN::DenseLayer::LoadWeights(const string &fname){
 	mBias.resize(dim[1]);
 	copy(bias , bias + dim[1], mBias.begin());
 	delete [] bias;
+
+	// Pack the weights into one aligned row-major block for the batched path
+	mRows = (int)mWeights.size();
+	mCols = mRows > 0 ? (int)mWeights[0].size() : 0;
+	mStride = ((mCols + VEC8_SIZE - 1) / VEC8_SIZE) * VEC8_SIZE;
+	free(mPackedWeights);
+	free(mPackedBias);
+	mPackedWeights = (float *) memalign(VEC8F_SIZE_B, sizeof(float) * max(1, mRows * mStride));
+	mPackedBias = (float *) memalign(VEC8F_SIZE_B, sizeof(float) * max(1, mStride));
+	if (mPackedWeights == NULL or mPackedBias == NULL)
+		ION_ABORT("ERROR: fail to allocate packed layer weights");
+	memset(mPackedWeights, 0, sizeof(float) * mRows * mStride);
+	memset(mPackedBias, 0, sizeof(float) * mStride);
+	for(int i = 0; i < mRows; ++i)
+		copy(mWeights[i].begin(), mWeights[i].end(), mPackedWeights + i * mStride);
+	for(int k = 0; k < mCols and k < (int)mBias.size(); ++k)
+		mPackedBias[k] = mBias[k];
+}
+
+NN::DenseLayer::~DenseLayer(){
+	free(mPackedWeights);
+	free(mPackedBias);
 }
 
 NN::DataChunk* NN::DenseLayer::GetOutput(NN::DataChunk* pred){
@@ -274,6 +336,37 @@ NN::DataChunk* NN::DenseLayer::GetOutput(NN::DataChunk* pred){
 	return output;
 }
 
+// Samples are processed in tiles small enough for the tile's output rows to stay in L1
+// while every weight row is streamed once per tile. Each output is accumulated over the
+// weight rows in the same order and with the same separate multiply/add as GetOutput(),
+// so the batched results are bit-identical to the single-sample path.
+void NN::DenseLayer::GetOutputBatch(const float* x, int x_stride, int num_samples, float* y) const{
+	const int kSampleTile = 16;
+	const int num_vec = mStride / VEC8_SIZE;
+
+	for(int s0 = 0; s0 < num_samples; s0 += kSampleTile){
+		int s1 = min(num_samples, s0 + kSampleTile);
+		memset(y + (size_t)s0 * mStride, 0, sizeof(float) * (s1 - s0) * mStride);
+
+		for(int i = 0; i < mRows; ++i){
+			const v8f * w = (const v8f *)(mPackedWeights + i * mStride);
+			for(int s = s0; s < s1; ++s){
+				v8f xi = LD_VEC8F(x[(size_t)s * x_stride + i]);
+				v8f * ys = (v8f *)(y + (size_t)s * mStride);
+				for(int j = 0; j < num_vec; ++j)
+					ys[j] += w[j] * xi;
+			}
+		}
+
+		const v8f * b = (const v8f *)mPackedBias;
+		for(int s = s0; s < s1; ++s){
+			v8f * ys = (v8f *)(y + (size_t)s * mStride);
+			for(int j = 0; j < num_vec; ++j)
+				ys[j] += b[j];
+		}
+	}
+}
+
 void NN::DenseLayer::SetDim(const vector<int> dims){
 	mDim1 = dims.at(0);
 	mDim2 = dims.at(1);
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <iostream>
 #include <stdlib.h>
+#include <math.h>
 
 using namespace std;
 
@@ -20,6 +21,23 @@ namespace NN{
 	class Layer;
 	class DenseLayer;
 	class DataChunk;
+	class NNWorkspace;
+
+	//! @brief  Softmax with clipped exponent, shared by the single-sample and the batched path
+	//!         so that both produce bit-identical probabilities.
+	inline void SoftMax(float* v, int n){
+		float sum = 0.0;
+		for(int j = 0; j < n; j++) {
+			if (v[j] < 10)
+				v[j] = exp(v[j]);
+			else
+				v[j] = exp(10);
+			sum += v[j];
+		}
+		for(int j = 0; j < n; ++j) {
+			v[j] /= sum;
+		}
+	}
 }
 
 class NN::NNModel{
@@ -28,9 +46,19 @@ public:
 	NNModel(const string &fname);
 	~NNModel();
 	vector<float>  CalculateOutput(NN::DataChunk* pred);
-	int GetInputLength(){
+
+	//! @brief  Evaluate the network for a batch of samples in one pass over the weights.
+	//!         Results are bit-identical to calling CalculateOutput() once per sample.
+	//! @param[in]  input        Row-major num_samples x GetInputLength() predictor matrix
+	//! @param[in]  num_samples  Number of samples (e.g. all flows of a read)
+	//! @param[in]  workspace    Per-thread activation buffers, grown on demand and reused across calls
+	//! @return     Row-major num_samples x GetOutputLength() softmax probabilities, owned by workspace
+	const float* CalculateOutputBatch(const float* input, int num_samples, NN::NNWorkspace& workspace) const;
+
+	int GetInputLength() const {
 		return (int)layerDimIn_[0];
 	};
+	int GetOutputLength() const;
 
 private:
 	void LoadWeights(const string &fname);
@@ -50,6 +78,12 @@ public:
 	virtual void SetName(int name) = 0;
 	virtual void SetDim(const vector<int> dims) = 0;
 	virtual NN::DataChunk* GetOutput(NN::DataChunk* pred) = 0;
+	//! Batched forward pass: y[s] = x[s] * W + b for num_samples rows of x (stride x_stride) into y (stride GetOutputStride())
+	virtual void GetOutputBatch(const float* x, int x_stride, int num_samples, float* y) const = 0;
+	//! Number of valid outputs per sample
+	virtual int GetOutputLength() const = 0;
+	//! Row stride of the batched output, padded to the SIMD width
+	virtual int GetOutputStride() const = 0;
 
 	//virtual unsigned int GetRows() const = 0;
 	//virtual unsigned int GetCols() const = 0;
@@ -59,14 +93,27 @@ public:
 
 class NN::DenseLayer : public Layer{
 public:
+	DenseLayer() : mPackedWeights(NULL), mPackedBias(NULL), mRows(0), mCols(0), mStride(0) {}
+	~DenseLayer();
 
 	void LoadWeights(const string &fname);
 	void SetName(int name);
 	void SetDim(const vector<int> dims);
 	NN::DataChunk* GetOutput(NN::DataChunk* pred);
+	void GetOutputBatch(const float* x, int x_stride, int num_samples, float* y) const;
+	int GetOutputLength() const { return mCols; }
+	int GetOutputStride() const { return mStride; }
 	std::vector<std::vector<float> > mWeights;
 	std::vector<float> mBias;
 
+	// Contiguous row-major copy of mWeights (mRows x mStride) and mBias, zero padded
+	// to a multiple of the SIMD width and aligned for vector loads.
+	float* mPackedWeights;
+	float* mPackedBias;
+	int mRows;
+	int mCols;
+	int mStride;
+
 	//virtual unsigned int GetRows() const { return 1; }
 	//virtual unsigned int GetCols() const { return dim1; }
 	//virtual unsigned int GetOuputs() const { return dim2; }
@@ -77,6 +124,25 @@ public:
 	int mName;
 };
 
+//! @brief  Per-thread activation buffers for NNModel::CalculateOutputBatch
+//! @details Buffers only grow, so a worker that keeps one workspace does not allocate per read.
+class NN::NNWorkspace{
+public:
+	NNWorkspace() : capacity_(0) { buffer_[0] = buffer_[1] = NULL; }
+	~NNWorkspace() { free(buffer_[0]); free(buffer_[1]); }
+	//! Make sure both ping-pong buffers hold at least num_floats values
+	void Reserve(size_t num_floats);
+	float* Buffer(int i) { return buffer_[i]; }
+	vector<float> input;    //!< Staging area for the caller's predictor matrix
+	vector<float> output;   //!< Softmax probabilities of the last batch
+
+private:
+	NNWorkspace(const NNWorkspace&);
+	NNWorkspace& operator=(const NNWorkspace&);
+	float* buffer_[2];
+	size_t capacity_;
+};
+
 class NN::DataChunk{  // only one dimensional data for now
 public:
 	DataChunk(void){}
@@ -0,0 +1,85 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     NNModelSpeed.cpp
+//! @ingroup  BaseCaller
+//! @brief    NNModelSpeed. Microbenchmark of per-flow network model QV inference,
+//!           single-sample NNModel::CalculateOutput against NNModel::CalculateOutputBatch
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "NNModel.h"
+#include "Utils.h"
+
+using namespace std;
+
+void PrintUsage()
+{
+  printf ("Usage: NNModelSpeed nnmodel.h5 [num_reads=2000] [num_flows=500]\n");
+  printf ("  Evaluates random predictors for num_reads reads of num_flows flows each,\n");
+  printf ("  reports reads/sec of the single-sample and the batched path and checks\n");
+  printf ("  that both produce bit-identical probabilities.\n");
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  string model_file = argv[1];
+  int num_reads = argc > 2 ? atoi(argv[2]) : 2000;
+  int num_flows = argc > 3 ? atoi(argv[3]) : 500;
+  if (num_reads <= 0 or num_flows <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  NN::NNModel model(model_file);
+  int num_in = model.GetInputLength();
+  int num_out = model.GetOutputLength();
+
+  // Predictors are drawn once per read position and shared by all reads,
+  // this keeps the random number generator out of the timed loops.
+  vector<float> predictors(num_flows * num_in);
+  srand48(42);
+  for (unsigned int i = 0; i < predictors.size(); ++i)
+    predictors[i] = (float)(4.0 * drand48() - 1.0);
+
+  // Single-sample path, as used by PerBaseQual::CalculatePerFlowScoreNN
+  vector<float> reference(num_flows);
+  Timer timer;
+  for (int read = 0; read < num_reads; ++read) {
+    for (int flow = 0; flow < num_flows; ++flow) {
+      NN::DataChunk input;
+      input.SetData(vector<float>(predictors.begin() + flow * num_in, predictors.begin() + (flow + 1) * num_in));
+      vector<float> output = model.CalculateOutput(&input);
+      reference[flow] = output[0];
+    }
+  }
+  double single_time = timer.elapsed();
+
+  // Batched path, one call per read with a reused workspace
+  NN::NNWorkspace workspace;
+  const float *batch = NULL;
+  timer.restart();
+  for (int read = 0; read < num_reads; ++read)
+    batch = model.CalculateOutputBatch(&predictors[0], num_flows, workspace);
+  double batch_time = timer.elapsed();
+
+  int num_mismatches = 0;
+  for (int flow = 0; flow < num_flows; ++flow)
+    if (memcmp(&reference[flow], &batch[flow * num_out], sizeof(float)) != 0)
+      ++num_mismatches;
+
+  printf ("NNModelSpeed: %d reads x %d flows, %d inputs, %d outputs\n", num_reads, num_flows, num_in, num_out);
+  printf ("  single-sample : %8.3f s  %12.1f reads/sec\n", single_time, num_reads / max(single_time, 1e-9));
+  printf ("  batched       : %8.3f s  %12.1f reads/sec\n", batch_time, num_reads / max(batch_time, 1e-9));
+  printf ("  speedup       : %8.2fx\n", single_time / max(batch_time, 1e-9));
+  printf ("  mismatching flows: %d\n", num_mismatches);
+
+  return num_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -12,18 +12,20 @@
 #include <algorithm>
 #include <iostream>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "ChipIdDecoder.h"
 #include "Utils.h"
 #include "IonErr.h"
 #include "NNModel.h"
+#include "Vecs.h"
 #include <hdf5.h>
 
 using namespace std;
 
 
 PerBaseQual::PerBaseQual()
-: phred_table_(0), save_predictors_(false)
+: phred_table_(0), lookup_cuts_(0), lookup_nan_bin_(0), save_predictors_(false)
 {
   phred_thresholds_.resize(kNumPredictors);
   phred_thresholds_max_.resize(kNumPredictors);
@@ -34,11 +36,7 @@ PerBaseQual::PerBaseQual()
 
 PerBaseQual::~PerBaseQual()
 {
-  if(phred_table_)
-  {
-    delete [] phred_table_;
-    phred_table_ = 0;
-  }
+  FreeLookupTables();
 
   if (save_predictors_)
     predictor_dump_.close();
@@ -61,11 +59,7 @@ void PerBaseQual::PrintHelp()
 
 void PerBaseQual::Init(OptArgs& opts, const string& chip_type, const string &input_directory, const string &output_directory, bool recalib)
 {
-  if(phred_table_)
-  {
-    delete [] phred_table_;
-    phred_table_ = 0;
-  }
+  FreeLookupTables();
 
   flow_predictor_              	= opts.GetFirstBoolean('-', "flow-predictors", false);
   string phred_table_file       = opts.GetFirstString ('-', "phred-table-file", "");
@@ -144,6 +138,7 @@ void PerBaseQual::Init(OptArgs& opts, const string& chip_type, const string &inp
   }
 
   bool binTable = true;
+  size_t table_size = 0;
   char *full_filename = NULL;
   if(load_phred_table_){  // phredtable based method
 	  if (phred_table_file.empty()) { // no phred table specified via the --phred-table-file option
@@ -279,6 +274,7 @@ void PerBaseQual::Init(OptArgs& opts, const string& chip_type, const string &inp
 		  hsize_t tbSize = H5Dget_storage_size(dsQvs);
 
 		  phred_table_ = new unsigned char[tbSize];
+		  table_size = tbSize;
 
 		  ret = H5Dread(dsQvs, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, phred_table_);
 		  H5Dclose(dsQvs);
@@ -413,6 +409,7 @@ void PerBaseQual::Init(OptArgs& opts, const string& chip_type, const string &inp
 
 		  phred_table_ = new unsigned char[tbSize];
 		  memcpy(phred_table_, ptr, tbSize * sizeof(unsigned char));
+		  table_size = tbSize;
 
 		  delete [] tbBlock;
 		  tbBlock = 0;
@@ -458,6 +455,7 @@ void PerBaseQual::Init(OptArgs& opts, const string& chip_type, const string &inp
 		for (int k = 0; k < kNumPredictors; ++k)
 		  phred_thresholds_max_[k] = *max_element(phred_thresholds_[k].begin(), phred_thresholds_[k].end());
 	  }
+	  PrepareLookupTables(table_size);
   }
   // Prepare for predictor dump here
 
@@ -481,101 +479,163 @@ void PerBaseQual::GetErrorDistribution(vector<vector<float>> & target){
 	target = errD_table_;
 }
 
-inline size_t GetIndex(const float predVal, const vector<float>& thresholds)
+// ----------------------------------------------------------------------------
+// Lookup tables. Both table formats are served by one direct lookup: each predictor is quantized
+// against its cuts and the bins index phred_table_, which is kept in 64 byte aligned memory.
+
+static void * AllocateAligned(size_t size)
 {
-  if(predVal >= thresholds.back())
-  {
-    return (thresholds.size() - 1);
-  }
+  void *memory = NULL;
+  if (posix_memalign(&memory, 64, max(size, (size_t)64)))
+    ION_ABORT("ERROR: PerBaseQual failed to allocate lookup tables");
+  return memory;
+}
 
-  size_t l = 0;
-  size_t r = thresholds.size() - 1;
-  size_t m = l;
-  while(r > l)
-  {
-    m = (r + l) >> 1;
-    if(m == l)
-    {
-      if(predVal <= thresholds[l])
-      {
-        return l;
-      }
-      else
-      {
-        return r;
-      }
-    }
+size_t PerBaseQual::ConvertLegacyTable()
+{
+  // Whether a predictor passes a threshold only depends on where it falls among the distinct
+  // thresholds of that predictor, so these become the cuts of an equivalent binary table.
+  // Values above the largest threshold were clipped to it, which lands them in the last bin.
+  int num_phred_cuts = phred_quality_.size();
+  if (num_phred_cuts == 0)
+    ION_ABORT("ERROR: Phred table has no entries");
+
+  phred_cuts_.assign(kNumPredictors, vector<float>());
+  offsets_.assign(kNumPredictors, 1);
+  size_t table_size = 1;
+  for (int k = kNumPredictors - 1; k >= 0; --k) {
+    phred_cuts_[k] = phred_thresholds_[k];
+    sort(phred_cuts_[k].begin(), phred_cuts_[k].end());
+    phred_cuts_[k].erase(unique(phred_cuts_[k].begin(), phred_cuts_[k].end()), phred_cuts_[k].end());
+    offsets_[k] = table_size;
+    table_size *= phred_cuts_[k].size();
+    if (table_size > (size_t)INT32_MAX)
+      ION_ABORT("ERROR: Phred table has too many distinct thresholds");
+  }
 
-    if(predVal == thresholds[m])
-    {
-      return m;
-    }
-    else if(predVal > thresholds[m])
-    {
-      l = m;
-    }
-    else
-    {
-      r = m;
-    }
+  // first_row[cell] is the earliest row whose thresholds all pass for the predictor bins of cell.
+  // A row passes exactly the cells at or below its own thresholds in every predictor, so each
+  // row is placed at its own cell and the minimum is swept down along one predictor at a time.
+  vector<int> first_row(table_size, num_phred_cuts);
+  for (int j = num_phred_cuts - 1; j >= 0; --j) {
+    size_t cell = 0;
+    for (int k = 0; k < kNumPredictors; ++k)
+      cell += (lower_bound(phred_cuts_[k].begin(), phred_cuts_[k].end(), phred_thresholds_[k][j]) - phred_cuts_[k].begin()) * offsets_[k];
+    first_row[cell] = j;
+  }
+  for (int k = 0; k < kNumPredictors; ++k) {
+    size_t last_bin = phred_cuts_[k].size() - 1;
+    for (size_t cell = table_size; cell-- > 0; )
+      if ((cell / offsets_[k]) % phred_cuts_[k].size() < last_bin)
+        first_row[cell] = min(first_row[cell], first_row[cell + offsets_[k]]);
   }
 
-  return r;
+  phred_table_ = new unsigned char[table_size];
+  for (size_t cell = 0; cell < table_size; ++cell)
+    phred_table_[cell] = (first_row[cell] < num_phred_cuts) ? phred_quality_[first_row[cell]] : kMinQuality;
+  return table_size;
 }
 
-
-uint8_t PerBaseQual::CalculatePerBaseScore(float* pred) const
+void PerBaseQual::PrepareLookupTables(size_t table_size)
 {
-  if(phred_table_)
-  {
-    size_t index = 0;
-    vector<size_t> vind;
-    for(int i = 0; i < kNumPredictors; ++i)
-    {
-      size_t indi = GetIndex(pred[i], phred_cuts_[i]);
-      vind.push_back(indi);
-      index += (indi * offsets_[i]);
-    }
-    return phred_table_[index];
+  // Binary tables used to be looked up by a binary search that put NaN in bin 1.
+  // NaN passed every threshold of a legacy table, which is bin 0.
+  lookup_nan_bin_ = 1;
+  if (not phred_table_) {
+    table_size = ConvertLegacyTable();
+    lookup_nan_bin_ = 0;
   }
-  else
-  {
-    int num_phred_cuts = phred_quality_.size(); // number of rows/lines in the table
 
-    for (int k = 0; k < kNumPredictors; k++)
-      pred[k] = min(pred[k], phred_thresholds_max_[k]);
+  size_t expected_size = 1;
+  int num_cuts = 0;
+  for (int k = 0; k < kNumPredictors; ++k) {
+    // Bins are found by counting the cuts below a value, which needs increasing cuts
+    for (size_t j = 1; j < phred_cuts_[k].size(); ++j)
+      if (not (phred_cuts_[k][j] > phred_cuts_[k][j-1]))
+        ION_ABORT("ERROR: Phred table thresholds of predictor " + ToStr(k) + " are not increasing");
+    if (phred_cuts_[k].empty() or offsets_[k] > (size_t)INT32_MAX)
+      ION_ABORT("ERROR: Wrong QV table size");
+    lookup_cut_begin_[k] = num_cuts;
+    lookup_num_cuts_[k] = phred_cuts_[k].size();
+    lookup_offsets_[k] = offsets_[k];
+    num_cuts += phred_cuts_[k].size();
+    expected_size *= phred_cuts_[k].size();
+  }
+  if (table_size != expected_size)
+    ION_ABORT("ERROR: Wrong QV table size");
 
-    for ( int j = 0; j < num_phred_cuts; ++j )
-    {
-      bool valid_cut = true;
-
-      for ( int k = 0; k < kNumPredictors; ++k )
-      {
-        if (pred[k] > phred_thresholds_[k][j])
-        {
-          valid_cut = false;
-          break;
-        }
-      }
+  lookup_cuts_ = (float*)AllocateAligned(num_cuts * sizeof(float));
+  for (int k = 0; k < kNumPredictors; ++k)
+    copy(phred_cuts_[k].begin(), phred_cuts_[k].end(), lookup_cuts_ + lookup_cut_begin_[k]);
 
-      if (valid_cut)
-        return phred_quality_[j];
-    }
+  unsigned char *aligned_table = (unsigned char*)AllocateAligned(table_size);
+  memcpy(aligned_table, phred_table_, table_size);
+  delete [] phred_table_;
+  phred_table_ = aligned_table;
+}
+
+void PerBaseQual::FreeLookupTables()
+{
+  free(phred_table_);
+  free(lookup_cuts_);
+  phred_table_ = 0;
+  lookup_cuts_ = 0;
+}
 
-    return kMinQuality; //minimal quality score
+
+void PerBaseQual::CalculateScores(const float* pred, int stride, int num_bases, uint8_t* quality) const
+{
+  const v4f *pred_blocks = (const v4f*)pred;
+  int num_blocks = stride / 4;
+
+  // Quantize four bases at a time. The bin of a value is the number of cuts below it,
+  // capped at the last bin.
+  for (int block = 0; block * 4 < num_bases; ++block) {
+    v4i index = LD_VEC4I(0);
+    for (int k = 0; k < kNumPredictors; ++k) {
+      v4f value = pred_blocks[k * num_blocks + block];
+      const float *cuts = lookup_cuts_ + lookup_cut_begin_[k];
+      v4i bin = (v4i)(value != value) & LD_VEC4I(lookup_nan_bin_);
+      for (int j = 0; j < lookup_num_cuts_[k]; ++j)
+        bin -= (v4i)(value > LD_VEC4F(cuts[j]));
+      v4i last_bin = LD_VEC4I(lookup_num_cuts_[k] - 1);
+      v4i over = (v4i)(bin > last_bin);
+      bin = (bin & ~over) | (last_bin & over);
+      index += bin * LD_VEC4I(lookup_offsets_[k]);
+    }
+    for (int lane = 0; lane < 4 and block * 4 + lane < num_bases; ++lane)
+      quality[block * 4 + lane] = phred_table_[index[lane]];
   }
 }
 
+
+uint8_t PerBaseQual::CalculatePerBaseScore(float* pred) const
+{
+  v4f block[kNumPredictors];
+  memset(block, 0, sizeof(block));
+  for(int k = 0; k < kNumPredictors; ++k)
+    block[k][0] = pred[k];
+  uint8_t quality;
+  CalculateScores((const float*)block, 4, 1, &quality);
+  return quality;
+}
+
 uint8_t PerBaseQual::CalculatePerFlowScoreNN(float* pred) const
 {
 	int numPred = int(kNumPredictorsFlowNN);
 	vector<float> in(pred , pred + numPred);
-	float qv = 0.0;
 	NN::DataChunk *input = new NN::DataChunk();
 	input->SetData(in);
 	vector<float> output = model_->CalculateOutput(input);
-	if (output[0] > 0)
-		qv = -10 * log10(output[0]);
+	delete input;
+	return NNProbabilityToQuality(output[0]);
+}
+
+uint8_t PerBaseQual::NNProbabilityToQuality(float p)
+{
+	float qv = 0.0;
+	if (p > 0)
+		qv = -10 * log10(p);
 	unsigned char qvc = (unsigned char)(qv + 0.5);
 	if (qvc > QV_MAX)
 		qvc = QV_MAX;
@@ -583,45 +643,7 @@ uint8_t PerBaseQual::CalculatePerFlowScoreNN(float* pred) const
 }
 uint8_t PerBaseQual::CalculatePerFlowScore(float* pred) const
 {
-  if(phred_table_)
-  {
-    size_t index = 0;
-    vector<size_t> vind;
-    for(int i = 0; i < kNumPredictors; ++i)
-    {
-      size_t indi = GetIndex(pred[i], phred_cuts_[i]);
-      vind.push_back(indi);
-      index += (indi * offsets_[i]);
-
-    }
-    return phred_table_[index];
-  }
-  else
-  {
-    int num_phred_cuts = phred_quality_.size(); // number of rows/lines in the table
-
-    for (int k = 0; k < kNumPredictors; k++)
-      pred[k] = min(pred[k], phred_thresholds_max_[k]);
-
-    for ( int j = 0; j < num_phred_cuts; ++j )
-    {
-      bool valid_cut = true;
-
-      for ( int k = 0; k < kNumPredictors; ++k )
-      {
-        if (pred[k] > phred_thresholds_[k][j])
-        {
-          valid_cut = false;
-          break;
-        }
-      }
-
-      if (valid_cut)
-        return phred_quality_[j];
-
-    }
-    return kMinQuality; //minimal quality score
-  }
+  return CalculatePerBaseScore(pred);
 }
 
 // Predictor 2 - Local noise/flowalign - Maximum residual within +-1 BASE
@@ -837,6 +859,11 @@ void PerBaseQual::GenerateBaseQualities(const string& read_name, int num_bases,
 	stringstream predictor_dump_block;
 	//copy(quality.begin(), quality.end(), ostream_iterator<char>(predictor_dump_block));
 
+	// Predictors of all bases are collected first, one row per predictor, and then scored in one pass
+	int stride = (max(max_eligible_base, 0) + 3) & ~3;
+	vector<v4f> pred_blocks(kNumPredictors * stride / 4 + 1);
+	float *pred_rows = (float*)&pred_blocks[0];
+
 	for (int base = 0; base < max_eligible_base; base++) { // first 4 bases are the keys TCAG
 		float pred[kNumPredictors];
 		pred[1] = predictor2[base]; // P2: local noise
@@ -883,7 +910,12 @@ void PerBaseQual::GenerateBaseQualities(const string& read_name, int num_bases,
 		//pred[0] = transform_P1(predictor1[base]);
 		//pred[4] = predictor5[base];
 		//pred[5] = predictor6[base];
-		quality.push_back(CalculatePerBaseScore(pred));
+		for (int k = 0; k < kNumPredictors; ++k)
+			pred_rows[k * stride + base] = pred[k];
+	}
+	if (max_eligible_base > 0) {
+		quality.resize(max_eligible_base);
+		CalculateScores(pred_rows, stride, max_eligible_base, &quality[0]);
 	}
 
 	for (int base = max_eligible_base; base < num_bases; base++)
@@ -907,7 +939,8 @@ void PerBaseQual::GenerateFlowQualities(const string& read_name, int num_bases,
         const vector<float> &candidate1, const vector<float> &candidate2, const vector<float> &candidate3,
         const vector<float> &predictor1_flow, const vector<float> &predictor5_flow, const vector<float> &predictor4_flow,
         //const vector<float> &wells_residual, //added
-        const vector<int>& flow_to_base, const bool flow_predictors_){
+        const vector<int>& flow_to_base, const bool flow_predictors_,
+        NN::NNWorkspace *nn_workspace){
 
 	if(num_flows == 0)
 		return;
@@ -917,6 +950,17 @@ void PerBaseQual::GenerateFlowQualities(const string& read_name, int num_bases,
 	int max_eligible_base = flow_predictors_ ? max_eligible_flow : min(num_bases, max_eligible_flow);
 	quality_flow.clear();
 
+	bool use_network_model = network_model_enable_ && !load_phred_table_;
+	NN::NNWorkspace local_workspace;
+	NN::NNWorkspace &workspace = nn_workspace ? *nn_workspace : local_workspace;
+	if(use_network_model)
+		workspace.input.resize(max(max_eligible_flow, 0) * kNumPredictorsFlowNN);
+
+	// Phred table predictors of all flows are collected first, one row per predictor, and then scored in one pass
+	int stride = use_network_model ? 0 : (max(max_eligible_flow, 0) + 3) & ~3;
+	vector<v4f> pred_blocks(kNumPredictors * stride / 4 + 1);
+	float *pred_rows = (float*)&pred_blocks[0];
+
 	for (int base = 0; base < max_eligible_flow; base++){
 		float pred[kNumPredictors];
 		int flow = base_to_flow[base];
@@ -928,8 +972,9 @@ void PerBaseQual::GenerateFlowQualities(const string& read_name, int num_bases,
 		pred[3] = predictor4_flow[base]; //P4
 		pred[4] = transform_P6(predictor6[base]); //P5
 
-		float predFlow[kNumPredictorsFlowNN];
-		if(network_model_enable_ && !load_phred_table_){
+		if(use_network_model){
+			// Collect the predictors of all flows; the network is evaluated once for the whole read below
+			float *predFlow = &workspace.input[base * kNumPredictorsFlowNN];
 			predFlow[0] = predictor1_flow[base];  //P1
 			predFlow[1] = predictor2[base];  	  //P2
 			predFlow[2] = predictor3[base];   	  //P3
@@ -939,12 +984,24 @@ void PerBaseQual::GenerateFlowQualities(const string& read_name, int num_bases,
 			predFlow[6] = candidate1[base];
 			predFlow[7] = candidate2[base];
 			predFlow[8] = candidate3[base];
-			quality_flow.push_back(CalculatePerFlowScoreNN(predFlow));
 		}
 		else{
-			quality_flow.push_back(CalculatePerFlowScore(pred));
+			for (int k = 0; k < kNumPredictors; ++k)
+				pred_rows[k * stride + base] = pred[k];
 		}
 	}
+
+	if(not use_network_model and max_eligible_flow > 0){
+		quality_flow.resize(max_eligible_flow);
+		CalculateScores(pred_rows, stride, max_eligible_flow, &quality_flow[0]);
+	}
+
+	if(use_network_model and max_eligible_flow > 0){
+		const float *prob = model_->CalculateOutputBatch(&workspace.input[0], max_eligible_flow, workspace);
+		int num_out = model_->GetOutputLength();
+		for (int base = 0; base < max_eligible_flow; base++)
+			quality_flow.push_back(NNProbabilityToQuality(prob[base * num_out]));
+	}
 	for (int base = max_eligible_flow; base < num_flows; base++)
 	    quality_flow.push_back(kMinQuality);
 
@@ -73,7 +73,8 @@ public:
       const vector<float> &candidate1, const vector<float> &candidate2, const vector<float> &candidate3,
       const vector<float> &predictor1_flow, const vector<float> &predictor5_flow, const vector<float> &predictor4_flow,
       //const vector<float> &wells_residual,
-      const vector<int>& flow_to_base, const bool flow_predictors_=false);
+      const vector<int>& flow_to_base, const bool flow_predictors_=false,
+      NN::NNWorkspace *nn_workspace=NULL);
 
   void DumpPredictors(const string& read_name, int num_bases, int num_flows,
       const vector<float> &predictor1, const vector<float> &predictor2, const vector<float> &predictor3,
@@ -133,7 +134,20 @@ protected:
   //! @return Quality value
   uint8_t CalculatePerBaseScore(float* pred) const;
   uint8_t CalculatePerFlowScore(float* pred) const;
+  //! @brief  Use phred table to determine quality values of a block of bases in one pass
+  //! @param[in]  pred        Predictor values, kNumPredictors rows of stride values each, 16 byte aligned
+  //! @param[in]  stride      Row length of pred, a multiple of 4 and at least num_bases
+  //! @param[in]  num_bases   Number of bases to score
+  //! @param[out] quality     Quality values, num_bases entries
+  void    CalculateScores(const float* pred, int stride, int num_bases, uint8_t* quality) const;
+  //! @brief  Build the aligned lookup representation of the loaded phred table
+  void    PrepareLookupTables(size_t table_size);
+  //! @brief  Turn a legacy threshold table into an equivalent binary table, returns the table size
+  size_t  ConvertLegacyTable();
+  void    FreeLookupTables();
   uint8_t CalculatePerFlowScoreNN(float* pred) const;
+  //! @brief  Convert the network's error probability into a quality value
+  static uint8_t NNProbabilityToQuality(float p);
 
 
   const static int        kNumPredictors = 6;         //!< Number of predictors used for quality value determination
@@ -146,9 +160,16 @@ protected:
   vector<uint8_t>         phred_quality_;             //!< Quality value associated with each predictor cut.
 
   vector<vector<float> >  phred_cuts_;				  //!< Predictor threshold table, kNumPredictors x num_phred_cuts.
-  unsigned char*		  phred_table_;   			  //!< Predictor table of QV values.
+  unsigned char*		  phred_table_;   			  //!< Predictor table of QV values, 64 byte aligned.
   vector<size_t>		  offsets_;					  //!< Indexing offsets.
 
+  // Lookup representation used by CalculateScores, built once by PrepareLookupTables
+  float*                  lookup_cuts_;                        //!< phred_cuts_ of all predictors back to back, 64 byte aligned
+  int                     lookup_cut_begin_[kNumPredictors];   //!< Position of each predictor's cuts in lookup_cuts_
+  int                     lookup_num_cuts_[kNumPredictors];    //!< Number of cuts of each predictor
+  int                     lookup_offsets_[kNumPredictors];     //!< offsets_ as 32 bit integers
+  int                     lookup_nan_bin_;                     //!< Bin of NaN predictor values
+
   vector<vector<float>>   errD_table_;				  //!< Error distribution of flow space QV values.
   int*		  			  dims_;					  //!< Dimension of the error distribution table
 
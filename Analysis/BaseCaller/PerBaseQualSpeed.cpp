@@ -0,0 +1,181 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     PerBaseQualSpeed.cpp
+//! @ingroup  BaseCaller
+//! @brief    PerBaseQualSpeed. Microbenchmark of per-base phred table QV assignment,
+//!           original per-base lookups against PerBaseQual::CalculateScores
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "OptArgs.h"
+#include "PerBaseQual.h"
+#include "Utils.h"
+#include "Vecs.h"
+
+using namespace std;
+
+void PrintUsage()
+{
+  printf ("Usage: PerBaseQualSpeed phred_table_file [num_reads=20000] [num_bases=300]\n");
+  printf ("  Scores random predictors for num_reads reads of num_bases bases each,\n");
+  printf ("  reports nanoseconds per base of the original per-base lookup and of the\n");
+  printf ("  block lookup, and checks that both assign identical quality values.\n");
+}
+
+// ----------------------------------------------------------------------------
+// Access to the loaded table, and the per-base lookups that CalculateScores replaced
+
+class PerBaseQualSpeed : public PerBaseQual {
+public:
+  bool  LegacyTable() const { return not phred_quality_.empty(); };
+  int   NumCuts(int k) const { return phred_cuts_[k].size(); };
+  float Cut(int k, int j) const { return phred_cuts_[k][j]; };
+
+  void  BlockScores(const float* pred, int stride, int num_bases, uint8_t* quality) const
+    { CalculateScores(pred, stride, num_bases, quality); };
+
+  uint8_t ReferenceScore(float* pred) const
+  {
+    if (not LegacyTable()) {
+      size_t index = 0;
+      vector<size_t> vind;
+      for (int i = 0; i < kNumPredictors; ++i) {
+        size_t indi = GetIndex(pred[i], phred_cuts_[i]);
+        vind.push_back(indi);
+        index += (indi * offsets_[i]);
+      }
+      return phred_table_[index];
+    }
+    int num_phred_cuts = phred_quality_.size();
+    for (int k = 0; k < kNumPredictors; k++)
+      pred[k] = min(pred[k], phred_thresholds_max_[k]);
+    for (int j = 0; j < num_phred_cuts; ++j) {
+      bool valid_cut = true;
+      for (int k = 0; k < kNumPredictors; ++k) {
+        if (pred[k] > phred_thresholds_[k][j]) {
+          valid_cut = false;
+          break;
+        }
+      }
+      if (valid_cut)
+        return phred_quality_[j];
+    }
+    return kMinQuality;
+  }
+
+  static int NumPredictors() { return kNumPredictors; };
+
+private:
+  static size_t GetIndex(const float predVal, const vector<float>& thresholds)
+  {
+    if (predVal >= thresholds.back())
+      return (thresholds.size() - 1);
+    size_t l = 0;
+    size_t r = thresholds.size() - 1;
+    size_t m = l;
+    while (r > l) {
+      m = (r + l) >> 1;
+      if (m == l)
+        return (predVal <= thresholds[l]) ? l : r;
+      if (predVal == thresholds[m])
+        return m;
+      else if (predVal > thresholds[m])
+        l = m;
+      else
+        r = m;
+    }
+    return r;
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+  if (argc < 2) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  int num_reads = argc > 2 ? atoi(argv[2]) : 20000;
+  int num_bases = argc > 3 ? atoi(argv[3]) : 300;
+  if (num_reads <= 0 or num_bases <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  OptArgs opts;
+  const char *table_args[] = { "PerBaseQualSpeed", "--phred-table-file", argv[1] };
+  opts.ParseCmdLine(3, table_args);
+  PerBaseQualSpeed quality_generator;
+  quality_generator.Init(opts, "", ".", ".", false);
+  int num_predictors = PerBaseQualSpeed::NumPredictors();
+
+  // A pool of simulated reads, drawn once so that the random number generator stays out of
+  // the timed loops. Values cover the range of the cuts with some margin, a fifth of them
+  // sit exactly on a cut and a few are NaN.
+  const int num_pool_reads = 64;
+  int stride = (num_bases + 3) & ~3;
+  vector<v4f> pool_blocks(num_pool_reads * num_predictors * stride / 4);
+  float *pool = (float*)&pool_blocks[0];
+  srand48(42);
+  for (int r = 0; r < num_pool_reads; ++r) {
+    for (int k = 0; k < num_predictors; ++k) {
+      int num_cuts = quality_generator.NumCuts(k);
+      float low = quality_generator.Cut(k, 0);
+      float high = quality_generator.Cut(k, num_cuts - 1);
+      float margin = 0.1f * (high - low) + 0.01f;
+      float *row = pool + (r * num_predictors + k) * stride;
+      for (int base = 0; base < stride; ++base) {
+        double dice = drand48();
+        if (dice < 0.001)
+          row[base] = NAN;
+        else if (dice < 0.2)
+          row[base] = quality_generator.Cut(k, lrand48() % num_cuts);
+        else
+          row[base] = low - margin + (high - low + 2 * margin) * drand48();
+      }
+    }
+  }
+
+  // Per-base lookup, as PerBaseQual::CalculatePerBaseScore used to do it
+  vector<uint8_t> reference(num_pool_reads * num_bases);
+  Timer timer;
+  for (int read = 0; read < num_reads; ++read) {
+    const float *rows = pool + (read % num_pool_reads) * num_predictors * stride;
+    uint8_t *quality = &reference[(read % num_pool_reads) * num_bases];
+    for (int base = 0; base < num_bases; ++base) {
+      float pred[16];
+      for (int k = 0; k < num_predictors; ++k)
+        pred[k] = rows[k * stride + base];
+      quality[base] = quality_generator.ReferenceScore(pred);
+    }
+  }
+  double reference_time = timer.elapsed();
+
+  // Block lookup, one call per read
+  vector<uint8_t> block(num_pool_reads * num_bases);
+  timer.restart();
+  for (int read = 0; read < num_reads; ++read)
+    quality_generator.BlockScores(pool + (read % num_pool_reads) * num_predictors * stride, stride, num_bases,
+        &block[(read % num_pool_reads) * num_bases]);
+  double block_time = timer.elapsed();
+
+  int num_mismatches = 0;
+  for (unsigned int i = 0; i < block.size(); ++i)
+    if (block[i] != reference[i])
+      ++num_mismatches;
+
+  double total_bases = (double)num_reads * num_bases;
+  printf ("PerBaseQualSpeed: %d reads x %d bases, %s phred table\n", num_reads, num_bases,
+      quality_generator.LegacyTable() ? "legacy" : "binary");
+  printf ("  per-base lookup : %8.3f s  %8.2f ns/base\n", reference_time, 1e9 * reference_time / total_bases);
+  printf ("  block lookup    : %8.3f s  %8.2f ns/base\n", block_time, 1e9 * block_time / total_bases);
+  printf ("  speedup         : %8.2fx\n", reference_time / max(block_time, 1e-9));
+  printf ("  mismatching bases: %d\n", num_mismatches);
+
+  return num_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
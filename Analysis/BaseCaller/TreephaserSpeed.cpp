@@ -0,0 +1,188 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     TreephaserSpeed.cpp
+//! @ingroup  BaseCaller
+//! @brief    TreephaserSpeed. Throughput of each TreephaserVEC backend, cross-checked against DPTreephaser
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include "DPTreephaser.h"
+#include "TreephaserVEC.h"
+#include "Utils.h"
+
+using namespace std;
+
+struct RecordedRead {
+  double        cf;
+  double        ie;
+  vector<float> measurements;
+};
+
+void PrintUsage()
+{
+  printf ("Usage: TreephaserSpeed [num_reads=2000] [reads.txt flow_order num_flows]\n");
+  printf ("  Runs NormalizeAndSolve and ComputeQVmetrics with every TreephaserVEC backend available\n");
+  printf ("  on this CPU and reports reads/sec. Each backend is checked bit-for-bit against the generic\n");
+  printf ("  backend, and its solver against DPTreephaser::Solve.\n");
+  printf ("  reads.txt holds one recorded read per line: cf ie measurement_0 ... measurement_n\n");
+  printf ("  Without it, reads are simulated with a fixed seed.\n");
+  printf ("  Exits with failure if any backend differs from the generic one or agrees with\n");
+  printf ("  DPTreephaser::Solve on fewer than 97%% of the reads.\n");
+}
+
+// ----------------------------------------------------------------------------
+
+void SimulateReads(const ion::FlowOrder& flow_order, int num_reads, vector<RecordedRead>& reads)
+{
+  DPTreephaser simulator(flow_order, DPTreephaser::kWindowSizeDefault_);
+  int num_flows = flow_order.num_flows();
+  srand48(1);
+  reads.resize(num_reads);
+  for (int r = 0; r < num_reads; ++r) {
+    BasecallerRead truth;
+    int length = 150 + lrand48() % 150;
+    for (int base = 0; base < length; ++base)
+      truth.sequence.push_back("ACGT"[lrand48() % 4]);
+    reads[r].cf = 0.005 + 0.01 * drand48();
+    reads[r].ie = 0.005 + 0.01 * drand48();
+    simulator.SetModelParameters(reads[r].cf, reads[r].ie);
+    truth.prediction.assign(num_flows, 0);
+    simulator.Simulate(truth, num_flows);
+    reads[r].measurements.resize(num_flows);
+    for (int flow = 0; flow < num_flows; ++flow)
+      reads[r].measurements[flow] = truth.prediction[flow] * (0.9 + 0.2 * drand48()) + 0.1 * (drand48() - 0.5);
+  }
+}
+
+bool LoadReads(const string& filename, int num_flows, int max_reads, vector<RecordedRead>& reads)
+{
+  ifstream in(filename.c_str());
+  if (not in.good())
+    return false;
+  string line;
+  while (getline(in, line) and (int)reads.size() < max_reads) {
+    istringstream fields(line);
+    RecordedRead read;
+    if (not (fields >> read.cf >> read.ie))
+      continue;
+    float value;
+    while (fields >> value)
+      read.measurements.push_back(value);
+    read.measurements.resize(num_flows, 0.0f);
+    reads.push_back(read);
+  }
+  return not reads.empty();
+}
+
+static bool SameFloats(const vector<float>& a, const vector<float>& b)
+{
+  return a.size() == b.size() and (a.empty() or memcmp(&a[0], &b[0], a.size() * sizeof(float)) == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  int num_reads = argc > 1 ? atoi(argv[1]) : 2000;
+  if (num_reads <= 0 or argc == 3 or argc == 4) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  vector<RecordedRead> reads;
+  ion::FlowOrder flow_order("TACGTACGTCTGAGCATCGATCGATGTACAGC", 400);
+  if (argc > 4) {
+    flow_order.SetFlowOrder(argv[3], atoi(argv[4]));
+    if (not LoadReads(argv[2], flow_order.num_flows(), num_reads, reads)) {
+      fprintf (stderr, "TreephaserSpeed: could not read any reads from %s\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+    SimulateReads(flow_order, num_reads, reads);
+  int num_flows = flow_order.num_flows();
+  num_reads = reads.size();
+
+  // DPTreephaser reference solutions
+  DPTreephaser dp_treephaser(flow_order, DPTreephaser::kWindowSizeDefault_);
+  vector<BasecallerRead> dp_reads(num_reads);
+  Timer timer;
+  for (int r = 0; r < num_reads; ++r) {
+    dp_reads[r].SetData(reads[r].measurements, num_flows);
+    dp_treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+    dp_treephaser.Solve(dp_reads[r], num_flows);
+  }
+  double dp_time = timer.elapsed();
+
+  printf ("TreephaserSpeed: %d reads x %d flows, best backend %s\n", num_reads, num_flows,
+      TreephaserVEC::BackendName(TreephaserVEC::BestBackend()));
+  printf ("  %-8s %12s %12s %14s %14s %12s\n", "backend", "solve/sec", "full/sec", "seq==DPsolve", "max|pred-DP|", "mismatches");
+  printf ("  %-8s %12.1f %12s\n", "dp", num_reads / max(dp_time, 1e-9), "-");
+
+  vector<BasecallerRead> reference_reads;
+  int failures = 0;
+  for (int b = 0; b < TreephaserVEC::kNumBackends; ++b) {
+    TreephaserVEC::Backend backend = (TreephaserVEC::Backend)b;
+    if (not TreephaserVEC::BackendAvailable(backend))
+      continue;
+    TreephaserVEC treephaser(flow_order, DPTreephaser::kWindowSizeDefault_, backend);
+
+    // Solving only, compared against DPTreephaser::Solve
+    int num_same_sequence = 0;
+    double max_prediction_diff = 0.0;
+    double solve_time = 0.0;
+    for (int r = 0; r < num_reads; ++r) {
+      BasecallerRead read;
+      read.SetData(reads[r].measurements, num_flows);
+      timer.restart();
+      treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+      treephaser.SolveRead(read, 0, num_flows);
+      solve_time += timer.elapsed();
+      if (read.sequence != dp_reads[r].sequence)
+        continue;
+      num_same_sequence++;
+      for (int flow = 0; flow < num_flows; ++flow)
+        max_prediction_diff = max(max_prediction_diff, (double)fabs(read.prediction[flow] - dp_reads[r].prediction[flow]));
+    }
+
+    // Full BaseCaller path, compared bit-for-bit against the generic backend
+    vector<BasecallerRead> full_reads(num_reads);
+    timer.restart();
+    for (int r = 0; r < num_reads; ++r) {
+      full_reads[r].SetData(reads[r].measurements, num_flows);
+      treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+      treephaser.NormalizeAndSolve(full_reads[r]);
+      treephaser.ComputeQVmetrics(full_reads[r]);
+    }
+    double full_time = timer.elapsed();
+
+    int num_mismatches = 0;
+    if (backend == TreephaserVEC::kBackendGeneric)
+      reference_reads.swap(full_reads);
+    else {
+      for (int r = 0; r < num_reads; ++r)
+        if (full_reads[r].sequence != reference_reads[r].sequence
+            or not SameFloats(full_reads[r].normalized_measurements, reference_reads[r].normalized_measurements)
+            or not SameFloats(full_reads[r].prediction, reference_reads[r].prediction)
+            or not SameFloats(full_reads[r].penalty_residual, reference_reads[r].penalty_residual)
+            or not SameFloats(full_reads[r].penalty_mismatch, reference_reads[r].penalty_mismatch))
+          num_mismatches++;
+    }
+
+    double same_fraction = (double)num_same_sequence / num_reads;
+    if (num_mismatches > 0 or same_fraction < 0.97)
+      failures++;
+    printf ("  %-8s %12.1f %12.1f %13.1f%% %14.4f %12d\n", TreephaserVEC::BackendName(backend),
+        num_reads / max(solve_time, 1e-9), num_reads / max(full_time, 1e-9),
+        100.0 * same_fraction, max_prediction_diff, num_mismatches);
+  }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,203 +1,115 @@
 /* Copyright (C) 2012 Ion Torrent Systems, Inc. All Rights Reserved */
 
-#ifndef TREEPHASERSSE_H
-#define TREEPHASERSSE_H
+//! @file     TreephaserVEC.h
+//! @ingroup  BaseCaller
+//! @brief    TreephaserVEC. Vectorized treephaser with runtime instruction set dispatch
 
-#include "DPTreephaser.h"
+#ifndef TREEPHASERVEC_H
+#define TREEPHASERVEC_H
 
-#include <algorithm>
 #include <vector>
 #include "BaseCallerUtils.h"
-#include "Vecs.h"
-
-#ifdef _WIN32
-  #define ALIGN(AAlignSize) __declspec(align(AAlignSize))
-  #define ALWAYS_INLINE __forceinline
-  #define EXPECTED(ABoolExpression) ABoolExpression
-  #define UNEXPECTED(ABoolExpression) ABoolExpression
-  #define RESTRICT_PTR * __restrict
-#else
-  #define ALIGN(AAlignSize) __attribute__((aligned(AAlignSize)))
-  #define ALWAYS_INLINE inline __attribute__((always_inline))
-  #define NEVER_INLINE inline __attribute__((noinline))
-  #define EXPECTED(ABoolExpression) __builtin_expect((ABoolExpression), 1)
-  #define UNEXPECTED(ABoolExpression) __builtin_expect((ABoolExpression), 0)
-  #define RESTRICT_PTR * __restrict__
-/*
-  #ifndef _mm_castps_si128
-    ALWAYS_INLINE __m128i _mm_castps_si128(__m128 __A) {
-      return (__m128i) __A;
-    }
-  #endif
-
-  #ifndef _mm_castsi128_ps
-    ALWAYS_INLINE __m128 _mm_castsi128_ps(__m128i __A) {
-      return (__m128) __A;
-    }
-  #endif
-*/
-#endif
-
-
-//#define MAX_VALS 1020
-#define MAX_VALS 2044
-//#define STEP_SIZE 38
-//#define MAX_STEPS 24
-// MAX_STEPS set large enough to handle minimum window size
-#define MAX_STEPS (1+(MAX_VALS/DPTreephaser::kMinWindowSize_))
-#define MAX_PATHS 8
-
-#define MAX_PATH_DELAY 40
-
-//#pragma pack(push, 1)
-struct __attribute__((packed)) ALIGN(64) PathRec {
-  int flow;
-  int window_start;
-  int window_end;
-  float res;
-  float metr;
-  float flowMetr;
-  int dotCnt;
-  float penalty;
-  float state[MAX_VALS] ALIGN(64);
-  float pred[MAX_VALS]  ALIGN(64);
-  char sequence[2*MAX_VALS + 12]; // +12 makes the enitre struct align well
-  int  sequence_length;
-  int last_hp;
-  int nuc;
-  float calib_A[MAX_VALS] ALIGN(64);
-  float calib_B[MAX_VALS] ALIGN(64);
-  float state_inphase[MAX_VALS] ALIGN(64);
+#include "DPTreephaser.h"
+
+using namespace std;
+
+
+//! @brief    Interface implemented by each instruction set specific treephaser kernel
+//! @ingroup  BaseCaller
+
+class TreephaserVECKernel {
+public:
+  virtual ~TreephaserVECKernel() {}
+
+  virtual void SetFlowOrder(const ion::FlowOrder& flow_order) = 0;
+  virtual void SetNormalizationWindowSize(const int windowSize) = 0;
+  virtual void SetModelParameters(double cf, double ie) = 0;
+  virtual void SolveRead(BasecallerRead& read, int begin_flow, int end_flow) = 0;
+  virtual void NormalizeAndSolve(BasecallerRead& read) = 0;
+  virtual bool SetAsBs(const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs) = 0;
+  virtual bool EnableRecalibration() = 0;
+  virtual void DisableRecalibration() = 0;
+  virtual void SkipRecalDuringNormalization(bool skip_recal) = 0;
+  virtual void ComputeQVmetrics(BasecallerRead& read) = 0;
+  virtual void ComputeQVmetrics_flow(BasecallerRead& read, vector<int>& flow_to_base, const bool flow_predictors_, const bool flow_quality) = 0;
 };
-//#pragma pack(pop)
 
 
-class TreephaserSSE {
+//! @brief    Vectorized treephaser front end
+//! @ingroup  BaseCaller
+//! @details
+//! Drop-in replacement for TreephaserSSE. The kernel is compiled once per instruction set and
+//! the widest one supported by the CPU is selected at startup, unless a backend is requested
+//! explicitly. All backends produce bit-identical results.
+
+class TreephaserVEC {
 public:
 
-  //! @brief      Default constructor
-  TreephaserSSE();
+  enum Backend {
+    kBackendAuto    = -1,   //!< Widest backend supported by this CPU
+    kBackendGeneric = 0,    //!< Build target instruction set (SSE on x86, NEON on ARM)
+    kBackendAVX2    = 1,    //!< x86 AVX2
+    kBackendAVX512  = 2,    //!< x86 AVX-512 F/BW/VL
+    kNumBackends    = 3
+  };
 
   //! @brief      Constructor
   //! @param[in]  flow_order  Flow order object
   //! @param[in]  windowSize  Size of the normalization window to use.
-  TreephaserSSE(const ion::FlowOrder& flow_order, const int windowSize);
+  //! @param[in]  backend     Kernel instruction set; must be available on this CPU
+  TreephaserVEC(const ion::FlowOrder& flow_order, const int windowSize, Backend backend = kBackendAuto);
+  ~TreephaserVEC();
+
+  //! @brief  Widest backend compiled in and supported by this CPU
+  static Backend      BestBackend();
+  //! @brief  Is the backend compiled in and supported by this CPU?
+  static bool         BackendAvailable(Backend backend);
+  static const char * BackendName(Backend backend);
+
+  Backend GetBackend() const { return backend_; };
 
   //! @brief      Set flow order and initialize internal variables
-  //! @param[in]  flow_order  Flow order object
-  void SetFlowOrder(const ion::FlowOrder& flow_order);
+  void SetFlowOrder(const ion::FlowOrder& flow_order) { kernel_->SetFlowOrder(flow_order); };
 
   //! @brief      Set the normalization window size
-  //! @param[in]  windowSize  Size of the normalization window to use.
-  inline void SetNormalizationWindowSize(const int windowSize) { windowSize_ = max(DPTreephaser::kMinWindowSize_, min(windowSize, DPTreephaser::kMaxWindowSize_));}
+  void SetNormalizationWindowSize(const int windowSize) { kernel_->SetNormalizationWindowSize(windowSize); };
 
   //! @brief     Set phasing model parameters
-  void SetModelParameters(double cf, double ie);
+  void SetModelParameters(double cf, double ie) { kernel_->SetModelParameters(cf, ie); };
 
   //! @brief      Interface function similar to DPTreephaser Solve
   //! @param[out] read        Basecaller read to be solved
   //! @param[in]  begin_flow  Start solving at this flow
   //! @param[in]  end_flow    Do not solve for any flows past this one
-  void SolveRead(BasecallerRead& read, int begin_flow, int end_flow);
+  void SolveRead(BasecallerRead& read, int begin_flow, int end_flow) { kernel_->SolveRead(read, begin_flow, end_flow); };
 
   //! @brief      Iterative solving and normalization routine
-  void NormalizeAndSolve(BasecallerRead& read);
-  PathRec* parent;
-  int best;
+  void NormalizeAndSolve(BasecallerRead& read) { kernel_->NormalizeAndSolve(read); };
 
   //! @brief      Set pointers to recalibration model
-  bool SetAsBs(const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs){
-    As_ = As;
-    Bs_ = Bs;
-    pm_model_available_ = (As_ != NULL) and (Bs_ != NULL);
-    recalibrate_predictions_ = pm_model_available_; // We bothered loading the model, of course we want to use it!
-    return pm_model_available_;
-  };
+  bool SetAsBs(const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs)
+    { return kernel_->SetAsBs(As, Bs); };
 
   //! @brief     Enables the use of recalibration if a model is available.
-  bool EnableRecalibration() {
-    recalibrate_predictions_ = pm_model_available_;
-    return pm_model_available_;
-  };
+  bool EnableRecalibration() { return kernel_->EnableRecalibration(); };
 
   //! @brief     Disables the use of recalibration until a new model is set.
-  void DisableRecalibration() {
-    //pm_model_available_ = false;
-    recalibrate_predictions_ = false;
-  };
+  void DisableRecalibration() { kernel_->DisableRecalibration(); };
 
   //! @brief  Switch to disable / enable the use of recalibration during the normalization phase
-  void SkipRecalDuringNormalization(bool skip_recal)
-    { skip_recal_during_normalization_ = skip_recal; };
+  void SkipRecalDuringNormalization(bool skip_recal) { kernel_->SkipRecalDuringNormalization(skip_recal); };
 
   //! @brief  Perform a more advanced simulation to generate QV predictors
-  void  ComputeQVmetrics(BasecallerRead& read);
-  void  ComputeQVmetrics_flow(BasecallerRead& read, vector<int>& flow_to_base, const bool flow_predictors_=false);
-
-  int nuc_char_to_int(char nuc) {if (nuc=='A') return 0; if (nuc=='C') return 1; if (nuc=='G') return 2; if (nuc=='T') return 3; return -1;}
-
-protected:
-
-  inline void CalcResidualI(PathRec RESTRICT_PTR parent,
-  		int flow, int j, v4f &rS, v4f rTemp1s_, v4f &rPenNeg, v4f &rPenPos);
-
-  //! @brief     Solving a read
-  bool  Solve(int begin_flow, int end_flow);
-  //! @brief     Normalizing a read
-  void  WindowedNormalize(BasecallerRead& read, int step);
-  //! @brief     Make recalibration changes to predictions explicitly visible
-  void  RecalibratePredictions(PathRec *maxPathPtr);
-  //! @brief     Resetting recalibration data structure
-  void  ResetRecalibrationStructures(int num_flows);
-  //! @brief      Initialize floating point array variables with a value
-  void InitializeVariables(float init_val);
-
-  void  sumNormMeasures();
-  void  advanceState4(PathRec RESTRICT_PTR parent, int end);
-  void  advanceStateInPlace(PathRec RESTRICT_PTR path, int nuc, int end);
-
-  // There was a small penalty in making these arrays class members, as opposed to static variables
-  ALIGN(64) short ts_NextNuc[4][MAX_VALS];
-  ALIGN(64) float ts_Transition[4][MAX_VALS];
-  ALIGN(64) v4i_u   ts_NextNuc4[MAX_VALS];
-  ALIGN(64) v4f_u ts_Transition4[MAX_VALS];
-
-  ALIGN(64) float rd_NormMeasure[MAX_VALS];
-  ALIGN(64) float rd_SqNormMeasureSum[MAX_VALS];
-
-  ALIGN(64) PathRec sv_pathBuf[MAX_PATHS+1];
-
-  ALIGN(64) float ft_stepNorms[MAX_STEPS];
-
-  ALIGN(64) v4f_u ad_MinFrac;
-  ALIGN(16) v4i_u ad_FlowEnd;
-  ALIGN(16) v4i_u ad_Idx;
-  ALIGN(16) v4i_u ad_End;
-  ALIGN(16) v4i_u ad_Beg;
-  ALIGN(64)v4f_u state_Buf[MAX_VALS+1];
-  ALIGN(64)v4f_u pred_Buf[MAX_VALS+1];
-  ALIGN(64)v4f_u nres_Buf[MAX_VALS+1];
-  ALIGN(64)v4f_u pres_Buf[MAX_VALS+1];
-  ion::FlowOrder      flow_order_;                //!< Sequence of nucleotide flows
-
-  PathRec *sv_PathPtr[MAX_PATHS+1];
-  int ad_Adv;
-  int num_flows_;
-  int ts_StepCnt;
-  int ts_StepBeg[MAX_STEPS+1];
-  int ts_StepEnd[MAX_STEPS+1];
-
-  
-  int      windowSize_;                         //!< Adaptive normalization window size
-  double   my_cf_;                              //!< Stores the cf phasing parameter used to compute transitions
-  double   my_ie_;                              //!< Stores the ie phasing parameter used to compute transitions
-  const vector< vector< vector<float> > > *As_; //!< Pointer to recalibration structure: multiplicative constant
-  const vector< vector< vector<float> > > *Bs_; //!< Pointer to recalibration structure: additive constant
-  bool     pm_model_available_;                 //!< Signals availability of a recalibration model
-  bool     recalibrate_predictions_;            //!< Switch to use recalibration model during metric generation
-  bool     skip_recal_during_normalization_;    //!< Switch to skip recalibration during the normalization phase
-  bool     state_inphase_enabled_;              //!< Switch to save inphase population of molecules
+  void ComputeQVmetrics(BasecallerRead& read) { kernel_->ComputeQVmetrics(read); };
+  void ComputeQVmetrics_flow(BasecallerRead& read, vector<int>& flow_to_base, const bool flow_predictors_=false, const bool flow_quality = false)
+    { kernel_->ComputeQVmetrics_flow(read, flow_to_base, flow_predictors_, flow_quality); };
+
+private:
+  TreephaserVEC(const TreephaserVEC&);             // not copyable, the kernel is large
+  TreephaserVEC& operator=(const TreephaserVEC&);
 
+  TreephaserVECKernel   *kernel_;    //!< 64 byte aligned kernel for the selected backend
+  Backend               backend_;    //!< Selected backend
 };
 
-#endif // TREEPHASERSSE_H
+#endif // TREEPHASERVEC_H
@@ -0,0 +1,250 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     WellsPrefetcher.cpp
+//! @ingroup  BaseCaller
+//! @brief    WellsPrefetcher. Read-ahead of wells regions for BaseCaller workers
+
+#include "WellsPrefetcher.h"
+
+#include <stdio.h>
+#include "BaseCallerParameters.h"
+#include "IonErr.h"
+#include "Utils.h"
+
+
+WellsPrefetcher::WellsPrefetcher()
+{
+  bc_                 = NULL;
+  prefetch_depth_     = 0;
+  all_regions_read_   = false;
+  prefetch_done_      = false;
+  thread_running_     = false;
+  num_regions_loaded_ = 0;
+  read_time_          = 0.0;
+  normalize_time_     = 0.0;
+  worker_wait_time_   = 0.0;
+  prefetch_wait_time_ = 0.0;
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&slot_free_cond_, NULL);
+  pthread_cond_init(&slot_ready_cond_, NULL);
+}
+
+WellsPrefetcher::~WellsPrefetcher()
+{
+  Stop();
+  pthread_cond_destroy(&slot_ready_cond_);
+  pthread_cond_destroy(&slot_free_cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+// ----------------------------------------------------------------------------
+
+void WellsPrefetcher::Start(BaseCallerContext *bc, int num_workers, int prefetch_depth)
+{
+  bc_ = bc;
+  prefetch_depth_ = max(prefetch_depth, 0);
+  all_regions_read_ = false;
+  prefetch_done_ = false;
+
+  // Every worker holds one region and the read-ahead thread may fill prefetch_depth_ more
+  slots_.resize(max(num_workers, 1) + prefetch_depth_);
+  for (unsigned int i = 0; i < slots_.size(); ++i) {
+    slots_[i].wells = new RawWells("", bc_->filename_wells.c_str());
+    slots_[i].wells->OpenForIncrementalRead();
+    slots_[i].wells_norm = new WellsNormalization(&bc_->flow_order, bc_->wells_norm_method);
+    slots_[i].wells_norm->SetWells(slots_[i].wells, bc_->mask);
+    free_slots_.push_back(&slots_[i]);
+  }
+
+  if (prefetch_depth_ > 0) {
+    if (pthread_create(&prefetch_thread_, NULL, PrefetchThread, this))
+      ION_ABORT("Could not start wells prefetch thread");
+    thread_running_ = true;
+  }
+}
+
+void WellsPrefetcher::Stop()
+{
+  if (thread_running_) {
+    pthread_mutex_lock(&mutex_);
+    all_regions_read_ = true;
+    pthread_cond_broadcast(&slot_free_cond_);
+    pthread_mutex_unlock(&mutex_);
+    pthread_join(prefetch_thread_, NULL);
+    thread_running_ = false;
+  }
+
+  for (unsigned int i = 0; i < slots_.size(); ++i) {
+    delete slots_[i].wells_norm;
+    if (slots_[i].wells) {
+      slots_[i].wells->Close();
+      delete slots_[i].wells;
+    }
+  }
+  slots_.clear();
+  free_slots_.clear();
+  ready_slots_.clear();
+}
+
+// ----------------------------------------------------------------------------
+// Assigns the next region of the chip subset to a slot. Must hold mutex_.
+
+bool WellsPrefetcher::AcquireNextRegion(WellsRegion *slot)
+{
+  if (all_regions_read_)
+    return false;
+  if (not bc_->chip_subset.GetCurrentRegionAndIncrement(slot->region, slot->begin_x, slot->end_x, slot->begin_y, slot->end_y)) {
+    all_regions_read_ = true;
+    return false;
+  }
+
+  slot->num_usable_wells = 0;
+  for (int y = slot->begin_y; y < slot->end_y; ++y)
+    for (int x = slot->begin_x; x < slot->end_x; ++x)
+      if (bc_->class_map[x + y * bc_->chip_subset.GetChipSizeX()] >= 0)
+        slot->num_usable_wells++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Reads the slot's region, outside of any lock.
+
+void WellsPrefetcher::ReadRegion(WellsRegion *slot, double &read_time)
+{
+  read_time = 0.0;
+  if (slot->num_usable_wells == 0) // There is nothing in this region. Don't even bother reading it
+    return;
+
+  Timer timer;
+  slot->wells->SetChunk(slot->begin_y, slot->end_y - slot->begin_y, slot->begin_x, slot->end_x - slot->begin_x,
+      0, bc_->flow_order.num_flows());
+  slot->wells->ReadWells();
+  read_time = timer.elapsed();
+}
+
+// Normalizes the slot's region on the worker that basecalls it, outside of any lock.
+
+void WellsPrefetcher::NormalizeRegion(WellsRegion *slot, double &normalize_time)
+{
+  normalize_time = 0.0;
+  if (slot->num_usable_wells == 0)
+    return;
+
+  Timer timer;
+  slot->wells_norm->CorrectSignalBias(bc_->keys);
+  slot->wells_norm->DoKeyNormalization(bc_->keys);
+  normalize_time = timer.elapsed();
+}
+
+// ----------------------------------------------------------------------------
+
+void * WellsPrefetcher::PrefetchThread(void *arg)
+{
+  WellsPrefetcher& prefetcher = *static_cast<WellsPrefetcher*>(arg);
+
+  pthread_mutex_lock(&prefetcher.mutex_);
+  while (true) {
+    Timer wait_timer;
+    while (prefetcher.free_slots_.empty() and not prefetcher.all_regions_read_)
+      pthread_cond_wait(&prefetcher.slot_free_cond_, &prefetcher.mutex_);
+    prefetcher.prefetch_wait_time_ += wait_timer.elapsed();
+
+    WellsRegion *slot = prefetcher.free_slots_.empty() ? NULL : prefetcher.free_slots_.front();
+    if (slot == NULL or not prefetcher.AcquireNextRegion(slot))
+      break;
+    prefetcher.free_slots_.pop_front();
+    pthread_mutex_unlock(&prefetcher.mutex_);
+
+    double read_time;
+    prefetcher.ReadRegion(slot, read_time);
+
+    pthread_mutex_lock(&prefetcher.mutex_);
+    prefetcher.read_time_ += read_time;
+    prefetcher.num_regions_loaded_++;
+    prefetcher.ready_slots_.push_back(slot);
+    pthread_cond_signal(&prefetcher.slot_ready_cond_);
+  }
+  // Wake up all workers waiting for regions that will never come
+  prefetcher.prefetch_done_ = true;
+  pthread_cond_broadcast(&prefetcher.slot_ready_cond_);
+  pthread_mutex_unlock(&prefetcher.mutex_);
+  return NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+WellsRegion* WellsPrefetcher::GetNextRegion(WellsRegion *finished)
+{
+  pthread_mutex_lock(&mutex_);
+
+  if (prefetch_depth_ == 0) {
+    // Synchronous mode: the calling worker loads the region itself
+    WellsRegion *slot = finished;
+    if (slot == NULL and not free_slots_.empty()) {
+      slot = free_slots_.front();
+      free_slots_.pop_front();
+    }
+    if (slot == NULL or not AcquireNextRegion(slot)) {
+      pthread_mutex_unlock(&mutex_);
+      return NULL;
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    double read_time, normalize_time;
+    ReadRegion(slot, read_time);
+    NormalizeRegion(slot, normalize_time);
+
+    pthread_mutex_lock(&mutex_);
+    read_time_ += read_time;
+    normalize_time_ += normalize_time;
+    worker_wait_time_ += read_time;
+    num_regions_loaded_++;
+    pthread_mutex_unlock(&mutex_);
+    return slot;
+  }
+
+  if (finished) {
+    free_slots_.push_back(finished);
+    pthread_cond_signal(&slot_free_cond_);
+  }
+
+  Timer wait_timer;
+  while (ready_slots_.empty() and not prefetch_done_)
+    pthread_cond_wait(&slot_ready_cond_, &mutex_);
+  worker_wait_time_ += wait_timer.elapsed();
+
+  WellsRegion *slot = NULL;
+  if (not ready_slots_.empty()) {
+    slot = ready_slots_.front();
+    ready_slots_.pop_front();
+  }
+  pthread_mutex_unlock(&mutex_);
+
+  // Normalization stays on the workers, so it runs in parallel across them
+  if (slot) {
+    double normalize_time;
+    NormalizeRegion(slot, normalize_time);
+    pthread_mutex_lock(&mutex_);
+    normalize_time_ += normalize_time;
+    pthread_mutex_unlock(&mutex_);
+  }
+  return slot;
+}
+
+// ----------------------------------------------------------------------------
+
+void WellsPrefetcher::PrintTimings() const
+{
+  printf("Wells prefetch (depth %d): %d regions, read %1.1lf s, normalize %1.1lf s, worker wait %1.1lf s, read-ahead wait %1.1lf s\n",
+      prefetch_depth_, num_regions_loaded_, read_time_, normalize_time_, worker_wait_time_, prefetch_wait_time_);
+}
+
+void WellsPrefetcher::SaveTimings(Json::Value &json) const
+{
+  json["prefetch_depth"]        = prefetch_depth_;
+  json["num_regions"]           = num_regions_loaded_;
+  json["read_seconds"]          = read_time_;
+  json["normalize_seconds"]     = normalize_time_;
+  json["worker_wait_seconds"]   = worker_wait_time_;
+  json["prefetch_wait_seconds"] = prefetch_wait_time_;
+}
@@ -0,0 +1,103 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     WellsPrefetcher.h
+//! @ingroup  BaseCaller
+//! @brief    WellsPrefetcher. Read-ahead of wells regions for BaseCaller workers
+
+#ifndef WELLSPREFETCHER_H
+#define WELLSPREFETCHER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+#include "json/json.h"
+#include "RawWells.h"
+#include "WellsNormalization.h"
+
+using namespace std;
+
+struct BaseCallerContext;
+
+
+//! @brief    One region of wells data, loaded for basecalling
+//! @ingroup  BaseCaller
+
+struct WellsRegion {
+  WellsRegion() : region(-1), begin_x(0), end_x(0), begin_y(0), end_y(0), num_usable_wells(0), wells(NULL), wells_norm(NULL) {}
+
+  int                   region;             //!< Region index, as used by OrderedDatasetWriter
+  int                   begin_x;
+  int                   end_x;
+  int                   begin_y;
+  int                   end_y;
+  int                   num_usable_wells;   //!< Wells with a non-negative class; data is only loaded if > 0
+  RawWells              *wells;             //!< Wells handle whose current chunk holds this region
+  WellsNormalization    *wells_norm;        //!< Normalization object bound to wells
+};
+
+
+//! @brief    Bounded read-ahead pipeline for BaseCaller wells regions
+//! @ingroup  BaseCaller
+//! @details
+//! A background thread walks the chip subset in region order, reads each region's wells chunk
+//! and queues the result. Workers pick up read regions, apply signal bias correction and key
+//! normalization to them themselves, and hand them back for reuse when done. HDF5 latency is
+//! thus taken off the basecalling threads, while normalization still runs in parallel across
+//! them. The number of regions read ahead is bounded by the prefetch depth. With depth 0 no
+//! thread is started and each worker reads its next region itself, which is the classic
+//! BaseCaller behavior.
+
+class WellsPrefetcher {
+public:
+  WellsPrefetcher();
+  ~WellsPrefetcher();
+
+  //! @brief  Open one wells handle per in-flight region and start the read-ahead thread.
+  //! @param  bc              BaseCaller context providing wells file name, chip subset, mask and keys
+  //! @param  num_workers     Number of basecalling threads that will call GetNextRegion
+  //! @param  prefetch_depth  Number of regions read ahead of the workers; 0 disables the background thread
+  void Start(BaseCallerContext *bc, int num_workers, int prefetch_depth);
+
+  //! @brief  Return a finished region (may be NULL) and obtain the next one, normalized by the calling worker.
+  //! @return Next region in chip order, or NULL once all regions have been handed out.
+  WellsRegion* GetNextRegion(WellsRegion *finished);
+
+  //! Join the read-ahead thread and close all wells handles.
+  void Stop();
+
+  //! Print and save per-stage timing
+  void PrintTimings() const;
+  void SaveTimings(Json::Value &json) const;
+
+private:
+  static void * PrefetchThread(void *arg);
+  bool  AcquireNextRegion(WellsRegion *slot);
+  void  ReadRegion(WellsRegion *slot, double &read_time);
+  void  NormalizeRegion(WellsRegion *slot, double &normalize_time);
+
+  BaseCallerContext         *bc_;
+  int                       prefetch_depth_;
+  vector<WellsRegion>       slots_;             //!< All in-flight regions, workers + prefetch depth
+  deque<WellsRegion*>       free_slots_;        //!< Slots available to the read-ahead thread
+  deque<WellsRegion*>       ready_slots_;       //!< Loaded regions waiting for a worker
+  bool                      all_regions_read_;  //!< No more regions to read
+  bool                      prefetch_done_;     //!< Read-ahead thread has queued its last region
+
+  pthread_t                 prefetch_thread_;
+  bool                      thread_running_;
+  pthread_mutex_t           mutex_;             //!< Protects queues, region iterator and timers
+  pthread_cond_t            slot_free_cond_;
+  pthread_cond_t            slot_ready_cond_;
+
+  // Per-stage timing, in seconds
+  int                       num_regions_loaded_;
+  double                    read_time_;         //!< HDF5 chunk reads
+  double                    normalize_time_;    //!< Summed over workers, signal bias correction and key normalization
+  double                    worker_wait_time_;  //!< Summed over workers, time spent waiting for a read region
+  double                    prefetch_wait_time_;//!< Time the read-ahead thread waited for a free slot
+};
+
+
+#endif // WELLSPREFETCHER_H
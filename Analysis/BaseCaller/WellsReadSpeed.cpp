@@ -0,0 +1,199 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     WellsReadSpeed.cpp
+//! @ingroup  BaseCaller
+//! @brief    WellsReadSpeed. Region by region read throughput of a wells file, the way
+//!           BaseCaller loads wells, against copies of it in the block storage formats
+//!           and a memory mapped contiguous hdf5 copy
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "RawWells.h"
+#include "Utils.h"
+
+using namespace std;
+
+void PrintUsage()
+{
+  printf ("Usage: WellsReadSpeed wells_file [output_dir=.] [region_rows] [region_cols]\n");
+  printf ("  Copies wells_file to output_dir in the hdf5-contiguous, blocks, blocks-ushort and\n");
+  printf ("  blocks-half storage formats, tiled like the chunks of the original. Then reads every file\n");
+  printf ("  one region at a time with all flows, the way BaseCaller does, and reports read\n");
+  printf ("  throughput and the largest difference to the original. The contiguous copy is\n");
+  printf ("  also read memory mapped, touching every value. Regions default to the hdf5 chunk\n");
+  printf ("  size of wells_file.\n");
+}
+
+struct WellsFormat {
+  const char *name;
+  const char *storage;
+  bool        save_as_ushort;
+};
+
+// Copy the wells of source into a new file. Like Analysis, the whole chip is written a
+// block of flows at a time, with the source read a strip of tiles at a time.
+static void ConvertWells(RawWells& source, const string& output_dir, const string& file_name,
+    const WellsFormat& format, uint tile_rows, uint tile_cols)
+{
+  size_t num_rows = source.NumRows();
+  size_t num_cols = source.NumCols();
+  size_t num_flows = source.NumFlows();
+  const size_t flow_block = 20;
+
+  RawWells wells (output_dir.c_str(), file_name.c_str(), format.save_as_ushort, -5.0f, 28.0f);
+  wells.SetCompression (0);
+  wells.SetStorageFormat (format.storage);
+  wells.SetRows (num_rows);
+  wells.SetCols (num_cols);
+  wells.SetFlows (num_flows);
+  wells.SetFlowOrder (source.FlowOrder());
+  uint tile_flows = num_flows;
+  wells.SetH5ChunkSize (tile_rows, tile_cols, tile_flows);
+  wells.OpenForWrite();
+  for (size_t flow_start = 0; flow_start < num_flows; flow_start += flow_block) {
+    size_t depth = min(flow_block, num_flows - flow_start);
+    wells.SetChunk(0, num_rows, 0, num_cols, flow_start, depth);
+    for (size_t row_start = 0; row_start < num_rows; row_start += tile_rows) {
+      size_t height = min((size_t)tile_rows, num_rows - row_start);
+      source.SetChunk(row_start, height, 0, num_cols, flow_start, depth);
+      source.ReadWells();
+      for (size_t row = row_start; row < row_start + height; ++row)
+        for (size_t col = 0; col < num_cols; ++col)
+          for (size_t flow = flow_start; flow < flow_start + depth; ++flow)
+            wells.Set(row, col, flow, source.At(row, col, flow));
+    }
+    wells.WriteWells();
+  }
+  wells.WriteRanks();
+  wells.WriteInfo();
+  wells.Close();
+}
+
+// Read the whole file region by region and add up the values, returns seconds.
+// Mapped files only read from disk when the values are touched.
+static double TimeRegionReads(const string& path, size_t region_rows, size_t region_cols, bool mem_map, double& sum)
+{
+  Timer timer;
+  RawWells wells (path.c_str(), 0, 0);
+  wells.SetConvertWithCopies(false);
+  wells.SetMemMap(mem_map);
+  wells.OpenForIncrementalRead();
+  size_t num_flows = wells.NumFlows();
+  for (size_t row_start = 0; row_start < wells.NumRows(); row_start += region_rows) {
+    for (size_t col_start = 0; col_start < wells.NumCols(); col_start += region_cols) {
+      size_t row_end = min(row_start + region_rows, wells.NumRows());
+      size_t col_end = min(col_start + region_cols, wells.NumCols());
+      wells.SetChunk(row_start, row_end - row_start, col_start, col_end - col_start, 0, num_flows);
+      wells.ReadWells();
+      for (size_t row = row_start; row < row_end; ++row) {
+        for (size_t col = col_start; col < col_end; ++col) {
+          const float *values = wells.FlowValues(row, col);
+          for (size_t flow = 0; flow < num_flows; ++flow)
+            sum += values[flow];
+        }
+      }
+    }
+  }
+  wells.Close();
+  return timer.elapsed();
+}
+
+// Largest difference between two files, compared a strip at a time
+static double MaxDifference(const string& path, bool mem_map, const string& reference_path, size_t strip_rows)
+{
+  RawWells wells (path.c_str(), 0, 0);
+  RawWells reference (reference_path.c_str(), 0, 0);
+  wells.SetConvertWithCopies(false);
+  wells.SetMemMap(mem_map);
+  reference.SetConvertWithCopies(false);
+  wells.OpenForIncrementalRead();
+  reference.OpenForIncrementalRead();
+  double max_diff = 0.0;
+  size_t num_cols = reference.NumCols();
+  size_t num_flows = reference.NumFlows();
+  for (size_t row_start = 0; row_start < reference.NumRows(); row_start += strip_rows) {
+    size_t height = min(strip_rows, reference.NumRows() - row_start);
+    wells.SetChunk(row_start, height, 0, num_cols, 0, num_flows);
+    reference.SetChunk(row_start, height, 0, num_cols, 0, num_flows);
+    wells.ReadWells();
+    reference.ReadWells();
+    for (size_t row = row_start; row < row_start + height; ++row)
+      for (size_t col = 0; col < num_cols; ++col)
+        for (size_t flow = 0; flow < num_flows; ++flow)
+          max_diff = max(max_diff, (double)fabs(wells.At(row, col, flow) - reference.At(row, col, flow)));
+  }
+  wells.Close();
+  reference.Close();
+  return max_diff;
+}
+
+int main(int argc, const char* argv[])
+{
+  if (argc < 2) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  string wells_file = argv[1];
+  string output_dir = argc > 2 ? argv[2] : ".";
+
+  RawWells source (wells_file.c_str(), 0, 0);
+  source.SetConvertWithCopies(false);
+  source.OpenForIncrementalRead();
+  uint tile_rows = 0, tile_cols = 0, tile_flows = 0;
+  source.GetH5ChunkSize(tile_rows, tile_cols, tile_flows);
+  if (tile_rows == 0 or tile_cols == 0) {
+    printf ("WellsReadSpeed: %s has no chunk size, using 50 x 50 tiles\n", wells_file.c_str());
+    tile_rows = tile_cols = 50;
+  }
+  int region_rows = argc > 3 ? atoi(argv[3]) : tile_rows;
+  int region_cols = argc > 4 ? atoi(argv[4]) : tile_cols;
+  if (region_rows <= 0 or region_cols <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  const WellsFormat formats[] = {
+    { "hdf5-contiguous", "hdf5-contiguous", false },
+    { "blocks",        "blocks",      false },
+    { "blocks-ushort", "blocks",      true  },
+    { "blocks-half",   "blocks-half", false },
+  };
+  const int num_formats = sizeof(formats) / sizeof(formats[0]);
+
+  vector<string> paths(1, wells_file);
+  vector<string> names(1, source.IsBlockFormat() ? "original (blocks)" : "original (hdf5)");
+  vector<bool> mem_map(1, false);
+  for (int f = 0; f < num_formats; ++f) {
+    string file_name = string("read_") + formats[f].name + ".wells";
+    ConvertWells(source, output_dir, file_name, formats[f], tile_rows, tile_cols);
+    paths.push_back(output_dir + "/" + file_name);
+    names.push_back(formats[f].name);
+    mem_map.push_back(false);
+    if (string(formats[f].storage) == "hdf5-contiguous") {
+      paths.push_back(paths.back());
+      names.push_back(string(formats[f].name) + " mmap");
+      mem_map.push_back(true);
+    }
+  }
+  size_t num_rows = source.NumRows();
+  size_t num_cols = source.NumCols();
+  size_t num_flows = source.NumFlows();
+  source.Close();
+
+  printf ("WellsReadSpeed: %d x %d wells, %d flows, %d x %d tiles, %d x %d regions\n", (int)num_rows, (int)num_cols,
+      (int)num_flows, tile_rows, tile_cols, region_rows, region_cols);
+  printf ("  %-22s %10s %10s %12s\n", "format", "read s", "MB/s", "max|diff|");
+  double total_mb = (double)num_rows * num_cols * num_flows * sizeof(float) / (1024.0 * 1024.0);
+  for (unsigned int f = 0; f < paths.size(); ++f) {
+    double sum = 0.0;
+    double read_time = TimeRegionReads(paths[f], region_rows, region_cols, mem_map[f], sum);
+    double max_diff = f == 0 ? 0.0 : MaxDifference(paths[f], mem_map[f], wells_file, tile_rows);
+    printf ("  %-22s %10.3f %10.1f %12.6f\n", names[f].c_str(), read_time, total_mb / max(read_time, 1e-9), max_diff);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,605 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include "BkgModSingleFlowFitBatch.h"
+#include "LevMarFitterV2.h"
+#include "SingleFlowFit.h"
+#include "DiffEqModel.h"
+#include <float.h>
+#include <math.h>
+#include <malloc.h>
+
+#define LANES SINGLE_FLOW_FIT_LANES
+
+static inline v_lanes Broadcast (float x)
+{
+  v_lanes v;
+  for (int k=0; k<LANES; k++)
+    v[k] = x;
+  return v;
+}
+
+// mask ? a : b, lane by lane
+static inline v_lanes Select (const v_lanes_int &mask, const v_lanes &a, const v_lanes &b)
+{
+  return (v_lanes) ( ( (v_lanes_int) a & mask) | ( (v_lanes_int) b & ~mask));
+}
+
+static inline v_lanes_int LaneMask (const bool *lane)
+{
+  v_lanes_int mask;
+  for (int k=0; k<LANES; k++)
+    mask[k] = lane[k] ? -1 : 0;
+  return mask;
+}
+
+static inline bool AnyPositive (const v_lanes &x)
+{
+  for (int k=0; k<LANES; k++)
+    if (x[k] > 0.0f)
+      return true;
+  return false;
+}
+
+static inline bool AnyLane (const bool *lane)
+{
+  for (int k=0; k<LANES; k++)
+    if (lane[k])
+      return true;
+  return false;
+}
+
+BkgModSingleFlowFitBatch::BkgModSingleFlowFitBatch (int len, float *_deltaFrame, float *_deltaFrameSeconds, PoissonCDFApproxMemo *_math_poiss, int _nparams)
+{
+  npts = len;
+  nparams = _nparams;
+  num_lanes = 0;
+  deltaFrame = _deltaFrame;
+  deltaFrameSeconds = _deltaFrameSeconds;
+  math_poiss = _math_poiss;
+  _emphasis_data = NULL;
+  dp = 0.001f;
+  lambda_threshold = 1.0E+10;
+
+  // 8 traces, then 5 model parameters and 3 x 2 fit parameters
+  int num_vectors = 8*npts + 5 + 6;
+  lane_block = (v_lanes *) memalign (sizeof (v_lanes), sizeof (v_lanes) *num_vectors);
+  memset (lane_block, 0, sizeof (v_lanes) *num_vectors);
+  obs = lane_block;
+  fval = obs + npts;
+  trial_fval = fval + npts;
+  err_vect = trial_fval + npts;
+  residualWeight = err_vect + npts;
+  bfjac[0] = residualWeight + npts;
+  bfjac[1] = bfjac[0] + npts;
+  ival = bfjac[1] + npts;
+  SP = ival + npts;
+  region_kr = SP + 1;
+  d = region_kr + 1;
+  tauB = d + 1;
+  gain = tauB + 1;
+  param_val = gain + 1;
+  param_min = param_val + 2;
+  param_max = param_min + 2;
+  scalar_ival = new float[npts];
+  scalar_trace = new float[npts];
+
+  for (int k=0; k<LANES; k++)
+  {
+    sqWtScale[k] = 0.0;
+    r_start[k] = FLT_MAX;
+    lambda[k] = 1.0f;
+    regularizer[k] = 0.0f;
+    delta0[k] = 0.0;
+    converged[k] = false;
+  }
+}
+
+BkgModSingleFlowFitBatch::~BkgModSingleFlowFitBatch()
+{
+  free (lane_block);
+  delete[] scalar_ival;
+  delete[] scalar_trace;
+}
+
+void BkgModSingleFlowFitBatch::BringUpLane (int lane, BeadParams *p, reg_params *rp, int fnum, int NucID, int flow,
+                                            int i_start, float *c_dntp_top, float *signal)
+{
+  // the curried trace only works out the parameters here, the lanes compute the traces
+  calc_trace[lane].SetWellRegionParams (p, rp, fnum, NucID, flow, i_start, c_dntp_top);
+  (*SP)[lane] = calc_trace[lane].SP;
+  (*region_kr)[lane] = calc_trace[lane].region_kr;
+  (*d)[lane] = calc_trace[lane].d;
+  (*tauB)[lane] = calc_trace[lane].tauB;
+  (*gain)[lane] = calc_trace[lane].gain;
+
+  for (int i=0; i<npts; i++)
+    obs[i][lane] = signal[i];
+
+  // SetLambdaStart and InitParams
+  lambda[lane] = 1E-20;
+  regularizer[lane] = 0.0f;
+  param_val[AMPLITUDE][lane] = p->Ampl[fnum];
+  if (nparams>1)
+    param_val[KMULT][lane] = p->kmult[fnum];
+  converged[lane] = false;
+}
+
+void BkgModSingleFlowFitBatch::SetLaneWeightVector (int lane, const float *vect)
+{
+  double sq = 0.0;
+  for (int i=0; i<npts; i++)
+  {
+    residualWeight[i][lane] = vect[i];
+    sq += vect[i]*vect[i];
+  }
+  sqWtScale[lane] = sq;
+}
+
+void BkgModSingleFlowFitBatch::SetLaneParamMin (int lane, const float *_param_min)
+{
+  for (int i=0; i<nparams; i++)
+    param_min[i][lane] = _param_min[i];
+}
+
+void BkgModSingleFlowFitBatch::SetLaneParamMax (int lane, const float *_param_max)
+{
+  for (int i=0; i<nparams; i++)
+    param_max[i][lane] = _param_max[i];
+}
+
+void BkgModSingleFlowFitBatch::DetermineAndSetWeightVector (int lane, float ampl)
+{
+  float weights[npts];
+  _emphasis_data->CustomEmphasis (weights, ampl);
+  SetLaneWeightVector (lane, weights);
+}
+
+// lanes not in use repeat lane 0, so every lane computes something sensible
+void BkgModSingleFlowFitBatch::PadLanes()
+{
+  for (int k=num_lanes; k<LANES; k++)
+  {
+    for (int i=0; i<npts; i++)
+    {
+      obs[i][k] = obs[i][0];
+      residualWeight[i][k] = residualWeight[i][0];
+    }
+    (*SP)[k] = (*SP)[0];
+    (*region_kr)[k] = (*region_kr)[0];
+    (*d)[k] = (*d)[0];
+    (*tauB)[k] = (*tauB)[0];
+    (*gain)[k] = (*gain)[0];
+    for (int i=0; i<2; i++)
+    {
+      param_val[i][k] = param_val[i][0];
+      param_min[i][k] = param_min[i][0];
+      param_max[i][k] = param_max[i][0];
+    }
+    sqWtScale[k] = sqWtScale[0];
+  }
+}
+
+// MathModel::RedTrace with SimplifyComputeCumulativeIncorporationHydrogens, one bead per lane.
+// Every operation is done in the same order as the scalar code, so each lane reproduces it.
+void BkgModSingleFlowFitBatch::Evaluate (v_lanes *fval_out, const v_lanes &A, const v_lanes &kmult)
+{
+  // region, flow and timing are the same in every lane
+  TraceCurry &common = calc_trace[0];
+  int i_start = common.i_start;
+  const int SUB_STEPS = ISIG_SUB_STEPS_SINGLE_FLOW;
+  const v_lanes zero = Broadcast (0.0f);
+  const v_lanes one = Broadcast (1.0f);
+
+  if (common.reg_p->hydrogenModelType != 0)
+  {
+    // no lane version of the other incorporation models
+    for (int k=0; k<LANES; k++)
+    {
+      MathModel::RedTrace (scalar_trace, scalar_ival, npts, deltaFrameSeconds, deltaFrame, common.c_dntp_top_pc, SUB_STEPS, i_start,
+                           common.C, A[k], (*SP)[k], (*region_kr)[k]*kmult[k], common.kmax, (*d)[k], common.molecules_to_micromolar_conversion,
+                           common.sens, (*gain)[k], (*tauB)[k], math_poiss, common.reg_p->hydrogenModelType);
+      for (int i=0; i<npts; i++)
+        fval_out[i][k] = scalar_trace[i];
+    }
+    return;
+  }
+
+  MixtureMemo mix_memo[LANES];
+  v_lanes sign, pact, totocc;
+  for (int k=0; k<LANES; k++)
+  {
+    // sign handled by function composition, as in ComputeCumulativeIncorporationHydrogens
+    float tA = A[k];
+    sign[k] = 1.0f;
+    if (tA<0.0f)
+    {
+      tA = -tA;
+      sign[k] = -1.0f;
+    }
+    tA = mix_memo[k].Generate (tA, math_poiss);
+    mix_memo[k].ScaleMixture ( (*SP)[k]);
+    pact[k] = mix_memo[k].total_live;
+    totocc[k] = (*SP)[k]*tA;
+  }
+
+  v_lanes totgen = totocc;
+  v_lanes hplus_events_sum = zero;
+  v_lanes hplus_events_current, c_dntp_bot, pact_new, enzyme_dt;
+  v_lanes kr = *region_kr*kmult;
+  v_lanes scaled_kr = kr*Broadcast (common.molecules_to_micromolar_conversion) / *d;
+  v_lanes half_kr = kr*Broadcast (0.5f) /Broadcast ( (float) SUB_STEPS);
+  v_lanes kmax = Broadcast (common.kmax);
+  v_lanes c_dntp_bot_plus_kmax = Broadcast (1.0f/common.kmax);
+  v_lanes c_dntp_old_effect = zero;
+  v_lanes c_dntp_new_effect = zero;
+  const float *nuc_rise_ptr = common.c_dntp_top_pc;
+  int c_dntp_top_ndx = i_start*SUB_STEPS;
+
+  int i=0;
+  for (; i<i_start and i<npts; i++)
+    ival[i] = zero;
+  for (; i<npts; i++)
+  {
+    // lanes that are done keep decreasing totgen, the clamp below gives them the scalar result
+    if (AnyPositive (totgen))
+    {
+      enzyme_dt = half_kr*Broadcast (deltaFrameSeconds[i]);
+      for (int st=1; (st <= SUB_STEPS) && AnyPositive (totgen); st++)
+      {
+        c_dntp_bot = Broadcast (nuc_rise_ptr[c_dntp_top_ndx]);
+        c_dntp_top_ndx++;
+
+        c_dntp_bot = c_dntp_bot / (one + scaled_kr*pact*c_dntp_bot_plus_kmax);
+        c_dntp_bot_plus_kmax = one / (c_dntp_bot + kmax);
+
+        c_dntp_old_effect = c_dntp_new_effect;
+        c_dntp_new_effect = c_dntp_bot*c_dntp_bot_plus_kmax;
+
+        hplus_events_current = enzyme_dt* (c_dntp_new_effect+c_dntp_old_effect);
+        hplus_events_sum += hplus_events_current;
+
+        // the poisson tables are different for every lane
+        for (int k=0; k<LANES; k++)
+          pact_new[k] = mix_memo[k].GetStep (hplus_events_sum[k]);
+        pact += pact_new;
+        pact *= Broadcast (0.5f);
+        totgen -= pact*hplus_events_current;
+        pact = pact_new;
+      }
+      totgen = Select (totgen < zero, zero, totgen);
+    }
+    ival[i] = totocc-totgen;
+  }
+
+  // hydrogens to signal, then the buffering of the well: RedSolveHydrogenFlowInWell
+  v_lanes sens = Broadcast (common.sens);
+  for (i=0; i<npts; i++)
+    ival[i] = ival[i]*sign*sens;
+  v_lanes one_over_two_tauB = one / (Broadcast (2.0f) * *tauB);
+  v_lanes aval, one_over_one_plus_aval;
+  for (i=0; i<i_start and i<npts; i++)
+    fval_out[i] = zero;
+  if (i_start<npts)
+  {
+    i = i_start;
+    aval = Broadcast (deltaFrame[i]) *one_over_two_tauB;
+    one_over_one_plus_aval = one / (one+aval);
+    fval_out[i] = ival[i]*one_over_one_plus_aval;
+    for (i++; i<npts; i++)
+    {
+      aval = Broadcast (deltaFrame[i]) *one_over_two_tauB;
+      one_over_one_plus_aval = one / (one+aval);
+      fval_out[i] = (ival[i]-ival[i-1]+ (one-aval) *fval_out[i-1]) *one_over_one_plus_aval;
+    }
+  }
+  for (i=0; i<npts; i++)
+    fval_out[i] *= *gain;
+}
+
+void BkgModSingleFlowFitBatch::EvaluateParams (v_lanes *fval_out, const v_lanes *params)
+{
+  if (nparams>1)
+    Evaluate (fval_out, params[AMPLITUDE], params[KMULT]);
+  else
+    Evaluate (fval_out, params[AMPLITUDE], Broadcast (1.0f));
+}
+
+void BkgModSingleFlowFitBatch::CalcResidual (const v_lanes *testVals, float *r, v_lanes *err_vec, const v_lanes_int &write_err)
+{
+  double sum[LANES];
+  for (int k=0; k<LANES; k++)
+    sum[k] = 0.0;
+  for (int i=0; i<npts; i++)
+  {
+    v_lanes e = residualWeight[i]* (obs[i]-testVals[i]);
+    for (int k=0; k<LANES; k++)
+      sum[k] += (double) e[k]*e[k];
+    if (err_vec)
+      err_vec[i] = Select (write_err, e, err_vec[i]);
+  }
+  for (int k=0; k<LANES; k++)
+    r[k] = sum[k]/sqWtScale[k];
+}
+
+void BkgModSingleFlowFitBatch::MakeJacobian (v_lanes *params)
+{
+  v_lanes params_new[2];
+  v_lanes dpv = Broadcast (dp);
+  for (int i=0; i<nparams; i++)
+  {
+    params_new[0] = params[0];
+    params_new[1] = params[1];
+    params_new[i] += dpv;
+    EvaluateParams (trial_fval, params_new);
+    for (int j=0; j<npts; j++)
+      bfjac[i][j] = residualWeight[j]* (trial_fval[j]-fval[j]) /dpv;
+  }
+}
+
+// solve for the step of one lane and apply it like LevMarFitterV2, false if the matrix is singular;
+// nan_detected is set if any component of the step is NaN, and the step must then be rejected
+bool BkgModSingleFlowFitBatch::SolveStep (int lane, double *lhs, double *rhs, float *params_new, bool &nan_detected)
+{
+  double delta[2];
+  nan_detected = false;
+  if (nparams==1)
+  {
+    if (lhs[0]==0.0)
+      return false;
+    delta[0] = rhs[0]/lhs[0];
+  }
+  else
+  {
+    // partial pivoting
+    double a00 = lhs[0], a01 = lhs[1], a10 = lhs[2], a11 = lhs[3];
+    double b0 = rhs[0], b1 = rhs[1];
+    if (fabs (a10) > fabs (a00))
+    {
+      std::swap (a00, a10);
+      std::swap (a01, a11);
+      std::swap (b0, b1);
+    }
+    if (a00==0.0)
+      return false;
+    double l = a10/a00;
+    double u11 = a11-l*a01;
+    if (u11==0.0)
+      return false;
+    delta[1] = (b1-l*b0) /u11;
+    delta[0] = (b0-a01*delta[1]) /a00;
+  }
+
+  for (int i=0; i<nparams; i++)
+  {
+    double tmp_eval = delta[i];
+    if (tmp_eval != tmp_eval)
+    {
+      nan_detected = true;
+      delta[i] = 0.0;
+      tmp_eval = 0.0;
+    }
+    tmp_eval += param_val[i][lane];
+    if ( (tmp_eval>FLT_MAX) or (tmp_eval<-FLT_MAX))
+    {
+      tmp_eval = param_val[i][lane];
+      delta[i] = 0.0;
+    }
+    params_new[i] = tmp_eval;
+    // ApplyMoveConstraints
+    params_new[i] = (params_new[i] > param_max[i][lane] ? param_max[i][lane] : params_new[i]);
+    params_new[i] = (params_new[i] < param_min[i][lane] ? param_min[i][lane] : params_new[i]);
+  }
+  delta0[lane] = delta[0];
+  return true;
+}
+
+void BkgModSingleFlowFitBatch::Fit (bool gauss_newton, int max_iter, const bool *fit_lane)
+{
+  bool active[LANES], solved[LANES], evaluated[LANES], accepted[LANES];
+  int done_cnt[LANES];
+  float r_trial[LANES];
+  v_lanes params_new[2];
+  bool all_lanes[LANES];
+
+  PadLanes();
+  for (int k=0; k<LANES; k++)
+  {
+    active[k] = (k<num_lanes) and (fit_lane==NULL or fit_lane[k]);
+    all_lanes[k] = true;
+    delta0[k] = 0.0;
+    done_cnt[k] = 0;
+  }
+
+  EvaluateParams (fval, param_val);
+  CalcResidual (fval, r_start, err_vect, LaneMask (all_lanes));
+
+  for (int iter=0; ; iter++)
+  {
+    // DoneTest and ForceQuit of every lane
+    for (int k=0; k<LANES; k++)
+    {
+      if (!active[k])
+        continue;
+      if (delta0[k]*delta0[k] < 0.0000025)
+        done_cnt[k]++;
+      else
+        done_cnt[k] = 0;
+      bool done = done_cnt[k] > 1;
+      if (done or (iter>=max_iter) or (lambda[k]>lambda_threshold))
+      {
+        converged[k] = done;
+        active[k] = false;
+      }
+    }
+    if (!AnyLane (active))
+      break;
+
+    MakeJacobian (param_val);
+    v_lanes jtj[3] = { Broadcast (0.0f), Broadcast (0.0f), Broadcast (0.0f) };
+    v_lanes rhs[2] = { Broadcast (0.0f), Broadcast (0.0f) };
+    for (int j=0; j<npts; j++)
+    {
+      jtj[0] += bfjac[0][j]*bfjac[0][j];
+      rhs[0] += bfjac[0][j]*err_vect[j];
+    }
+    if (nparams>1)
+    {
+      for (int j=0; j<npts; j++)
+      {
+        jtj[1] += bfjac[0][j]*bfjac[1][j];
+        jtj[2] += bfjac[1][j]*bfjac[1][j];
+        rhs[1] += bfjac[1][j]*err_vect[j];
+      }
+    }
+    for (int k=0; k<LANES; k++)
+    {
+      bfjtj[k][0] = jtj[0][k];
+      bfrhs[k][0] = rhs[0][k];
+      if (nparams>1)
+      {
+        bfjtj[k][1] = bfjtj[k][2] = jtj[1][k];
+        bfjtj[k][3] = jtj[2][k];
+        bfrhs[k][1] = rhs[1][k];
+      }
+    }
+
+    if (gauss_newton)
+    {
+      // TryGaussNewtonStep
+      float pn[2];
+      params_new[0] = param_val[0];
+      params_new[1] = param_val[1];
+      for (int k=0; k<LANES; k++)
+      {
+        solved[k] = evaluated[k] = false;
+        if (!active[k])
+          continue;
+        if ( (nparams==1) & (bfjtj[k][0]==0.0f))
+          regularizer[k] += REGULARIZER_VAL;
+        for (int i=0; i<nparams; i++)
+          bfjtj[k][i*nparams+i] += regularizer[k];
+        bool nan_detected;
+        if (!SolveStep (k, bfjtj[k], bfrhs[k], pn, nan_detected))
+        {
+          delta0[k] = 0.0;
+          regularizer[k] += REGULARIZER_VAL;
+          continue;
+        }
+        solved[k] = true;
+        // a NaN step is not tried, as in TryGaussNewtonStep
+        evaluated[k] = !nan_detected;
+        for (int i=0; i<nparams; i++)
+          params_new[i][k] = pn[i];
+      }
+      if (AnyLane (evaluated))
+      {
+        EvaluateParams (trial_fval, params_new);
+        // dynamic emphasis
+        for (int k=0; k<LANES; k++)
+          if (evaluated[k])
+            DetermineAndSetWeightVector (k, params_new[AMPLITUDE][k]);
+        CalcResidual (trial_fval, r_trial, err_vect, LaneMask (evaluated));
+      }
+      for (int k=0; k<LANES; k++)
+      {
+        accepted[k] = solved[k] and evaluated[k] and (r_trial[k] < r_start[k]);
+        if (accepted[k])
+        {
+          for (int i=0; i<nparams; i++)
+            param_val[i][k] = params_new[i][k];
+          r_start[k] = r_trial[k];
+        }
+        else if (solved[k])
+          DetermineAndSetWeightVector (k, param_val[AMPLITUDE][k]);
+      }
+      v_lanes_int accept_mask = LaneMask (accepted);
+      for (int j=0; j<npts; j++)
+        fval[j] = Select (accept_mask, trial_fval[j], fval[j]);
+    }
+    else
+    {
+      // TryLevMarStep: raise lambda until the lane improves or gives up
+      bool trying[LANES];
+      for (int k=0; k<LANES; k++)
+        trying[k] = active[k] and ! (lambda[k]>lambda_threshold);
+      while (AnyLane (trying))
+      {
+        float pn[2];
+        params_new[0] = param_val[0];
+        params_new[1] = param_val[1];
+        for (int k=0; k<LANES; k++)
+        {
+          solved[k] = evaluated[k] = false;
+          if (!trying[k])
+            continue;
+          double bflhs[4];
+          memcpy (bflhs, bfjtj[k], sizeof (bflhs));
+          for (int i=0; i<nparams; i++)
+            bflhs[i*nparams+i] *= (1.0 + lambda[k]);
+          if ( (nparams==1) & (bflhs[0]==0.0f))
+            regularizer[k] += REGULARIZER_VAL;
+          for (int i=0; i<nparams; i++)
+            bflhs[i*nparams+i] += regularizer[k];
+          bool nan_detected;
+          if (!SolveStep (k, bflhs, bfrhs[k], pn, nan_detected))
+          {
+            delta0[k] = 0.0;
+            lambda[k] *= LEVMAR_STEP_V2;
+            regularizer[k] += REGULARIZER_VAL;
+            continue;
+          }
+          solved[k] = true;
+          // a NaN step is not tried and raises lambda, as in TryLevMarStep
+          evaluated[k] = !nan_detected;
+          for (int i=0; i<nparams; i++)
+            params_new[i][k] = pn[i];
+        }
+        if (AnyLane (evaluated))
+        {
+          EvaluateParams (trial_fval, params_new);
+          CalcResidual (trial_fval, r_trial, err_vect, LaneMask (evaluated));
+        }
+        for (int k=0; k<LANES; k++)
+        {
+          accepted[k] = solved[k] and evaluated[k] and (r_trial[k] < r_start[k]);
+          if (accepted[k])
+          {
+            if (lambda[k] > LEVMAR_STEP_V2*FLT_MIN)
+              lambda[k] /= LEVMAR_STEP_V2;
+            for (int i=0; i<nparams; i++)
+              param_val[i][k] = params_new[i][k];
+            r_start[k] = r_trial[k];
+            trying[k] = false;
+          }
+          else if (solved[k])
+            lambda[k] *= LEVMAR_STEP_V2;
+          if (lambda[k] > lambda_threshold)
+            trying[k] = false;
+        }
+        v_lanes_int accept_mask = LaneMask (accepted);
+        for (int j=0; j<npts; j++)
+          fval[j] = Select (accept_mask, trial_fval[j], fval[j]);
+      }
+    }
+  }
+
+  for (int k=0; k<num_lanes; k++)
+    if (fit_lane==NULL or fit_lane[k])
+      regularizer[k] = 0.0f;
+}
+
+void BkgModSingleFlowFitBatch::GetMeanSquaredError (float *mse)
+{
+  float r[LANES];
+  PadLanes();
+  EvaluateParams (fval, param_val);
+  CalcResidual (fval, r, NULL, LaneMask (converged));
+  for (int k=0; k<num_lanes; k++)
+    mse[k] = r[k];
+}
+
+void BkgModSingleFlowFitBatch::ReturnPredicted (int lane, float *f_predict)
+{
+  if (f_predict!=NULL)
+    for (int i=0; i<npts; i++)
+      f_predict[i] = fval[i][lane];
+}
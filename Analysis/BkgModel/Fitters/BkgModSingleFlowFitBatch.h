@@ -0,0 +1,110 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef BKGMODSINGLEFLOWFITBATCH_H
+#define BKGMODSINGLEFLOWFITBATCH_H
+
+#include "TraceCurry.h"
+#include "EmphasisVector.h"
+
+// one bead per lane, as many lanes as fit in one register
+#if defined( __AVX512F__ )
+#define SINGLE_FLOW_FIT_LANES 16
+#elif defined( __AVX__ )
+#define SINGLE_FLOW_FIT_LANES 8
+#else
+#define SINGLE_FLOW_FIT_LANES 4
+#endif
+
+typedef float v_lanes __attribute__ ( (vector_size (sizeof (float) *SINGLE_FLOW_FIT_LANES)));
+typedef int v_lanes_int __attribute__ ( (vector_size (sizeof (int) *SINGLE_FLOW_FIT_LANES)));
+
+// Structure-of-arrays version of BkgModSingleFlowFit, laid out like the bead-per-thread
+// SingleFitStream on the GPU.  Up to SINGLE_FLOW_FIT_LANES beads of one region in the same flow
+// are fit in lock-step: traces are stored frame-major with one bead per lane, so the
+// incorporation trace, the finite difference jacobian and the weighted residuals are computed
+// for every bead at once.  The Gauss-Newton and Lev-Mar iterations follow LevMarFitterV2 and the
+// BkgModSingleFlowFit done test lane by lane, lanes that are done are masked out.
+class BkgModSingleFlowFitBatch
+{
+  public:
+    // one curried trace per lane, holds the bead/region/flow parameters of that bead
+    TraceCurry calc_trace[SINGLE_FLOW_FIT_LANES];
+
+    BkgModSingleFlowFitBatch (int len, float *deltaFrame, float *deltaFrameSeconds, PoissonCDFApproxMemo *math_poiss, int nparams);
+    ~BkgModSingleFlowFitBatch();
+
+    void SetLambdaThreshold (float _lambda_threshold) { lambda_threshold = _lambda_threshold; }
+    void SetUpEmphasis (EmphasisClass *emphasis_data) { _emphasis_data = emphasis_data; }
+    int GetnParams() { return nparams; }
+
+    // lanes in use are 0..num_lanes-1
+    void SetNumLanes (int _num_lanes) { num_lanes = _num_lanes; }
+    int GetNumLanes() { return num_lanes; }
+    // equivalent of SetWellRegionParams, SetLambdaStart and InitParams for one lane
+    void BringUpLane (int lane, BeadParams *p, reg_params *rp, int fnum, int NucID, int flow, int i_start, float *c_dntp_top, float *signal);
+    void SetLaneWeightVector (int lane, const float *vect);
+    void SetLaneParamMin (int lane, const float *_param_min);
+    void SetLaneParamMax (int lane, const float *_param_max);
+    void SetNthParam (int lane, float val, int idx) { param_val[idx][lane] = val; }
+    float ReturnNthParam (int lane, int idx) { return param_val[idx][lane]; }
+    bool IsConverged (int lane) { return converged[lane]; }
+
+    // fit the lanes flagged in fit_lane, all lanes in use if NULL
+    void Fit (bool gauss_newton, int max_iter, const bool *fit_lane = NULL);
+    // mean squared error of every lane at the current parameters and weights,
+    // keeps the evaluated traces for ReturnPredicted
+    void GetMeanSquaredError (float *mse);
+    void ReturnPredicted (int lane, float *f_predict);
+
+  private:
+    // incorporation trace of every lane for amplitude A and kmult
+    void Evaluate (v_lanes *fval, const v_lanes &A, const v_lanes &kmult);
+    void EvaluateParams (v_lanes *fval, const v_lanes *params);
+    // weighted residual of every lane, error vector written for the lanes in write_err
+    void CalcResidual (const v_lanes *testVals, float *r, v_lanes *err_vec, const v_lanes_int &write_err);
+    void DetermineAndSetWeightVector (int lane, float ampl);
+    void MakeJacobian (v_lanes *params);
+    bool SolveStep (int lane, double *lhs, double *rhs, float *params_new, bool &nan_detected);
+    void PadLanes();
+
+    int npts;
+    int nparams;
+    int num_lanes;
+    float *deltaFrame;
+    float *deltaFrameSeconds;
+    PoissonCDFApproxMemo *math_poiss;
+    EmphasisClass *_emphasis_data;
+
+    // frame-major traces, one bead per lane, and per lane values, all in one aligned block
+    // (a class with vector members would need over-aligned new)
+    v_lanes *lane_block;
+    v_lanes *obs;
+    v_lanes *fval;
+    v_lanes *trial_fval;
+    v_lanes *err_vect;
+    v_lanes *residualWeight;
+    v_lanes *bfjac[2];
+    v_lanes *ival;
+    float *scalar_ival; // incorporation models without a lane version
+    float *scalar_trace;
+
+    // per lane model parameters
+    v_lanes *SP, *region_kr, *d, *tauB, *gain;
+
+    // per lane fit state, nparams vectors each
+    v_lanes *param_val;
+    v_lanes *param_min;
+    v_lanes *param_max;
+    double sqWtScale[SINGLE_FLOW_FIT_LANES];
+    float r_start[SINGLE_FLOW_FIT_LANES];
+    float lambda[SINGLE_FLOW_FIT_LANES];
+    float regularizer[SINGLE_FLOW_FIT_LANES];
+    double delta0[SINGLE_FLOW_FIT_LANES];
+    double bfjtj[SINGLE_FLOW_FIT_LANES][4];
+    double bfrhs[SINGLE_FLOW_FIT_LANES][2];
+    bool converged[SINGLE_FLOW_FIT_LANES];
+
+    float dp;
+    float lambda_threshold;
+};
+
+#endif // BKGMODSINGLEFLOWFITBATCH_H
@@ -32,20 +32,10 @@ void RefineFit::InitSingleFlowFit()
 
 
 
-void RefineFit::FitAmplitudePerBeadPerFlow (int ibd, NucStep &cache_step, int flow_block_size, int flow_block_start)
+void RefineFit::PrepareBeadSignal (int ibd, error_track &err_t, float *block_signal_corrected, float *block_signal_original, float *block_signal_sbg,
+                                   int flow_block_size, int flow_block_start)
 {
-
   BeadParams *p = &bkg.region_data->my_beads.params_nn[ibd];
-  float block_signal_corrected[bkg.region_data->my_scratch.bead_flow_t];
-  float block_signal_predicted[bkg.region_data->my_scratch.bead_flow_t];
-  float block_signal_original[bkg.region_data->my_scratch.bead_flow_t]; // what were we before? correct-in-place erases information
-  float block_signal_sbg[bkg.region_data->my_scratch.bead_flow_t]; // what background did we actually use: may not be stable in case of bugs
-
-
-  float washoutThreshold = bkg.getWashoutThreshold();
-  int washoutFlowDetection = bkg.getWashoutFlowDetection();
-
-  error_track err_t; // temporary store fitting information, including errors for this bead this flow
 
   bkg.trace_bkg_adj->ReturnBackgroundCorrectedSignal (block_signal_corrected, block_signal_original, block_signal_sbg, ibd, flow_block_size, flow_block_start);
 
@@ -59,6 +49,46 @@ void RefineFit::FitAmplitudePerBeadPerFlow (int ibd, NucStep &cache_step, int fl
 
   }
   }
+}
+
+void RefineFit::FinishBeadFit (int ibd, error_track &err_t, float *block_signal_predicted, float *block_signal_corrected, float *block_signal_original, float *block_signal_sbg,
+                               int flow_block_size, int flow_block_start)
+{
+  BeadParams *p = &bkg.region_data->my_beads.params_nn[ibd];
+  float washoutThreshold = bkg.getWashoutThreshold();
+  int washoutFlowDetection = bkg.getWashoutFlowDetection();
+
+  // do things with my error vector for this bead
+
+  // now detect corruption & store average error
+  p->DetectCorruption (err_t, washoutThreshold, washoutFlowDetection, flow_block_size);
+  // update error here to be passed to later block of flows
+  // don't keep individual flow errors because we're surprisingly tight on memory
+  p->UpdateCumulativeAvgError (err_t, flow_block_start + flow_block_size, flow_block_size); // current flow reached, 1-based
+  if (bkg.global_defaults.signal_process_control.stop_beads){
+  bool trip_flag = bkg.region_data->my_beads.UpdateSTOP(ibd, flow_block_size);
+  // debugging, decrease number of high quality wells track when it happens
+  if ((trip_flag) & (ibd % 143==0)){ // sample debug beads
+    printf("STOP: %d %d %d %d %d %f\n", bkg.region_data->region->index,ibd, p->x, p->y, flow_block_start, bkg.region_data->my_beads.decay_ssq[ibd]);
+  }
+  }
+
+  // send prediction to hdf5 if necessary
+  CrazyDumpToHDF5(p,ibd,block_signal_predicted, block_signal_corrected, block_signal_original, block_signal_sbg, err_t, flow_block_start );
+}
+
+void RefineFit::FitAmplitudePerBeadPerFlow (int ibd, NucStep &cache_step, int flow_block_size, int flow_block_start)
+{
+
+  BeadParams *p = &bkg.region_data->my_beads.params_nn[ibd];
+  float block_signal_corrected[bkg.region_data->my_scratch.bead_flow_t];
+  float block_signal_predicted[bkg.region_data->my_scratch.bead_flow_t];
+  float block_signal_original[bkg.region_data->my_scratch.bead_flow_t]; // what were we before? correct-in-place erases information
+  float block_signal_sbg[bkg.region_data->my_scratch.bead_flow_t]; // what background did we actually use: may not be stable in case of bugs
+
+  error_track err_t; // temporary store fitting information, including errors for this bead this flow
+
+  PrepareBeadSignal (ibd, err_t, block_signal_corrected, block_signal_original, block_signal_sbg, flow_block_size, flow_block_start);
 
   for (int fnum=0;fnum < flow_block_size;fnum++)
   {
@@ -75,24 +105,53 @@ void RefineFit::FitAmplitudePerBeadPerFlow (int ibd, NucStep &cache_step, int fl
     err_t.t_sigma_actual[fnum] = cache_step.t_sigma_actual[fnum];
   }
 
+  FinishBeadFit (ibd, err_t, block_signal_predicted, block_signal_corrected, block_signal_original, block_signal_sbg, flow_block_size, flow_block_start);
+}
 
-  // do things with my error vector for this bead
-
-  // now detect corruption & store average error
-  p->DetectCorruption (err_t, washoutThreshold, washoutFlowDetection, flow_block_size);
-  // update error here to be passed to later block of flows
-  // don't keep individual flow errors because we're surprisingly tight on memory
-  p->UpdateCumulativeAvgError (err_t, flow_block_start + flow_block_size, flow_block_size); // current flow reached, 1-based
-  if (bkg.global_defaults.signal_process_control.stop_beads){
-  bool trip_flag = bkg.region_data->my_beads.UpdateSTOP(ibd, flow_block_size);
-  // debugging, decrease number of high quality wells track when it happens
-  if ((trip_flag) & (ibd % 143==0)){ // sample debug beads
-    printf("STOP: %d %d %d %d %d %f\n", bkg.region_data->region->index,ibd, p->x, p->y, flow_block_start, bkg.region_data->my_beads.decay_ssq[ibd]);
+// same as FitAmplitudePerBeadPerFlow for a group of beads, each flow is fit for all of them at once
+void RefineFit::FitAmplitudePerBeadGroupPerFlow (int *ibd, int num_beads, NucStep &cache_step, int flow_block_size, int flow_block_start)
+{
+  int bead_flow_t = bkg.region_data->my_scratch.bead_flow_t;
+  int npts = bkg.region_data->time_c.npts();
+  std::vector<float> group_signal_corrected (num_beads*bead_flow_t);
+  std::vector<float> group_signal_predicted (num_beads*bead_flow_t);
+  std::vector<float> group_signal_original (num_beads*bead_flow_t);
+  std::vector<float> group_signal_sbg (num_beads*bead_flow_t);
+  std::vector<error_track> group_err_t (num_beads);
+
+  std::vector<BeadParams *> p (num_beads);
+  std::vector<error_track *> err_t (num_beads);
+  std::vector<float *> signal_corrected (num_beads);
+  std::vector<float *> signal_predicted (num_beads);
+  for (int i=0; i<num_beads; i++)
+  {
+    p[i] = &bkg.region_data->my_beads.params_nn[ibd[i]];
+    err_t[i] = &group_err_t[i];
+    PrepareBeadSignal (ibd[i], group_err_t[i], &group_signal_corrected[i*bead_flow_t], &group_signal_original[i*bead_flow_t], &group_signal_sbg[i*bead_flow_t],
+                       flow_block_size, flow_block_start);
   }
+
+  for (int fnum=0;fnum < flow_block_size;fnum++)
+  {
+    for (int i=0; i<num_beads; i++)
+    {
+      signal_corrected[i] = &group_signal_corrected[i*bead_flow_t + fnum*npts];
+      signal_predicted[i] = &group_signal_predicted[i*bead_flow_t + fnum*npts];
+    }
+    int NucID = bkg.region_data_extras.my_flow->flow_ndx_map[fnum];
+    my_single_fit.FitOneFlowBatch (num_beads, fnum, &p[0], &err_t[0], &signal_corrected[0], &signal_predicted[0],
+                                   NucID, cache_step.NucFineStep (fnum), cache_step.i_start_fine_step[fnum],
+                                   flow_block_start, bkg.region_data->emphasis_data, bkg.region_data->my_regions);
+    for (int i=0; i<num_beads; i++)
+    {
+      group_err_t[i].t_mid_nuc_actual[fnum] = cache_step.t_mid_nuc_actual[fnum];
+      group_err_t[i].t_sigma_actual[fnum] = cache_step.t_sigma_actual[fnum];
+    }
   }
 
-  // send prediction to hdf5 if necessary
-  CrazyDumpToHDF5(p,ibd,block_signal_predicted, block_signal_corrected, block_signal_original, block_signal_sbg, err_t, flow_block_start );
+  for (int i=0; i<num_beads; i++)
+    FinishBeadFit (ibd[i], group_err_t[i], &group_signal_predicted[i*bead_flow_t], &group_signal_corrected[i*bead_flow_t],
+                   &group_signal_original[i*bead_flow_t], &group_signal_sbg[i*bead_flow_t], flow_block_size, flow_block_start);
 }
 
 // this HDF5 dump has gotten way out of hand
@@ -259,6 +318,38 @@ void RefineFit::FitAmplitudePerFlow ( int flow_block_size, int flow_block_start
 
   // allocate mResError
   //bkg.global_state.AllocDataCubeResErr(*bkg.region_data);
+  // xtalk correction of a bead uses the amplitudes its neighbours were just refit to,
+  // so with xtalk the beads are fit one at a time in order
+  if (bkg.global_defaults.signal_process_control.single_flow_batch and not bkg.trace_xtalk_spec.do_xtalk_correction)
+  {
+    // several batches of lanes per group, the debug bead keeps the per bead path
+    const int group_size = 4*SINGLE_FLOW_FIT_LANES;
+    int group[group_size];
+    int num_in_group = 0;
+    for (int ibd = 0;ibd < bkg.region_data->my_beads.numLBeads;ibd++)
+    {
+      if (ibd==bkg.region_data->my_beads.DEBUG_BEAD)
+      {
+        if (num_in_group>0)
+          FitAmplitudePerBeadGroupPerFlow (group, num_in_group, bkg.region_data->my_regions.cache_step, flow_block_size, flow_block_start);
+        num_in_group = 0;
+        FitAmplitudePerBeadPerFlow (ibd,bkg.region_data->my_regions.cache_step, flow_block_size, flow_block_start);
+      }
+      else if (bkg.region_data->my_beads.params_nn[ibd].FitBeadLogic () or bkg.region_data->isRegionSample(ibd) or bkg.region_data->isBestRegion)
+      {
+        group[num_in_group++] = ibd;
+        if (num_in_group==group_size)
+        {
+          FitAmplitudePerBeadGroupPerFlow (group, num_in_group, bkg.region_data->my_regions.cache_step, flow_block_size, flow_block_start);
+          num_in_group = 0;
+        }
+      }
+    }
+    if (num_in_group>0)
+      FitAmplitudePerBeadGroupPerFlow (group, num_in_group, bkg.region_data->my_regions.cache_step, flow_block_size, flow_block_start);
+    return;
+  }
+
   for (int ibd = 0;ibd < bkg.region_data->my_beads.numLBeads;ibd++)
   {
     if (bkg.region_data->my_beads.params_nn[ibd].FitBeadLogic () or bkg.region_data->isRegionSample(ibd) or bkg.region_data->isBestRegion or ibd==bkg.region_data->my_beads.DEBUG_BEAD) // make sure debugging beads are preserved
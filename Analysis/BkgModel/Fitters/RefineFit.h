@@ -19,6 +19,12 @@ class RefineFit
     void InitSingleFlowFit();
     void FitAmplitudePerFlow ( int flow_block_size, int flow_block_start );
     void FitAmplitudePerBeadPerFlow (int ibd, NucStep &cache_step, int flow_block_size, int flow_block_start);
+    void FitAmplitudePerBeadGroupPerFlow (int *ibd, int num_beads, NucStep &cache_step, int flow_block_size, int flow_block_start);
+    // background correction before and bookkeeping after the single flow fits of one bead
+    void PrepareBeadSignal (int ibd, error_track &err_t, float *block_signal_corrected, float *block_signal_original, float *block_signal_sbg,
+                            int flow_block_size, int flow_block_start);
+    void FinishBeadFit (int ibd, error_track &err_t, float *block_signal_predicted, float *block_signal_corrected, float *block_signal_original, float *block_signal_sbg,
+                        int flow_block_size, int flow_block_start);
     void SetupLocalEmphasis();
 
     void CrazyDumpToHDF5(BeadParams *p, int ibd, float * block_signal_predicted, float *block_signal_corrected, float *block_signal_original, float *block_signal_sbg,error_track &err_t, int flow_block_start );
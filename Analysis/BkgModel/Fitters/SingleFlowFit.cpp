@@ -12,6 +12,8 @@ single_flow_optimizer::single_flow_optimizer()
   // be processing
   oneFlowFit = NULL;
   oneFlowFitKrate = NULL;
+  oneFlowFitBatch = NULL;
+  oneFlowFitKrateBatch = NULL;
 
   for (int i=0; i<2; i++)
   {
@@ -32,6 +34,8 @@ void single_flow_optimizer::Delete()
 {
   if (oneFlowFitKrate!=NULL) delete oneFlowFitKrate;
   if (oneFlowFit!=NULL) delete oneFlowFit;
+  if (oneFlowFitKrateBatch!=NULL) delete oneFlowFitKrateBatch;
+  if (oneFlowFitBatch!=NULL) delete oneFlowFitBatch;
 }
 
 single_flow_optimizer::~single_flow_optimizer()
@@ -81,6 +85,9 @@ void single_flow_optimizer::SetupOneParameter(TimeCompression &time_c, PoissonCD
   oneFlowFit = new BkgModSingleFlowFit (time_c.npts(),&time_c.frameNumber[0],&time_c.deltaFrame[0],&time_c.deltaFrameSeconds[0],_math_poiss,1);
   oneFlowFit->SetLambdaThreshold (10.0);
   SendLimitsToOptimizer(oneFlowFit);
+
+  oneFlowFitBatch = new BkgModSingleFlowFitBatch (time_c.npts(),&time_c.deltaFrame[0],&time_c.deltaFrameSeconds[0],_math_poiss,1);
+  oneFlowFitBatch->SetLambdaThreshold (10.0);
 }
 
 void single_flow_optimizer::SetupTwoParameter(TimeCompression &time_c, PoissonCDFApproxMemo *_math_poiss)
@@ -90,6 +97,9 @@ void single_flow_optimizer::SetupTwoParameter(TimeCompression &time_c, PoissonCD
   oneFlowFitKrate->SetLambdaThreshold (1.0);
   SendLimitsToOptimizer(oneFlowFitKrate);
 
+  oneFlowFitKrateBatch = new BkgModSingleFlowFitBatch (time_c.npts(),&time_c.deltaFrame[0],&time_c.deltaFrameSeconds[0],_math_poiss,2);
+  oneFlowFitKrateBatch->SetLambdaThreshold (1.0);
+
   // in case of slow incorporation
   // detect kmult at lower boundary
   // large fit error
@@ -268,3 +278,168 @@ int single_flow_optimizer::FitOneFlow (int fnum, float *evect, BeadParams *p,  e
 
   return (fitType);
 }
+
+
+// the batch fitters walk through the same steps as FitStandardPath, one bead per lane
+
+void single_flow_optimizer::BringUpOptimizerBatch (BkgModSingleFlowFitBatch *BatchFit, int num_beads, int fnum, BeadParams **p, float **signal_corrected, int NucID, float *lnucRise, int l_i_start,
+                                                   int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions)
+{
+  float evect[emphasis_data.npts];
+  BatchFit->SetNumLanes (num_beads);
+  for (int lane=0; lane<num_beads; lane++)
+  {
+    emphasis_data.CustomEmphasis (evect, p[lane]->Ampl[fnum]);
+    BatchFit->SetLaneWeightVector (lane, evect);
+    BatchFit->SetLaneParamMin (lane, pmin_param);
+    BatchFit->SetLaneParamMax (lane, pmax_param);
+    BatchFit->BringUpLane (lane, p[lane], &my_regions.rp, fnum, NucID, flow_block_start + fnum, l_i_start, lnucRise, signal_corrected[lane]);
+  }
+}
+
+void single_flow_optimizer::SpecialStartChooseKmultBatch (int fnum, BeadParams **p, error_track **err_t)
+{
+  int num_beads = oneFlowFitKrateBatch->GetNumLanes();
+  float eval_one[SINGLE_FLOW_FIT_LANES], eval_two[SINGLE_FLOW_FIT_LANES];
+  for (int lane=0; lane<num_beads; lane++)
+    oneFlowFitKrateBatch->SetNthParam (lane, 1.0f, KMULT);
+  oneFlowFitKrateBatch->GetMeanSquaredError (eval_one); // default kmult=1
+  for (int lane=0; lane<num_beads; lane++)
+    oneFlowFitKrateBatch->SetNthParam (lane, pmin_param[KMULT], KMULT);
+  oneFlowFitKrateBatch->GetMeanSquaredError (eval_two); // lower bound
+  for (int lane=0; lane<num_beads; lane++)
+  {
+    if ( (eval_two[lane]<eval_one[lane]) or (always_slow))
+      p[lane]->kmult[fnum] = pmin_param[KMULT];
+    else
+      p[lane]->kmult[fnum] = 1.0f;
+    oneFlowFitKrateBatch->SetNthParam (lane, p[lane]->kmult[fnum], KMULT);
+    err_t[lane]->initkmult[fnum] = p[lane]->kmult[fnum];
+  }
+}
+
+void single_flow_optimizer::SpecialReFitSlowIncorporationsBatch (int fnum, error_track **err_t)
+{
+  int num_beads = oneFlowFitKrateBatch->GetNumLanes();
+  float mse[SINGLE_FLOW_FIT_LANES];
+  bool refit[SINGLE_FLOW_FIT_LANES];
+  bool any_refit = false;
+  oneFlowFitKrateBatch->GetMeanSquaredError (mse);
+  for (int lane=0; lane<SINGLE_FLOW_FIT_LANES; lane++)
+  {
+    refit[lane] = false;
+    if (lane>=num_beads)
+      continue;
+    err_t[lane]->fit_type[fnum] = FITKRATE;
+    if ( (fabs (oneFlowFitKrateBatch->ReturnNthParam (lane, KMULT)-pmin_param[KMULT]) <kmult_at_bottom) and (sqrt (mse[lane]) >fit_error_too_high))
+    {
+      // possible slow incorporation, allow kmult below the usual limit
+      float slow_min[2] = {pmin_param[AMPLITUDE], final_minimum_kmult};
+      float slow_max[2] = {pmax_param[AMPLITUDE], pmin_param[KMULT]};
+      oneFlowFitKrateBatch->SetLaneParamMin (lane, slow_min);
+      oneFlowFitKrateBatch->SetLaneParamMax (lane, slow_max);
+      err_t[lane]->fit_type[fnum] = FITSLOW;
+      refit[lane] = any_refit = true;
+    }
+  }
+  if (any_refit)
+  {
+    int max_fit_iter = gauss_newton_fit ? NUMSINGLEFLOWITER_GAUSSNEWTON : NUMSINGLEFLOWITER_LEVMAR;
+    oneFlowFitKrateBatch->Fit (gauss_newton_fit, max_fit_iter, refit);
+  }
+}
+
+void single_flow_optimizer::ReturnTrackedDataBatch (BkgModSingleFlowFitBatch *BatchFit, int fnum, BeadParams **p, error_track **err_t, float **signal_predicted, EmphasisClass &emphasis_data)
+{
+  int num_beads = BatchFit->GetNumLanes();
+  float mse[SINGLE_FLOW_FIT_LANES];
+  for (int lane=0; lane<num_beads; lane++)
+  {
+    p[lane]->Ampl[fnum] = BatchFit->ReturnNthParam (lane, AMPLITUDE);
+    if (BatchFit->GetnParams() >1)
+      p[lane]->kmult[fnum] = BatchFit->ReturnNthParam (lane, KMULT);
+    else
+      p[lane]->kmult[fnum] = 1.0f;
+    err_t[lane]->tauB[fnum] = BatchFit->calc_trace[lane].tauB;
+    err_t[lane]->etbR[fnum] = BatchFit->calc_trace[lane].etbR;
+    err_t[lane]->converged[fnum] = BatchFit->IsConverged (lane);
+    BatchFit->SetLaneWeightVector (lane, emphasis_data.EmphasisVectorByHomopolymer[emphasis_data.numEv-1]);
+  }
+  BatchFit->GetMeanSquaredError (mse);
+  for (int lane=0; lane<num_beads; lane++)
+  {
+    err_t[lane]->mean_residual_error[fnum] = sqrt (mse[lane]);
+    BatchFit->ReturnPredicted (lane, signal_predicted[lane]);
+  }
+}
+
+void single_flow_optimizer::FitKrateOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                                                  int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions)
+{
+  BringUpOptimizerBatch (oneFlowFitKrateBatch, num_beads, fnum, p, signal_corrected, NucID, lnucRise, l_i_start, flow_block_start, emphasis_data, my_regions);
+  SpecialStartChooseKmultBatch (fnum, p, err_t);
+
+  int max_fit_iter = gauss_newton_fit ? NUMSINGLEFLOWITER_GAUSSNEWTON : NUMSINGLEFLOWITER_LEVMAR;
+  oneFlowFitKrateBatch->Fit (gauss_newton_fit, max_fit_iter);
+
+  SpecialReFitSlowIncorporationsBatch (fnum, err_t);
+
+  ReturnTrackedDataBatch (oneFlowFitKrateBatch, fnum, p, err_t, signal_predicted, emphasis_data);
+}
+
+void single_flow_optimizer::FitThisOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                                                 int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions)
+{
+  for (int lane=0; lane<num_beads; lane++)
+  {
+    p[lane]->kmult[fnum] = 1.0f;
+    err_t[lane]->fit_type[fnum] = FITAMPONLY;
+  }
+  BringUpOptimizerBatch (oneFlowFitBatch, num_beads, fnum, p, signal_corrected, NucID, lnucRise, l_i_start, flow_block_start, emphasis_data, my_regions);
+
+  int max_fit_iter = gauss_newton_fit ? NUMSINGLEFLOWITER_GAUSSNEWTON : NUMSINGLEFLOWITER_LEVMAR;
+  oneFlowFitBatch->Fit (gauss_newton_fit, max_fit_iter);
+
+  ReturnTrackedDataBatch (oneFlowFitBatch, fnum, p, err_t, signal_predicted, emphasis_data);
+}
+
+void single_flow_optimizer::FitOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                                             int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions)
+{
+  // sort the beads by fit type, so that every lane of a batch takes the same path
+  std::vector<int> krate, amp_only;
+  for (int ibd=0; ibd<num_beads; ibd++)
+  {
+    err_t[ibd]->initA[fnum] = p[ibd]->Ampl[fnum];
+    err_t[ibd]->initkmult[fnum] = p[ibd]->kmult[fnum];
+    if ( (p[ibd]->Copies*p[ibd]->Ampl[fnum]) > decision_threshold)
+      krate.push_back (ibd);
+    else
+      amp_only.push_back (ibd);
+  }
+
+  BeadParams *lane_p[SINGLE_FLOW_FIT_LANES];
+  error_track *lane_err_t[SINGLE_FLOW_FIT_LANES];
+  float *lane_corrected[SINGLE_FLOW_FIT_LANES];
+  float *lane_predicted[SINGLE_FLOW_FIT_LANES];
+  for (int pass=0; pass<2; pass++)
+  {
+    std::vector<int> &beads = (pass==0) ? krate : amp_only;
+    for (size_t start=0; start<beads.size(); start+=SINGLE_FLOW_FIT_LANES)
+    {
+      int num_lanes = std::min ( (int) (beads.size()-start), SINGLE_FLOW_FIT_LANES);
+      for (int lane=0; lane<num_lanes; lane++)
+      {
+        int ibd = beads[start+lane];
+        lane_p[lane] = p[ibd];
+        lane_err_t[lane] = err_t[ibd];
+        lane_corrected[lane] = signal_corrected[ibd];
+        lane_predicted[lane] = signal_predicted[ibd];
+      }
+      if (pass==0)
+        FitKrateOneFlowBatch (num_lanes, fnum, lane_p, lane_err_t, lane_corrected, lane_predicted, NucID, lnucRise, l_i_start, flow_block_start, emphasis_data, my_regions);
+      else
+        FitThisOneFlowBatch (num_lanes, fnum, lane_p, lane_err_t, lane_corrected, lane_predicted, NucID, lnucRise, l_i_start, flow_block_start, emphasis_data, my_regions);
+    }
+  }
+}
@@ -25,6 +25,7 @@
 #define KMULT 1
 
 #include "BkgModSingleFlowFit.h"
+#include "BkgModSingleFlowFitBatch.h"
 
 
 
@@ -37,6 +38,10 @@ class single_flow_optimizer
 
     BkgModSingleFlowFit *oneFlowFitKrate;
 
+    // the same two fits for SINGLE_FLOW_FIT_LANES beads at a time
+    BkgModSingleFlowFitBatch *oneFlowFitBatch;
+    BkgModSingleFlowFitBatch *oneFlowFitKrateBatch;
+
     // extra decision boundaries to try to trap slow incorporations
      float kmult_at_bottom;
      float fit_error_too_high; //@TODO: this does not scale with signal!!!!
@@ -90,12 +95,30 @@ class single_flow_optimizer
 
     void ResetStandardLimits();
 
+    // same as FitOneFlow for each of num_beads beads in the same flow, fit types go to err_t
+    void FitOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                          int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions);
+    // at most SINGLE_FLOW_FIT_LANES beads each
+    void FitKrateOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                               int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions);
+    void FitThisOneFlowBatch (int num_beads, int fnum, BeadParams **p, error_track **err_t, float **signal_corrected, float **signal_predicted, int NucID, float *lnucRise, int l_i_start,
+                              int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions);
+    void BringUpOptimizerBatch (BkgModSingleFlowFitBatch *BatchFit, int num_beads, int fnum, BeadParams **p, float **signal_corrected, int NucID, float *lnucRise, int l_i_start,
+                                int flow_block_start, EmphasisClass &emphasis_data, RegionTracker &my_regions);
+    void SpecialStartChooseKmultBatch (int fnum, BeadParams **p, error_track **err_t);
+    void SpecialReFitSlowIncorporationsBatch (int fnum, error_track **err_t);
+    void ReturnTrackedDataBatch (BkgModSingleFlowFitBatch *BatchFit, int fnum, BeadParams **p, error_track **err_t, float **signal_predicted, EmphasisClass &emphasis_data);
+
     void SetUpEmphasisForLevMarOptimizer(EmphasisClass* emphasis_data)
     {
       if (oneFlowFit)
         oneFlowFit->SetUpEmphasis(emphasis_data);      
       if (oneFlowFitKrate)
         oneFlowFitKrate->SetUpEmphasis(emphasis_data);      
+      if (oneFlowFitBatch)
+        oneFlowFitBatch->SetUpEmphasis(emphasis_data);
+      if (oneFlowFitKrateBatch)
+        oneFlowFitKrateBatch->SetUpEmphasis(emphasis_data);
     }
     void SendLimitsToOptimizer(BkgModSingleFlowFit *OneFit);
 
@@ -29,6 +29,7 @@ LocalSigProcControl::LocalSigProcControl()
 
 
   fit_gauss_newton = true;
+  single_flow_batch = false;
   fit_region_kmult = false;
 
   do_clonal_filter = true;
@@ -73,6 +74,7 @@ void LocalSigProcControl::PrintHelp()
     printf ("     --skip-first-flow-block-regional-fitting   BOOL  skip multi flow regional fitting in first flow block if a regional parameters json file is provided [false]\n");
     printf ("     --bkg-prefilter-beads   BOOL              use prefilter beads [false]\n");
     printf ("     --vectorize             BOOL              use vectorization [true]\n");
+    printf ("     --bkg-single-flow-batch BOOL              fit single flows of several beads at once in vector lanes, not with xtalk correction [false]\n");
     printf ("     --limit-rdr-fit         BOOL              use no ratio drift fit first 20 flows [false]\n");
     printf ("     --fitting-taue          BOOL              enable fitting taue [false]\n");
     printf ("     --bkg-single-alternate  BOOL              use fit alternate [false]\n");
@@ -159,6 +161,7 @@ void LocalSigProcControl::SetOpts(OptArgs &opts, Json::Value& json_params)
    stop_beads = RetrieveParameterBool(opts, json_params, '-', "stop-beads", false);
 
 	fit_gauss_newton = RetrieveParameterBool(opts, json_params, '-', "bkg-single-gauss-newton", true);
+	single_flow_batch = RetrieveParameterBool(opts, json_params, '-', "bkg-single-flow-batch", false);
 
   fit_region_kmult = RetrieveParameterBool(opts, json_params, '-', "fit-region-kmult", false);
   always_start_slow = RetrieveParameterBool(opts, json_params, '-', "always-start-slow", true);
@@ -40,6 +40,7 @@ struct LocalSigProcControl{
   bool stop_beads;
 
   bool fit_gauss_newton;
+  bool single_flow_batch; // fit the single flows of several beads at once
   int   choose_time;
 
 // regional sampling filtering
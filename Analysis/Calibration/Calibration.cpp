@@ -20,7 +20,29 @@
 using namespace std;
 using namespace BamTools;
 
+// ----------------------------------------------------------------
+//! @brief    Training data owned by a single worker thread.
+//! @ingroup  Calibration
+//! Unless the linear model is fit blindly, which needs the master model updated after every batch,
+//! workers accumulate into their own models without locking and these are combined after the threads join.
+
+struct CalibrationWorkerShard
+{
+  CalibrationContext *       calib_context;
+  HistogramCalibration *     hist_calibration_local;     //!< Histogram training data of this thread
+  LinearCalibrationModel *   linear_cal_model_local;     //!< Linear model training data of this thread
+  unsigned long              num_useful_reads;           //!< Useful reads processed by this thread
+};
+
+//! @brief    A pair of worker shards combined in one step of the reduction tree.
+struct CalibrationShardMerge
+{
+  CalibrationWorkerShard *   target;
+  CalibrationWorkerShard *   source;
+};
+
 void * CalibrationWorker(void *input);
+void * CalibrationReduceShards(void *input);
 int ExecuteThreadedCalibrationTraining(CalibrationContext &calib_context);
 
 // ----------------------------------------------------------------
@@ -190,9 +212,17 @@ int ExecuteThreadedCalibrationTraining(CalibrationContext &calib_context){
   pthread_cond_init(&calib_context.model_read_cond, NULL);
   pthread_cond_init(&calib_context.model_write_cond, NULL);
 
+  vector<CalibrationWorkerShard> shards(calib_context.num_threads);
+  for (unsigned int worker = 0; worker < calib_context.num_threads; worker++) {
+    shards[worker].calib_context          = &calib_context;
+    shards[worker].hist_calibration_local = new HistogramCalibration(*calib_context.hist_calibration_master);
+    shards[worker].linear_cal_model_local = new LinearCalibrationModel(*calib_context.linear_model_master);
+    shards[worker].num_useful_reads       = 0;
+  }
+
   pthread_t worker_id[calib_context.num_threads];
   for (unsigned int worker = 0; worker < calib_context.num_threads; worker++)
-    if (pthread_create(&worker_id[worker], NULL, CalibrationWorker, &calib_context)) {
+    if (pthread_create(&worker_id[worker], NULL, CalibrationWorker, &shards[worker])) {
       cerr << "Calibration ERROR: Problem starting thread" << endl;
       exit (EXIT_FAILURE);
     }
@@ -200,6 +230,32 @@ int ExecuteThreadedCalibrationTraining(CalibrationContext &calib_context){
   for (unsigned int worker = 0; worker < calib_context.num_threads; worker++)
     pthread_join(worker_id[worker], NULL);
 
+  // Combine the training data of the workers pairwise in a tree, each level of merges in parallel,
+  // and add the result to the master models. Shards of blind fit workers are empty.
+  vector<CalibrationShardMerge> merges(calib_context.num_threads / 2);
+  for (unsigned int stride = 1; stride < calib_context.num_threads; stride *= 2) {
+    unsigned int num_merges = 0;
+    for (unsigned int worker = 0; worker + stride < calib_context.num_threads; worker += 2*stride) {
+      merges[num_merges].target = &shards[worker];
+      merges[num_merges].source = &shards[worker+stride];
+      if (pthread_create(&worker_id[num_merges], NULL, CalibrationReduceShards, &merges[num_merges])) {
+        cerr << "Calibration ERROR: Problem starting thread" << endl;
+        exit (EXIT_FAILURE);
+      }
+      num_merges++;
+    }
+    for (unsigned int merge = 0; merge < num_merges; merge++)
+      pthread_join(worker_id[merge], NULL);
+  }
+  if (calib_context.bam_reader.NumPasses() == 0)
+    calib_context.num_useful_reads += shards[0].num_useful_reads;
+  if (calib_context.local_fit_polish_model)
+    calib_context.hist_calibration_master->AccumulateHistData(*shards[0].hist_calibration_local);
+  if (calib_context.local_fit_linear_model)
+    calib_context.linear_model_master->AccumulateTrainingData(*shards[0].linear_cal_model_local);
+  delete shards[0].hist_calibration_local;
+  delete shards[0].linear_cal_model_local;
+
   pthread_mutex_destroy(&calib_context.read_mutex);
   pthread_mutex_destroy(&calib_context.write_mutex);
   pthread_cond_destroy(&calib_context.model_read_cond);
@@ -215,10 +271,33 @@ int ExecuteThreadedCalibrationTraining(CalibrationContext &calib_context){
 // --------------------------------------------------------------------------
 
 
+// Adds the training data of the source shard to the target shard and releases the source models.
+
+void * CalibrationReduceShards(void *input)
+{
+  CalibrationShardMerge& merge = *static_cast<CalibrationShardMerge*>(input);
+  const CalibrationContext& calib_context = *merge.target->calib_context;
+
+  merge.target->num_useful_reads += merge.source->num_useful_reads;
+  if (calib_context.local_fit_polish_model)
+    merge.target->hist_calibration_local->AccumulateHistData(*merge.source->hist_calibration_local);
+  if (calib_context.local_fit_linear_model)
+    merge.target->linear_cal_model_local->AccumulateTrainingData(*merge.source->linear_cal_model_local);
+
+  delete merge.source->hist_calibration_local;
+  delete merge.source->linear_cal_model_local;
+  merge.source->hist_calibration_local = NULL;
+  merge.source->linear_cal_model_local = NULL;
+  return NULL;
+}
+
+// --------------------------------------------------------------------------
+
 void * CalibrationWorker(void *input)
 {
 
-  CalibrationContext& calib_context = *static_cast<CalibrationContext*>(input);
+  CalibrationWorkerShard& shard = *static_cast<CalibrationWorkerShard*>(input);
+  CalibrationContext& calib_context = *shard.calib_context;
 
   // *** Initialize Modules
 
@@ -240,23 +319,31 @@ void * CalibrationWorker(void *input)
     treephaser_vector.push_back(dpTreephaser);
   }
 
-  HistogramCalibration    hist_calibration_local(*calib_context.hist_calibration_master);
-  LinearCalibrationModel  linear_cal_model_local(*calib_context.linear_model_master); // Training data for current batch
+  HistogramCalibration&   hist_calibration_local = *shard.hist_calibration_local;
+  LinearCalibrationModel& linear_cal_model_local = *shard.linear_cal_model_local; // Training data for current batch or thread
   LinearCalibrationModel  linear_model_cal_sim  (*calib_context.linear_model_master); // state of master to date (changing for blind)
 
+  // Blind fitting of the linear model synchronizes with the master model after every batch;
+  // otherwise training data is collected by this thread and combined once all threads are done.
+  bool sync_batches = calib_context.blind_fit and calib_context.local_fit_linear_model;
+  hist_calibration_local.CleanSlate();
+  linear_cal_model_local.CleanSlate();
+
 
   // *** Process reads
 
   while (true) {
 
-    hist_calibration_local.CleanSlate();
-    linear_cal_model_local.CleanSlate();
+    if (sync_batches) {
+      hist_calibration_local.CleanSlate();
+      linear_cal_model_local.CleanSlate();
+    }
     unsigned long num_useful_reads = 0;
 
     // Step 0 *** Wait for permission to read most recent master model
     //            Blind fit only! Non-blind is limited to one training iteration.
 
-    if (calib_context.blind_fit and calib_context.local_fit_linear_model){
+    if (sync_batches){
       pthread_mutex_lock(&calib_context.write_mutex);
 
       while(calib_context.wait_to_read_model)
@@ -368,15 +455,19 @@ void * CalibrationWorker(void *input)
 
 
     // Step 3 *** After read processing finished, aggregate the collected information.
+    //            Without synchronization it stays with the thread until the final reduction.
+
+    if (not sync_batches) {
+      shard.num_useful_reads += num_useful_reads;
+      continue;
+    }
 
     pthread_mutex_lock(&calib_context.write_mutex);
 
-    if (calib_context.blind_fit and calib_context.local_fit_linear_model){
-      while(calib_context.wait_to_write_model)
-        pthread_cond_wait (&calib_context.model_write_cond, &calib_context.write_mutex);
+    while(calib_context.wait_to_write_model)
+      pthread_cond_wait (&calib_context.model_write_cond, &calib_context.write_mutex);
 
-      calib_context.num_model_writes++;
-    }
+    calib_context.num_model_writes++;
 
     if (update_bam_stats)
       calib_context.num_useful_reads += num_useful_reads;
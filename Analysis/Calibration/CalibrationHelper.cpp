@@ -718,7 +718,8 @@ bool ReadAlignmentInfo::UnpackAlignmentInfo (const CalibrationContext& calib_con
   else if (calib_context.do_flow_alignment){
 
     align_success = PerformFlowAlignment(full_target_bases, full_query_bases, flow_order.str(), 0,
-                           aln_flow_order, aligned_qHPs, aligned_tHPs, align_flow_index, pretty_flow_align);
+                           aln_flow_order, aligned_qHPs, aligned_tHPs, align_flow_index, pretty_flow_align,
+                           flow_align_workspace);
   }
   else { // light flow alignment
 
@@ -20,6 +20,7 @@
 #include "api/BamAlignment.h"
 #include "DPTreephaser.h"
 #include "BaseCallerUtils.h"
+#include "FlowAlignment.h"
 #include "json/json.h"
 
 using namespace std;
@@ -193,6 +194,7 @@ public:
   vector<int>     aligned_tHPs;             //!< The HP compressed target or reference sequence in the alignment, including gaps.
   vector<int>     align_flow_index;         //!< The flow index corresponding to flow aligned query HPs, padded with -1 in gaps
   vector<char>    pretty_flow_align;        //!< The flow alignment operation string
+  FlowAlignmentWorkspace  flow_align_workspace;  //!< Scratch memory of the flow alignment, reused between reads
 
   bool            is_filtered;
 
@@ -2,6 +2,8 @@
 
 #include "FlowAlignment.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
 #include "MiscUtil.h"
 
 using namespace std;
@@ -162,6 +164,86 @@ void RetrieveBaseAlignment(
 
 // =================================================================================
 
+void FlowAlignmentWorkspace::Resize(int num_rows, int row_size)
+{
+  row_size_ = row_size;
+  size_t num_cells = (size_t)num_rows * row_size;
+  if (match_score_.size() < num_cells) {
+    match_score_.resize(num_cells);
+    ins_score_.resize(num_cells);
+    del_score_.resize(num_cells);
+    match_from_.resize(num_cells);
+    ins_from_.resize(num_cells);
+    del_from_.resize(num_cells);
+  }
+}
+
+// ---------------------------------------------------------------------------------
+
+// Vertical (insertion) and diagonal (match) moves into one row of the flow alignment matrices.
+// These only depend on previous rows, so each cell of the row is independent of its neighbors.
+// The moves are evaluated for every cell and selected without branches for the compiler to vectorize;
+// ties resolve as in a sequential comparison since a candidate only replaces the current best if strictly better.
+
+static void FlowAlignRowInsMatch(int t_size, char q_nuc, int q_hp, int gap_sum, int hp_weight, bool start_local,
+    const char * __restrict t_nuc, const int * __restrict t_hp,
+    const int * __restrict match_up, const int * __restrict ins_up, const int * __restrict del_up,
+    const int * __restrict match_jmp, const int * __restrict ins_jmp,
+    int * __restrict match_score, char * __restrict match_from, int * __restrict ins_score, char * __restrict ins_from)
+{
+  for(int t_idx = 1; t_idx <= t_size; ++t_idx) { // target
+
+    // vertical
+    // four moves:
+    // 1. phased from match
+    // 2. phased from ins
+    // 3. empty from match
+    // 4. empty from ins
+    // Note: use the NEXT reference base for flow order matching
+
+    int  empty_ok    = (t_idx < t_size) & (q_nuc != t_nuc[t_idx]);
+    int  empty_score = max(del_up[t_idx], match_up[t_idx]) - q_hp;
+    empty_score      = max(empty_score, (int)MINOR_INF);
+    int  empty_ins   = ins_up[t_idx] - q_hp;
+    int  from_ie     = empty_ok & (empty_score < empty_ins);
+    empty_score      = max(empty_score, empty_ins);
+
+    int  ins  = empty_ok ? empty_score : (int)MINOR_INF;
+    char insf = from_ie ? (char)FROM_IE : (char)FROM_ME;
+    int candidate = match_jmp[t_idx] - gap_sum;
+    insf = (ins < candidate) ? (char)FROM_MP : insf;
+    ins  = max(ins, candidate);
+    candidate = ins_jmp[t_idx] - gap_sum;
+    insf = (ins < candidate) ? (char)FROM_IP : insf;
+    ins  = max(ins, candidate);
+    ins_score[t_idx] = ins;
+    ins_from[t_idx]  = insf;
+
+    // diagonal
+    // Preference: D, M, I
+
+    int  delta_hp = hp_weight * abs(t_hp[t_idx-1] - q_hp);
+    int  match    = del_up[t_idx-1] - delta_hp;
+    char matchf   = FROM_D;
+    candidate = match_up[t_idx-1] - delta_hp;
+    matchf = (match < candidate) ? (char)FROM_M : matchf;
+    match  = max(match, candidate);
+    candidate = ins_up[t_idx-1] - delta_hp;
+    matchf = (match < candidate) ? (char)FROM_I : matchf;
+    match  = max(match, candidate);
+    // Start anywhere in tseq
+    if(start_local) {
+      matchf = (match < -delta_hp) ? (char)FROM_S : matchf;  // From arbitrarily located start point
+      match  = max(match, -delta_hp);
+    }
+    int  same_nuc = (q_nuc == t_nuc[t_idx-1]);
+    match_score[t_idx] = same_nuc ? match : (int)MINOR_INF;
+    match_from[t_idx]  = same_nuc ? matchf : (char)FROM_S;
+  }
+}
+
+// ---------------------------------------------------------------------------------
+
 // Function does a flow alignment and tries to match homopolymer lengths
 // Inputs:         tseq_bases : Target bases
 //                 qseq_bases : Query bases
@@ -184,6 +266,28 @@ bool PerformFlowAlignment(
     vector<char>&             aln,
     bool                      debug_output)
 {
+  FlowAlignmentWorkspace workspace;
+  return PerformFlowAlignment(tseq_bases, qseq_bases, main_flow_order, first_useful_flow,
+                              flowOrder, qseq, tseq, aln_flow_index, aln, workspace, debug_output);
+}
+
+// ---------------------------------------------------------------------------------
+
+bool PerformFlowAlignment(
+    // Inputs:
+    const string&             tseq_bases,
+    const string&             qseq_bases,
+    const string&             main_flow_order,
+    int                       first_useful_flow,
+    // Outputs:
+    vector<char>&             flowOrder,
+    vector<int>&              qseq,
+    vector<int>&              tseq,
+    vector<int>&              aln_flow_index,
+    vector<char>&             aln,
+    FlowAlignmentWorkspace&   workspace,
+    bool                      debug_output)
+{
 
   bool startLocal = false; // CK: I not sure these options work correctly
   bool endLocal = false;
@@ -193,10 +297,13 @@ bool PerformFlowAlignment(
   // **** Generate homopolymer representation for the qseq_bases.
 
 
-  vector<char>  qseq_hp_nuc;
-  vector<int>   qseq_hp;
-  vector<int>   qseq_flow_idx;
+  vector<char>& qseq_hp_nuc   = workspace.qseq_hp_nuc;
+  vector<int>&  qseq_hp       = workspace.qseq_hp;
+  vector<int>&  qseq_flow_idx = workspace.qseq_flow_idx;
 
+  qseq_hp_nuc.clear();
+  qseq_hp.clear();
+  qseq_flow_idx.clear();
   qseq_hp_nuc.reserve(main_flow_order.size());
   qseq_hp.reserve(main_flow_order.size());
   qseq_flow_idx.reserve(main_flow_order.size());
@@ -213,7 +320,8 @@ bool PerformFlowAlignment(
     }
   }
 
-  vector<int>   qseq_hp_previous_nuc(qseq_hp.size(),0);
+  vector<int>&  qseq_hp_previous_nuc = workspace.qseq_hp_previous_nuc;
+  qseq_hp_previous_nuc.assign(qseq_hp.size(),0);
 
   int last_nuc_pos[8] = {-100,-100,-100,-100,-100,-100,-100,-100};
   for (int q_idx = 0; q_idx < (int)qseq_hp.size(); ++q_idx) {
@@ -224,10 +332,12 @@ bool PerformFlowAlignment(
 
   // **** Generate homopolymer representation of tseq_bases.
 
-  vector<char>  tseq_hp_nuc;
-  vector<int>   tseq_hp;
+  vector<char>& tseq_hp_nuc = workspace.tseq_hp_nuc;
+  vector<int>&  tseq_hp     = workspace.tseq_hp;
 
-  tseq_hp_nuc.reserve(tseq_bases.size());
+  tseq_hp_nuc.clear();
+  tseq_hp.clear();
+  tseq_hp_nuc.reserve(tseq_bases.size()+1);
   tseq_hp.reserve(tseq_bases.size());
   char prev_base = 0;
 
@@ -252,140 +362,110 @@ bool PerformFlowAlignment(
   }
   // **** Done
 
+  const int q_size = qseq_hp.size();
+  const int t_size = tseq_hp.size();
+  // The empty flow moves look at the NEXT target nucleotide; the padding makes the row loop branch free.
+  tseq_hp_nuc.push_back(0);
 
   // Initialize gaps sums
-  vector<int> gapSumsI(qseq_hp.size(), phasePenalty);
-  for(int q_idx = 0; q_idx < (int)qseq_hp.size(); ++q_idx)
+  vector<int>& gapSumsI = workspace.gap_sums_ins;
+  gapSumsI.assign(q_size, phasePenalty);
+  for(int q_idx = 0; q_idx < q_size; ++q_idx)
     for(int idx = qseq_hp_previous_nuc[q_idx]; idx <= q_idx; ++idx)
       gapSumsI[q_idx] += qseq_hp[idx];
 
 
-  // Stores the score for extending with a match.
-  vector<vector<int> > dp_matchScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
-  // Stores the score for extending with a insertion.
-  vector<vector<int> > dp_insScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
-  // Stores the score for extending with a deletion.
-  vector<vector<int> > dp_delScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
-
-  // Stores the previous cell in the path to a match.
-  vector<vector<int> > dp_matchFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
-  // Stores the previous cell in the path to a insertion.
-  vector<vector<int> > dp_insFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
-  // Stores the previous cell in the path to a deletion.
-  vector<vector<int> > dp_delFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
-
-  // Vertical: Insertion score for first column of dp matrix
-  // only allow phasing from an insertion
-  for(int q_idx = 1; q_idx <= (int)qseq_hp.size(); ++q_idx) {
-    int q_jump_idx = qseq_hp_previous_nuc[q_idx-1];
-    if(0 == q_jump_idx) {
-      dp_insScore[q_idx][0] = 0 - gapSumsI[q_idx-1];
-      dp_insFrom[q_idx][0] = FROM_IP;
-    } else {
-      dp_insScore[q_idx][0] = dp_insScore[q_jump_idx][0] - gapSumsI[q_idx-1];
-      dp_insFrom[q_idx][0] = FROM_IP;
+  // Dynamic programming matrices of (1+q_size) x (1+t_size) cells
+  workspace.Resize(1+q_size, 1+t_size);
+
+  // First row: deletions only
+  {
+    int *  match_score = workspace.MatchScore(0);
+    int *  ins_score   = workspace.InsScore(0);
+    int *  del_score   = workspace.DelScore(0);
+    char * match_from  = workspace.MatchFrom(0);
+    char * ins_from    = workspace.InsFrom(0);
+    char * del_from    = workspace.DelFrom(0);
+    for (int t_idx = 0; t_idx <= t_size; ++t_idx) {
+      match_score[t_idx] = MINOR_INF;
+      ins_score[t_idx]   = MINOR_INF;
+      match_from[t_idx]  = FROM_S;
+      ins_from[t_idx]    = FROM_S;
+    }
+    // init start cell
+    match_score[0] = 0;
+    del_score[0]   = MINOR_INF;
+    del_from[0]    = FROM_S;
+
+    // Horizontal: Deletion score for first row of dp matrix
+    for (int t_idx = 1; t_idx <= t_size; ++t_idx) {
+      int previous = 0;
+      if (t_idx > 1)
+        previous = del_score[t_idx-1];
+      del_score[t_idx] = previous - 2*tseq_hp[t_idx-1];
+      del_from[t_idx]  = FROM_D;
     }
   }
 
-  // Horizontal: Deletion score for first row of dp matrix
-  for (unsigned int t_idx = 1; t_idx <= tseq_hp.size(); ++t_idx) {
-    int previous = 0;
-    if (t_idx > 1)
-      previous = dp_delScore[0][t_idx-1];
-    dp_delScore[0][t_idx] = previous - 2*tseq_hp[t_idx-1];
-    dp_delFrom[0][t_idx]  = FROM_D;
-  }
-
-  // init start cells
-  dp_matchScore[0][0] = 0;
-
   // align
 
-  for(int q_idx = 1; q_idx <= (int)qseq_hp.size(); ++q_idx) { // query
-    int q_jump_idx = qseq_hp_previous_nuc[q_idx-1];
-
-    for(unsigned int t_idx = 1; t_idx <= tseq_hp.size(); ++t_idx) { // target
+  const char * t_nuc = &tseq_hp_nuc[0];
+  const int *  t_hp  = tseq_hp.empty() ? NULL : &tseq_hp[0];
 
-      // horizontal. Preference: D, M, I
-
-      dp_delScore[q_idx][t_idx]     = dp_delScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
-      dp_delFrom[q_idx][t_idx]      = FROM_D;
-
-      if (dp_delScore[q_idx][t_idx] < dp_matchScore[q_idx][t_idx-1] - tseq_hp[t_idx-1]) {
-        dp_delScore[q_idx][t_idx]   = dp_matchScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
-        dp_delFrom[q_idx][t_idx]    = FROM_M;
-      }
-      if (dp_delScore[q_idx][t_idx] < dp_insScore[q_idx][t_idx-1] - tseq_hp[t_idx-1]) {
-        dp_delScore[q_idx][t_idx]   = dp_insScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
-        dp_delFrom[q_idx][t_idx]    = FROM_I;
-      }
-
-      // vertical
-      // four moves:
-      // 1. phased from match
-      // 2. phased from ins
-      // 3. empty from match
-      // 4. empty from ins
-      // Note: use the NEXT reference base for flow order matching
-
-      dp_insScore[q_idx][t_idx]       = MINOR_INF;
-      dp_insFrom[q_idx][t_idx]        = FROM_ME;
-
-      if(t_idx < tseq_hp.size() and q_idx >= 1 and qseq_hp_nuc[q_idx-1] != tseq_hp_nuc[t_idx]) {
-        if (dp_insScore[q_idx][t_idx] < dp_delScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
-          dp_insScore[q_idx][t_idx]   = dp_delScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
-          dp_insFrom[q_idx][t_idx]    = FROM_ME;
-        }
-        if (dp_insScore[q_idx][t_idx] < dp_matchScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
-          dp_insScore[q_idx][t_idx]   = dp_matchScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
-          dp_insFrom[q_idx][t_idx]    = FROM_ME;
-        }
-        if (dp_insScore[q_idx][t_idx] < dp_insScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
-          dp_insScore[q_idx][t_idx]   = dp_insScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
-          dp_insFrom[q_idx][t_idx]    = FROM_IE;
-        }
-      }
-
-      if (dp_insScore[q_idx][t_idx]   < dp_matchScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1]) {
-        dp_insScore[q_idx][t_idx]     = dp_matchScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1];
-        dp_insFrom[q_idx][t_idx]      = FROM_MP;
-      }
-
-      if (dp_insScore[q_idx][t_idx]   < dp_insScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1]) {
-        dp_insScore[q_idx][t_idx]     = dp_insScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1];
-        dp_insFrom[q_idx][t_idx]      = FROM_IP;
+  for(int q_idx = 1; q_idx <= q_size; ++q_idx) { // query
+    int q_jump_idx = qseq_hp_previous_nuc[q_idx-1];
+    const char q_nuc     = qseq_hp_nuc[q_idx-1];
+    const int  q_hp      = qseq_hp[q_idx-1];
+    const int  gap_sum   = gapSumsI[q_idx-1];
+    const int  hp_weight = (q_idx == 1 or q_idx == q_size) ? 0 : 1;   // no HP penalty for first and last flow
+    const bool start_local_row = (startLocal and q_idx == 1);
+
+    const int * match_up  = workspace.MatchScore(q_idx-1);
+    const int * ins_up    = workspace.InsScore(q_idx-1);
+    const int * del_up    = workspace.DelScore(q_idx-1);
+    const int * match_jmp = workspace.MatchScore(q_jump_idx);
+    const int * ins_jmp   = workspace.InsScore(q_jump_idx);
+    int *  match_score     = workspace.MatchScore(q_idx);
+    int *  ins_score       = workspace.InsScore(q_idx);
+    int *  del_score       = workspace.DelScore(q_idx);
+    char * match_from      = workspace.MatchFrom(q_idx);
+    char * ins_from        = workspace.InsFrom(q_idx);
+    char * del_from        = workspace.DelFrom(q_idx);
+
+    // Vertical: Insertion score for first column of dp matrix
+    // only allow phasing from an insertion
+    match_score[0] = MINOR_INF;
+    match_from[0]  = FROM_S;
+    del_score[0]   = MINOR_INF;
+    del_from[0]    = FROM_S;
+    ins_score[0]   = ((0 == q_jump_idx) ? 0 : ins_jmp[0]) - gap_sum;
+    ins_from[0]    = FROM_IP;
+
+    // Vertical and diagonal moves only depend on previous rows
+    FlowAlignRowInsMatch(t_size, q_nuc, q_hp, gap_sum, hp_weight, start_local_row, t_nuc, t_hp,
+                         match_up, ins_up, del_up, match_jmp, ins_jmp, match_score, match_from, ins_score, ins_from);
+
+    // horizontal. Preference: D, M, I
+    // A deletion extends the cell to its left in the same row, so this is a serial scan.
+
+    for(int t_idx = 1; t_idx <= t_size; ++t_idx) { // target
+      int  del  = del_score[t_idx-1] - t_hp[t_idx-1];
+      char delf = FROM_D;
+      int candidate = match_score[t_idx-1] - t_hp[t_idx-1];
+      if (del < candidate) {
+        del  = candidate;
+        delf = FROM_M;
       }
-
-
-      // diagonal
-
-      dp_matchScore[q_idx][t_idx]       = MINOR_INF;
-      dp_matchFrom[q_idx][t_idx]        = FROM_S;
-
-      if(qseq_hp_nuc[q_idx-1] == tseq_hp_nuc[t_idx-1]) {
-        int delta_hp = (q_idx == 1 or q_idx == (int)qseq_hp.size()) ? 0 : abs(tseq_hp[t_idx-1] - qseq_hp[q_idx-1]);
-
-        // Preference: D, M, I
-        dp_matchScore[q_idx][t_idx]     = dp_delScore[q_idx-1][t_idx-1] - delta_hp;
-        dp_matchFrom[q_idx][t_idx]      = FROM_D;
-
-        if (dp_matchScore[q_idx][t_idx] < dp_matchScore[q_idx-1][t_idx-1] - delta_hp) {
-          dp_matchScore[q_idx][t_idx]   = dp_matchScore[q_idx-1][t_idx-1] - delta_hp;
-          dp_matchFrom[q_idx][t_idx]    = FROM_M;
-        }
-
-        if (dp_matchScore[q_idx][t_idx] < dp_insScore[q_idx-1][t_idx-1] - delta_hp) {
-          dp_matchScore[q_idx][t_idx]   = dp_insScore[q_idx-1][t_idx-1] - delta_hp;
-          dp_matchFrom[q_idx][t_idx]    = FROM_I;
-        }
-        // Start anywhere in tseq
-        if(dp_matchScore[q_idx][t_idx]  < -delta_hp and startLocal and q_idx == 1) {
-          dp_matchScore[q_idx][t_idx]   = -delta_hp;
-          dp_matchFrom[q_idx][t_idx]    = FROM_S;  // From arbitrarily located start point
-        }
+      candidate = ins_score[t_idx-1] - t_hp[t_idx-1];
+      if (del < candidate) {
+        del  = candidate;
+        delf = FROM_I;
       }
+      del_score[t_idx] = del;
+      del_from[t_idx]  = delf;
     }
   }
+  tseq_hp_nuc.pop_back();
 
   // Get best scoring cell
   int best_score = MINOR_INF-1;    // The best alignment score found so far.
@@ -396,23 +476,26 @@ bool PerformFlowAlignment(
   // TODO: want to map the query into a sub-sequence of the target
   // We can end anywhere in the target, but we haven't done the beginning.
   // We also need to return where the start end in the target to update start/end position(s).
-  for(unsigned int t_idx = endLocal ? 1 : tseq_hp.size(); t_idx <= tseq_hp.size(); ++t_idx) { // target
-    if(best_score <= dp_delScore[qseq_hp.size()][t_idx]) {
-      q_traceback = qseq_hp.size();
+  const int * last_match_score = workspace.MatchScore(q_size);
+  const int * last_ins_score   = workspace.InsScore(q_size);
+  const int * last_del_score   = workspace.DelScore(q_size);
+  for(int t_idx = endLocal ? 1 : t_size; t_idx <= t_size; ++t_idx) { // target
+    if(best_score <= last_del_score[t_idx]) {
+      q_traceback = q_size;
       t_traceback = t_idx;
-      best_score = dp_delScore[qseq_hp.size()][t_idx];
+      best_score = last_del_score[t_idx];
       from_traceback = FROM_D;
     }
-    if(best_score <= dp_insScore[qseq_hp.size()][t_idx]) {
-      q_traceback = qseq_hp.size();
+    if(best_score <= last_ins_score[t_idx]) {
+      q_traceback = q_size;
       t_traceback = t_idx;
-      best_score = dp_insScore[qseq_hp.size()][t_idx];
+      best_score = last_ins_score[t_idx];
       from_traceback = FROM_I;
     }
-    if(best_score <= dp_matchScore[qseq_hp.size()][t_idx]) {
-      q_traceback = qseq_hp.size();
+    if(best_score <= last_match_score[t_idx]) {
+      q_traceback = q_size;
       t_traceback = t_idx;
-      best_score = dp_matchScore[qseq_hp.size()][t_idx];
+      best_score = last_match_score[t_idx];
       from_traceback = FROM_M;
     }
   }
@@ -438,7 +521,7 @@ bool PerformFlowAlignment(
       case FROM_M:
       case FROM_ME:
       case FROM_MP:
-        from_traceback = dp_matchFrom.at(q_traceback).at(t_traceback);
+        from_traceback = workspace.MatchFrom(q_traceback)[t_traceback];
         q_traceback--;
         t_traceback--;
 
@@ -452,7 +535,7 @@ bool PerformFlowAlignment(
       case FROM_I:
       case FROM_IE:
       case FROM_IP:
-        from_traceback = dp_insFrom.at(q_traceback).at(t_traceback);
+        from_traceback = workspace.InsFrom(q_traceback)[t_traceback];
 
         if(from_traceback == FROM_ME or from_traceback == FROM_IE) {
           q_traceback--;
@@ -484,7 +567,7 @@ bool PerformFlowAlignment(
         break;
 
       case FROM_D:
-        from_traceback = dp_delFrom.at(q_traceback).at(t_traceback);
+        from_traceback = workspace.DelFrom(q_traceback)[t_traceback];
         t_traceback--;
 
         flowOrder.push_back(tseq_hp_nuc.at(t_traceback) - 'A' + 'a');
@@ -48,6 +48,46 @@ void RetrieveBaseAlignment(
     unsigned int&                left_sc,
     unsigned int&                right_sc);
 
+// ----------------------------------------------------------
+
+// Scratch memory of PerformFlowAlignment, kept by the caller to be reused from read to read.
+// Dynamic programming matrices are stored row by row (one row per query flow) in flat arrays
+// that only grow, so a thread aligning many reads does not allocate per read.
+
+class FlowAlignmentWorkspace {
+public:
+  FlowAlignmentWorkspace() : row_size_(0) {};
+
+  void Resize(int num_rows, int row_size);
+
+  int * MatchScore(int q_idx) { return &match_score_[q_idx*row_size_]; };
+  int * InsScore(int q_idx)   { return &ins_score_[q_idx*row_size_]; };
+  int * DelScore(int q_idx)   { return &del_score_[q_idx*row_size_]; };
+  char* MatchFrom(int q_idx)  { return &match_from_[q_idx*row_size_]; };
+  char* InsFrom(int q_idx)    { return &ins_from_[q_idx*row_size_]; };
+  char* DelFrom(int q_idx)    { return &del_from_[q_idx*row_size_]; };
+
+  // Homopolymer representations of query and target
+  std::vector<char>  qseq_hp_nuc;
+  std::vector<int>   qseq_hp;
+  std::vector<int>   qseq_flow_idx;
+  std::vector<int>   qseq_hp_previous_nuc;
+  std::vector<int>   gap_sums_ins;
+  std::vector<char>  tseq_hp_nuc;
+  std::vector<int>   tseq_hp;
+
+private:
+  int                row_size_;
+  std::vector<int>   match_score_;   //!< Score for extending with a match
+  std::vector<int>   ins_score_;     //!< Score for extending with an insertion
+  std::vector<int>   del_score_;     //!< Score for extending with a deletion
+  std::vector<char>  match_from_;    //!< Previous cell in the path to a match
+  std::vector<char>  ins_from_;      //!< Previous cell in the path to an insertion
+  std::vector<char>  del_from_;      //!< Previous cell in the path to a deletion
+};
+
+// ----------------------------------------------------------
+
 bool PerformFlowAlignment(
     // Inputs:
     const std::string&             tseq_bases,
@@ -63,6 +103,22 @@ bool PerformFlowAlignment(
     std::vector<char>&             aln,
     bool                           debug_output=false);
 
+// same function signature, with caller provided scratch memory
+bool PerformFlowAlignment(
+    // Inputs:
+    const std::string&             tseq_bases,
+    const std::string&             qseq_bases,
+    const std::string&             main_flow_order,
+    int                       first_useful_flow,
+    // Outputs:
+    std::vector<char>&             flowOrder,
+    std::vector<int>&              qseq,
+    std::vector<int>&              tseq,
+    std::vector<int>&              aln_flow_index,
+    std::vector<char>&             aln,
+    FlowAlignmentWorkspace&        workspace,
+    bool                           debug_output=false);
+
 // same function signature
 bool NullFlowAlignment(
     // Inputs:
@@ -0,0 +1,549 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     FlowAlignmentSpeed.cpp
+//! @ingroup  Calibration
+//! @brief    FlowAlignmentSpeed. Throughput of PerformFlowAlignment against the previous implementation
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "FlowAlignment.h"
+#include "Utils.h"
+
+using namespace std;
+
+struct AlignmentPair {
+  string target_bases;
+  string query_bases;
+};
+
+struct FlowAlignmentResult {
+  bool          success;
+  vector<char>  flow_order;
+  vector<int>   qseq;
+  vector<int>   tseq;
+  vector<int>   flow_index;
+  vector<char>  aln;
+
+  bool operator==(const FlowAlignmentResult& other) const {
+    return success == other.success and flow_order == other.flow_order and qseq == other.qseq
+        and tseq == other.tseq and flow_index == other.flow_index and aln == other.aln;
+  }
+};
+
+void PrintUsage()
+{
+  printf ("Usage: FlowAlignmentSpeed [num_reads=5000] [pairs.txt]\n");
+  printf ("  Runs the previous PerformFlowAlignment, and the current one with a new workspace for every\n");
+  printf ("  read and with one workspace reused for all reads, and reports aligned reads/sec for each.\n");
+  printf ("  All three must give identical alignments, and every successful alignment must spell out\n");
+  printf ("  the query bases and the target bases from its start onwards.\n");
+  printf ("  pairs.txt holds one target and query base sequence per line, separated by white space.\n");
+  printf ("  Without it, reads with substitutions and homopolymer errors are simulated with a fixed seed.\n");
+}
+
+// ----------------------------------------------------------------------------
+
+void SimulatePairs(int num_reads, vector<AlignmentPair>& pairs)
+{
+  srand48(1);
+  pairs.resize(num_reads);
+  for (int r = 0; r < num_reads; ++r) {
+    int length = 50 + lrand48() % 250;
+    string& target = pairs[r].target_bases;
+    string& query  = pairs[r].query_bases;
+    for (int base = 0; base < length; ++base)
+      target.push_back("ACGT"[lrand48() % 4]);
+    for (int base = 0; base < length; ++base) {
+      double error = drand48();
+      if (error < 0.01)
+        continue;                                   // deletion
+      if (error < 0.02)
+        query.push_back(target[base]);              // homopolymer over-call
+      if (error < 0.025)
+        query.push_back("ACGT"[lrand48() % 4]);     // insertion
+      query.push_back(target[base]);
+    }
+  }
+}
+
+bool LoadPairs(const string& filename, int max_reads, vector<AlignmentPair>& pairs)
+{
+  ifstream in(filename.c_str());
+  if (not in.good())
+    return false;
+  string line;
+  while (getline(in, line) and (int)pairs.size() < max_reads) {
+    istringstream fields(line);
+    AlignmentPair pair;
+    if (fields >> pair.target_bases >> pair.query_bases)
+      pairs.push_back(pair);
+  }
+  return not pairs.empty();
+}
+
+// An alignment has to account for all query bases that fit the flow order, and for the target bases
+// from where the alignment starts to the end of the target
+static bool SpellsOutInput(const AlignmentPair& pair, const FlowAlignmentResult& result)
+{
+  string query, target, expected_target;
+  for (unsigned int idx = 0; idx < result.aln.size(); ++idx) {
+    char nuc = toupper(result.flow_order[idx]);
+    query.append(result.qseq[idx], nuc);
+    target.append(result.tseq[idx], nuc);
+  }
+  for (unsigned int base = 0; base < pair.target_bases.size(); ++base)
+    expected_target.push_back(pair.target_bases[base] == 'N' ? 'A' : pair.target_bases[base]);
+  return target.size() <= expected_target.size()
+      and expected_target.compare(expected_target.size() - target.size(), target.size(), target) == 0
+      and pair.query_bases.compare(0, query.size(), query) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// PerformFlowAlignment as it was before the rolling-row rewrite, kept as the reference for
+// throughput and results. Full score and traceback matrices as vectors of vectors.
+
+static bool PreviousFlowAlignment(
+    // Inputs:
+    const string&             tseq_bases,
+    const string&             qseq_bases,
+    const string&             main_flow_order,
+    int                       first_useful_flow,
+    //const vector<uint16_t>&   fz_tag,
+    // Outputs:
+    vector<char>&             flowOrder,
+    vector<int>&              qseq,
+    vector<int>&              tseq,
+    vector<int>&              aln_flow_index,
+    vector<char>&             aln)
+{
+
+  bool startLocal = false; // CK: I not sure these options work correctly
+  bool endLocal = false;
+  int phasePenalty = PHASE_PENALTY;
+
+
+  // **** Generate homopolymer representation for the qseq_bases.
+
+
+  vector<char>  qseq_hp_nuc;
+  vector<int>   qseq_hp;
+  vector<int>   qseq_flow_idx;
+
+  qseq_hp_nuc.reserve(main_flow_order.size());
+  qseq_hp.reserve(main_flow_order.size());
+  qseq_flow_idx.reserve(main_flow_order.size());
+
+  const char *base_ptr = qseq_bases.c_str();
+  for (int flow = first_useful_flow; flow < (int)main_flow_order.size() and *base_ptr; ++flow) {
+    qseq_hp_nuc.push_back(main_flow_order[flow]);
+    //qseq_hp_perturbation.push_back(fz_tag.at(flow));
+    qseq_flow_idx.push_back(flow);
+    qseq_hp.push_back(0);
+    while (*base_ptr!='\0' and *base_ptr == main_flow_order[flow]) {
+      base_ptr++;
+      qseq_hp.back()++;
+    }
+  }
+
+  vector<int>   qseq_hp_previous_nuc(qseq_hp.size(),0);
+
+  int last_nuc_pos[8] = {-100,-100,-100,-100,-100,-100,-100,-100};
+  for (int q_idx = 0; q_idx < (int)qseq_hp.size(); ++q_idx) {
+    if (last_nuc_pos[qseq_hp_nuc[q_idx]&7] >= 0)
+      qseq_hp_previous_nuc[q_idx] = last_nuc_pos[qseq_hp_nuc[q_idx]&7] + 1;
+    last_nuc_pos[qseq_hp_nuc[q_idx]&7] = q_idx;
+  }
+
+  // **** Generate homopolymer representation of tseq_bases.
+
+  vector<char>  tseq_hp_nuc;
+  vector<int>   tseq_hp;
+
+  tseq_hp_nuc.reserve(tseq_bases.size());
+  tseq_hp.reserve(tseq_bases.size());
+  char prev_base = 0;
+
+  // TODO: Better handling of 'N's
+  for (unsigned int tseq_bases_idx = 0; tseq_bases_idx < tseq_bases.size(); ++tseq_bases_idx) {
+    char current_base = tseq_bases[tseq_bases_idx];
+    switch (current_base) {
+      case 'N':   current_base = 'A';   // weird rule from FlowSeq
+      case 'A':
+      case 'C':
+      case 'G':
+      case 'T':   break;
+      default:    continue;
+    }
+
+    if (current_base != prev_base) {
+      tseq_hp_nuc.push_back(current_base);
+      tseq_hp.push_back(0);
+      prev_base = current_base;
+    }
+    tseq_hp.back()++;
+  }
+  // **** Done
+
+
+  // Initialize gaps sums
+  vector<int> gapSumsI(qseq_hp.size(), phasePenalty);
+  for(int q_idx = 0; q_idx < (int)qseq_hp.size(); ++q_idx)
+    for(int idx = qseq_hp_previous_nuc[q_idx]; idx <= q_idx; ++idx)
+      gapSumsI[q_idx] += qseq_hp[idx];
+
+
+  // Stores the score for extending with a match.
+  vector<vector<int> > dp_matchScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
+  // Stores the score for extending with a insertion.
+  vector<vector<int> > dp_insScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
+  // Stores the score for extending with a deletion.
+  vector<vector<int> > dp_delScore(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), MINOR_INF));
+
+  // Stores the previous cell in the path to a match.
+  vector<vector<int> > dp_matchFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
+  // Stores the previous cell in the path to a insertion.
+  vector<vector<int> > dp_insFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
+  // Stores the previous cell in the path to a deletion.
+  vector<vector<int> > dp_delFrom(1+qseq_hp.size(), vector<int>(1+tseq_hp.size(), FROM_S));
+
+  // Vertical: Insertion score for first column of dp matrix
+  // only allow phasing from an insertion
+  for(int q_idx = 1; q_idx <= (int)qseq_hp.size(); ++q_idx) {
+    int q_jump_idx = qseq_hp_previous_nuc[q_idx-1];
+    if(0 == q_jump_idx) {
+      dp_insScore[q_idx][0] = 0 - gapSumsI[q_idx-1];
+      dp_insFrom[q_idx][0] = FROM_IP;
+    } else {
+      dp_insScore[q_idx][0] = dp_insScore[q_jump_idx][0] - gapSumsI[q_idx-1];
+      dp_insFrom[q_idx][0] = FROM_IP;
+    }
+  }
+
+  // Horizontal: Deletion score for first row of dp matrix
+  for (unsigned int t_idx = 1; t_idx <= tseq_hp.size(); ++t_idx) {
+    int previous = 0;
+    if (t_idx > 1)
+      previous = dp_delScore[0][t_idx-1];
+    dp_delScore[0][t_idx] = previous - 2*tseq_hp[t_idx-1];
+    dp_delFrom[0][t_idx]  = FROM_D;
+  }
+
+  // init start cells
+  dp_matchScore[0][0] = 0;
+
+  // align
+
+  for(int q_idx = 1; q_idx <= (int)qseq_hp.size(); ++q_idx) { // query
+    int q_jump_idx = qseq_hp_previous_nuc[q_idx-1];
+
+    for(unsigned int t_idx = 1; t_idx <= tseq_hp.size(); ++t_idx) { // target
+
+      // horizontal. Preference: D, M, I
+
+      dp_delScore[q_idx][t_idx]     = dp_delScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
+      dp_delFrom[q_idx][t_idx]      = FROM_D;
+
+      if (dp_delScore[q_idx][t_idx] < dp_matchScore[q_idx][t_idx-1] - tseq_hp[t_idx-1]) {
+        dp_delScore[q_idx][t_idx]   = dp_matchScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
+        dp_delFrom[q_idx][t_idx]    = FROM_M;
+      }
+      if (dp_delScore[q_idx][t_idx] < dp_insScore[q_idx][t_idx-1] - tseq_hp[t_idx-1]) {
+        dp_delScore[q_idx][t_idx]   = dp_insScore[q_idx][t_idx-1] - tseq_hp[t_idx-1];
+        dp_delFrom[q_idx][t_idx]    = FROM_I;
+      }
+
+      // vertical
+      // four moves:
+      // 1. phased from match
+      // 2. phased from ins
+      // 3. empty from match
+      // 4. empty from ins
+      // Note: use the NEXT reference base for flow order matching
+
+      dp_insScore[q_idx][t_idx]       = MINOR_INF;
+      dp_insFrom[q_idx][t_idx]        = FROM_ME;
+
+      if(t_idx < tseq_hp.size() and q_idx >= 1 and qseq_hp_nuc[q_idx-1] != tseq_hp_nuc[t_idx]) {
+        if (dp_insScore[q_idx][t_idx] < dp_delScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
+          dp_insScore[q_idx][t_idx]   = dp_delScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
+          dp_insFrom[q_idx][t_idx]    = FROM_ME;
+        }
+        if (dp_insScore[q_idx][t_idx] < dp_matchScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
+          dp_insScore[q_idx][t_idx]   = dp_matchScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
+          dp_insFrom[q_idx][t_idx]    = FROM_ME;
+        }
+        if (dp_insScore[q_idx][t_idx] < dp_insScore[q_idx-1][t_idx] - qseq_hp[q_idx-1]) {
+          dp_insScore[q_idx][t_idx]   = dp_insScore[q_idx-1][t_idx] - qseq_hp[q_idx-1];
+          dp_insFrom[q_idx][t_idx]    = FROM_IE;
+        }
+      }
+
+      if (dp_insScore[q_idx][t_idx]   < dp_matchScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1]) {
+        dp_insScore[q_idx][t_idx]     = dp_matchScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1];
+        dp_insFrom[q_idx][t_idx]      = FROM_MP;
+      }
+
+      if (dp_insScore[q_idx][t_idx]   < dp_insScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1]) {
+        dp_insScore[q_idx][t_idx]     = dp_insScore[q_jump_idx][t_idx] - gapSumsI[q_idx-1];
+        dp_insFrom[q_idx][t_idx]      = FROM_IP;
+      }
+
+
+      // diagonal
+
+      dp_matchScore[q_idx][t_idx]       = MINOR_INF;
+      dp_matchFrom[q_idx][t_idx]        = FROM_S;
+
+      if(qseq_hp_nuc[q_idx-1] == tseq_hp_nuc[t_idx-1]) {
+        int delta_hp = (q_idx == 1 or q_idx == (int)qseq_hp.size()) ? 0 : abs(tseq_hp[t_idx-1] - qseq_hp[q_idx-1]);
+
+        // Preference: D, M, I
+        dp_matchScore[q_idx][t_idx]     = dp_delScore[q_idx-1][t_idx-1] - delta_hp;
+        dp_matchFrom[q_idx][t_idx]      = FROM_D;
+
+        if (dp_matchScore[q_idx][t_idx] < dp_matchScore[q_idx-1][t_idx-1] - delta_hp) {
+          dp_matchScore[q_idx][t_idx]   = dp_matchScore[q_idx-1][t_idx-1] - delta_hp;
+          dp_matchFrom[q_idx][t_idx]    = FROM_M;
+        }
+
+        if (dp_matchScore[q_idx][t_idx] < dp_insScore[q_idx-1][t_idx-1] - delta_hp) {
+          dp_matchScore[q_idx][t_idx]   = dp_insScore[q_idx-1][t_idx-1] - delta_hp;
+          dp_matchFrom[q_idx][t_idx]    = FROM_I;
+        }
+        // Start anywhere in tseq
+        if(dp_matchScore[q_idx][t_idx]  < -delta_hp and startLocal and q_idx == 1) {
+          dp_matchScore[q_idx][t_idx]   = -delta_hp;
+          dp_matchFrom[q_idx][t_idx]    = FROM_S;  // From arbitrarily located start point
+        }
+      }
+    }
+  }
+
+  // Get best scoring cell
+  int best_score = MINOR_INF-1;    // The best alignment score found so far.
+  int from_traceback = FROM_S;
+  int q_traceback = -1;
+  int t_traceback = -1;
+
+  // TODO: want to map the query into a sub-sequence of the target
+  // We can end anywhere in the target, but we haven't done the beginning.
+  // We also need to return where the start end in the target to update start/end position(s).
+  for(unsigned int t_idx = endLocal ? 1 : tseq_hp.size(); t_idx <= tseq_hp.size(); ++t_idx) { // target
+    if(best_score <= dp_delScore[qseq_hp.size()][t_idx]) {
+      q_traceback = qseq_hp.size();
+      t_traceback = t_idx;
+      best_score = dp_delScore[qseq_hp.size()][t_idx];
+      from_traceback = FROM_D;
+    }
+    if(best_score <= dp_insScore[qseq_hp.size()][t_idx]) {
+      q_traceback = qseq_hp.size();
+      t_traceback = t_idx;
+      best_score = dp_insScore[qseq_hp.size()][t_idx];
+      from_traceback = FROM_I;
+    }
+    if(best_score <= dp_matchScore[qseq_hp.size()][t_idx]) {
+      q_traceback = qseq_hp.size();
+      t_traceback = t_idx;
+      best_score = dp_matchScore[qseq_hp.size()][t_idx];
+      from_traceback = FROM_M;
+    }
+  }
+
+  // ***** Back tracking
+
+  flowOrder.clear();
+  qseq.clear();
+  tseq.clear();
+  aln_flow_index.clear();
+  aln.clear();
+
+  flowOrder.reserve(qseq_hp.size() + tseq_hp.size());
+  qseq.reserve(qseq_hp.size() + tseq_hp.size());
+  tseq.reserve(qseq_hp.size() + tseq_hp.size());
+  aln_flow_index.reserve(qseq_hp.size() + tseq_hp.size());
+  aln.reserve(qseq_hp.size() + tseq_hp.size());
+
+  // trace path back
+  while(q_traceback > 0) { // qseq flows left
+
+    switch(from_traceback) {
+      case FROM_M:
+      case FROM_ME:
+      case FROM_MP:
+        from_traceback = dp_matchFrom.at(q_traceback).at(t_traceback);
+        q_traceback--;
+        t_traceback--;
+
+        flowOrder.push_back(qseq_hp_nuc.at(q_traceback));
+        qseq.push_back(qseq_hp.at(q_traceback));
+        tseq.push_back(tseq_hp.at(t_traceback));
+        aln_flow_index.push_back(qseq_flow_idx.at(q_traceback));
+        aln.push_back((qseq_hp.at(q_traceback) == tseq_hp.at(t_traceback)) ? ALN_MATCH : ALN_MISMATCH);
+        break;
+
+      case FROM_I:
+      case FROM_IE:
+      case FROM_IP:
+        from_traceback = dp_insFrom.at(q_traceback).at(t_traceback);
+
+        if(from_traceback == FROM_ME or from_traceback == FROM_IE) {
+          q_traceback--;
+
+          flowOrder.push_back(qseq_hp_nuc.at(q_traceback));
+          qseq.push_back(qseq_hp.at(q_traceback));
+          tseq.push_back(0);
+          aln_flow_index.push_back(qseq_flow_idx.at(q_traceback));
+          aln.push_back((qseq_hp.at(q_traceback) == 0) ? ALN_MATCH : ALN_MISMATCH);
+
+        } else if(from_traceback == FROM_MP or from_traceback == FROM_IP or from_traceback == FROM_S) {
+          int q_jump_idx = qseq_hp_previous_nuc.at(q_traceback-1);
+          if(from_traceback == FROM_S)
+            q_jump_idx = 0;
+          while(q_traceback > q_jump_idx) {
+            q_traceback--;
+
+            flowOrder.push_back(qseq_hp_nuc.at(q_traceback));
+            qseq.push_back(qseq_hp.at(q_traceback));
+            tseq.push_back(0);
+            aln_flow_index.push_back(qseq_flow_idx.at(q_traceback));
+            aln.push_back(ALN_INS);
+          }
+
+        } else {
+          //printf("ERROR: Failed check A; from_traceback=%d, q_traceback=%d, t_traceback=%d\n", from_traceback, q_traceback, t_traceback);
+          return false;
+        }
+        break;
+
+      case FROM_D:
+        from_traceback = dp_delFrom.at(q_traceback).at(t_traceback);
+        t_traceback--;
+
+        flowOrder.push_back(tseq_hp_nuc.at(t_traceback) - 'A' + 'a');
+        qseq.push_back(0);
+        tseq.push_back(tseq_hp.at(t_traceback));
+        aln_flow_index.push_back(-1);
+        aln.push_back(ALN_DEL);
+        break;
+
+      case FROM_S:
+      default:
+        //printf("ERROR: Failed check B; from_traceback=%d, q_traceback=%d, t_traceback=%d\n", from_traceback, q_traceback, t_traceback);
+        return false;
+    }
+  }
+
+  int tseqStart = 0;   // The zero-based index in the input tseq where the alignment starts.
+  for(int t_idx = 0; t_idx < t_traceback; ++t_idx)
+    tseqStart += tseq_hp[t_idx];
+
+  // reverse the arrays tseq, qseq, aln, flowOrder <- because backtracking filled it in reverse!
+  for(int q_idx = 0; q_idx < (int)qseq.size()/2;q_idx++) {
+    int p = aln_flow_index[q_idx];
+    aln_flow_index[q_idx] = aln_flow_index[qseq.size()-q_idx-1];
+    aln_flow_index[qseq.size()-q_idx-1] = p;
+
+    int b = qseq[q_idx];
+    qseq[q_idx] = qseq[qseq.size()-q_idx-1];
+    qseq[qseq.size()-q_idx-1] = b;
+
+    char c = aln[q_idx];
+    aln[q_idx] = aln[qseq.size()-q_idx-1];
+    aln[qseq.size()-q_idx-1] = c;
+
+    b = tseq[q_idx];
+    tseq[q_idx] = tseq[qseq.size()-q_idx-1];
+    tseq[qseq.size()-q_idx-1] = b;
+
+    c = flowOrder[q_idx];
+    flowOrder[q_idx] = flowOrder[qseq.size()-q_idx-1];
+    flowOrder[qseq.size()-q_idx-1] = c;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  int num_reads = argc > 1 ? atoi(argv[1]) : 5000;
+  if (num_reads <= 0 or argc > 3) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  vector<AlignmentPair> pairs;
+  if (argc > 2) {
+    if (not LoadPairs(argv[2], num_reads, pairs)) {
+      fprintf (stderr, "FlowAlignmentSpeed: could not read any sequence pairs from %s\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+    SimulatePairs(num_reads, pairs);
+  num_reads = pairs.size();
+
+  string flow_order;
+  while (flow_order.size() < 1200)
+    flow_order += "TACGTACGTCTGAGCATCGATCGATGTACAGC";
+
+  // The previous implementation
+  vector<FlowAlignmentResult> previous_results(num_reads);
+  Timer timer;
+  for (int r = 0; r < num_reads; ++r) {
+    FlowAlignmentResult& res = previous_results[r];
+    res.success = PreviousFlowAlignment(pairs[r].target_bases, pairs[r].query_bases, flow_order, 0,
+        res.flow_order, res.qseq, res.tseq, res.flow_index, res.aln);
+  }
+  double previous_time = timer.elapsed();
+
+  // A new workspace for every read, as allocated by the original entry point
+  vector<FlowAlignmentResult> fresh_results(num_reads);
+  timer.restart();
+  for (int r = 0; r < num_reads; ++r) {
+    FlowAlignmentResult& res = fresh_results[r];
+    res.success = PerformFlowAlignment(pairs[r].target_bases, pairs[r].query_bases, flow_order, 0,
+        res.flow_order, res.qseq, res.tseq, res.flow_index, res.aln);
+  }
+  double fresh_time = timer.elapsed();
+
+  // One workspace reused for all reads, as kept by a calibration thread
+  FlowAlignmentWorkspace workspace;
+  vector<FlowAlignmentResult> reused_results(num_reads);
+  timer.restart();
+  for (int r = 0; r < num_reads; ++r) {
+    FlowAlignmentResult& res = reused_results[r];
+    res.success = PerformFlowAlignment(pairs[r].target_bases, pairs[r].query_bases, flow_order, 0,
+        res.flow_order, res.qseq, res.tseq, res.flow_index, res.aln, workspace);
+  }
+  double reused_time = timer.elapsed();
+
+  int num_aligned = 0, num_mismatches = 0, num_inconsistent = 0;
+  for (int r = 0; r < num_reads; ++r) {
+    if (not (previous_results[r] == fresh_results[r]) or not (previous_results[r] == reused_results[r]))
+      num_mismatches++;
+    if (not previous_results[r].success)
+      continue;
+    num_aligned++;
+    if (not SpellsOutInput(pairs[r], previous_results[r]))
+      num_inconsistent++;
+  }
+
+  printf ("FlowAlignmentSpeed: %d reads, %d aligned\n", num_reads, num_aligned);
+  printf ("  %-20s %14s %10s\n", "implementation", "reads/sec", "speedup");
+  printf ("  %-20s %14.1f %10.2f\n", "previous", num_reads / max(previous_time, 1e-9), 1.0);
+  printf ("  %-20s %14.1f %10.2f\n", "workspace per read", num_reads / max(fresh_time, 1e-9),
+          previous_time / max(fresh_time, 1e-9));
+  printf ("  %-20s %14.1f %10.2f\n", "workspace reused", num_reads / max(reused_time, 1e-9),
+          previous_time / max(reused_time, 1e-9));
+  printf ("  mismatches against previous %d, inconsistent alignments %d\n", num_mismatches, num_inconsistent);
+
+  return (num_mismatches == 0 and num_inconsistent == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2146,6 +2146,15 @@ int AdvCompr::UnCompress(int _threadNum)
 	Read(fd, &timestamps_uncompr[0],
 			sizeof(timestamps_uncompr[0]) * FileHdrV4.frames_in_file);
 
+#ifndef WIN32
+	if (unCompressThreads > 1 && rblocks > 1 && UnCompressThreaded(fd) == 0)
+	{
+		close(fd);
+		timing.overall = AdvCTimer() - start;
+		return 0;
+	}
+#endif
+
 	for (int rblk = 0; rblk < rblocks; rblk++)
 	{
 
@@ -2153,80 +2162,196 @@ int AdvCompr::UnCompress(int _threadNum)
 		fflush(stdout);
 
 		for (int cblk = 0; cblk < cblocks; cblk++)
-		{
-			Read(fd, &hdr, sizeof(hdr));
-			// make sure hdr contains what we expect
+			UnCompressBlock(fd, fb, fbLen);
+	}
 
-			if ((hdr.key != ADVCOMPR_KEY) || (hdr.rend > h) || (hdr.cend > w)
-					|| (hdr.npts != npts) || (hdr.ver != 0))
-			{
-				AdvComprPrintf(
-						"hdr doesn't look correct %x rend(%d) cend(%d) npts (%d != %d) ver(%d)\n",
-						hdr.key, hdr.rend, hdr.cend, hdr.npts, npts, hdr.ver);
-			}
-			else
-			{
-				ntrcs = (hdr.cend - hdr.cstart) * (hdr.rend - hdr.rstart);
+	if(fb)
+		free(fb);
 
+	FREE_STRUCTURES(1);
 
-				if(fb == NULL || fbLen < sizeof(uint64_t) * hdr.datalength)
-				{
-					if(fb )
-						free(fb );
+#ifdef WIN32
+	CloseHandle(fd);
+#else
+	close(fd);
+#endif
+	timing.overall = AdvCTimer() - start;
+	return 0;
+}
 
-					fbLen=sizeof(uint64_t) * hdr.datalength;
-					fb = (uint64_t *) malloc(fbLen);
-				}
+// read the next region block from fd and decode it into raw
+void AdvCompr::UnCompressBlock(FILE_HANDLE fd, uint64_t *&fb, uint32_t &fbLen)
+{
+	Read(fd, &hdr, sizeof(hdr));
+	// make sure hdr contains what we expect
 
-				ALLOC_STRUCTURES(hdr.nBasisVec);
+	if ((hdr.key != ADVCOMPR_KEY) || (hdr.rend > h) || (hdr.cend > w)
+			|| (hdr.npts != npts) || (hdr.ver != 0))
+	{
+		AdvComprPrintf(
+				"hdr doesn't look correct %x rend(%d) cend(%d) npts (%d != %d) ver(%d)\n",
+				hdr.key, hdr.rend, hdr.cend, hdr.npts, npts, hdr.ver);
+	}
+	else
+	{
+		ntrcs = (hdr.cend - hdr.cstart) * (hdr.rend - hdr.rstart);
+
+
+		if(fb == NULL || fbLen < sizeof(uint64_t) * hdr.datalength)
+		{
+			if(fb )
+				free(fb );
+
+			fbLen=sizeof(uint64_t) * hdr.datalength;
+			fb = (uint64_t *) malloc(fbLen);
+		}
+
+		ALLOC_STRUCTURES(hdr.nBasisVec);
 
 //				CLEAR_STRUCTURES();
 
-				// read in the bits needed per vec
-				Read(fd, bitsNeeded, sizeof(int) * (hdr.nBasisVec));
+		// read in the bits needed per vec
+		Read(fd, bitsNeeded, sizeof(int) * (hdr.nBasisVec));
 
-				// read in mean_trc
-				Read(fd, &mean_trc[0], sizeof(float) * hdr.npts);
+		// read in mean_trc
+		Read(fd, &mean_trc[0], sizeof(float) * hdr.npts);
 
-				// read in basis_vectors
-				Read(fd, &basis_vectors[0],
-						sizeof(float) * hdr.npts * (hdr.nBasisVec));
+		// read in basis_vectors
+		Read(fd, &basis_vectors[0],
+				sizeof(float) * hdr.npts * (hdr.nBasisVec));
 
-				// read in the min vectors
-				Read(fd, &minVals[0],
-						sizeof(float) * (hdr.nBasisVec));
+		// read in the min vectors
+		Read(fd, &minVals[0],
+				sizeof(float) * (hdr.nBasisVec));
 
-				// read in the max vectors
-				Read(fd, &maxVals[0],
-						sizeof(float) * (hdr.nBasisVec));
+		// read in the max vectors
+		Read(fd, &maxVals[0],
+				sizeof(float) * (hdr.nBasisVec));
 
-				// read in trcs_coeffs
-				Read(fd, &fb[0],
-						hdr.datalength * sizeof(uint64_t));
+		// read in trcs_coeffs
+		Read(fd, &fb[0],
+				hdr.datalength * sizeof(uint64_t));
 
-				UnPackBits(fb,
-						&fb[hdr.datalength]);
+		UnPackBits(fb,
+				&fb[hdr.datalength]);
 
-				ExtractTraceBlock();
+		ExtractTraceBlock();
 
 
-			}
-		}
 	}
+}
 
-	if(fb)
-		free(fb);
+#ifndef WIN32
+int AdvCompr::unCompressThreads = 1;
 
-	FREE_STRUCTURES(1);
+void AdvCompr::SetUnCompressThreads(int numThreads)
+{
+	unCompressThreads = (numThreads > 1) ? numThreads : 1;
+}
 
-#ifdef WIN32
-	CloseHandle(fd);
-#else
+typedef struct {
+	AdvCompr *advc;     // private copy of the decoder state
+	int numBlocks;
+	off_t offset;       // file offset of the first block
+	bool started;
+} AdvComprBlocksJob;
+
+void *AdvCompr::UnCompressBlocksThread(void *arg)
+{
+	AdvComprBlocksJob *job = (AdvComprBlocksJob *) arg;
+	AdvCompr *advc = job->advc;
+	uint64_t *fb = NULL;
+	uint32_t fbLen = 0;
+
+	int fd = open(advc->fname, O_RDONLY);
+	if (fd < 0)
+	{
+		AdvComprPrintf("failed to open file %s\n", advc->fname);
+		exit(-1);
+	}
+	lseek(fd, job->offset, SEEK_SET);
+	for (int blk = 0; blk < job->numBlocks; blk++)
+		advc->UnCompressBlock(fd, fb, fbLen);
 	close(fd);
-#endif
-	timing.overall = AdvCTimer() - start;
+
+	if (fb)
+		free(fb);
+	advc->FREE_STRUCTURES(1);
+	return NULL;
+}
+
+// Decode the rows of region blocks on unCompressThreads threads.  The block
+// headers are walked first to find where each row of blocks starts, then every
+// thread reads its rows through its own file descriptor into its own scratch
+// memory.  Blocks write disjoint parts of raw, so the image is the same as the
+// serial decode.  Returns -1 for anything unusual, leaving fd where it was, so
+// the serial decoder handles and reports it.
+int AdvCompr::UnCompressThreaded(FILE_HANDLE fd)
+{
+	struct stat statbuf;
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	if (offset < 0 || fstat(fd, &statbuf) != 0)
+		return -1;
+
+	off_t *rowOffsets = (off_t *) malloc(sizeof(off_t) * (rblocks + 1));
+	for (int blk = 0; blk < rblocks * cblocks; blk++)
+	{
+		AdvComprHeader_t bhdr;
+		if (blk % cblocks == 0)
+			rowOffsets[blk / cblocks] = offset;
+		// the 8 wide stores of ExtractTraceBlock() must stay inside the block
+		if (pread(fd, &bhdr, sizeof(bhdr), offset) != sizeof(bhdr)
+				|| (bhdr.key != ADVCOMPR_KEY) || (bhdr.rend > h) || (bhdr.cend > w)
+				|| (bhdr.npts != npts) || (bhdr.ver != 0)
+				|| (bhdr.rstart >= bhdr.rend) || (bhdr.cstart >= bhdr.cend)
+				|| ((bhdr.cend - bhdr.cstart) % VEC8_SIZE) != 0)
+		{
+			free(rowOffsets);
+			return -1;
+		}
+		offset += sizeof(bhdr) + sizeof(int) * bhdr.nBasisVec
+				+ sizeof(float) * (bhdr.npts + bhdr.npts * bhdr.nBasisVec + 2 * bhdr.nBasisVec)
+				+ sizeof(uint64_t) * (off_t) bhdr.datalength;
+		if (offset > statbuf.st_size)
+		{
+			free(rowOffsets);
+			return -1;
+		}
+	}
+	rowOffsets[rblocks] = offset;
+
+	int numThreads = (unCompressThreads < rblocks) ? unCompressThreads : rblocks;
+	AdvComprBlocksJob *jobs = (AdvComprBlocksJob *) malloc(sizeof(AdvComprBlocksJob) * numThreads);
+	pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * numThreads);
+	for (int t = 0; t < numThreads; t++)
+	{
+		int rblkStart = (rblocks * t) / numThreads;
+		int rblkEnd = (rblocks * (t + 1)) / numThreads;
+		jobs[t].advc = new AdvCompr(*this);
+		jobs[t].advc->ThreadNum = -1; // don't share the static per thread memory
+		jobs[t].advc->GblMemPtr = NULL;
+		jobs[t].advc->GblMemLen = 0;
+		jobs[t].numBlocks = (rblkEnd - rblkStart) * cblocks;
+		jobs[t].offset = rowOffsets[rblkStart];
+		jobs[t].started = (pthread_create(&threads[t], NULL, UnCompressBlocksThread, &jobs[t]) == 0);
+		if (!jobs[t].started)
+			UnCompressBlocksThread(&jobs[t]);
+	}
+	for (int t = 0; t < numThreads; t++)
+	{
+		if (jobs[t].started)
+			pthread_join(threads[t], NULL);
+		timing.UnPackBits += jobs[t].advc->timing.UnPackBits;
+		timing.Extract += jobs[t].advc->timing.Extract;
+		delete jobs[t].advc;
+	}
+	lseek(fd, rowOffsets[rblocks], SEEK_SET);
+	free(threads);
+	free(jobs);
+	free(rowOffsets);
 	return 0;
 }
+#endif
 
 double AdvCompr::AdvCTimer()
 {
@@ -109,6 +109,10 @@ public:
     static void WriteGain(int region, int w, int h, char *destPath);
     static float *ReSetGain(int region, int w, int h, float *gainPtr);
     static void xtalkCorrect_raw(float xtalk_fraction, int w, int h, int npts, short int *raw);
+#ifndef WIN32
+    /* threads UnCompress() decodes the rows of region blocks on, 1 decodes on the calling thread */
+    static void SetUnCompressThreads(int numThreads);
+#endif
 
 private:
         AdvCompr() {} // no default constructor
@@ -120,6 +124,11 @@ private:
 	void Write(FILE_HANDLE fd, void *buf, int len);
 	int  Read(FILE_HANDLE fd, void *buf, int len);
 	void UnPackBits(uint64_t *trcs_coeffs_buffer, uint64_t *bufferEnd);
+	void UnCompressBlock(FILE_HANDLE fd, uint64_t *&fb, uint32_t &fbLen);
+#ifndef WIN32
+	int  UnCompressThreaded(FILE_HANDLE fd);
+	static void *UnCompressBlocksThread(void *arg);
+#endif
 	float findt0(int *idx);
 	int   PopulateTraceBlock_ComputeMean();
 	void  ComputeMeanTrace();
@@ -394,6 +403,9 @@ private:
 	static uint32_t gainCorrectionSize[ADVC_MAX_REGIONS];
 	static char *threadMem[ADVC_MAX_REGIONS];
 	static uint32_t threadMemLen[ADVC_MAX_REGIONS];
+#ifndef WIN32
+	static int unCompressThreads;
+#endif
 };
 
 #ifndef WIN32
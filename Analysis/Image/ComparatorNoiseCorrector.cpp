@@ -12,6 +12,7 @@
 
 #include "Utils.h"
 #include "ComparatorNoiseCorrector.h"
+#include "NoiseCorrectorThreads.h"
 #include "deInterlace.h"
 #include "Vecs.h"
 #ifdef __AVX__
@@ -33,8 +34,8 @@
 #define mAvg_num_ACC(x,comparator)  (mAvg_num[(x)+((comparator)*cols)])
 #define SIGS_ACC(x,comparator,frame) (mComparator_sigs[((comparator)*cols*frames) + ((frame) *cols) + (x)])
 
-char *ComparatorNoiseCorrector::mAllocMem[MAX_CNC_THREADS] = {NULL};
-int ComparatorNoiseCorrector::mAllocMemLen[MAX_CNC_THREADS] = {0};
+static AlignedScratchPool cncScratch(VEC8F_SIZE_B);
+static int cncThreads = 1;
 
 
 double CNCTimer()
@@ -57,6 +58,371 @@ double CNCTimer()
 #endif
 }
 
+void ComparatorNoiseCorrector::SetThreads(int numThreads)
+{
+	cncThreads = (numThreads > 1) ? numThreads : 1;
+}
+
+int ComparatorNoiseCorrector::GetThreads()
+{
+	return cncThreads;
+}
+
+// The stages below work on bands of columns, rows or comparators on their own
+// threads.  Every output value is still added up in the same order as with a
+// single thread, so the correction doesn't depend on the number of threads.
+
+struct SumColumnsJob {
+	short int *image;
+	float *mask;
+	float *sigs;
+	float *avg_num;
+	int rows;
+	int cols;
+	int frames;
+	int row_start;
+	int row_end;
+};
+
+static void AddRowToColumns(const short int * __restrict src, float * __restrict dst, int n)
+{
+	for (int x = 0; x < n; x++)
+		dst[x] += (float)src[x];
+}
+
+static void AddRowToColumnsMasked(const short int * __restrict src, float * __restrict dst,
+		float * __restrict sum, const float * __restrict msk, int n)
+{
+	for (int x = 0; x < n; x++)
+	{
+		dst[x] += (float)src[x];
+		sum[x] += msk[x];
+	}
+}
+
+static void DivideColumns(float * __restrict dst, const float * __restrict sum, int n)
+{
+	for (int x = 0; x < n; x++)
+		dst[x] /= (sum[x] != 0.0f) ? sum[x] : 1.0f;
+}
+
+static void SumColumnsBand(void *arg, int x_start, int x_end)
+{
+	SumColumnsJob *job = (SumColumnsJob *)arg;
+	int cols = job->cols;
+	int frames = job->frames;
+	int frameStride = job->rows*cols;
+	int width = x_end - x_start;
+	int frame, y, comparator;
+
+#ifdef __AVX__
+	if((cols%VEC8_SIZE) == 0)
+	{
+		v8f_u valU;
+
+		valU.V=LD_VEC8F(0);
+		for (frame = 0; frame < frames; frame++)
+		{
+			for (y = job->row_start; y < job->row_end; y++)
+			{
+				comparator = (y - job->row_start) & 0x3;
+				short int *sptr = &job->image[frame * frameStride + y * cols + x_start];
+				v8f *dstPtr = (v8f *) (job->sigs + comparator * cols * frames + frame * cols + x_start);
+				v8f *sumPtr = (v8f *) (job->avg_num + comparator * cols * frames + frame * cols + x_start);
+				v8f *mskPtr = (v8f *) (job->mask + cols*y + x_start);
+
+				for (int x = 0; x < width; x+=VEC8_SIZE,sptr+=VEC8_SIZE,dstPtr++,sumPtr++,mskPtr++)
+				{
+					LD_VEC8S_CVT_VEC8F(sptr,valU);
+
+					*dstPtr += valU.V;
+					*sumPtr += *mskPtr;
+				}
+			}
+		}
+		for (frame = 0; frame < frames; frame++)
+		{
+			for (comparator = 0; comparator < 4; comparator++)
+			{
+				DivideColumns(job->sigs + comparator * cols * frames + frame * cols + x_start,
+						job->avg_num + comparator * cols * frames + frame * cols + x_start, width);
+			}
+		}
+		return;
+	}
+#endif
+	for (frame = 0; frame < frames; frame++)
+	{
+		for (y = job->row_start; y < job->row_end; y++)
+		{
+			comparator = (y - job->row_start) & 0x3;
+			short int *srcPtr = &job->image[frame * frameStride + y * cols + x_start];
+			float *dstPtr = job->sigs + comparator * cols * frames + frame * cols + x_start;
+			if(frame==0)
+				AddRowToColumnsMasked(srcPtr, dstPtr, job->avg_num + comparator * cols + x_start,
+						job->mask + cols*y + x_start, width);
+			else
+				AddRowToColumns(srcPtr, dstPtr, width);
+		}
+	}
+	for (frame = 0; frame < frames; frame++)
+	{
+		for (comparator = 0; comparator < 4; comparator++)
+		{
+			DivideColumns(job->sigs + comparator * cols * frames + frame * cols + x_start,
+					job->avg_num + comparator * cols + x_start, width);
+		}
+	}
+}
+
+struct ApplyCorrectionJob {
+	short int *image;
+	short int *correction;
+	int rows;
+	int cols;
+	int frames;
+	int row_start;
+	int corrComp[4];
+};
+
+static void ApplyCorrectionBand(void *arg, int band_start, int band_end)
+{
+	ApplyCorrectionJob *job = (ApplyCorrectionJob *)arg;
+	int cols = job->cols;
+	int frameStride = job->rows*cols;
+	int lw = cols/VEC8_SIZE;
+
+	for (int frame = 0; frame < job->frames; frame++)
+	{
+		for (int y = job->row_start + band_start; y < job->row_start + band_end; y++)
+		{
+			v8s *srcPtr = (v8s *)(&job->image[frame * frameStride + y * cols]);
+			v8s *corPtr = (v8s *)(job->correction + job->corrComp[(y-job->row_start)&3]*job->frames*cols + frame*cols);
+
+			for (int i = 0;i<lw;i++)
+			{
+				srcPtr[i] -= corPtr[i];
+			}
+		}
+	}
+}
+
+struct NNSubtractJob {
+	float *pnn;
+	float *psigs;
+	int *mask;
+	float *hfnoise;
+	int span;
+	int n_comparators;
+	int nframes;
+	int ncomp;
+	int regionXSize;
+};
+
+static void NNSubtractBand(void *arg, int i_start, int i_end)
+{
+	NNSubtractJob *job = (NNSubtractJob *)arg;
+	float *pnn = job->pnn;
+	float *psigs = job->psigs;
+	int *mask = job->mask;
+	float *hfnoise = job->hfnoise;
+	int span = job->span;
+	int n_comparators = job->n_comparators;
+	int nframes = job->nframes;
+	int ncomp = job->ncomp;
+	int regionXSize = job->regionXSize;
+
+	float nn_avg[nframes];
+	float zero_sig[nframes];
+
+	memset(zero_sig, 0, sizeof(zero_sig));
+
+	for (int i = i_start; i < i_end; i++) {
+		int nn_cnt = 0;
+		float *cptr;
+		float *n_cptr;
+		float *chfptr = NULL;
+		float *n_chfptr = NULL;
+		float *nncptr;
+		int i_c0 = i & ~(ncomp - 1);
+		memset(nn_avg, 0, sizeof(nn_avg));
+
+		// in case we weren't provided with high frequency noise correction for NNs, use all zeros instead
+		chfptr = zero_sig;
+		n_chfptr = zero_sig;
+
+		// rounding down the starting point and adding one to the rhs properly centers
+		// the neighbor average about the central column...except in cases where columns are
+		// masked within the neighborhood.
+
+		//same column but the other comparators
+		for (int comparator = 0; comparator < ncomp; comparator++) {
+			int cndx = i_c0 + comparator;
+
+			if (!mask[cndx] && cndx != i) {
+				// get a pointer to the comparator signal
+				cptr = psigs + cndx * nframes;
+
+				if (hfnoise != NULL) {
+					chfptr = hfnoise + cndx * nframes;
+
+					// add it to the average
+					for (int frame = 0; frame < nframes; frame++)
+						nn_avg[frame] += cptr[frame] - chfptr[frame];
+				} else {
+					// add it to the average
+					for (int frame = 0; frame < nframes; frame++)
+						nn_avg[frame] += cptr[frame];
+				}
+
+				nn_cnt++;
+			}
+		}
+
+		for (int s = 1; s <= span; s++) {
+			//i_c0 is even number
+			for (int comparator = 0; comparator < ncomp; comparator++) {
+				int cndx = i_c0 - ncomp * s + comparator;
+				int n_cndx = i_c0 + ncomp * s + comparator;
+				if (!(cndx < 0 || n_cndx >= n_comparators ||
+						mask[cndx] || mask[n_cndx] ||
+						(regionXSize
+								&& (((cndx / ncomp) / regionXSize) != ((i / ncomp) / regionXSize) ||
+								  ((n_cndx / ncomp) / regionXSize) != ((i / ncomp) / regionXSize))))) {
+					// get a pointer to the comparator signal
+					cptr = psigs + cndx * nframes;
+					n_cptr = psigs + n_cndx * nframes;
+
+					if (hfnoise != NULL) {
+						chfptr = hfnoise + cndx * nframes;
+						n_chfptr = hfnoise + n_cndx * nframes;
+					}
+					// add it to the average
+					for (int frame = 0; frame < nframes; frame++) {
+						nn_avg[frame] += cptr[frame] - chfptr[frame];
+						nn_avg[frame] += n_cptr[frame] - n_chfptr[frame];
+					}
+
+					nn_cnt += 2;
+				}
+			}
+		}
+
+		if ((nn_cnt > 0)) {
+			for (int frame = 0; frame < nframes; frame++)
+				nn_avg[frame] /= nn_cnt;
+
+			// now subtract the neighbor average
+			cptr = psigs + i * nframes;
+			nncptr = pnn + i * nframes;
+			for (int frame = 0; frame < nframes; frame++)
+				nncptr[frame] = cptr[frame] - nn_avg[frame];
+		} else {
+//      fprintf (stdout, "Default noise of 0 is set: %d\n", i);
+			// not a good set of neighbors to use...just blank the correction
+			// signal and do nothing.
+			nncptr = pnn + i * nframes;
+			for (int frame = 0; frame < nframes; frame++)
+				nncptr[frame] = 0.0f;
+		}
+	}
+}
+
+// one power iteration of GetPrincComp() is split in two passes, projecting every
+// comparator signal onto the current estimate, then adding up the signals weighted
+// by their projections a band of frames at a time
+struct PrincCompJob {
+	float *pnn;
+	int *mask;
+	float *ptmp;
+	float *proj;
+	float *ttmp;
+	int n_comparators;
+	int nframes;
+};
+
+static void PrincCompProjectBand(void *arg, int i_start, int i_end)
+{
+	PrincCompJob *job = (PrincCompJob *)arg;
+	int nframes = job->nframes;
+
+	for (int i = i_start; i < i_end; i++)
+	{
+		float sum=0.0f;
+		float *cptr = job->pnn + i*nframes;
+
+		if (job->mask[i] == 0)
+		{
+			for (int j=0;j < nframes;j++)
+				sum += job->ptmp[j]*cptr[j];
+		}
+		job->proj[i] = sum;
+	}
+}
+
+static void AddScaledSignal(float * __restrict dst, const float * __restrict src, float scale, int n)
+{
+	for (int j = 0; j < n; j++)
+		dst[j] += src[j]*scale;
+}
+
+static void PrincCompSumBand(void *arg, int j_start, int j_end)
+{
+	PrincCompJob *job = (PrincCompJob *)arg;
+
+	for (int i=0;i < job->n_comparators;i++)
+	{
+		if (job->mask[i] == 0)
+			AddScaledSignal(job->ttmp + j_start, job->pnn + i*job->nframes + j_start, job->proj[i], j_end - j_start);
+	}
+}
+
+struct GenerateMaskJob {
+	short int *image;
+	float *mask;
+	int frameStride;
+	int frames;
+};
+
+static void MaskPinnedInFrame(const short int * __restrict src, float * __restrict msk, int n)
+{
+	for (int idx = 0; idx < n; idx++)
+	{
+		float val = src[idx];
+		msk[idx] = ((val >= 16380.0f) | (5.0f >= val)) ? 0.0f : msk[idx];
+	}
+}
+
+static void GenerateMaskBand(void *arg, int idx_start, int idx_end)
+{
+	GenerateMaskJob *job = (GenerateMaskJob *)arg;
+	int frameStride = job->frameStride;
+	// only whole vectors of pixels have ever been checked
+	int len = std::min(idx_end, (frameStride/VEC8_SIZE)*VEC8_SIZE) - idx_start;
+	float *mask = job->mask;
+	int idx, frm;
+
+	// initialize the mask to all 1's
+	for(idx=0;idx<len;idx++)
+		mask[idx_start + idx]=1.0f;
+
+	for(frm=0;frm<job->frames;frm++)
+		MaskPinnedInFrame(job->image + frameStride*frm + idx_start, mask + idx_start, len);
+
+	// now, clear all pinned pixels so the column adds will be quick
+	for(idx=idx_start;idx<idx_end;idx++)
+	{
+		if(mask[idx]==0)
+		{
+			// this pixel is pinned..  clear all the frame values
+			for(frm=0;frm<job->frames;frm++)
+			{
+				job->image[frameStride*frm + idx] = 0;
+			}
+		}
+	}
+}
+
 void ComparatorNoiseCorrector::CorrectComparatorNoise(RawImage *raw,Mask *mask, bool verbose,
 		bool aggressive_correction, bool beadfind_image, int threadNum)
 {
@@ -158,9 +524,6 @@ char *ComparatorNoiseCorrector::AllocateStructs(int threadNum, int _rows, int _c
 {
 	int len=0;
 	char *allocBuffer=NULL;
-	char **allocPtr = &allocBuffer;
-	int allocLen=0;
-	int *allocLenPtr = &allocLen;
 	char *aptr;
 
 	rows=_rows;
@@ -182,27 +545,13 @@ char *ComparatorNoiseCorrector::AllocateStructs(int threadNum, int _rows, int _c
     len += mCorrection_len;
     len += mMask_len;
 
-    if(threadNum >= 0 && threadNum < MAX_CNC_THREADS)
-    {
-    	allocPtr = &mAllocMem[threadNum];
-    	allocLenPtr = &mAllocMemLen[threadNum];
-    }
-
-	if(*allocLenPtr < len)
-	{
-		if(*allocPtr)
-		{
-//			printf("Freeing old memory tn=%d\n",threadNum);
-			free(*allocPtr);
-		}
-
-//		printf("allocating new memory tn=%d len=%d\n",threadNum,len);
-		*allocPtr = (char *)memalign(VEC8F_SIZE_B,len);
-		*allocLenPtr = len;
-	}
+	if(threadNum >= 0)
+		allocBuffer = cncScratch.Acquire(len);
+	else
+		allocBuffer = (char *)memalign(VEC8F_SIZE_B,len);
 	// check for failed alloc here..
 
-	aptr = *allocPtr; // allocate the single large buffer as needed
+	aptr = allocBuffer; // allocate the single large buffer as needed
 
 	mComparator_sigs = (float *)aptr;  aptr += mComparator_sigs_len;
     mComparator_noise = (float *)aptr; aptr += mComparator_noise_len;
@@ -216,23 +565,20 @@ char *ComparatorNoiseCorrector::AllocateStructs(int threadNum, int _rows, int _c
     mCorrection = (short int *)aptr; aptr += mCorrection_len;
     mMask = (float *)aptr; aptr += mMask_len;
 
-   	return *allocPtr;
+   	return allocBuffer;
 }
 
 void ComparatorNoiseCorrector::FreeStructs(int threadNum, bool force, char *ptr)
 {
-	if(force || threadNum < 0)
+	if(threadNum >= 0)
 	{
-		if(threadNum >= 0)
-		{
-			free(mAllocMem[threadNum]);
-			mAllocMem[threadNum]=NULL;
-			mAllocMemLen[threadNum]=0;
-		}
-		else if(ptr)
-		{
-			free(ptr);
-		}
+		cncScratch.Release(ptr);
+		if(force)
+			cncScratch.Trim();
+	}
+	else if(ptr)
+	{
+		free(ptr);
 	}
 }
 
@@ -697,45 +1043,37 @@ void ComparatorNoiseCorrector::BuildCorrection(bool hfonly)
 // subtract the already computed correction from the image file
 void ComparatorNoiseCorrector::ApplyCorrection(int  phase, int row_start, int row_end, short int *correction)
 {
-	int i,y,frame;
-	int frameStride=rows*cols;
-	v8s *srcPtr, *corPtr;
-	int lw=cols/VEC8_SIZE;
-	int corrComp[4] = {0,1,2,3};
+	ApplyCorrectionJob job;
 	double startTime = CNCTimer();
 
+	job.image = image;
+	job.correction = correction;
+	job.rows = rows;
+	job.cols = cols;
+	job.frames = frames;
+	job.row_start = row_start;
+	for (int i = 0; i < 4; i++)
+		job.corrComp[i] = i;
+
 //	printf("ncomp=%d phase=%d row_start=%d row_end=%d\n",ncomp,phase,row_start,row_end);
 	if(ncomp == 2){
 		if(phase==0){
-		corrComp[0] = 1;
-		corrComp[1] = 1;
-		corrComp[2] = 0;
-		corrComp[3] = 0;
+		job.corrComp[0] = 1;
+		job.corrComp[1] = 1;
+		job.corrComp[2] = 0;
+		job.corrComp[3] = 0;
 		}
 		else{
-			corrComp[0] = 0;
-			corrComp[1] = 1;
-			corrComp[2] = 1;
-			corrComp[3] = 0;
+			job.corrComp[0] = 0;
+			job.corrComp[1] = 1;
+			job.corrComp[2] = 1;
+			job.corrComp[3] = 0;
 		}
 	}
 
 	// now subtract each neighbor-subtracted comparator signal from the
-	// pixels that are connected to that comparator
-
-	for (frame = 0; frame < frames; frame++)
-	{
-		for (y = row_start; y < row_end; y++)
-		{
-			srcPtr = (v8s *)(&image[frame * frameStride + y * cols]);
-			corPtr = (v8s *) (correction + corrComp[(y-row_start)&3]*frames*cols + frame*cols);
-
-			for (i = 0;i<lw;i++)
-			{
-				srcPtr[i] -= corPtr[i];
-			}
-		}
-	}
+	// pixels that are connected to that comparator, a band of rows per thread
+	NoiseCorrectorRunBands(ApplyCorrectionBand, &job, row_end - row_start, cols*frames, cncThreads, 4);
 	  applyTime += CNCTimer()-startTime;
 }
 
@@ -743,98 +1081,23 @@ void ComparatorNoiseCorrector::ApplyCorrection(int  phase, int row_start, int ro
 // mMask has a 1 in it for every active column and a zero for every pinned pixel
 void ComparatorNoiseCorrector::SumColumns(int row_start, int row_end)
 {
-	int frame,x,y,comparator;
-	int frameStride=rows*cols;
-
+	SumColumnsJob job;
 	double startTime=CNCTimer();
 
-
 	memset(mAvg_num,0,mAvg_num_len);
 
-#ifdef __AVX__
-	if((cols%VEC8_SIZE) == 0)
-	{
-		int lw=cols/VEC8_SIZE;
-		v8f_u valU;
-
-		valU.V=LD_VEC8F(0);
-		for (frame = 0; frame < frames; frame++)
-		{
-			for (y = row_start; y < row_end; y++)
-			{
-				comparator = (y - row_start) & 0x3;
-				short int *sptr = &image[frame * frameStride + y * cols];
-				v8f *dstPtr = (v8f *) (mComparator_sigs + comparator * cols * frames + frame * cols);
-				v8f *sumPtr = (v8f *) (mAvg_num + comparator * cols * frames + frame * cols);
-				v8f *mskPtr = (v8f *) (mMask + cols*y);
-
-				for (x = 0; x < lw; x++,sptr+=VEC8_SIZE,dstPtr++,sumPtr++,mskPtr++)
-				{
-					LD_VEC8S_CVT_VEC8F(sptr,valU);
+	job.image = image;
+	job.mask = mMask;
+	job.sigs = mComparator_sigs;
+	job.avg_num = mAvg_num;
+	job.rows = rows;
+	job.cols = cols;
+	job.frames = frames;
+	job.row_start = row_start;
+	job.row_end = row_end;
 
-					*dstPtr += valU.V;
-					*sumPtr += *mskPtr;
-				}
-			}
-		}
-		for (frame = 0; frame < frames; frame++)
-		{
-			for (comparator = 0; comparator < 4; comparator++)
-			{
-				float *dstPtr = (float *) (mComparator_sigs + comparator * cols * frames + frame * cols);
-				float *sumPtr = (float *) (mAvg_num + comparator * cols * frames + frame * cols);
-				for (x = 0; x < cols; x++)
-				{
-					float valU = (float)((sumPtr[x])?sumPtr[x]:1);
-					dstPtr[x] /= valU;
-				}
-			}
-		}
-	}
-	else
-#endif
-	{
-		for (frame = 0; frame < frames; frame++)
-		{
-			for (y = row_start; y < row_end; y++)
-			{
-				comparator = (y - row_start) & 0x3;
-				float valU;
-				short int *srcPtr = (short int *) (&image[frame * frameStride + y * cols]);
-				float *dstPtr = (float *) (mComparator_sigs + comparator * cols * frames + frame * cols);
-				float *sumPtr = (float *) (mAvg_num + comparator * cols);
-				float *mskPtr = (float *) (mMask + cols*y);
-				if(frame==0){
-					for (x = 0; x < cols; x++)
-					{
-						valU= (float)srcPtr[x];
-						dstPtr[x] += valU;
-						sumPtr[x] += mskPtr[x];
-					}
-				}
-				else{
-					for (x = 0; x < cols; x++)
-					{
-						valU= (float)srcPtr[x];
-						dstPtr[x] += valU;
-					}
-				}
-			}
-		}
-		for (frame = 0; frame < frames; frame++)
-		{
-			for (comparator = 0; comparator < 4; comparator++)
-			{
-				float *dstPtr = (float *) (mComparator_sigs + comparator * cols * frames + frame * cols);
-				float *sumPtr = (float *) (mAvg_num + comparator * cols);
-				for (x = 0; x < cols; x++)
-				{
-					float valU = (float)((sumPtr[x])?sumPtr[x]:1);
-					dstPtr[x] /= valU;
-				}
-			}
-		}
-	}
+	// each thread sums a band of columns, keeping the vectors aligned
+	NoiseCorrectorRunBands(SumColumnsBand, &job, cols, (row_end-row_start)*frames, cncThreads, VEC8_SIZE);
 
 	sumTime += CNCTimer() - startTime;
 
@@ -1060,102 +1323,20 @@ int ComparatorNoiseCorrector::DiscoverComparatorPhase(float *psigs,int n_compara
 // now neighbor-subtract the comparator signals
 void ComparatorNoiseCorrector::NNSubtractComparatorSigs(float *pnn,float *psigs,int *mask,int span,int n_comparators,int nframes,float *hfnoise)
 {
+	NNSubtractJob job;
 	double startTime = CNCTimer();
 
-	float nn_avg[nframes];
-	float zero_sig[nframes];
-
-	memset(zero_sig, 0, sizeof(zero_sig));
-
-	for (int i = 0; i < n_comparators; i++) {
-		int nn_cnt = 0;
-		float *cptr;
-		float *n_cptr;
-		float *chfptr = NULL;
-		float *n_chfptr = NULL;
-		float *nncptr;
-		int i_c0 = i & ~(ncomp - 1);
-		memset(nn_avg, 0, sizeof(nn_avg));
-
-		// in case we weren't provided with high frequency noise correction for NNs, use all zeros instead
-		chfptr = zero_sig;
-		n_chfptr = zero_sig;
-
-		// rounding down the starting point and adding one to the rhs properly centers
-		// the neighbor average about the central column...except in cases where columns are
-		// masked within the neighborhood.
-
-		//same column but the other comparators
-		for (int comparator = 0; comparator < ncomp; comparator++) {
-			int cndx = i_c0 + comparator;
-
-			if (!mask[cndx] && cndx != i) {
-				// get a pointer to the comparator signal
-				cptr = psigs + cndx * nframes;
-
-				if (hfnoise != NULL) {
-					chfptr = hfnoise + cndx * nframes;
-
-					// add it to the average
-					for (int frame = 0; frame < nframes; frame++)
-						nn_avg[frame] += cptr[frame] - chfptr[frame];
-				} else {
-					// add it to the average
-					for (int frame = 0; frame < nframes; frame++)
-						nn_avg[frame] += cptr[frame];
-				}
-
-				nn_cnt++;
-			}
-		}
-
-		for (int s = 1; s <= span; s++) {
-			//i_c0 is even number
-			for (int comparator = 0; comparator < ncomp; comparator++) {
-				int cndx = i_c0 - ncomp * s + comparator;
-				int n_cndx = i_c0 + ncomp * s + comparator;
-				if (!(cndx < 0 || n_cndx >= n_comparators ||
-						mask[cndx] || mask[n_cndx] ||
-						(regionXSize
-								&& (((cndx / ncomp) / regionXSize) != ((i / ncomp) / regionXSize) ||
-								  ((n_cndx / ncomp) / regionXSize) != ((i / ncomp) / regionXSize))))) {
-					// get a pointer to the comparator signal
-					cptr = psigs + cndx * nframes;
-					n_cptr = psigs + n_cndx * nframes;
-
-					if (hfnoise != NULL) {
-						chfptr = hfnoise + cndx * nframes;
-						n_chfptr = hfnoise + n_cndx * nframes;
-					}
-					// add it to the average
-					for (int frame = 0; frame < nframes; frame++) {
-						nn_avg[frame] += cptr[frame] - chfptr[frame];
-						nn_avg[frame] += n_cptr[frame] - n_chfptr[frame];
-					}
-
-					nn_cnt += 2;
-				}
-			}
-		}
-
-		if ((nn_cnt > 0)) {
-			for (int frame = 0; frame < nframes; frame++)
-				nn_avg[frame] /= nn_cnt;
-
-			// now subtract the neighbor average
-			cptr = psigs + i * nframes;
-			nncptr = pnn + i * nframes;
-			for (int frame = 0; frame < nframes; frame++)
-				nncptr[frame] = cptr[frame] - nn_avg[frame];
-		} else {
-//      fprintf (stdout, "Default noise of 0 is set: %d\n", i);
-			// not a good set of neighbors to use...just blank the correction
-			// signal and do nothing.
-			nncptr = pnn + i * nframes;
-			for (int frame = 0; frame < nframes; frame++)
-				nncptr[frame] = 0.0f;
-		}
-	}
+	job.pnn = pnn;
+	job.psigs = psigs;
+	job.mask = mask;
+	job.hfnoise = hfnoise;
+	job.span = span;
+	job.n_comparators = n_comparators;
+	job.nframes = nframes;
+	job.ncomp = ncomp;
+	job.regionXSize = regionXSize;
+
+	NoiseCorrectorRunBands(NNSubtractBand, &job, n_comparators, nframes*(2*span+1), cncThreads, ncomp);
 	nnsubTime += CNCTimer() - startTime;
 }
 
@@ -1356,6 +1537,7 @@ void ComparatorNoiseCorrector::MaskUsingDynamicStdCutoff(int *mask,float *prms,i
 // simple iterative formula that is good for getting the first principal component
 void ComparatorNoiseCorrector::GetPrincComp(float *mPcomp,float *pnn,int *mask,int n_comparators,int nframes)
 {
+	double startTime = CNCTimer();
 	float ptmp[nframes];
 	float ttmp[nframes];
 	float residual;
@@ -1372,24 +1554,22 @@ void ComparatorNoiseCorrector::GetPrincComp(float *mPcomp,float *pnn,int *mask,i
 	residual = FLT_MAX;
  
         int iterations = 0;	
+	float proj[n_comparators];
+	PrincCompJob job;
+	job.pnn = pnn;
+	job.mask = mask;
+	job.ptmp = ptmp;
+	job.proj = proj;
+	job.ttmp = ttmp;
+	job.n_comparators = n_comparators;
+	job.nframes = nframes;
+
 	while((residual > 0.001) && (iterations < MAX_CNC_PCA_ITERS))
 	{
 		memset(ttmp,0,sizeof(float)*nframes);
 
-		for (int i=0;i < n_comparators;i++)
-		{
-			float sum=0.0f;
-			float *cptr = pnn + i*nframes;
-			
-			if (mask[i] == 0)
-			{
-				for (int j=0;j < nframes;j++)
-					sum += ptmp[j]*cptr[j];
-				
-				for (int j=0;j < nframes;j++)
-					ttmp[j] += cptr[j]*sum;
-			}
-		}
+		NoiseCorrectorRunBands(PrincCompProjectBand, &job, n_comparators, nframes, cncThreads);
+		NoiseCorrectorRunBands(PrincCompSumBand, &job, nframes, n_comparators, cncThreads, VEC8_SIZE);
 				
 		float tmag = 0.0f;
 		for (int i=0;i < nframes;i++)
@@ -1408,6 +1588,7 @@ void ComparatorNoiseCorrector::GetPrincComp(float *mPcomp,float *pnn,int *mask,i
 
                 iterations++;
 	}
+	pcaTime += CNCTimer() - startTime;
 }
 
 void ComparatorNoiseCorrector::FilterUsingPrincComp(float *pnn,float *mPcomp,int n_comparators,int nframes)
@@ -1452,64 +1633,15 @@ void ComparatorNoiseCorrector::GenerateIntMask(Mask *_mask)
 // generates a mask of pinned pixels
 void ComparatorNoiseCorrector::GenerateMask(float *_mask)
 {
-	int frm,idx;
-	int frameStride=rows*cols;
-	int len=frameStride/VEC8_SIZE;
-	v8f_u *mskPtr,tmp;
-	v8f_u high,low;
-	int cnt=0;
+	GenerateMaskJob job;
 	mMaskGenerated=1;
 
-	high.V=LD_VEC8F(16380);
-	low.V=LD_VEC8F(5);
-
+	job.image = image;
+	job.mask = _mask;
+	job.frameStride = rows*cols;
+	job.frames = frames;
 
-	// initialize the mask to all 1's
-	tmp.V=LD_VEC8F(1.0f);
-	mskPtr=(v8f_u *)_mask;
-	for(idx=0;idx<len;idx++)
-		mskPtr[idx].V=tmp.V;
-
-	for(frm=0;frm<frames;frm++)
-	{
-		mskPtr=(v8f_u *)_mask;
-#if 0//def __AVX__
-		v8f_u tmpV;
-		uint16_t *src=(uint16_t *)(image + rows*cols*frm);
-		for(idx=0;idx<len;idx++)
-		{
-			LD_VEC8S_CVT_VEC8F(src,tmpV);
-
-			// now, do the pinned pixel comparisons
-			mskPtr[idx].V += __builtin_ia32_cmpps256(tmpV.V , low.V, _CMP_LT_OS);
-			mskPtr[idx].V += __builtin_ia32_cmpps256(high.V, tmpV.V, _CMP_LT_OS);
-		}
-#else
-		v8s_u *src=(v8s_u *)(image + rows*cols*frm);
-		for(idx=0;idx<len;idx++)
-		{
-			for(int k=0;k<VEC8_SIZE;k++)
-			{
-				if(src[idx].A[k] >= high.A[k] || low.A[k] >= src[idx].A[k])
-					mskPtr[idx].A[k]=0;
-			}
-		}
-#endif
-	}
-
-	// now, clear all pinned pixels so the column adds will be quick
-	for(idx=0;idx<frameStride;idx++)
-	{
-		if(_mask[idx]==0)
-		{
-			cnt++;
-			// this pixel is pinned..  clear all the frame values
-			for(frm=0;frm<frames;frm++)
-			{
-				image[rows*cols*frm + idx] = 0;
-			}
-		}
-	}
+	NoiseCorrectorRunBands(GenerateMaskBand, &job, rows*cols, frames, cncThreads, VEC8_SIZE);
 
 //	printf("found %d pinned pixels out of %d pixels\n",cnt,frameStride);
 }
@@ -20,12 +20,13 @@ typedef struct  {
 #include "RawImage.h"
 #endif
 
-#define MAX_CNC_THREADS 256
 #define MAX_CNC_PCA_ITERS 40
 
 class ComparatorNoiseCorrector
 {
 public:
+    // with threadNum >= 0 the scratch memory comes from a pool shared by all threads and
+    // goes back to it for the next image, with threadNum < 0 it is only used for this image
     char *AllocateStructs(int threadNum, int _rows, int _cols, int _frames);
     void FreeStructs(int threadNum, bool force=false, char *ptr=NULL);
     void CorrectComparatorNoise(RawImage *raw,Mask *mask,bool verbose,bool aggressive_corection = false,
@@ -41,6 +42,17 @@ public:
     void CorrectComparatorNoiseThumbnail(short *image, int rows, int cols, int frames, Mask *mask, int regionXSize, int regionYSize, bool verbose);
 	void justGenerateMask(RawImage *raw, int threadNum);
 
+    // number of threads working on each image, 1 corrects on the calling thread
+    static void SetThreads(int numThreads);
+    static int GetThreads();
+
+    // seconds spent in each stage so far
+    double SumTime() const { return sumTime; }
+    double NNSubtractTime() const { return nnsubTime; }
+    double PrincCompTime() const { return pcaTime; }
+    double ApplyTime() const { return applyTime; }
+    double TotalTime() const { return totalTime; }
+
     ComparatorNoiseCorrector() {
       mComparator_sigs = NULL;
       mComparator_noise = NULL;
@@ -62,6 +74,7 @@ public:
       tm2_2=0;
       tm2_3=0;
       nnsubTime=0;
+      pcaTime=0;
       mskTime=0;
       regionXSize=0;
       regionYSize=0;
@@ -177,6 +190,7 @@ private:
     double tm2_2;
     double tm2_3;
     double nnsubTime;
+    double pcaTime;
     double mskTime;
     double allocTime;
     double maskTime;
@@ -187,9 +201,6 @@ private:
     //    RandSchrange mRand;
     int mSigsSize;
     int NNSpan;
-
-    static char *mAllocMem[MAX_CNC_THREADS];
-    static int   mAllocMemLen[MAX_CNC_THREADS];
 };
 
 #endif // COMPARATORNOISECORRECTOR_H
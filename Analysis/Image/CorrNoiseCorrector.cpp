@@ -12,6 +12,7 @@
 
 #include "Utils.h"
 #include "CorrNoiseCorrector.h"
+#include "NoiseCorrectorThreads.h"
 #include "deInterlace.h"
 #include "Vecs.h"
 #ifdef __AVX__
@@ -43,8 +44,8 @@
 //#define CORR_ACC(idx,comparator,frame) (mCorrection[((comparator)*CorrLen*frames) + ((frame) *CorrLen) + (idx)])
 
 
-char *CorrNoiseCorrector::mAllocMem[MAX_RNC_THREADS] = {NULL};
-int CorrNoiseCorrector::mAllocMemLen[MAX_RNC_THREADS] = {0};
+static AlignedScratchPool rncScratch(VEC8F_SIZE_B);
+static int rncThreads = 1;
 
 
 static double CNCTimer()
@@ -67,6 +68,272 @@ static double CNCTimer()
 #endif
 }
 
+void CorrNoiseCorrector::SetThreads(int numThreads)
+{
+	rncThreads = (numThreads > 1) ? numThreads : 1;
+}
+
+int CorrNoiseCorrector::GetThreads()
+{
+	return rncThreads;
+}
+
+// The stages below work on bands of rows or columns on their own threads.  Every
+// output value is still added up in the same order as with a single thread, so
+// the correction doesn't depend on the number of threads.
+
+struct CorrBandJob {
+	short int *image;
+	short int *mask;
+	float *sigs;
+	float *noise;
+	int rows;
+	int cols;
+	int frames;
+	int fmult;
+	int ncomp;
+	int CorrLen;
+	int row_span;
+	int time_span;
+	int thumbnail;
+};
+
+#define BAND_SIGS_ACC(job,idx,comparator,frame) ((job)->sigs[((comparator)*(job)->CorrLen*(job)->frames) + ((frame)*(job)->CorrLen) + (idx)])
+#define BAND_NOISE_ACC(job,idx,comparator,frame) ((job)->noise[((comparator)*(job)->CorrLen*(job)->frames) + ((frame)*(job)->CorrLen) + (idx)])
+
+static void SumRowsBand(void *arg, int y_start, int y_end)
+{
+	CorrBandJob *job = (CorrBandJob *)arg;
+	int cols = job->cols;
+	int lcols = cols/8;
+
+	for (int frame = 0; frame < job->frames; frame++)
+	{
+		for (int y = y_start; y < y_end; y++){
+			short int *sptr = (short int *) (&job->image[frame * job->fmult * cols*job->rows + y * cols]);
+			v8s  *maskSumPtr=(v8s *)&job->mask[y*cols];
+			for(int reg=0;reg<job->ncomp;reg++){
+				v8s_u maskSum;
+				v8f_u sum;
+				v8f_u valU;
+				maskSum.V=LD_VEC8S(0);
+				sum.V=LD_VEC8F(0);
+				for (int x = 0; x < lcols/job->ncomp; x++)
+				{
+					LD_VEC8S_CVT_VEC8F(sptr,valU);
+					sum.V += valU.V;
+					maskSum.V+=*maskSumPtr++;
+					sptr+=8;
+				}
+				float avg=0;
+				float msksm=0;
+				for(int j=0;j<8;j++){
+					avg += sum.A[j];
+					msksm += maskSum.A[j];
+				}
+				BAND_SIGS_ACC(job,y,reg,frame) = avg/msksm;
+			}
+		}
+	}
+}
+
+static void SumColsBand(void *arg, int x_start, int x_end)
+{
+	CorrBandJob *job = (CorrBandJob *)arg;
+	int rows = job->rows;
+	int cols = job->cols;
+	int ncomp = job->ncomp;
+
+	for (int frame = 0; frame < job->frames; frame++)
+	{
+		for (int x = x_start; x < x_end; x+=8){
+
+			v8f_u sum;
+			v8f_u valU;
+
+			short int *sptr = (short int *) (&job->image[frame*job->fmult*cols*rows + x]);
+			for(int reg=0;reg<ncomp;reg++){
+				sum.V=LD_VEC8F(0);
+
+				for (int y = (reg)*(rows/ncomp); y < (reg+1)*(rows/ncomp); y++)
+				{
+					LD_VEC8S_CVT_VEC8F(sptr,valU);
+					sum.V += valU.V;
+					sptr+=cols;
+				}
+				for(int i=0;i<8;i++){
+					BAND_SIGS_ACC(job,x+i,reg,frame) = sum.A[i]/(float)(rows/ncomp);
+				}
+			}
+		}
+	}
+}
+
+// the rows averaged into the neighbor average of row (or column) y
+static void NNWindow(CorrBandJob *job, int y, int &start_y, int &end_y)
+{
+	int my_rowspan = job->row_span;
+	if(my_rowspan > job->CorrLen)
+		my_rowspan=job->CorrLen;
+	start_y = std::max(y-my_rowspan,0);
+	end_y   = std::min(y+my_rowspan,job->CorrLen);
+	if(job->thumbnail){
+		// keep the ns within the 100x100 block
+		start_y = y - y%100; // the beginning of the 100x100 block
+		end_y=start_y+100;
+	}
+}
+
+#define NN_LANES 64
+
+// Adds up the windows of a run of neighboring rows together, one lane per row.  The
+// windows only move forward from row to row, so every lane adds its own rows in the
+// same order the single row loop does, and adds zeros for the rest.
+static void NNWindowSums(const float * __restrict sig, const int * __restrict starts,
+		const int * __restrict ends, float * __restrict sums, int lanes)
+{
+	for (int l = 0; l < lanes; l++)
+		sums[l] = 0.0f;
+	for (int ry = starts[0]; ry < ends[lanes-1]; ry++)
+	{
+		float val = sig[ry];
+		for (int l = 0; l < lanes; l++)
+			sums[l] += ((ry >= starts[l]) & (ry < ends[l])) ? val : 0.0f;
+	}
+}
+
+static void NNSubtractBand(void *arg, int y_start, int y_end)
+{
+	CorrBandJob *job = (CorrBandJob *)arg;
+	int frames = job->frames;
+	float nn_avg[frames];
+	float nn_avg_smoothed[frames];
+	int time_span = job->time_span;
+
+#ifndef SMOOTH_NNAVG
+	if(time_span == 1){
+		int starts[NN_LANES];
+		int ends[NN_LANES];
+		float sums[NN_LANES];
+
+		for (int y0 = y_start; y0 < y_end; y0 += NN_LANES) {
+			int lanes = std::min(NN_LANES, y_end - y0);
+			for (int l = 0; l < lanes; l++)
+				NNWindow(job, y0+l, starts[l], ends[l]);
+
+			for(int comp = 0;comp < job->ncomp; comp++){
+				for (int frame = 0; frame < frames; frame++){
+					float *sig = &BAND_SIGS_ACC(job,0,comp,frame);
+					float *noise = &BAND_NOISE_ACC(job,0,comp,frame);
+
+					NNWindowSums(sig, starts, ends, sums, lanes);
+					for (int l = 0; l < lanes; l++){
+						float avg = sums[l];
+						avg /= (ends[l]-starts[l]);
+						float tmp = sig[y0+l] - avg;
+						if(tmp != tmp)
+							tmp=0;
+
+						noise[y0+l] = tmp;
+					}
+				}
+			}
+		}
+		return;
+	}
+#endif
+
+	for (int y = y_start; y < y_end; y++) {
+		int start_y, end_y;
+		NNWindow(job, y, start_y, end_y);
+
+		for(int comp = 0;comp < job->ncomp; comp++){
+			memset(nn_avg, 0, sizeof(nn_avg));
+			for (int frame = 0; frame < frames; frame++){
+				int start_frame= std::max(frame-time_span+1,0);
+				int end_frame  = std::min(frame+time_span,frames);
+				for(int fr=start_frame;fr<end_frame;fr++){
+					for(int ry=start_y;ry<end_y;ry++){
+						nn_avg[frame] += BAND_SIGS_ACC(job,ry,comp,fr);
+					}
+				}
+				nn_avg[frame] /= (end_y-start_y)*(end_frame-start_frame);
+			}
+
+#ifdef SMOOTH_NNAVG
+			// now, smooth nn_avg
+			for (int frame = 0; frame < frames; frame++){
+				int span=SMOOTH_NNAVG;
+				int start_fr=frame-span;
+				int end_fr=frame+span;
+				if(start_fr < 0)start_fr=0;
+				if(end_fr > frames)end_fr=frames;
+
+				nn_avg_smoothed[frame]=0;
+				for(int fr=start_fr;fr<end_fr;fr++){
+					nn_avg_smoothed[frame] += nn_avg[fr];
+				}
+				nn_avg_smoothed[frame] /= (end_fr-start_fr);
+			}
+#else
+			for (int frame = 0; frame < frames; frame++){
+				nn_avg_smoothed[frame] =nn_avg[frame];
+			}
+#endif
+			for (int frame = 0; frame < frames; frame++){
+				float tmp = BAND_SIGS_ACC(job,y,comp,frame) - nn_avg_smoothed[frame];
+				if(tmp != tmp)
+					tmp=0;
+
+				BAND_NOISE_ACC(job,y,comp,frame) = tmp;
+			}
+		}
+	}
+}
+
+static void ApplyCorrectionRowsBand(void *arg, int y_start, int y_end)
+{
+	CorrBandJob *job = (CorrBandJob *)arg;
+	int cols = job->cols;
+	int ncomp = job->ncomp;
+	int frameStrideV=(job->rows*cols/8)*job->fmult;
+
+	for (int y = y_start; y < y_end; y++){
+		v8s *srcPtr = (v8s *) (&job->image[y * cols]);
+		int x = 0;
+
+		for (int reg = 0; reg < ncomp; reg++){
+			for(;x<(reg+1)*(cols/ncomp);x+=8,srcPtr++){
+				for (int frame = 0; frame < job->frames; frame++)
+				{
+					v8s corr=LD_VEC8S((short int)(BAND_NOISE_ACC(job,y,reg,frame)));
+					srcPtr[frame*frameStrideV] -= corr;
+				}
+			}
+		}
+	}
+}
+
+static void ApplyCorrectionColsBand(void *arg, int y_start, int y_end)
+{
+	CorrBandJob *job = (CorrBandJob *)arg;
+	int rows = job->rows;
+	int cols = job->cols;
+
+	for (int frame = 0; frame < job->frames; frame++)
+	{
+		for(int y=y_start ;y< y_end; y++){
+			v8f_u *corr=(v8f_u *)&BAND_NOISE_ACC(job,0,0,frame);
+			v8s *srcPtr=(v8s *)&job->image[frame*job->fmult*rows*cols + y*cols];
+			for(int x=0 ;x< cols; x+=8,corr++,srcPtr++){
+				v8s_u corrS;
+				CVT_VEC8F_VEC8S(corrS,(*corr));
+				*srcPtr -= corrS.V;
+			}
+		}
+	}
+}
+
 #ifndef BB_DC
 double CorrNoiseCorrector::CorrectCorrNoise(RawImage *raw, int correctRows, int thumbnail, bool override,
 		bool verbose, int threadNum, int avg)
@@ -158,9 +425,6 @@ char *CorrNoiseCorrector::AllocateStructs(int threadNum, int _rows, int _cols, i
 {
 	int len=0;
 	char *allocBuffer=NULL;
-	char **allocPtr = &allocBuffer;
-	int allocLen=0;
-	int *allocLenPtr = &allocLen;
 	char *aptr;
 
 	initVars();
@@ -170,50 +434,50 @@ char *CorrNoiseCorrector::AllocateStructs(int threadNum, int _rows, int _cols, i
     len += mCorr_noise_len;
 //    len += mCorrection_len;
 
-    if(threadNum >= 0 && threadNum < MAX_RNC_THREADS)
-    {
-    	allocPtr = &mAllocMem[threadNum];
-    	allocLenPtr = &mAllocMemLen[threadNum];
-    }
-
-	if(*allocLenPtr < len)
-	{
-		if(*allocPtr)
-		{
-//			printf("Freeing old memory tn=%d\n",threadNum);
-			free(*allocPtr);
-		}
-
-//		printf("allocating new memory tn=%d len=%d\n",threadNum,len);
-		*allocPtr = (char *)memalign(VEC8F_SIZE_B,len);
-		*allocLenPtr = len;
-	}
+	if(threadNum >= 0)
+		allocBuffer = rncScratch.Acquire(len);
+	else
+		allocBuffer = (char *)memalign(VEC8F_SIZE_B,len);
 	// check for failed alloc here..
 
-	aptr = *allocPtr; // allocate the single large buffer as needed
+	aptr = allocBuffer; // allocate the single large buffer as needed
 
 	mCorr_sigs = (float *)aptr;  aptr += mCorr_sigs_len;
     mCorr_noise = (float *)aptr; aptr += mCorr_noise_len;
 //    mCorrection = (short int *)aptr; aptr += mCorrection_len;
 
-   	return *allocPtr;
+   	return allocBuffer;
 }
 
 void CorrNoiseCorrector::FreeStructs(int threadNum, bool force, char *ptr)
 {
-	if(force || threadNum < 0)
+	if(threadNum >= 0)
 	{
-		if(threadNum >= 0)
-		{
-			free(mAllocMem[threadNum]);
-			mAllocMem[threadNum]=NULL;
-			mAllocMemLen[threadNum]=0;
-		}
-		else if(ptr)
-		{
-			free(ptr);
-		}
+		rncScratch.Release(ptr);
+		if(force)
+			rncScratch.Trim();
 	}
+	else if(ptr)
+	{
+		free(ptr);
+	}
+}
+
+void CorrNoiseCorrector::SetUpBandJob(CorrBandJob &job)
+{
+	job.image = image;
+	job.mask = mCorr_mask;
+	job.sigs = mCorr_sigs;
+	job.noise = mCorr_noise;
+	job.rows = rows;
+	job.cols = cols;
+	job.frames = frames;
+	job.fmult = fmult;
+	job.ncomp = ncomp;
+	job.CorrLen = CorrLen;
+	job.row_span = 0;
+	job.time_span = 1;
+	job.thumbnail = thumbnail;
 }
 
 double CorrNoiseCorrector::CorrectRowNoise_internal( bool verbose, int correctRows)
@@ -499,64 +763,29 @@ void CorrNoiseCorrector::ReZeroPinnedPixels_cpFirstFrame()
 // subtract the already computed correction from the image file
 double CorrNoiseCorrector::ApplyCorrection_rows()
 {
-	int y;
-	int frameStride=rows*cols*fmult;
-	int frameStrideV=(rows*cols/8)*fmult;
+	CorrBandJob job;
 	double startTime = CNCTimer();
 	double TotalAvgNoiseSq=0;
 	double TotalAvgNoiseSum=0;
 //	v8s imgAvg=LD_VEC8S((short int)CorrAvg);
 
-
-	for (y = 0; y < rows; y++){
-		v8s *srcPtr = (v8s *) (&image[0 * frameStride + y * cols]);
-		int x = 0;
-
+	for (int y = 0; y < rows; y++){
 		for (int reg = 0; reg < ncomp; reg++){
-
-			{
-				float avgNoiseSq=0;
-				float avgNoiseSum = 0;
-				for(int frame=0;frame<frames;frame++){
-					float corr=NOISE_ACC(y,reg,frame);
-					avgNoiseSq +=  corr*corr;
-					avgNoiseSum += corr;
-				}
-				TotalAvgNoiseSq += avgNoiseSq;
-				TotalAvgNoiseSum += avgNoiseSum;
-			}
-
-#if 0
-			float noise_slope=0;
-			float noise_offset=NOISE_ACC(y,reg,frame);
-			float noise_cnt=0;
-			if(reg > 0){
-				noise_slope+=(NOISE_ACC(y,reg,frame)-NOISE_ACC(y,reg-1,frame))/(float)(cols/ncomp);
-				noise_cnt++;
-			}
-			if(reg < 3){
-				noise_slope+=(NOISE_ACC(y,reg+1,frame)-NOISE_ACC(y,reg,frame))/(float)(cols/ncomp);
-				noise_cnt++;
-			}
-			noise_slope/=noise_cnt;
-			for (float weight=-cols/8; weight < cols/8; weight++,x++){
-				srcPtr[x] -= noise_offset + weight*noise_slope;
+			float avgNoiseSq=0;
+			float avgNoiseSum = 0;
+			for(int frame=0;frame<frames;frame++){
+				float corr=NOISE_ACC(y,reg,frame);
+				avgNoiseSq +=  corr*corr;
+				avgNoiseSum += corr;
 			}
-#else
-			for(;x<(reg+1)*(cols/ncomp);x+=8,srcPtr++){
-//				v8s corr0=LD_VEC8S((short int)NOISE_ACC(y,reg,1));
-				for (int frame = 0; frame < frames; frame++)
-				{
-					v8s corr=LD_VEC8S((short int)(NOISE_ACC(y,reg,frame)));
-//					srcPtr[frame*frameStrideV] += imgAvg - srcPtr[1*frameStrideV] - corr + corr0;
-//					srcPtr[frame*frameStrideV] = LD_VEC8S((short int)(8192 + SIGS_ACC(y,reg,frame) - NOISE_ACC(y,reg,frame)));
-					srcPtr[frame*frameStrideV] -= corr;
-				}
-			}
-#endif
+			TotalAvgNoiseSq += avgNoiseSq;
+			TotalAvgNoiseSum += avgNoiseSum;
 		}
 	}
 
+	SetUpBandJob(job);
+	NoiseCorrectorRunBands(ApplyCorrectionRowsBand, &job, rows, cols*frames, rncThreads);
+
 	TotalAvgNoiseSum /= (double)(rows*ncomp*frames);
 	TotalAvgNoiseSq /= (double)(rows*ncomp*frames);
 //	printf("RTN: sq=%.1lf rms=%.1lf\n",TotalAvgNoiseSq,sqrt(TotalAvgNoiseSq));
@@ -571,44 +800,11 @@ double CorrNoiseCorrector::ApplyCorrection_rows()
 // subtract the already computed correction from the image file
 void CorrNoiseCorrector::ApplyCorrection_cols()
 {
+	CorrBandJob job;
 	double startTime = CNCTimer();
 	//printf("%s\n",__FUNCTION__);
-	for (int frame = 0; frame < frames; frame++)
-	{
-		for(int y=0 ;y< rows; y++){
-			v8f_u *corr=(v8f_u *)&NOISE_ACC(0,0,frame);
-			v8s *srcPtr=(v8s *)&image[frame*fmult*rows*cols + y*cols];
-			for(int x=0 ;x< cols; x+=8,corr++,srcPtr++){
-				v8s_u corrS;
-				CVT_VEC8F_VEC8S(corrS,(*corr));
-				*srcPtr -= corrS.V;
-
-
-//			int16_t sum[4]={0,0,0,0};
-//			for(int j=0;j<4;j++){
-//				sum[j] = NOISE_ACC(y,j,frame);
-//			}
-//			short int *srcPtr = (short int *) (&image[frame*rows*cols + x]);
-//			int y = 0;
-//			for (int reg = 0; reg < ncomp; reg++){
-//				float noise_slope=0;
-//				float noise_offset=NOISE_ACC(x,reg,frame);
-//				float noise_cnt=0;
-//				if(reg > 0){
-//					noise_slope+=(NOISE_ACC(x,reg,frame)-NOISE_ACC(x,reg-1,frame))/(float)(rows/ncomp);
-//					noise_cnt++;
-//				}
-//				if(reg < (ncomp-1)){
-//					noise_slope+=(NOISE_ACC(x,reg+1,frame)-NOISE_ACC(x,reg,frame))/(float)(rows/ncomp);
-//					noise_cnt++;
-//				}
-//				noise_slope/=noise_cnt;
-//				for (float weight=-(float)rows/((float)ncomp*2.0f); weight < (float)rows/((float)ncomp*2.0f); weight++,y++){
-//					srcPtr[y*cols] -= noise_offset + weight*noise_slope;
-//				}
-			}
-		}
-	}
+	SetUpBandJob(job);
+	NoiseCorrectorRunBands(ApplyCorrectionColsBand, &job, rows, cols*frames, rncThreads);
 
 //	printf("ncomp=%d phase=%d row_start=%d row_end=%d\n",ncomp,phase,row_start,row_end);
 	  applyTime += CNCTimer()-startTime;
@@ -618,39 +814,13 @@ void CorrNoiseCorrector::ApplyCorrection_cols()
 // mMask has a 1 in it for every active column and a zero for every pinned pixel
 void CorrNoiseCorrector::SumRows()
 {
-	int frame,x,y;
+	CorrBandJob job;
+	int y;
 	double startTime=CNCTimer();
 
-	int lcols=cols/8;
-	for (frame = 0; frame < frames; frame++)
-	{
-		for (y = 0; y < rows; y++){
-			short int *sptr = (short int *) (&image[frame * fmult * cols*rows + y * cols]);
-			v8s  *maskSumPtr=(v8s *)&mCorr_mask[y*cols];
-			for(int reg=0;reg<ncomp;reg++){
-				v8s_u maskSum;
-				v8f_u sum;
-				v8f_u valU;
-				maskSum.V=LD_VEC8S(0);
-				sum.V=LD_VEC8F(0);
-				for (x = 0; x < lcols/ncomp; x++)
-				{
-					LD_VEC8S_CVT_VEC8F(sptr,valU);
-					sum.V += valU.V;
-					maskSum.V+=*maskSumPtr++;
-					sptr+=8;
-				}
-				float avg=0;
-				float msksm=0;
-				for(int j=0;j<8;j++){
-					avg += sum.A[j];
-					msksm += maskSum.A[j];
-				}
-				SIGS_ACC(y,reg,frame) = avg/msksm;
-			}
-		}
-	}
-
+	// each thread averages the regions of a band of rows
+	SetUpBandJob(job);
+	NoiseCorrectorRunBands(SumRowsBand, &job, rows, cols*frames, rncThreads);
 
 	if(CorrAvg==0){
 		for (int reg = 0; reg < ncomp; reg++){
@@ -682,40 +852,12 @@ void CorrNoiseCorrector::SumRows()
 // mMask has a 1 in it for every active column and a zero for every pinned pixel
 void CorrNoiseCorrector::SumCols()
 {
-	int frame;
-//	int colsV=cols/8;
-
+	CorrBandJob job;
 	double startTime=CNCTimer();
 
-	for (frame = 0; frame < frames; frame++)
-	{
-		for (int x = 0; x < cols; x+=8){
-
-			v8f_u sum;
-			v8f_u valU;
-
-
-			short int *sptr = (short int *) (&image[frame*fmult*cols*rows + x]);
-//			v8s  *maskSumPtr=(v8s *)&mCorr_mask[x];
-			for(int reg=0;reg<ncomp;reg++){
-//				v8s_u maskSum;
-				sum.V=LD_VEC8F(0);
-//				maskSum.V=LD_VEC8S(0);
-
-				for (int y = (reg)*(rows/ncomp); y < (reg+1)*(rows/ncomp); y++)
-				{
-					LD_VEC8S_CVT_VEC8F(sptr,valU);
-					sum.V += valU.V;
-//					maskSum.V+=*maskSumPtr++;
-					sptr+=cols;
-//					maskSumPtr += colsV;
-				}
-				for(int i=0;i<8;i++){
-					SIGS_ACC(x+i,reg,frame) = sum.A[i]/(float)(/*maskSum.A[i]*/rows/ncomp);
-				}
-			}
-		}
-	}
+	// each thread averages the regions of a band of columns
+	SetUpBandJob(job);
+	NoiseCorrectorRunBands(SumColsBand, &job, cols, rows*frames, rncThreads, 8);
 
 	sumTime += CNCTimer() - startTime;
 }
@@ -798,78 +940,16 @@ void CorrNoiseCorrector::smoothRowAvgs(float weight)
 // now neighbor-subtract the comparator signals
 void CorrNoiseCorrector::NNSubtractComparatorSigs(int row_span, int time_span, int correctRows)
 {
-	float nn_avg[frames];
-	float nn_avg_smoothed[frames];
-
+	CorrBandJob job;
 	double startTime = CNCTimer();
 
 	if(time_span<1)
 		time_span=1;
 
-	for (int y = 0; y < CorrLen; y++) {
-		int my_rowspan = row_span;
-		if(my_rowspan > CorrLen)
-			my_rowspan=CorrLen;
-//		if((y+my_rowspan) > CorrLen)
-//			my_rowspan = CorrLen-y;
-		int start_y = std::max(y-my_rowspan,0);
-		int end_y   = std::min(y+my_rowspan,CorrLen);
-		if(thumbnail/* && !correctRows*/){
-			// keep the ns within the 100x100 block
-			start_y = y - y%100; // the beginning of the 100x100 block
-			end_y=start_y+100;
-		}
-
-		for(int comp = 0;comp < ncomp; comp++){
-			memset(nn_avg, 0, sizeof(nn_avg));
-			for (int frame = 0; frame < frames; frame++){
-				int start_frame= std::max(frame-time_span+1,0);
-				int end_frame  = std::min(frame+time_span,frames);
-				for(int fr=start_frame;fr<end_frame;fr++){
-					for(int ry=start_y;ry<end_y;ry++){
-						nn_avg[frame] += SIGS_ACC(ry,comp,fr);
-					}
-				}
-				nn_avg[frame] /= (end_y-start_y)*(end_frame-start_frame);
-			}
-
-#ifdef SMOOTH_NNAVG
-			// now, smooth nn_avg
-			for (int frame = 0; frame < frames; frame++){
-				int span=SMOOTH_NNAVG;
-				int start_fr=frame-span;
-				int end_fr=frame+span;
-				if(start_fr < 0)start_fr=0;
-				if(end_fr > frames)end_fr=frames;
-
-				nn_avg_smoothed[frame]=0;
-				for(int fr=start_fr;fr<end_fr;fr++){
-					nn_avg_smoothed[frame] += nn_avg[fr];
-				}
-				nn_avg_smoothed[frame] /= (end_fr-start_fr);
-			}
-#else
-			for (int frame = 0; frame < frames; frame++){
-				nn_avg_smoothed[frame] =nn_avg[frame];
-			}
-#endif
-			for (int frame = 0; frame < frames; frame++){
-				float tmp = SIGS_ACC(y,comp,frame) - nn_avg_smoothed[frame];
-				if(tmp != tmp)
-					tmp=0;
-
-				NOISE_ACC(y,comp,frame) = tmp;
-
-//				if(y<5 && comp==0)
-//					printf("%d start_frame=%d end_frame=%d avg=%f noise=%f\n",frame,start_frame,end_frame,nn_avg[frame],NOISE_ACC(y,comp,frame));
-			}
-		}
-	}
+	SetUpBandJob(job);
+	job.row_span = row_span;
+	job.time_span = time_span;
+	NoiseCorrectorRunBands(NNSubtractBand, &job, CorrLen, ncomp*frames*(2*row_span+1), rncThreads);
 
 	nnsubTime += CNCTimer() - startTime;
 }
-
-
-
-
-
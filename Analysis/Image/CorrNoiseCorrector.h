@@ -20,11 +20,13 @@
 #include "RawImage.h"
 #endif
 
-#define MAX_RNC_THREADS 256
+struct CorrBandJob;
 
 class CorrNoiseCorrector
 {
 public:
+    // with threadNum >= 0 the scratch memory comes from a pool shared by all threads and
+    // goes back to it for the next image, with threadNum < 0 it is only used for this image
     char *AllocateStructs(int threadNum, int _rows, int _cols, int _frames);
     void FreeStructs(int threadNum, bool force=false, char *ptr=NULL);
     double CorrectCorrNoise(RawImage *raw, int correctRows, int thumbnail, bool override=false,
@@ -37,6 +39,16 @@ public:
     		int thumbnail, bool overrride=false, bool verbose=false, int threadNum=-1,
     		int avg=0, int frame_mult=0);
 
+    // number of threads working on each image, 1 corrects on the calling thread
+    static void SetThreads(int numThreads);
+    static int GetThreads();
+
+    // seconds spent in each stage so far
+    double SumTime() const { return sumTime; }
+    double NNSubtractTime() const { return nnsubTime; }
+    double ApplyTime() const { return applyTime; }
+    double TotalTime() const { return totalTime; }
+
     CorrNoiseCorrector() {
       mCorr_sigs = NULL;
       mCorr_noise = NULL;
@@ -86,6 +98,7 @@ private:
     void smoothRowAvgs(float weight);
     void FixouterPixels();
     void ReZeroPinnedPixels_cpFirstFrame();
+    void SetUpBandJob(CorrBandJob &job);
 
     // list of allocated structures
     float *mCorr_sigs; // [cols*frames*4];
@@ -133,9 +146,6 @@ private:
 
     int NNSpan;
     int thumbnail;
-
-    static char *mAllocMem[MAX_RNC_THREADS];
-    static int   mAllocMemLen[MAX_RNC_THREADS];
 };
 
 #endif // CORRNOISECORRECTOR_H
@@ -0,0 +1,93 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+// DatLoadSpeed. Time to decode dat files the way Image::ActuallyLoadRaw does, on one
+// thread and on several, and a check that the images are identical.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deInterlace.h"
+#include "Utils.h"
+
+void PrintUsage()
+{
+  printf ("Usage: DatLoadSpeed threads [repeats=3] dat_file [dat_file ...]\n");
+  printf ("  Loads every dat file with 1 decode thread and with the given number of threads,\n");
+  printf ("  reports the average load time of each, and compares the images and timestamps.\n");
+}
+
+// Load fname repeats times, keeps the first image and returns seconds per load
+static double TimeLoads(char *fname, int repeats, short **image, int **timestamps,
+                        int &rows, int &cols, int &frames)
+{
+  int uncompFrames = 0;
+  double elapsed = 0.0;
+  for (int r = 0; r < repeats; ++r) {
+    short *out = NULL;
+    int *ts = NULL;
+    Timer timer;
+    if (!deInterlace_c (fname, &out, &ts, &rows, &cols, &frames, &uncompFrames,
+                        0, 0, 0, 0, 0, 0, 0, NULL)) {
+      printf ("DatLoadSpeed: failed to load %s\n", fname);
+      exit (EXIT_FAILURE);
+    }
+    elapsed += timer.elapsed();
+    if (r == 0) {
+      *image = out;
+      *timestamps = ts;
+    }
+    else {
+      free (out);
+      free (ts);
+    }
+  }
+  return elapsed / repeats;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  int threads = atoi (argv[1]);
+  int repeats = 3;
+  int first_file = 2;
+  if (argc > 3 and strspn (argv[2], "0123456789") == strlen (argv[2])) {
+    repeats = atoi (argv[2]);
+    first_file = 3;
+  }
+  if (threads <= 0 or repeats <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  printf ("  %-40s %16s %10s %10s %8s %10s\n", "file", "size", "1 thread", "threads", "speedup", "identical");
+  bool all_identical = true;
+  for (int f = first_file; f < argc; ++f) {
+    short *serial = NULL, *threaded = NULL;
+    int *serial_ts = NULL, *threaded_ts = NULL;
+    int rows = 0, cols = 0, frames = 0;
+
+    deInterlaceSetThreads (1);
+    double serial_time = TimeLoads (argv[f], repeats, &serial, &serial_ts, rows, cols, frames);
+    deInterlaceSetThreads (threads);
+    double threaded_time = TimeLoads (argv[f], repeats, &threaded, &threaded_ts, rows, cols, frames);
+
+    size_t num_values = (size_t)rows * cols * frames;
+    bool identical = memcmp (serial, threaded, num_values * sizeof(short)) == 0
+                     and memcmp (serial_ts, threaded_ts, frames * sizeof(int)) == 0;
+    all_identical = all_identical and identical;
+
+    char size[64];
+    snprintf (size, sizeof(size), "%dx%dx%d", rows, cols, frames);
+    printf ("  %-40s %16s %10.3f %10.3f %8.2f %10s\n", argv[f], size, serial_time, threaded_time,
+            serial_time / (threaded_time > 0 ? threaded_time : 1e-9), identical ? "yes" : "NO");
+    free (serial);
+    free (threaded);
+    free (serial_ts);
+    free (threaded_ts);
+  }
+  return all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
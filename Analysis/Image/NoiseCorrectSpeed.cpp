@@ -0,0 +1,126 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+// NoiseCorrectSpeed. Time spent in each stage of correlated (row and column) noise
+// correction and comparator noise correction of dat files, on one thread and on
+// several, and a check that the corrected images are identical.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deInterlace.h"
+#include "CorrNoiseCorrector.h"
+#include "ComparatorNoiseCorrector.h"
+#include "Utils.h"
+
+void PrintUsage()
+{
+  printf ("Usage: NoiseCorrectSpeed threads [repeats=3] dat_file [dat_file ...]\n");
+  printf ("  Corrects every dat file repeats times with 1 thread and with the given number of threads\n");
+  printf ("  per image, reports the average time of each stage, and compares the corrected images.\n");
+  printf ("  Row and column noise correction runs first, then aggressive comparator noise correction.\n");
+}
+
+enum Stage {
+  RNC_SUM, RNC_NNSUB, RNC_APPLY, RNC_TOTAL,
+  CNC_SUM, CNC_NNSUB, CNC_PCA, CNC_APPLY, CNC_TOTAL,
+  NUM_STAGES
+};
+
+const char *stage_names[NUM_STAGES] = {
+  "row/col sums", "row/col nn subtract", "row/col apply", "row/col total",
+  "comparator sums", "comparator nn subtract", "comparator pca", "comparator apply", "comparator total"
+};
+
+// Correct copies of raw repeats times, keeps the first corrected image and the seconds per image of each stage
+static void TimeCorrections(const short *raw, int rows, int cols, int frames, int threads, int repeats,
+                            short *corrected, double *times)
+{
+  size_t num_values = (size_t)rows * cols * frames;
+  short *image = (short *) malloc (num_values * sizeof(short));
+
+  CorrNoiseCorrector::SetThreads (threads);
+  ComparatorNoiseCorrector::SetThreads (threads);
+  memset (times, 0, NUM_STAGES * sizeof(double));
+  for (int r = 0; r < repeats; ++r) {
+    memcpy (image, raw, num_values * sizeof(short));
+
+    CorrNoiseCorrector rnc;
+    rnc.CorrectCorrNoise (image, rows, cols, frames, 3, 0, true, false, 0);
+    times[RNC_SUM] += rnc.SumTime();
+    times[RNC_NNSUB] += rnc.NNSubtractTime();
+    times[RNC_APPLY] += rnc.ApplyTime();
+    times[RNC_TOTAL] += rnc.TotalTime();
+
+    ComparatorNoiseCorrector cnc;
+    cnc.CorrectComparatorNoise (image, rows, cols, frames, NULL, false, true, false, 0);
+    times[CNC_SUM] += cnc.SumTime();
+    times[CNC_NNSUB] += cnc.NNSubtractTime();
+    times[CNC_PCA] += cnc.PrincCompTime();
+    times[CNC_APPLY] += cnc.ApplyTime();
+    times[CNC_TOTAL] += cnc.TotalTime();
+
+    if (r == 0)
+      memcpy (corrected, image, num_values * sizeof(short));
+  }
+  for (int stage = 0; stage < NUM_STAGES; ++stage)
+    times[stage] /= repeats;
+  free (image);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  int threads = atoi (argv[1]);
+  int repeats = 3;
+  int first_file = 2;
+  if (argc > 3 and strspn (argv[2], "0123456789") == strlen (argv[2])) {
+    repeats = atoi (argv[2]);
+    first_file = 3;
+  }
+  if (threads <= 0 or repeats <= 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  bool all_identical = true;
+  for (int f = first_file; f < argc; ++f) {
+    short *raw = NULL;
+    int *timestamps = NULL;
+    int rows = 0, cols = 0, frames = 0, uncompFrames = 0;
+    if (!deInterlace_c (argv[f], &raw, &timestamps, &rows, &cols, &frames, &uncompFrames,
+                        0, 0, 0, 0, 0, 0, 0, NULL)) {
+      printf ("NoiseCorrectSpeed: failed to load %s\n", argv[f]);
+      return EXIT_FAILURE;
+    }
+    if (cols % 8) {
+      printf ("NoiseCorrectSpeed: %s has %d columns, the correctors need a multiple of 8\n", argv[f], cols);
+      return EXIT_FAILURE;
+    }
+
+    size_t num_values = (size_t)rows * cols * frames;
+    short *serial = (short *) malloc (num_values * sizeof(short));
+    short *threaded = (short *) malloc (num_values * sizeof(short));
+    double serial_times[NUM_STAGES], threaded_times[NUM_STAGES];
+    TimeCorrections (raw, rows, cols, frames, 1, repeats, serial, serial_times);
+    TimeCorrections (raw, rows, cols, frames, threads, repeats, threaded, threaded_times);
+
+    bool identical = memcmp (serial, threaded, num_values * sizeof(short)) == 0;
+    all_identical = all_identical and identical;
+
+    printf ("  %s %dx%dx%d, identical %s\n", argv[f], rows, cols, frames, identical ? "yes" : "NO");
+    printf ("    %-22s %10s %10s %8s\n", "stage (sec/image)", "1 thread", "threads", "speedup");
+    for (int stage = 0; stage < NUM_STAGES; ++stage)
+      printf ("    %-22s %10.4f %10.4f %8.2f\n", stage_names[stage], serial_times[stage], threaded_times[stage],
+              serial_times[stage] / (threaded_times[stage] > 0 ? threaded_times[stage] : 1e-9));
+
+    free (serial);
+    free (threaded);
+    free (raw);
+    free (timestamps);
+  }
+  return all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,227 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <deque>
+
+#include "NoiseCorrectorThreads.h"
+
+AlignedScratchPool::AlignedScratchPool(size_t alignment)
+{
+	mAlignment = alignment;
+#ifndef WIN32
+	pthread_mutex_init(&mLock, NULL);
+#endif
+}
+
+AlignedScratchPool::~AlignedScratchPool()
+{
+	Trim();
+#ifndef WIN32
+	pthread_mutex_destroy(&mLock);
+#endif
+}
+
+char *AlignedScratchPool::Acquire(size_t len)
+{
+	Buffer buf;
+	buf.ptr = NULL;
+	buf.len = 0;
+
+#ifndef WIN32
+	pthread_mutex_lock(&mLock);
+#endif
+	// take the smallest idle buffer that is large enough
+	int best = -1;
+	for (size_t i = 0; i < mIdle.size(); i++)
+	{
+		if (mIdle[i].len >= len && (best < 0 || mIdle[i].len < mIdle[best].len))
+			best = i;
+	}
+	if (best < 0 && !mIdle.empty())
+	{
+		// none is, so replace the largest one rather than keep it around as well
+		best = 0;
+		for (size_t i = 1; i < mIdle.size(); i++)
+		{
+			if (mIdle[i].len > mIdle[best].len)
+				best = i;
+		}
+		free(mIdle[best].ptr);
+		mIdle[best].ptr = NULL;
+		mIdle[best].len = 0;
+	}
+	if (best >= 0)
+	{
+		buf = mIdle[best];
+		mIdle.erase(mIdle.begin() + best);
+	}
+#ifndef WIN32
+	pthread_mutex_unlock(&mLock);
+#endif
+
+	if (buf.ptr == NULL)
+	{
+		buf.ptr = (char *)memalign(mAlignment, len);
+		buf.len = len;
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&mLock);
+#endif
+	mBusy.push_back(buf);
+#ifndef WIN32
+	pthread_mutex_unlock(&mLock);
+#endif
+	return buf.ptr;
+}
+
+void AlignedScratchPool::Release(char *ptr)
+{
+	if (ptr == NULL)
+		return;
+#ifndef WIN32
+	pthread_mutex_lock(&mLock);
+#endif
+	for (size_t i = 0; i < mBusy.size(); i++)
+	{
+		if (mBusy[i].ptr == ptr)
+		{
+			mIdle.push_back(mBusy[i]);
+			mBusy.erase(mBusy.begin() + i);
+			ptr = NULL;
+			break;
+		}
+	}
+#ifndef WIN32
+	pthread_mutex_unlock(&mLock);
+#endif
+	if (ptr)
+		free(ptr);  // not one of ours
+}
+
+void AlignedScratchPool::Trim()
+{
+#ifndef WIN32
+	pthread_mutex_lock(&mLock);
+#endif
+	for (size_t i = 0; i < mIdle.size(); i++)
+		free(mIdle[i].ptr);
+	mIdle.clear();
+#ifndef WIN32
+	pthread_mutex_unlock(&mLock);
+#endif
+}
+
+#ifndef WIN32
+struct NoiseCorrectorBand {
+	NoiseCorrectorBandFunc func;
+	void *arg;
+	int start;
+	int end;
+	int *remaining;  // bands of the same call not finished yet
+};
+
+// Band workers are started on first use and kept for the life of the process. They are
+// shared by all the correctors running at the same time and take bands in call order.
+static pthread_mutex_t bandLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bandReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t bandDone = PTHREAD_COND_INITIALIZER;
+static std::deque<NoiseCorrectorBand *> bandQueue;
+static int bandWorkers = 0;
+
+// with bandLock held, runs the band with the lock released
+static void RunQueuedBand(NoiseCorrectorBand *band)
+{
+	pthread_mutex_unlock(&bandLock);
+	band->func(band->arg, band->start, band->end);
+	pthread_mutex_lock(&bandLock);
+	if (--(*band->remaining) == 0)
+		pthread_cond_broadcast(&bandDone);
+}
+
+static void *NoiseCorrectorBandWorker(void *arg)
+{
+	pthread_mutex_lock(&bandLock);
+	while (true)
+	{
+		while (bandQueue.empty())
+			pthread_cond_wait(&bandReady, &bandLock);
+		NoiseCorrectorBand *band = bandQueue.front();
+		bandQueue.pop_front();
+		RunQueuedBand(band);
+	}
+	pthread_mutex_unlock(&bandLock);
+	return NULL;
+}
+#endif
+
+void NoiseCorrectorRunBands(NoiseCorrectorBandFunc func, void *arg, int n, int unitWork, int numThreads, int granularity)
+{
+	if (granularity < 1)
+		granularity = 1;
+	int units = (n + granularity - 1) / granularity;
+	if (numThreads > units)
+		numThreads = units;
+	// handing a band to another thread only pays off for enough work
+	long long work = (long long)n * unitWork;
+	if (numThreads > work / NOISE_CORRECTOR_MIN_BAND_WORK)
+		numThreads = work / NOISE_CORRECTOR_MIN_BAND_WORK;
+#ifndef WIN32
+	if (numThreads > 1)
+	{
+		NoiseCorrectorBand bands[numThreads];
+		int remaining = numThreads - 1;
+		for (int t = 0; t < numThreads; t++)
+		{
+			bands[t].func = func;
+			bands[t].arg = arg;
+			bands[t].start = ((units * t) / numThreads) * granularity;
+			bands[t].end = ((units * (t + 1)) / numThreads) * granularity;
+			if (bands[t].end > n)
+				bands[t].end = n;
+			bands[t].remaining = &remaining;
+		}
+
+		pthread_mutex_lock(&bandLock);
+		while (bandWorkers < numThreads - 1)
+		{
+			pthread_t worker;
+			if (pthread_create(&worker, NULL, NoiseCorrectorBandWorker, NULL))
+				break;  // the bands still get done, by the workers there are or by this thread
+			pthread_detach(worker);
+			bandWorkers++;
+		}
+		for (int t = 1; t < numThreads; t++)
+			bandQueue.push_back(&bands[t]);
+		pthread_cond_broadcast(&bandReady);
+		pthread_mutex_unlock(&bandLock);
+
+		func(arg, bands[0].start, bands[0].end);
+
+		// take back the bands no worker has started on, then wait for the others
+		pthread_mutex_lock(&bandLock);
+		while (remaining > 0)
+		{
+			NoiseCorrectorBand *own = NULL;
+			for (std::deque<NoiseCorrectorBand *>::iterator it = bandQueue.begin(); it != bandQueue.end(); ++it)
+			{
+				if ((*it)->remaining == &remaining)
+				{
+					own = *it;
+					bandQueue.erase(it);
+					break;
+				}
+			}
+			if (own)
+				RunQueuedBand(own);
+			else
+				pthread_cond_wait(&bandDone, &bandLock);
+		}
+		pthread_mutex_unlock(&bandLock);
+		return;
+	}
+#endif
+	if (n > 0)
+		func(arg, 0, n);
+}
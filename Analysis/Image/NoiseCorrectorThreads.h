@@ -0,0 +1,57 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef NOISECORRECTORTHREADS_H
+#define NOISECORRECTORTHREADS_H
+
+#include <stddef.h>
+#include <vector>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+// Aligned scratch buffers shared by all the threads running a noise corrector.
+// A buffer is taken for one correction and handed back afterwards, so there are
+// only ever as many buffers as corrections running at the same time, whatever
+// the thread numbers of the callers are.
+class AlignedScratchPool
+{
+public:
+    AlignedScratchPool(size_t alignment);
+    ~AlignedScratchPool();
+
+    // a buffer of at least len bytes, reusing an idle one if it is large enough
+    char *Acquire(size_t len);
+    // hand a buffer from Acquire() back for reuse
+    void Release(char *ptr);
+    // free all the idle buffers
+    void Trim();
+
+private:
+    struct Buffer {
+      char  *ptr;
+      size_t len;
+    };
+
+    size_t mAlignment;
+    std::vector<Buffer> mIdle;
+    std::vector<Buffer> mBusy;
+#ifndef WIN32
+    pthread_mutex_t mLock;
+#endif
+};
+
+// Least work, in values touched, worth handing to another thread
+#define NOISE_CORRECTOR_MIN_BAND_WORK (1 << 16)
+
+// Splits [0,n) into contiguous bands that start on a multiple of granularity and
+// calls func(arg,start,end) once for each band.  Band 0 runs on the calling
+// thread and the others on a pool of band workers that lives as long as the
+// process, at most numThreads bands in all.  unitWork is the work of one of the
+// n units, and each band gets at least NOISE_CORRECTOR_MIN_BAND_WORK of it, so
+// small stages run on the calling thread alone.
+// Each band should only write its own part of the output, so the result doesn't
+// depend on the number of threads.
+typedef void (*NoiseCorrectorBandFunc)(void *arg, int start, int end);
+
+void NoiseCorrectorRunBands(NoiseCorrectorBandFunc func, void *arg, int n, int unitWork, int numThreads, int granularity=1);
+
+#endif // NOISECORRECTORTHREADS_H
@@ -17,6 +17,9 @@
 #include <pthread.h>
 #include <sys/mman.h>
 #include <unistd.h>  // for sysconf ()
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #define MY_FILE_HANDLE  int
 #else
 #include <windows.h>
@@ -698,6 +701,512 @@ void InterpolateFramesBeforeT0 ( int* regionalT0, short *out, int rows, int cols
 
 
 
+// unpack one group of 8 region deltas stored with state bits each.  returns 0 for an unknown state
+static inline int UnpackRegionGroup ( unsigned char *&CompPtr, unsigned int state, short *Val )
+{
+  switch ( state )
+  {
+    case 3:
+      // get 8 values
+      Val[0] = ( CompPtr[0] >> 5 ) & 0x7;
+      Val[1] = ( CompPtr[0] >> 2 ) & 0x7;
+      Val[2] = ( ( CompPtr[0] << 1 ) & 0x6 ) | ( ( CompPtr[1] >> 7 ) & 1 );
+      Val[3] = ( ( CompPtr[1] >> 4 ) & 0x7 );
+      Val[4] = ( ( CompPtr[1] >> 1 ) & 0x7 );
+      Val[5] = ( ( CompPtr[1] << 2 ) & 0x4 ) | ( ( CompPtr[2] >> 6 ) & 3 );
+      Val[6] = ( ( CompPtr[2] >> 3 ) & 0x7 );
+      Val[7] = ( ( CompPtr[2] ) & 0x7 );
+      CompPtr += 3;
+      break;
+
+    case 4:
+      Val[0] = ( CompPtr[0] >> 4 ) & 0xf;
+      Val[1] = ( CompPtr[0] ) & 0xf;
+      Val[2] = ( CompPtr[1] >> 4 ) & 0xf;
+      Val[3] = ( CompPtr[1] ) & 0xf;
+      Val[4] = ( CompPtr[2] >> 4 ) & 0xf;
+      Val[5] = ( CompPtr[2] ) & 0xf;
+      Val[6] = ( CompPtr[3] >> 4 ) & 0xf;
+      Val[7] = ( CompPtr[3] ) & 0xf;
+      CompPtr += 4;
+      break;
+
+    case 5:
+      Val[0] = ( CompPtr[0] >> 3 ) & 0x1f;
+      Val[1] = ( ( CompPtr[0] << 2 ) & 0x1c ) | ( ( CompPtr[1] >> 6 ) & 0x3 );
+      Val[2] = ( CompPtr[1] >> 1 ) & 0x1f;
+      Val[3] = ( ( CompPtr[1] << 4 ) & 0x10 ) | ( ( CompPtr[2] >> 4 ) & 0xf );
+      Val[4] = ( ( CompPtr[2] << 1 ) & 0x1e ) | ( ( CompPtr[3] >> 7 ) & 0x1 );
+      Val[5] = ( CompPtr[3] >> 2 ) & 0x1f;
+      Val[6] = ( ( CompPtr[3] << 3 ) & 0x18 ) | ( ( CompPtr[4] >> 5 ) & 0x7 );
+      Val[7] = ( CompPtr[4] ) & 0x1f;
+      CompPtr += 5;
+      break;
+
+    case 6:
+      Val[0] = ( CompPtr[0] >> 2 ) & 0x3f;
+      Val[1] = ( ( CompPtr[0] << 4 ) & 0x30 ) | ( ( CompPtr[1] >> 4 ) & 0xf );
+      Val[2] = ( ( CompPtr[1] << 2 ) & 0x3c ) | ( ( CompPtr[2] >> 6 ) & 0x3 );
+      Val[3] = ( CompPtr[2] & 0x3f );
+      Val[4] = ( CompPtr[3] >> 2 ) & 0x3f;
+      Val[5] = ( ( CompPtr[3] << 4 ) & 0x30 ) | ( ( CompPtr[4] >> 4 ) & 0xf );
+      Val[6] = ( ( CompPtr[4] << 2 ) & 0x3c ) | ( ( CompPtr[5] >> 6 ) & 0x3 );
+      Val[7] = ( CompPtr[5] & 0x3f );
+      CompPtr += 6;
+      break;
+
+    case 7:
+      Val[0] = ( CompPtr[0] >> 1 ) & 0x7f;
+      Val[1] = ( ( CompPtr[0] << 6 ) & 0x40 ) | ( ( CompPtr[1] >> 2 ) & 0x3f );
+      Val[2] = ( ( CompPtr[1] << 5 ) & 0x60 ) | ( ( CompPtr[2] >> 3 ) & 0x1f );
+      Val[3] = ( ( CompPtr[2] << 4 ) & 0x70 ) | ( ( CompPtr[3] >> 4 ) & 0x0f );
+      Val[4] = ( ( CompPtr[3] << 3 ) & 0x78 ) | ( ( CompPtr[4] >> 5 ) & 0x07 );
+      Val[5] = ( ( CompPtr[4] << 2 ) & 0x7c ) | ( ( CompPtr[5] >> 6 ) & 0x3 );
+      Val[6] = ( ( CompPtr[5] << 1 ) & 0x7e ) | ( ( CompPtr[6] >> 7 ) & 0x1 );
+      Val[7] = ( CompPtr[6] & 0x7f );
+      CompPtr += 7;
+      break;
+
+    case 8:
+      Val[0] = CompPtr[0];
+      Val[1] = CompPtr[1];
+      Val[2] = CompPtr[2];
+      Val[3] = CompPtr[3];
+      Val[4] = CompPtr[4];
+      Val[5] = CompPtr[5];
+      Val[6] = CompPtr[6];
+      Val[7] = CompPtr[7];
+      CompPtr += 8;
+      break;
+
+    case 16:
+      Val[0] = ( CompPtr[0] << 8 ) | CompPtr[1];
+      Val[1] = ( CompPtr[2] << 8 ) | CompPtr[3];
+      Val[2] = ( CompPtr[4] << 8 ) | CompPtr[5];
+      Val[3] = ( CompPtr[6] << 8 ) | CompPtr[7];
+      Val[4] = ( CompPtr[8] << 8 ) | CompPtr[9];
+      Val[5] = ( CompPtr[10] << 8 ) | CompPtr[11];
+      Val[6] = ( CompPtr[12] << 8 ) | CompPtr[13];
+      Val[7] = ( CompPtr[14] << 8 ) | CompPtr[15];
+      CompPtr += 16;
+      break;
+
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+#ifndef WIN32
+static int deInterlaceThreads = 1;
+
+void deInterlaceSetThreads ( int numThreads )
+{
+  deInterlaceThreads = ( numThreads > 1 ) ? numThreads : 1;
+  AdvCompr::SetUnCompressThreads ( deInterlaceThreads );
+}
+
+int deInterlaceGetThreads ()
+{
+  return deInterlaceThreads;
+}
+
+// sum of the bytes in buf, the same checksum GetFileData() keeps
+static uint64_t SumFileBytes ( const unsigned char *buf, size_t len )
+{
+  uint64_t sum = 0;
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i acc = _mm_setzero_si128();
+  __m128i zero = _mm_setzero_si128();
+  for ( ; i + 16 <= len; i += 16 )
+    acc = _mm_add_epi64 ( acc, _mm_sad_epu8 ( _mm_loadu_si128 ( ( const __m128i * ) ( buf + i ) ), zero ) );
+  uint64_t lanes[2];
+  _mm_storeu_si128 ( ( __m128i * ) lanes, acc );
+  sum = lanes[0] + lanes[1];
+#endif
+  for ( ; i < len; i++ )
+    sum += buf[i];
+  return sum;
+}
+
+// big endian 14 bit pixels to host order
+static void SwapAndMaskPixels ( const unsigned char *src, short *dst, int npix )
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i mask = _mm_set1_epi16 ( 0x3fff );
+  for ( ; i + 8 <= npix; i += 8 )
+  {
+    __m128i v = _mm_loadu_si128 ( ( const __m128i * ) ( src + 2*i ) );
+    v = _mm_or_si128 ( _mm_slli_epi16 ( v, 8 ), _mm_srli_epi16 ( v, 8 ) );
+    _mm_storeu_si128 ( ( __m128i * ) ( dst + i ), _mm_and_si128 ( v, mask ) );
+  }
+#endif
+  for ( ; i < npix; i++ )
+  {
+    unsigned short val;
+    memcpy ( &val, src + 2*i, 2 );
+    dst[i] = ( short ) ( BYTE_SWAP_2 ( val ) & 0x3fff );
+  }
+}
+
+// where each frame of a region compressed file lives in the mapped file
+typedef struct
+{
+  unsigned int Compressed;
+  unsigned int Transitions;     // from the frame header, compressed frames only
+  unsigned int total;
+  unsigned int offset;          // file offset of the frame data, for error messages
+  int len;
+  const unsigned char *data;    // raw pixels, or the region offsets followed by the regions
+} RegionFrameInfo;
+
+// one band of region rows, decoded through every frame
+typedef struct
+{
+  const RegionFrameInfo *frames;
+  int numFrames;
+  short *out;
+  int rows;
+  int cols;
+  int x_region_size;
+  int y_region_size;
+  uint32_t num_regions_x;
+  uint32_t y_reg_start;
+  uint32_t y_reg_end;
+  int *regionalT0;
+  int ignoreErrors;
+  unsigned int *total;          // per frame
+  unsigned int *Transitions;    // per frame
+  const unsigned char *cksumStart;
+  size_t cksumLen;
+  uint64_t cksum;
+} RegionBandJob;
+
+static void DecodeRegionBand ( RegionBandJob *job )
+{
+  int rows = job->rows;
+  int cols = job->cols;
+  int frameStride = rows * cols;
+  uint32_t num_regions_x = job->num_regions_x;
+  short Val[8] = {0};
+
+  job->cksum = SumFileBytes ( job->cksumStart, job->cksumLen );
+
+  int band_start = job->y_reg_start * job->y_region_size;
+  int band_end = job->y_reg_end * job->y_region_size;
+  if ( band_end > rows )
+    band_end = rows;
+
+  for ( int frame = 0; frame < job->numFrames; frame++ )
+  {
+    const RegionFrameInfo *info = &job->frames[frame];
+    unsigned short *frameOut = ( unsigned short * ) ( job->out + ( size_t ) frame * frameStride );
+    unsigned short *prevOut = frameOut - frameStride;
+
+    job->total[frame] = 0;
+    job->Transitions[frame] = 0;
+    if ( !info->Compressed )
+    {
+      SwapAndMaskPixels ( info->data + ( size_t ) band_start * cols * 2, ( short * ) frameOut + ( size_t ) band_start * cols,
+                          ( band_end - band_start ) * cols );
+      continue;
+    }
+
+    unsigned int total = 0;
+    unsigned int Transitions = 0;
+    for ( uint32_t y_reg = job->y_reg_start; y_reg < job->y_reg_end; y_reg++ )
+    {
+      for ( uint32_t x_reg = 0; x_reg < num_regions_x; x_reg++ )
+      {
+        int regionNum = y_reg * num_regions_x + x_reg;
+        uint32_t roff;
+        memcpy ( &roff, info->data + regionNum * 4, 4 );
+        roff = BYTE_SWAP_4 ( roff );
+
+        int nelems_x = job->x_region_size;
+        int nelems_y = job->y_region_size;
+        if ( ( int ) ( ( x_reg+1 ) * job->x_region_size ) > cols )
+          nelems_x = cols - x_reg * job->x_region_size;
+        if ( ( int ) ( ( y_reg+1 ) * job->y_region_size ) > rows )
+          nelems_y = rows - y_reg * job->y_region_size;
+        size_t regionStart = ( size_t ) y_reg * job->y_region_size * cols + x_reg * job->x_region_size;
+
+        if ( roff == 0xFFFFFFFF )
+        {
+          // nothing stored, the region didn't change
+          for ( int y = 0; y < nelems_y; y++ )
+            memcpy ( frameOut + regionStart + y * cols, prevOut + regionStart + y * cols, nelems_x * 2 );
+          continue;
+        }
+
+        if ( job->regionalT0[regionNum] == -1 )
+          job->regionalT0[regionNum] = ( frame == 1 ) ? -2 : frame;
+
+        unsigned char *CompPtr = ( unsigned char * ) info->data + roff - sizeof ( struct _expmt_hdr_cmp_frame ) + 8;
+        unsigned int state = 0; // first entry better be a state change
+        int leftShift = 0;
+        uint16_t RegionAverage = 0;
+        if ( info->Compressed >= 3 )
+        {
+          RegionAverage = CompPtr[0] << 8 | CompPtr[1];
+          CompPtr += 2;
+        }
+
+        for ( int y = 0; y < nelems_y; y++ )
+        {
+          unsigned short *WholeFrame = frameOut + regionStart + y * cols;
+          unsigned short *PrevWholeFrame = prevOut + regionStart + y * cols;
+          for ( int x = 0; x < nelems_x; x += 8 )
+          {
+            if ( CompPtr[0] == 0x7F )
+            {
+              if ( ( CompPtr[1] & 0x0f ) == KEY_16_1 )
+                state = 16;
+              else
+                state = CompPtr[1] & 0xf;
+              if ( info->Compressed >= 2 )
+                leftShift = ( ( CompPtr[1] >> 4 ) & 0xf );
+              else
+                leftShift = 0;
+              CompPtr += 2;
+              Transitions++;
+            }
+
+            if ( !UnpackRegionGroup ( CompPtr, state, Val ) )
+            {
+              printf ( "corrupt file\n" );
+              if ( !job->ignoreErrors )
+                exit ( 2 );
+            }
+
+            if ( state != 16 )
+            {
+              for ( int i = 0; i < 8; i++ )
+                Val[i] -= 1 << ( state-1 );
+            }
+            if ( leftShift )
+            {
+              for ( int i = 0; i < 8; i++ )
+                Val[i] <<= leftShift;
+            }
+            for ( int i = 0; i < 8; i++ )
+            {
+              Val[i] += PrevWholeFrame[i] + RegionAverage;
+              total += Val[i];
+              WholeFrame[i] = Val[i];
+            }
+            WholeFrame += 8;
+            PrevWholeFrame += 8;
+          }
+        }
+      }
+    }
+    job->total[frame] = total;
+    job->Transitions[frame] = Transitions;
+  }
+}
+
+static void *DecodeRegionBandThread ( void *arg )
+{
+  DecodeRegionBand ( ( RegionBandJob * ) arg );
+  return NULL;
+}
+
+// Whole image version of LoadCompressedRegionImage() that decodes bands of
+// region rows on deInterlaceThreads threads.  Regions only depend on the same
+// region of the previous frame, so the bands are independent.  The frame
+// headers are walked first, and the per frame totals and the file checksum are
+// added up from the bands and checked in frame order afterwards.  Returns -1
+// without touching out for anything it doesn't handle, including damaged files,
+// so the serial decoder can deal with them and report the errors as always.
+static int LoadCompressedRegionImageThreaded ( DeCompFile *fd, short *out, int rows, int cols, int totalFrames,
+    int end_frame, int *timestamps, int x_region_size, int y_region_size,
+    unsigned int offset, int ignoreErrors )
+{
+  uint32_t num_regions_x = cols/x_region_size;
+  uint32_t num_regions_y = rows/y_region_size;
+  if ( cols%x_region_size )
+    num_regions_x++;
+  if ( rows%y_region_size )
+    num_regions_y++;
+  int numRegions = num_regions_x*num_regions_y;
+
+  // groups of 8 pixels must not run past a region into a neighboring band
+  if ( ( x_region_size % 8 ) || ( cols % 8 ) || num_regions_y < 2 || fd->fileLen <= 0 )
+    return -1;
+
+  unsigned char *fileData = ( unsigned char * ) mmap ( 0, fd->fileLen, PROT_READ, MAP_PRIVATE, fd->hFile, 0 );
+  if ( fileData == MAP_FAILED )
+    return -1;
+
+  int numFrames = end_frame + 1;
+  RegionFrameInfo *frames = ( RegionFrameInfo * ) malloc ( numFrames * sizeof ( RegionFrameInfo ) );
+  int ok = 1;
+  for ( int frame = 0; frame < numFrames && ok; frame++ )
+  {
+    RegionFrameInfo *info = &frames[frame];
+    unsigned int hdr[6];
+    if ( ( size_t ) offset + 8 > ( size_t ) fd->fileLen )
+    {
+      ok = 0;
+      break;
+    }
+    memcpy ( hdr, fileData + offset, 8 );
+    if ( timestamps )
+      timestamps[frame] = BYTE_SWAP_4 ( hdr[0] );
+    info->Compressed = BYTE_SWAP_4 ( hdr[1] );
+    offset += 8;
+
+    if ( !info->Compressed )
+    {
+      // the first frame is the reference for the rest
+      info->len = rows*cols*2;
+      ok = ( size_t ) offset + info->len <= ( size_t ) fd->fileLen;
+    }
+    else
+    {
+      int hlen = sizeof ( struct _expmt_hdr_cmp_frame ) - 8;
+      ok = frame > 0 && ( size_t ) offset + hlen <= ( size_t ) fd->fileLen;
+      if ( !ok )
+        break;
+      memcpy ( &hdr[2], fileData + offset, hlen );
+      unsigned int len = BYTE_SWAP_4 ( hdr[2] );
+      info->Transitions = BYTE_SWAP_4 ( hdr[3] );
+      info->total = BYTE_SWAP_4 ( hdr[4] );
+      offset += hlen;
+      info->len = len - sizeof ( struct _expmt_hdr_cmp_frame ) + 8;
+      ok = BYTE_SWAP_4 ( hdr[5] ) == PLACEKEY && info->len >= numRegions*4
+           && ( size_t ) offset + info->len <= ( size_t ) fd->fileLen;
+      for ( int reg = 0; ok && reg < numRegions; reg++ )
+      {
+        uint32_t roff;
+        memcpy ( &roff, fileData + offset + reg*4, 4 );
+        roff = BYTE_SWAP_4 ( roff );
+        if ( roff != 0xFFFFFFFF )
+          ok = roff >= sizeof ( struct _expmt_hdr_cmp_frame ) - 8 && roff - ( sizeof ( struct _expmt_hdr_cmp_frame ) - 8 ) < ( unsigned int ) info->len;
+      }
+    }
+    info->offset = offset;
+    info->data = fileData + offset;
+    offset += info->len;
+  }
+  if ( !ok || frames[0].Compressed )
+  {
+    free ( frames );
+    munmap ( fileData, fd->fileLen );
+    return -1;
+  }
+
+  int *regionalT0 = ( int * ) malloc ( numRegions*sizeof ( int ) );
+  for ( int reg=0; reg < numRegions; ++reg )
+    regionalT0[reg] = -1;
+
+  int numThreads = deInterlaceThreads;
+  if ( numThreads > ( int ) num_regions_y )
+    numThreads = num_regions_y;
+  RegionBandJob *jobs = ( RegionBandJob * ) malloc ( numThreads * sizeof ( RegionBandJob ) );
+  unsigned int *counts = ( unsigned int * ) malloc ( 2 * numThreads * numFrames * sizeof ( unsigned int ) );
+  for ( int t = 0; t < numThreads; t++ )
+  {
+    RegionBandJob *job = &jobs[t];
+    job->frames = frames;
+    job->numFrames = numFrames;
+    job->out = out;
+    job->rows = rows;
+    job->cols = cols;
+    job->x_region_size = x_region_size;
+    job->y_region_size = y_region_size;
+    job->num_regions_x = num_regions_x;
+    job->y_reg_start = ( num_regions_y * t ) / numThreads;
+    job->y_reg_end = ( num_regions_y * ( t+1 ) ) / numThreads;
+    job->regionalT0 = regionalT0;
+    job->ignoreErrors = ignoreErrors;
+    job->total = counts + 2 * t * numFrames;
+    job->Transitions = job->total + numFrames;
+    size_t cksumBegin = ( ( size_t ) offset * t ) / numThreads;
+    job->cksumStart = fileData + cksumBegin;
+    job->cksumLen = ( ( size_t ) offset * ( t+1 ) ) / numThreads - cksumBegin;
+  }
+
+  pthread_t *threads = ( pthread_t * ) malloc ( numThreads * sizeof ( pthread_t ) );
+  int started = 1;
+  for ( int t = 1; t < numThreads; t++, started++ )
+  {
+    if ( pthread_create ( &threads[t], NULL, DecodeRegionBandThread, &jobs[t] ) )
+      break;
+  }
+  DecodeRegionBand ( &jobs[0] );
+  for ( int t = started; t < numThreads; t++ )
+    DecodeRegionBand ( &jobs[t] );  // couldn't start a thread for it
+  for ( int t = 1; t < started; t++ )
+    pthread_join ( threads[t], NULL );
+  free ( threads );
+
+  unsigned int cksum = 0;
+  for ( int t = 0; t < numThreads; t++ )
+    cksum += ( unsigned int ) jobs[t].cksum;
+
+  for ( int frame = 1; frame < numFrames; frame++ )
+  {
+    if ( !frames[frame].Compressed )
+      continue;
+    unsigned int total = 0;
+    unsigned int Transitions = 0;
+    for ( int t = 0; t < numThreads; t++ )
+    {
+      total += jobs[t].total[frame];
+      Transitions += jobs[t].Transitions[frame];
+    }
+    if ( Transitions != frames[frame].Transitions )
+    {
+      printf ( "transitions don't match %x %x!!\n",Transitions,frames[frame].Transitions );
+      printf ( "corrupt file\n" );
+      if ( !ignoreErrors )
+        exit ( 2 );
+    }
+    if ( total != frames[frame].total )
+    {
+      printf ( "totals don't match!! %x %x %d\n",total,frames[frame].total,frames[frame].offset + frames[frame].len );
+      printf ( "corrupt file\n" );
+      if ( !ignoreErrors )
+        exit ( 2 );
+    }
+  }
+
+  // only interpolate for full time histories as the checks aren't sufficient for sub-sets
+  if ( ( totalFrames-1 ) == end_frame )
+    InterpolateFramesBeforeT0 ( regionalT0, out, rows, cols, 0, end_frame,
+                                0, 0, cols, rows, x_region_size, y_region_size, timestamps );
+
+  // try to get a checksum at the end of the file...
+  if ( ( end_frame >= ( totalFrames-1 ) ) && ( ( size_t ) offset + 4 <= ( size_t ) fd->fileLen ) )
+  {
+    unsigned char *cksmPtr = fileData + offset;
+    unsigned int tmpcksum = cksmPtr[3];
+    tmpcksum |= cksmPtr[2] << 8;
+    tmpcksum |= cksmPtr[1] << 16;
+    tmpcksum |= cksmPtr[0] << 24;
+    if ( tmpcksum != cksum )
+    {
+      printf ( "checksums don't match %x %x %x-%x-%x-%x\n",cksum,tmpcksum,cksmPtr[0],cksmPtr[1],cksmPtr[2],cksmPtr[3] );
+      printf ( "corrupt file\n" );
+      if ( !ignoreErrors )
+        exit ( 2 );
+    }
+  }
+
+  free ( counts );
+  free ( jobs );
+  free ( regionalT0 );
+  free ( frames );
+  munmap ( fileData, fd->fileLen );
+  CloseFile ( fd );
+  return 1;
+}
+#endif
+
 // inputs:
 //        fd:  input file descriptor
 //        out:  array of unsigned short pixel values (three-dimensional   frames:rows:cols
@@ -711,6 +1220,16 @@ int LoadCompressedRegionImage ( DeCompFile *fd, short *out, int rows, int cols,
                                 int x_region_size, int y_region_size, unsigned int offset, int ignoreErrors )
 
 {
+#if !defined(WIN32) && !defined(DEBUG)
+  if ( ( deInterlaceThreads > 1 ) && ( start_frame == 0 ) && ( mincols == 0 ) && ( minrows == 0 ) &&
+       ( maxcols == cols ) && ( maxrows == rows ) )
+  {
+    int rc = LoadCompressedRegionImageThreaded ( fd, out, rows, cols, totalFrames, end_frame, timestamps,
+             x_region_size, y_region_size, offset, ignoreErrors );
+    if ( rc >= 0 )
+      return rc;
+  }
+#endif
   int frameStride = rows * cols;
   short *imagePtr = ( short * ) out;
   unsigned char *CompPtr,*StartCompPtr;
@@ -1046,103 +1565,12 @@ int LoadCompressedRegionImage ( DeCompFile *fd, short *out, int rows, int cols,
               Transitions++;
             }
 
-            switch ( state )
+            if ( !UnpackRegionGroup ( CompPtr, state, Val ) )
             {
-              case 3:
-                // get 8 values
-                Val[0] = ( CompPtr[0] >> 5 ) & 0x7;
-                Val[1] = ( CompPtr[0] >> 2 ) & 0x7;
-                Val[2] = ( ( CompPtr[0] << 1 ) & 0x6 ) | ( ( CompPtr[1] >> 7 ) & 1 );
-                Val[3] = ( ( CompPtr[1] >> 4 ) & 0x7 );
-                Val[4] = ( ( CompPtr[1] >> 1 ) & 0x7 );
-                Val[5] = ( ( CompPtr[1] << 2 ) & 0x4 ) | ( ( CompPtr[2] >> 6 ) & 3 );
-                Val[6] = ( ( CompPtr[2] >> 3 ) & 0x7 );
-                Val[7] = ( ( CompPtr[2] ) & 0x7 );
-                CompPtr += 3;
-                break;
-
-              case 4:
-                Val[0] = ( CompPtr[0] >> 4 ) & 0xf;
-                Val[1] = ( CompPtr[0] ) & 0xf;
-                Val[2] = ( CompPtr[1] >> 4 ) & 0xf;
-                Val[3] = ( CompPtr[1] ) & 0xf;
-                Val[4] = ( CompPtr[2] >> 4 ) & 0xf;
-                Val[5] = ( CompPtr[2] ) & 0xf;
-                Val[6] = ( CompPtr[3] >> 4 ) & 0xf;
-                Val[7] = ( CompPtr[3] ) & 0xf;
-                CompPtr += 4;
-                break;
-
-              case 5:
-                Val[0] = ( CompPtr[0] >> 3 ) & 0x1f;
-                Val[1] = ( ( CompPtr[0] << 2 ) & 0x1c ) | ( ( CompPtr[1] >> 6 ) & 0x3 );
-                Val[2] = ( CompPtr[1] >> 1 ) & 0x1f;
-                Val[3] = ( ( CompPtr[1] << 4 ) & 0x10 ) | ( ( CompPtr[2] >> 4 ) & 0xf );
-                Val[4] = ( ( CompPtr[2] << 1 ) & 0x1e ) | ( ( CompPtr[3] >> 7 ) & 0x1 );
-                Val[5] = ( CompPtr[3] >> 2 ) & 0x1f;
-                Val[6] = ( ( CompPtr[3] << 3 ) & 0x18 ) | ( ( CompPtr[4] >> 5 ) & 0x7 );
-                Val[7] = ( CompPtr[4] ) & 0x1f;
-                CompPtr += 5;
-                break;
-
-              case 6:
-                Val[0] = ( CompPtr[0] >> 2 ) & 0x3f;
-                Val[1] = ( ( CompPtr[0] << 4 ) & 0x30 ) | ( ( CompPtr[1] >> 4 ) & 0xf );
-                Val[2] = ( ( CompPtr[1] << 2 ) & 0x3c ) | ( ( CompPtr[2] >> 6 ) & 0x3 );
-                Val[3] = ( CompPtr[2] & 0x3f );
-                Val[4] = ( CompPtr[3] >> 2 ) & 0x3f;
-                Val[5] = ( ( CompPtr[3] << 4 ) & 0x30 ) | ( ( CompPtr[4] >> 4 ) & 0xf );
-                Val[6] = ( ( CompPtr[4] << 2 ) & 0x3c ) | ( ( CompPtr[5] >> 6 ) & 0x3 );
-                Val[7] = ( CompPtr[5] & 0x3f );
-                CompPtr += 6;
-                break;
-
-
-              case 7:
-                Val[0] = ( CompPtr[0] >> 1 ) & 0x7f;
-                Val[1] = ( ( CompPtr[0] << 6 ) & 0x40 ) | ( ( CompPtr[1] >> 2 ) & 0x3f );
-                Val[2] = ( ( CompPtr[1] << 5 ) & 0x60 ) | ( ( CompPtr[2] >> 3 ) & 0x1f );
-                Val[3] = ( ( CompPtr[2] << 4 ) & 0x70 ) | ( ( CompPtr[3] >> 4 ) & 0x0f );
-                Val[4] = ( ( CompPtr[3] << 3 ) & 0x78 ) | ( ( CompPtr[4] >> 5 ) & 0x07 );
-                Val[5] = ( ( CompPtr[4] << 2 ) & 0x7c ) | ( ( CompPtr[5] >> 6 ) & 0x3 );
-                Val[6] = ( ( CompPtr[5] << 1 ) & 0x7e ) | ( ( CompPtr[6] >> 7 ) & 0x1 );
-                Val[7] = ( CompPtr[6] & 0x7f );
-                CompPtr += 7;
-                break;
-
-              case 8:
-                Val[0] = CompPtr[0];
-                Val[1] = CompPtr[1];
-                Val[2] = CompPtr[2];
-                Val[3] = CompPtr[3];
-                Val[4] = CompPtr[4];
-                Val[5] = CompPtr[5];
-                Val[6] = CompPtr[6];
-                Val[7] = CompPtr[7];
-                CompPtr += 8;
-                break;
-
-              case 16:
-                Val[0] = ( CompPtr[0] << 8 ) | CompPtr[1];
-                Val[1] = ( CompPtr[2] << 8 ) | CompPtr[3];
-                Val[2] = ( CompPtr[4] << 8 ) | CompPtr[5];
-                Val[3] = ( CompPtr[6] << 8 ) | CompPtr[7];
-                Val[4] = ( CompPtr[8] << 8 ) | CompPtr[9];
-                Val[5] = ( CompPtr[10] << 8 ) | CompPtr[11];
-                Val[6] = ( CompPtr[12] << 8 ) | CompPtr[13];
-                Val[7] = ( CompPtr[14] << 8 ) | CompPtr[15];
-                CompPtr += 16;
-                break;
-
-              default:
-              {
-                printf ( "corrupt file\n" );
-                __debugbreak();
-                if ( !ignoreErrors )
-                  exit ( 2 );
-              }
-              break;
-
+              printf ( "corrupt file\n" );
+              __debugbreak();
+              if ( !ignoreErrors )
+                exit ( 2 );
             }
 
 //      groupCksum = *CompPtr++;
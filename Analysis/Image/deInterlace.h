@@ -66,5 +66,11 @@ extern "C" int __declspec(dllexport) deInterlaceUncomp(
 #endif
         short *_out, int *_timestamps, int frames, int uncFrames, int stride, short *outUncomp, int *timestampsUncomp);
 
+#ifndef WIN32
+// number of threads used to decode a single dat file, 1 decodes on the calling thread
+void deInterlaceSetThreads ( int numThreads );
+int deInterlaceGetThreads ();
+#endif
+
 
 #endif // DEINTERLACE_H
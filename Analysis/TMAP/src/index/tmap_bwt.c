@@ -385,6 +385,8 @@ tmap_bwt_destroy(tmap_bwt_t *bwt)
   if(1 == bwt->is_shm) {
       free(bwt->hash_k);
       free(bwt->hash_l);
+      free(bwt->occ_lines);
+      free(bwt->occ_lines_super);
       free(bwt);
   }
   else {
@@ -402,6 +404,8 @@ tmap_bwt_destroy(tmap_bwt_t *bwt)
       }
       free(bwt->hash_k);
       free(bwt->hash_l);
+      free(bwt->occ_lines);
+      free(bwt->occ_lines_super);
       // close and unmmap the file...
       if(bwt->mmap_fp)
     	  tmap_file_fclose((  tmap_file_t *)bwt->mmap_fp);
@@ -680,6 +684,103 @@ __occ_aux16(uint32_t y, int c)
   return (((y + (y >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24; // count
 }
 
+#define __occ_aux4(bwt, b)											\
+  ((bwt)->cnt_table[(b)&0xff] + (bwt)->cnt_table[(b)>>8&0xff]		\
+   + (bwt)->cnt_table[(b)>>16&0xff] + (bwt)->cnt_table[(b)>>24&0xff])
+
+//NB: to avoid overflow if the interval is large
+static inline void
+__occ_aux4_alt(const tmap_bwt_t *bwt, uint32_t b, tmap_bwt_int_t cnt[4]) 
+{
+  uint32_t y = __occ_aux4(bwt, b);
+  cnt[0] += y&0xff; cnt[1] += y>>8&0xff; cnt[2] += y>>16&0xff; cnt[3] += y>>24&0xff;
+}
+
+#define __occ_aux8(bwt, b)											\
+  ((bwt)->cnt_table[(b)&0xff] + (bwt)->cnt_table[(b)>>8&0xff]		\
+   + (bwt)->cnt_table[(b)>>16&0xff] + (bwt)->cnt_table[(b)>>24&0xff] \
+   + (bwt)->cnt_table[(b)>>32&0xff] + (bwt)->cnt_table[(b)>>40&0xff] \
+   + (bwt)->cnt_table[(b)>>48&0xff] + (bwt)->cnt_table[(b)>>56]) 
+
+//NB: to avoid overflow if the interval is large
+static inline void
+__occ_aux8_alt(const tmap_bwt_t *bwt, uint64_t b, tmap_bwt_int_t cnt[4])
+{
+  uint32_t y = __occ_aux8(bwt, b);
+  cnt[0] += y&0xff; cnt[1] += y>>8&0xff; cnt[2] += y>>16&0xff; cnt[3] += y>>24&0xff;
+}
+
+/**
+ * Occurrence lines
+ */
+
+// the number of set bits when at most one of every two bits is set
+static inline uint32_t
+tmap_bwt_line_pop(uint64_t y)
+{
+#ifdef __POPCNT__
+  return __builtin_popcountll(y);
+#else
+  y = (y & 0x3333333333333333ull) + (y >> 2 & 0x3333333333333333ull);
+  return ((y + (y >> 4)) & 0xf0f0f0f0f0f0f0full) * 0x101010101010101ull >> 56;
+#endif
+}
+
+// the bases of the line in words [0, r>>5], up to and including base r
+#define __line_mask(r) (~0ull << ((~(r)&31)<<1))
+
+static inline tmap_bwt_int_t
+tmap_bwt_line_occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k, uint8_t c)
+{
+  tmap_bwt_int_t i = k / TMAP_BWT_LINE_BASES;
+  const tmap_bwt_line_t *p = bwt->occ_lines + i;
+  uint32_t r = k - i * TMAP_BWT_LINE_BASES, w = r >> 5, j, n = 0;
+  uint64_t y, m = 0x5555555555555555ull;
+  for(j = 0; j <= w; j++) {
+      y = p->bits[j];
+      if(j == w) m &= __line_mask(r);
+      n += tmap_bwt_line_pop(((c&2)? y : ~y) >> 1 & ((c&1)? y : ~y) & m);
+  }
+  return bwt->occ_lines_super[(i >> TMAP_BWT_LINE_SUPER_LOG2 << 2) + c] + p->cnt[c] + n;
+}
+
+static inline void
+tmap_bwt_line_occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t cnt[4])
+{
+  tmap_bwt_int_t i = k / TMAP_BWT_LINE_BASES;
+  const tmap_bwt_line_t *p = bwt->occ_lines + i;
+  const tmap_bwt_int_t *s = bwt->occ_lines_super + (i >> TMAP_BWT_LINE_SUPER_LOG2 << 2);
+  uint32_t r = k - i * TMAP_BWT_LINE_BASES, w = r >> 5, j;
+#ifdef __POPCNT__
+  uint32_t n1 = 0, n2 = 0, n3 = 0;
+  uint64_t y, hi, lo;
+  for(j = 0; j <= w; j++) {
+      y = p->bits[j];
+      if(j == w) y &= __line_mask(r); // masked bases count as A
+      hi = y >> 1 & 0x5555555555555555ull;
+      lo = y & 0x5555555555555555ull;
+      n1 += tmap_bwt_line_pop(lo & ~hi);
+      n2 += tmap_bwt_line_pop(hi & ~lo);
+      n3 += tmap_bwt_line_pop(hi & lo);
+  }
+  cnt[0] = s[0] + p->cnt[0] + (r + 1 - n1 - n2 - n3);
+  cnt[1] = s[1] + p->cnt[1] + n1;
+  cnt[2] = s[2] + p->cnt[2] + n2;
+  cnt[3] = s[3] + p->cnt[3] + n3;
+#else
+  // a line has fewer than 256 bases, so the counts of all its words fit in one uint32_t
+  uint32_t x = 0;
+  for(j = 0; j < w; j++) {
+      x += __occ_aux8(bwt, p->bits[j]);
+  }
+  x += __occ_aux8(bwt, p->bits[w] & __line_mask(r)) - (~r&31);
+  cnt[0] = s[0] + p->cnt[0] + (x&0xff);
+  cnt[1] = s[1] + p->cnt[1] + (x>>8&0xff);
+  cnt[2] = s[2] + p->cnt[2] + (x>>16&0xff);
+  cnt[3] = s[3] + p->cnt[3] + (x>>24);
+#endif
+}
+
 tmap_bwt_int_t
 tmap_bwt_occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k, uint8_t c)
 {
@@ -689,6 +790,7 @@ tmap_bwt_occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k, uint8_t c)
   if(k == bwt->seq_len) return bwt->L2[c+1] - bwt->L2[c];
   if(TMAP_BWT_INT_MAX == k) return 0;
   if(k >= bwt->primary) --k; // because $ is not in bwt
+  if(NULL != bwt->occ_lines) return tmap_bwt_line_occ(bwt, k, c);
 
   // retrieve Occ at k/bwt->occ_interval
   n = ((tmap_bwt_int_t*)(p = tmap_bwt_occ_intv(bwt, k)))[c];
@@ -727,7 +829,7 @@ tmap_bwt_2occ_orig(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, ui
   }
   _k = (k >= bwt->primary)? k-1 : k;
   _l = (l >= bwt->primary)? l-1 : l;
-  if((_l >> bwt->occ_interval_log2) != (_k >> bwt->occ_interval_log2) || TMAP_BWT_INT_MAX == k || TMAP_BWT_INT_MAX == l) {
+  if(NULL != bwt->occ_lines || (_l >> bwt->occ_interval_log2) != (_k >> bwt->occ_interval_log2) || TMAP_BWT_INT_MAX == k || TMAP_BWT_INT_MAX == l) {
       if(l == TMAP_BWT_INT_MAX) k = TMAP_BWT_INT_MAX; 
       *ok = tmap_bwt_occ(bwt, k, c);
       *ol = tmap_bwt_occ(bwt, l, c);
@@ -837,30 +939,41 @@ tmap_bwt_2occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, uint8_t
 #endif
 }
 
-#define __occ_aux4(bwt, b)											\
-  ((bwt)->cnt_table[(b)&0xff] + (bwt)->cnt_table[(b)>>8&0xff]		\
-   + (bwt)->cnt_table[(b)>>16&0xff] + (bwt)->cnt_table[(b)>>24&0xff])
-
-//NB: to avoid overflow if the interval is large
-static inline void
-__occ_aux4_alt(const tmap_bwt_t *bwt, uint32_t b, tmap_bwt_int_t cnt[4]) 
+void
+tmap_bwt_gen_occ_lines(tmap_bwt_t *bwt)
 {
-  uint32_t y = __occ_aux4(bwt, b);
-  cnt[0] += y&0xff; cnt[1] += y>>8&0xff; cnt[2] += y>>16&0xff; cnt[3] += y>>24&0xff;
-}
-
-#define __occ_aux8(bwt, b)											\
-  ((bwt)->cnt_table[(b)&0xff] + (bwt)->cnt_table[(b)>>8&0xff]		\
-   + (bwt)->cnt_table[(b)>>16&0xff] + (bwt)->cnt_table[(b)>>24&0xff] \
-   + (bwt)->cnt_table[(b)>>32&0xff] + (bwt)->cnt_table[(b)>>40&0xff] \
-   + (bwt)->cnt_table[(b)>>48&0xff] + (bwt)->cnt_table[(b)>>56]) 
+  tmap_bwt_int_t i, n_lines, n_super, cnt[4] = {0, 0, 0, 0};
+  tmap_bwt_int_t *super = NULL;
+  tmap_bwt_line_t *p = NULL;
+  uint32_t r, x;
+
+  if(NULL != bwt->occ_lines) return;
+
+  n_lines = bwt->seq_len / TMAP_BWT_LINE_BASES + 1;
+  n_super = (n_lines >> TMAP_BWT_LINE_SUPER_LOG2) + 1;
+  bwt->occ_lines = tmap_memalign(64, n_lines * sizeof(tmap_bwt_line_t), "bwt->occ_lines");
+  bwt->occ_lines_super = tmap_calloc(4 * n_super, sizeof(tmap_bwt_int_t), "bwt->occ_lines_super");
+  memset(bwt->occ_lines, 0, n_lines * sizeof(tmap_bwt_line_t));
+
+  // copy the bwt sixteen bases at a time, the padding of the last word is never counted
+  for(i = 0, p = bwt->occ_lines - 1; i < bwt->seq_len; i += 16) {
+      r = i % TMAP_BWT_LINE_BASES;
+      if(0 == r) {
+          p++;
+          if(0 == ((p - bwt->occ_lines) & ((1 << TMAP_BWT_LINE_SUPER_LOG2) - 1))) {
+              super = bwt->occ_lines_super + ((p - bwt->occ_lines) >> TMAP_BWT_LINE_SUPER_LOG2 << 2);
+              memcpy(super, cnt, 4 * sizeof(tmap_bwt_int_t));
+          }
+          p->cnt[0] = cnt[0] - super[0]; p->cnt[1] = cnt[1] - super[1];
+          p->cnt[2] = cnt[2] - super[2]; p->cnt[3] = cnt[3] - super[3];
+      }
+      x = tmap_bwt_get_bwt16(bwt, i);
+      p->bits[r >> 5] |= (uint64_t)x << ((r & 16) ? 0 : 32);
+      x = __occ_aux4(bwt, x);
+      cnt[0] += x&0xff; cnt[1] += x>>8&0xff; cnt[2] += x>>16&0xff; cnt[3] += x>>24&0xff;
+  }
 
-//NB: to avoid overflow if the interval is large
-static inline void
-__occ_aux8_alt(const tmap_bwt_t *bwt, uint64_t b, tmap_bwt_int_t cnt[4])
-{
-  uint32_t y = __occ_aux8(bwt, b);
-  cnt[0] += y&0xff; cnt[1] += y>>8&0xff; cnt[2] += y>>16&0xff; cnt[3] += y>>24&0xff;
+  tmap_progress_print2("generated %llu occurrence lines", (unsigned long long int)n_lines);
 }
 
 void
@@ -873,6 +986,10 @@ tmap_bwt_occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t cnt[4])
       return;
   }
   if(k >= bwt->primary) --k; // because $ is not in bwt
+  if(NULL != bwt->occ_lines) {
+      tmap_bwt_line_occ4(bwt, k, cnt);
+      return;
+  }
   p = tmap_bwt_occ_intv(bwt, k);
   memcpy(cnt, p, 4 * sizeof(tmap_bwt_int_t));
   p += sizeof(tmap_bwt_int_t); // move to the first bwt cell
@@ -908,7 +1025,7 @@ tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_b
   }
   _k = (k >= bwt->primary)? k-1 : k;
   _l = (l >= bwt->primary)? l-1 : l;
-  if((_l >> bwt->occ_interval_log2) != (_k >> bwt->occ_interval_log2) || TMAP_BWT_INT_MAX == k || TMAP_BWT_INT_MAX == l) {
+  if(NULL != bwt->occ_lines || (_l >> bwt->occ_interval_log2) != (_k >> bwt->occ_interval_log2) || TMAP_BWT_INT_MAX == k || TMAP_BWT_INT_MAX == l) {
       if(l == TMAP_BWT_INT_MAX) k = TMAP_BWT_INT_MAX; 
       tmap_bwt_occ4(bwt, k, cntk);
       tmap_bwt_occ4(bwt, l, cntl);
@@ -960,6 +1077,20 @@ tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_b
   }
 }
 
+void
+tmap_bwt_2occ4_batch(const tmap_bwt_t *bwt, int32_t n, const tmap_bwt_int_t *k, const tmap_bwt_int_t *l, 
+                     tmap_bwt_int_t (*cntk)[4], tmap_bwt_int_t (*cntl)[4])
+{
+  int32_t i;
+  for(i = 0; i < n; i++) {
+      tmap_bwt_prefetch_occ(bwt, k[i]);
+      tmap_bwt_prefetch_occ(bwt, l[i]);
+  }
+  for(i = 0; i < n; i++) {
+      tmap_bwt_2occ4(bwt, k[i], l[i], cntk[i], cntl[i]);
+  }
+}
+
 int
 tmap_bwt_pac2bwt_main(int argc, char *argv[])
 {
@@ -56,6 +56,26 @@ typedef uint8_t ubyte_t;
 #define TMAP_BWT_HASH_WIDTH_AUTO_MIN 8
 #define TMAP_BWT_HASH_WIDTH_AUTO_MAX 12
 
+/*! 
+  the number of bases in one line of the occurrence lines
+  */
+#define TMAP_BWT_LINE_BASES 192
+/*! 
+  log2 of the number of lines in one super block of the occurrence lines
+  @details  the line counts are relative to their super block, which must hold fewer than 2^32 bases
+  */
+#define TMAP_BWT_LINE_SUPER_LOG2 22
+
+/*! 
+  one cache line of the occurrence lines
+  @details  the counts are those before the first base of the line, relative to the super block,
+  and the bases are two bits each with the first base in the highest bits of the first word
+  */
+typedef struct {
+    uint32_t cnt[4];  /*!< the occurrences of each base before this line, relative to the super block */
+    uint64_t bits[6];  /*!< the bases of this line, 32 per word */
+} tmap_bwt_line_t;
+
 // NB: we do not need a multi-level hash, just the highest-level hash.  We can
 // simulate the others from this one...
 /*! 
@@ -78,6 +98,8 @@ typedef struct {
     uint32_t occ_interval_log2; /*!< log2 value of of the the occurrence array interval */
     uint32_t occ_array_16_pt2; /*!< equal to ((bwt)->occ_interval/(sizeof(uint32_t)<<3>>1) + (sizeof(tmap_bwt_int_t)>>2<<2))) */
     void *mmap_fp;
+    tmap_bwt_line_t *occ_lines;  /*!< the occurrence lines, NULL unless tmap_bwt_gen_occ_lines was called */
+    tmap_bwt_int_t *occ_lines_super;  /*!< the occurrences of each base before each super block of lines */
 } tmap_bwt_t;
 
 /*! 
@@ -161,6 +183,16 @@ tmap_bwt_gen_cnt_table(tmap_bwt_t *bwt);
 void
 tmap_bwt_gen_hash(tmap_bwt_t *bwt, int32_t hash_width, uint32_t check_hash);
 
+/*! 
+  generates the occurrence lines, a copy of the occurrence array with the counts and bases of
+  every TMAP_BWT_LINE_BASES bases in one cache line
+  @param  bwt  pointer to the bwt structure to update 
+  @details     once generated, the occurrence functions and tmap_bwt_B0 use the lines instead of
+  the occurrence array; the lines are not part of the index files or shared memory
+  */
+void
+tmap_bwt_gen_occ_lines(tmap_bwt_t *bwt);
+
 /*! 
   calculates the next occurrence given the previous occurrence and the next base
   @param  bwt  pointer to the bwt structure 
@@ -205,6 +237,22 @@ tmap_bwt_2occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, uint8_t
 void
 tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_bwt_int_t cntk[4], tmap_bwt_int_t cntl[4]);
 
+/*! 
+  calculates the next SA intervals given the previous SA intervals for all four bases, for a
+  batch of intervals
+  @param  bwt   pointer to the bwt structure 
+  @param  n     the number of intervals
+  @param  k     previous lower occurrences
+  @param  l     previous upper occurrences
+  @param  cntk  next upper occurrences
+  @param  cntl  next lower occurrences
+  @details      the memory of all the intervals is prefetched before any are computed, so the
+  cache misses of independent intervals overlap; requires that k[i] <= l[i] (not checked)
+  */
+void
+tmap_bwt_2occ4_batch(const tmap_bwt_t *bwt, int32_t n, const tmap_bwt_int_t *k, const tmap_bwt_int_t *l, 
+                     tmap_bwt_int_t (*cntk)[4], tmap_bwt_int_t (*cntl)[4]);
+
 /*!
   @param  b   pointer to the bwt structure
   @param  k   the zero-based index of the bwt character to retrieve
@@ -224,6 +272,18 @@ tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_b
 //#define tmap_bwt_get_bwt16(b, k) ((b)->bwt[tmap_bwt_get_occ_array_i16(b, k) + sizeof(tmap_bwt_int_t)/4*4 + (k)%(b)->occ_interval/16])
 
 
+/*! 
+  @param  bwt  pointer to the bwt structure
+  @param  k    the zero-based index of the bwt character to retrieve
+  @return      the bwt character from the $-removed BWT string, read from the occurrence lines
+  */
+static inline uint32_t
+tmap_bwt_line_B0(const tmap_bwt_t *bwt, tmap_bwt_int_t k)
+{
+  uint32_t r = k % TMAP_BWT_LINE_BASES;
+  return bwt->occ_lines[k / TMAP_BWT_LINE_BASES].bits[r >> 5] >> ((~r & 31) << 1) & 3;
+}
+
 /*! 
   @param  b   pointer to the bwt structure
   @param  k   the zero-based index of the bwt character to retrieve
@@ -231,7 +291,7 @@ tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_b
   @details    Note that tmap_bwt_t::bwt is not exactly the BWT string 
   and therefore this define is called tmap_bwt_B0 instead of tmap_bwt_B. 
   */
-#define tmap_bwt_B0(b, k) (tmap_bwt_get_bwt16(b, k)>>((~(k)&0xf)<<1)&3)
+#define tmap_bwt_B0(b, k) ((NULL != (b)->occ_lines) ? tmap_bwt_line_B0(b, k) : (tmap_bwt_get_bwt16(b, k)>>((~(k)&0xf)<<1)&3))
 
 /*!
   @param  b   pointer to the bwt structure
@@ -240,6 +300,28 @@ tmap_bwt_2occ4(const tmap_bwt_t *bwt, tmap_bwt_int_t k, tmap_bwt_int_t l, tmap_b
   */
 #define tmap_bwt_occ_intv(b, k) ((b)->bwt + tmap_bwt_get_occ_array_i16(b, k))
 
+/*! 
+  @param  bwt  pointer to the bwt structure
+  @param  k    the occurrence position
+  @details     prefetches the memory read by the occurrence functions for k
+  */
+static inline void
+tmap_bwt_prefetch_occ(const tmap_bwt_t *bwt, tmap_bwt_int_t k)
+{
+  const uint32_t *p;
+  if(TMAP_BWT_INT_MAX == k) return;
+  if(k >= bwt->primary) --k; // because $ is not in bwt
+  if(NULL != bwt->occ_lines) {
+      __builtin_prefetch(bwt->occ_lines + k / TMAP_BWT_LINE_BASES);
+  }
+  else {
+      // the occurrence array interval need not start on a cache line
+      p = tmap_bwt_occ_intv(bwt, k);
+      __builtin_prefetch(p);
+      __builtin_prefetch(p + bwt->occ_array_16_pt2 - 1);
+  }
+}
+
 /*!  
   inverse Psi function
   @param  bwt  pointer to the bwt structure
@@ -526,6 +526,63 @@ tmap_bwt_match_hash_exact_reverse(const tmap_bwt_t *bwt, int len, const uint8_t
   return prev.l - prev.k + 1;
 }
 
+void
+tmap_bwt_match_hash_exact_reverse_batch(const tmap_bwt_t *bwt, int32_t n, const int32_t *len, uint8_t **str, 
+                                        tmap_bwt_match_occ_t *match_sa, tmap_bwt_int_t *n_sa)
+{
+  int32_t i, m;
+  uint8_t c;
+  tmap_bwt_match_occ_t next;
+
+  // NB: n_sa is TMAP_BWT_INT_MAX while the sequence is being searched
+  for(i=m=0;i<n;i++) {
+      n_sa[i] = TMAP_BWT_INT_MAX;
+      if(0 < bwt->hash_width && 0 < len[i]) { 
+          if(0 == tmap_bwt_match_hash_reverse_init(bwt, len[i], str[i], &match_sa[i])) {
+              n_sa[i] = 0;
+              continue;
+          }
+      }
+      else {
+          match_sa[i].k = 0; match_sa[i].l = bwt->seq_len;
+          match_sa[i].offset = 0;
+          match_sa[i].hi = 0;
+      }
+      if(len[i] <= 0 || (uint32_t)len[i] <= match_sa[i].offset) n_sa[i] = match_sa[i].l - match_sa[i].k + 1;
+      else m++;
+  }
+
+  while(0 < m) {
+      for(i=0;i<n;i++) {
+          if(TMAP_BWT_INT_MAX == n_sa[i]) {
+              tmap_bwt_prefetch_occ(bwt, match_sa[i].k-1);
+              tmap_bwt_prefetch_occ(bwt, match_sa[i].l);
+          }
+      }
+      for(i=0;i<n;i++) {
+          if(TMAP_BWT_INT_MAX != n_sa[i]) continue;
+          c = str[i][len[i]-match_sa[i].offset-1];
+          if(TMAP_UNLIKELY(3 < c)) {
+              match_sa[i].offset++; 
+              match_sa[i].k = match_sa[i].l + 1;
+              n_sa[i] = 0;
+              m--;
+              continue;
+          }
+          tmap_bwt_match_hash_2occ(bwt, &match_sa[i], c, &next, NULL);
+          match_sa[i] = next;
+          if(next.k > next.l || TMAP_BWT_INT_MAX == next.k) { // no match
+              n_sa[i] = 0;
+              m--;
+          }
+          else if((uint32_t)len[i] <= next.offset) { // len[i] > 0 while searching
+              n_sa[i] = next.l - next.k + 1;
+              m--;
+          }
+      }
+  }
+}
+
 tmap_bwt_int_t
 tmap_bwt_match_hash_exact_alt(const tmap_bwt_t *bwt, int len, const uint8_t *str, 
                          tmap_bwt_match_occ_t *match_sa, tmap_bwt_match_hash_t *hash)
@@ -143,6 +143,21 @@ tmap_bwt_match_hash_exact(const tmap_bwt_t *bwt, int len, const uint8_t *str, tm
 tmap_bwt_int_t
 tmap_bwt_match_hash_exact_reverse(const tmap_bwt_t *bwt, int len, const uint8_t *str, tmap_bwt_match_occ_t *match_sa, tmap_bwt_match_hash_t *hash);
 
+/*! 
+  computes the SA intervals for a batch of sequences (if any), using reverse search
+  @param  bwt       pointer to the bwt structure 
+  @param  n         the number of sequences
+  @param  len       the length of each sequence
+  @param  str       the DNA sequences in 2-bit format
+  @param  match_sa  the match structures to be returned, one per sequence
+  @param  n_sa      the size of the SA interval of each sequence, 0 if none found
+  @details          the same as tmap_bwt_match_hash_exact_reverse without a hash, but the sequences are
+  extended one base at a time in turn, with the memory for the next base of every sequence prefetched first
+  */
+void
+tmap_bwt_match_hash_exact_reverse_batch(const tmap_bwt_t *bwt, int32_t n, const int32_t *len, uint8_t **str, 
+                                        tmap_bwt_match_occ_t *match_sa, tmap_bwt_int_t *n_sa);
+
 /*! 
   computes the SA interval for the given sequence (if any), using forward search
   @param  bwt       pointer to the bwt structure 
@@ -44,12 +44,31 @@
 #include "tmap_bwt_match.h"
 #include "tmap_bwt_smem.h"
 
+// the number of intervals extended at once in the backward search
+#define TMAP_BWT_SMEM_BATCH 8
+
+// the extensions of ik given the occurrences before its ends
+static inline void
+tmap_bwt_smem_extend_cnt(const tmap_bwt_t *bwt, const tmap_bwt_smem_intv_t *ik, const tmap_bwt_int_t tk[4], const tmap_bwt_int_t tl[4], 
+                         tmap_bwt_smem_intv_t ok[4], int32_t is_back)
+{
+  int32_t i;
+  for (i = 0; i != 4; ++i) {
+      ok[i].x[!is_back] = bwt->L2[i] + 1 + tk[i];
+      if(tl[i] < tk[i]) ok[i].size = 0;
+      else ok[i].size = tl[i] - tk[i];
+  }
+  ok[3].x[is_back] = ik->x[is_back] + (ik->x[!is_back] <= bwt->primary && ik->x[!is_back] + ik->size - 1 >= bwt->primary);
+  ok[2].x[is_back] = ok[3].x[is_back] + ok[3].size;
+  ok[1].x[is_back] = ok[2].x[is_back] + ok[2].size;
+  ok[0].x[is_back] = ok[1].x[is_back] + ok[1].size;
+}
+
 // TODO: the primary and secondary hash (etc.)
 static void
 tmap_bwt_smem_extend(const tmap_bwt_t *bwt, const tmap_bwt_smem_intv_t *ik, tmap_bwt_smem_intv_t ok[4], int32_t is_back)
 {
   tmap_bwt_int_t tk[4], tl[4];
-  int32_t i;
   // TODO: the primary and secondary hash (etc.)
   tmap_bwt_2occ4(bwt, ik->x[!is_back] - 1, ik->x[!is_back] - 1 + ik->size, tk, tl);
   /*
@@ -58,15 +77,7 @@ tmap_bwt_smem_extend(const tmap_bwt_t *bwt, const tmap_bwt_smem_intv_t *ik, tmap
           tk[0], tk[1], tk[2], tk[3],
           tl[0], tl[1], tl[2], tl[3]);
           */
-  for (i = 0; i != 4; ++i) {
-      ok[i].x[!is_back] = bwt->L2[i] + 1 + tk[i];
-      if(tl[i] < tk[i]) ok[i].size = 0;
-      else ok[i].size = tl[i] - tk[i];
-  }
-  ok[3].x[is_back] = ik->x[is_back] + (ik->x[!is_back] <= bwt->primary && ik->x[!is_back] + ik->size - 1 >= bwt->primary);
-  ok[2].x[is_back] = ok[3].x[is_back] + ok[3].size;
-  ok[1].x[is_back] = ok[2].x[is_back] + ok[2].size;
-  ok[0].x[is_back] = ok[1].x[is_back] + ok[1].size;
+  tmap_bwt_smem_extend_cnt(bwt, ik, tk, tl, ok, is_back);
 }
 
 static void 
@@ -86,8 +97,10 @@ tmap_bwt_smem_reverse_intvs(tmap_bwt_smem_intv_vec_t *p)
 int32_t
 tmap_bwt_smem1(const tmap_bwt_t *bwt, int32_t len, const uint8_t *q, int32_t x, tmap_bwt_smem_intv_vec_t *mem, tmap_bwt_smem_intv_vec_t *tmpvec[2])
 {
-  int32_t i, j, c, ret;
+  int32_t i, j, c, ret, b, n;
   tmap_bwt_smem_intv_t ik, ok[4];
+  tmap_bwt_int_t bk[TMAP_BWT_SMEM_BATCH], bl[TMAP_BWT_SMEM_BATCH];
+  tmap_bwt_int_t tk[TMAP_BWT_SMEM_BATCH][4], tl[TMAP_BWT_SMEM_BATCH][4];
   tmap_bwt_smem_intv_vec_t a[2], *prev, *curr, *swap;
 
   mem->n = 0;
@@ -133,7 +146,15 @@ tmap_bwt_smem1(const tmap_bwt_t *bwt, int32_t len, const uint8_t *q, int32_t x,
       if (c > 3) break;
       for (j = 0, curr->n = 0; j < prev->n; ++j) {
           tmap_bwt_smem_intv_t *p = &prev->a[j];
-          tmap_bwt_smem_extend(bwt, p, ok, 1);
+          if (0 == j % TMAP_BWT_SMEM_BATCH) { // the intervals are independent, so extend a batch at once
+              n = (prev->n - j < TMAP_BWT_SMEM_BATCH) ? (prev->n - j) : TMAP_BWT_SMEM_BATCH;
+              for (b = 0; b < n; ++b) {
+                  bk[b] = p[b].x[0] - 1;
+                  bl[b] = p[b].x[0] - 1 + p[b].size;
+              }
+              tmap_bwt_2occ4_batch(bwt, n, bk, bl, tk, tl);
+          }
+          tmap_bwt_smem_extend_cnt(bwt, p, tk[j % TMAP_BWT_SMEM_BATCH], tl[j % TMAP_BWT_SMEM_BATCH], ok, 1);
           if (ok[c].size <= 0 || i == -1) { // keep the hit if reaching the beginning or not extended further
               if (curr->n == 0) { // curr->n to make sure there is no longer matches
                   if (mem->n == 0 || i + 1 < mem->a[mem->n-1].info>>32) { // skip contained matches
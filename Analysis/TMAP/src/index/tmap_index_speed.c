@@ -17,81 +17,130 @@
 #include "tmap_sa.h"
 #include "tmap_index.h"
 #include "tmap_bwt_match.h"
+#include "tmap_bwt_match_hash.h"
 #include "tmap_index_speed.h"
 
+// simulate the next kmer
+static void
+tmap_index_speed_kmer(tmap_index_t *index, tmap_rand_t *rand, tmap_index_speed_opt_t *opt, uint8_t *seq)
+{
+  int32_t j;
+  tmap_bwt_int_t pacpos;
+  while(1) {
+      if(tmap_rand_get(rand) < opt->rand_frac) {
+          for(j=0;j<opt->kmer_length;j++) {
+              seq[j] = (uint8_t)(tmap_rand_get(rand) * 4);
+          }
+          return;
+      }
+      // get a position (one-based)
+      pacpos = 1 + (tmap_bwt_int_t)(tmap_rand_get(rand) * (index->refseq->len - opt->kmer_length + 1));
+      if(0 != tmap_refseq_subseq(index->refseq, pacpos, opt->kmer_length, seq)) {
+          return;
+      }
+  }
+}
+
 static int32_t  
 tmap_index_speed_test(tmap_index_t *index, clock_t *total_clock, tmap_index_speed_opt_t *opt)
 {
   tmap_rand_t *rand;
-  int32_t i, j, num_found, found;
-  tmap_bwt_int_t k, l;
-  tmap_bwt_int_t pacpos;
-  uint8_t *seq = NULL;
-  tmap_bwt_match_occ_t cur;
+  int32_t i, j, b, n, num_found;
+  tmap_bwt_int_t k;
+  uint8_t **seqs = NULL;
+  int32_t *lens = NULL;
+  tmap_bwt_match_occ_t *cur = NULL;
+  tmap_bwt_int_t *n_sa = NULL, *ks = NULL, *ls = NULL;
+  tmap_bwt_int_t (*cntk)[4] = NULL, (*cntl)[4] = NULL;
+  int32_t *cs = NULL;
   clock_t start_clock = 0;
-  tmap_bwt_int_t cntk[4], cntl[4], ok, ol;
+  tmap_bwt_int_t ok, ol;
 
   rand = tmap_rand_init(13);
-  if(0 == opt->func) seq = tmap_malloc(opt->kmer_length * sizeof(uint8_t), "seq");
+  cur = tmap_malloc(opt->batch * sizeof(tmap_bwt_match_occ_t), "cur");
+  n_sa = tmap_malloc(opt->batch * sizeof(tmap_bwt_int_t), "n_sa");
+  ks = tmap_malloc(opt->batch * sizeof(tmap_bwt_int_t), "ks");
+  ls = tmap_malloc(opt->batch * sizeof(tmap_bwt_int_t), "ls");
+  cs = tmap_malloc(opt->batch * sizeof(int32_t), "cs");
+  cntk = tmap_malloc(opt->batch * sizeof(tmap_bwt_int_t) * 4, "cntk");
+  cntl = tmap_malloc(opt->batch * sizeof(tmap_bwt_int_t) * 4, "cntl");
+  if(0 == opt->func) {
+      seqs = tmap_malloc(opt->batch * sizeof(uint8_t*), "seqs");
+      lens = tmap_malloc(opt->batch * sizeof(int32_t), "lens");
+      for(b=0;b<opt->batch;b++) {
+          seqs[b] = tmap_malloc(opt->kmer_length * sizeof(uint8_t), "seqs[b]");
+          lens[b] = opt->kmer_length;
+      }
+  }
 
   num_found = 0;
-  for(i=0;i<opt->kmer_num;i++) {
-      if(0 < i && 0 == (i % 1000000)) {
+  for(i=0;i<opt->kmer_num;i+=n) {
+      if(0 < i && (i / 1000000) != ((i - n) / 1000000)) {
           tmap_progress_print2("processed %d kmers", i);
       }
+      n = (opt->kmer_num - i < opt->batch) ? (opt->kmer_num - i) : opt->batch;
       if(0 == opt->func) {
-          if(tmap_rand_get(rand) < opt->rand_frac) {
-              for(j=0;j<opt->kmer_length;j++) {
-                  seq[j] = (uint8_t)(tmap_rand_get(rand) * 4);
-              }
+          for(b=0;b<n;b++) {
+              tmap_index_speed_kmer(index, rand, opt, seqs[b]);
+          }
+          start_clock = clock();
+          if(1 == opt->batch) {
+              n_sa[0] = tmap_bwt_match_exact_reverse(index->bwt, opt->kmer_length, seqs[0], &cur[0]);
           }
           else {
-              // get a position (one-based)
-              pacpos = 1 + (tmap_bwt_int_t)(tmap_rand_get(rand) * (index->refseq->len - opt->kmer_length + 1));
-              if(0 == tmap_refseq_subseq(index->refseq, pacpos, opt->kmer_length, seq)) {
-                  i--;
-                  continue;
-              }
+              tmap_bwt_match_hash_exact_reverse_batch(index->bwt, n, lens, seqs, cur, n_sa);
           }
-          found = 0;
-          start_clock = clock();
-          if(0 < tmap_bwt_match_exact_reverse(index->bwt, opt->kmer_length, seq, &cur)) {
-              if(0 <= opt->enum_max_hits && (cur.l - cur.k + 1) <= opt->enum_max_hits) {
-                  for(k=cur.k;k<=cur.l;k++) {
-                      // retrieve the packed position
-                      pacpos = index->bwt->seq_len - tmap_sa_pac_pos(index->sa, index->bwt, k) - opt->kmer_length + 1;
+          for(b=0;b<n;b++) {
+              if(0 < n_sa[b]) {
+                  if(0 <= opt->enum_max_hits && (cur[b].l - cur[b].k + 1) <= opt->enum_max_hits) {
+                      for(k=cur[b].k;k<=cur[b].l;k++) {
+                          // retrieve the packed position
+                          tmap_sa_pac_pos(index->sa, index->bwt, k);
+                      }
                   }
+                  num_found++;
               }
-              found = 1;
           }
           (*total_clock) += clock() - start_clock;
-          if(0 < found) {
-              num_found++;
-          }
       }
       else {
-          k = tmap_rand_int(rand) % index->bwt->seq_len;
-          l = k; //l = tmap_rand_int(rand) % index->bwt->seq_len;
-          j = tmap_rand_int(rand) % 4;
+          for(b=0;b<n;b++) {
+              ks[b] = tmap_rand_int(rand) % index->bwt->seq_len;
+              ls[b] = ks[b]; //l = tmap_rand_int(rand) % index->bwt->seq_len;
+              cs[b] = tmap_rand_int(rand) % 4;
+          }
           start_clock = clock();
-          switch(opt->func) {
-            case 1:
-              k = tmap_bwt_occ(index->bwt, k, j);
-              break;
-            case 2:
-              tmap_bwt_occ4(index->bwt, k, cntk);
-              break;
-            case 3:
-              tmap_bwt_2occ(index->bwt, k, l, j, &ok, &ol);
-              break;
-            case 4:
-              tmap_bwt_2occ4(index->bwt, k, l, cntk, cntl);
-              break;
-            case 5:
-              k = tmap_sa_pac_pos(index->sa, index->bwt, k);
-              break;
-            default:
-              tmap_bug();
+          if(1 < n && 4 == opt->func) {
+              tmap_bwt_2occ4_batch(index->bwt, n, ks, ls, cntk, cntl);
+          }
+          else {
+              if(1 < n) { // prefetch the batch
+                  for(b=0;b<n;b++) {
+                      tmap_bwt_prefetch_occ(index->bwt, ks[b]);
+                  }
+              }
+              for(b=0;b<n;b++) {
+                  j = cs[b];
+                  switch(opt->func) {
+                    case 1:
+                      k = tmap_bwt_occ(index->bwt, ks[b], j);
+                      break;
+                    case 2:
+                      tmap_bwt_occ4(index->bwt, ks[b], cntk[b]);
+                      break;
+                    case 3:
+                      tmap_bwt_2occ(index->bwt, ks[b], ls[b], j, &ok, &ol);
+                      break;
+                    case 4:
+                      tmap_bwt_2occ4(index->bwt, ks[b], ls[b], cntk[b], cntl[b]);
+                      break;
+                    case 5:
+                      k = tmap_sa_pac_pos(index->sa, index->bwt, ks[b]);
+                      break;
+                    default:
+                      tmap_bug();
+                  }
+              }
           }
           (*total_clock) += clock() - start_clock;
       }
@@ -99,7 +148,20 @@ tmap_index_speed_test(tmap_index_t *index, clock_t *total_clock, tmap_index_spee
   tmap_progress_print2("processed %d kmers", i);
 
   tmap_rand_destroy(rand);
-  if(0 == opt->func) free(seq);
+  if(0 == opt->func) {
+      for(b=0;b<opt->batch;b++) {
+          free(seqs[b]);
+      }
+      free(seqs);
+      free(lens);
+  }
+  free(cur);
+  free(n_sa);
+  free(ks);
+  free(ls);
+  free(cs);
+  free(cntk);
+  free(cntl);
 
   return num_found;
 }
@@ -123,6 +185,11 @@ tmap_index_speed_core(tmap_index_speed_opt_t *opt)
       index->bwt->hash_width = opt->hash_width;
   }
 
+  // use the occurrence lines
+  if(1 == opt->occ_lines) {
+      tmap_bwt_gen_occ_lines(index->bwt);
+  }
+
   // clock on
   start_time = time(NULL);
 
@@ -161,6 +228,8 @@ usage(tmap_index_speed_opt_t *opt)
   tmap_file_fprintf(tmap_file_stderr, "                         3 - tmap_bwt_2occ\n");
   tmap_file_fprintf(tmap_file_stderr, "                         4 - tmap_bwt_2occ4\n");
   tmap_file_fprintf(tmap_file_stderr, "                         5 - tmap_sa_pac_pos\n");
+  tmap_file_fprintf(tmap_file_stderr, "         -L          use the cache line occurrence array (see tmap_bwt_gen_occ_lines) [%s]\n", (1 == opt->occ_lines) ? "true" : "false");
+  tmap_file_fprintf(tmap_file_stderr, "         -B INT      the number of lookups run at once with -F 0 to 4, prefetching their memory first [%d]\n", opt->batch);
   tmap_file_fprintf(tmap_file_stderr, "         -e INT      the maximum number of hits to enumerate with -F 0 (-1 for unlimited, 0 to disable) [%d]\n", opt->enum_max_hits);
   tmap_file_fprintf(tmap_file_stderr, "         -K INT      the kmer length to simulate with -F 0 [%d]\n", opt->kmer_length);
   tmap_file_fprintf(tmap_file_stderr, "         -R FLOAT    the fraction of random kmers with -F 0 [%.2lf]\n", opt->rand_frac);
@@ -184,8 +253,10 @@ tmap_index_speed(int argc, char *argv[])
   opt.rand_frac = 0.0;
   opt.shm_key = 0;
   opt.func = 0;
+  opt.occ_lines = 0;
+  opt.batch = 1;
       
-  while((c = getopt(argc, argv, "f:k:w:e:K:N:R:F:hv")) >= 0) {
+  while((c = getopt(argc, argv, "f:k:w:e:K:N:R:F:LB:hv")) >= 0) {
       switch(c) {
         case 'f':
           opt.fn_fasta = tmap_strdup(optarg); break;
@@ -205,6 +276,10 @@ tmap_index_speed(int argc, char *argv[])
           tmap_progress_set_verbosity(1); break;
         case 'F':
           opt.func = atoi(optarg); break;
+        case 'L':
+          opt.occ_lines = 1; break;
+        case 'B':
+          opt.batch = atoi(optarg); break;
         case 'h':
         default:
           return usage(&opt);
@@ -233,6 +308,10 @@ tmap_index_speed(int argc, char *argv[])
       tmap_error("the option -F must be between 0 and 5", Exit, CommandLineArgument);
   }
 
+  if(opt.batch <= 0) {
+      tmap_error("the option -B must be greater than zero", Exit, CommandLineArgument);
+  }
+
   tmap_index_speed_core(&opt);
 
   free(opt.fn_fasta);
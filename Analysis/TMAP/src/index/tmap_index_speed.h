@@ -19,6 +19,8 @@ typedef struct {
     int32_t kmer_num;  /*!< the number of kmers to simulate (-N) */
     double rand_frac;  /*!< the fraction of random kmers (-R) */
     int32_t func;  /*!< the function to test (-F) */
+    int32_t occ_lines;  /*!< use the occurrence lines (-L) */
+    int32_t batch;  /*!< the number of lookups run at once (-B) */
 } tmap_index_speed_opt_t;
 
 /*! 
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/mman.h>
 
 #include "../util/tmap_error.h"
 #include "../util/tmap_alloc.h"
@@ -39,6 +40,35 @@ tmap_sa_read(const char *fn_fasta)
 
   sa = tmap_calloc(1, sizeof(tmap_sa_t), "sa");
 
+#ifdef TMAP_MMAP
+  size_t fp_length = 0;
+  char *sa_ptr = NULL;
+  long page_size;
+
+  sa_ptr = tmap_file_mmap(fp_sa, &fp_length);
+  if(NULL == sa_ptr || fp_length < 3 * sizeof(tmap_bwt_int_t)) {
+      tmap_error(NULL, Exit, ReadFileError);
+  }
+  sa->mmap_fp = (void*)fp_sa;
+  memcpy(&sa->primary, sa_ptr, sizeof(tmap_bwt_int_t));
+  memcpy(&sa->sa_intv, sa_ptr + sizeof(tmap_bwt_int_t), sizeof(tmap_bwt_int_t));
+  memcpy(&sa->seq_len, sa_ptr + 2 * sizeof(tmap_bwt_int_t), sizeof(tmap_bwt_int_t));
+
+  sa->n_sa = (sa->seq_len + sa->sa_intv) / sa->sa_intv;
+  if(fp_length < (sa->n_sa + 2) * sizeof(tmap_bwt_int_t)) {
+      tmap_error(NULL, Exit, ReadFileError);
+  }
+
+  // the entries are used in place, with sa[0] over the sequence length in the header.
+  // NB: only the first page becomes a private copy, the rest stays shared in the page cache
+  sa->sa = (tmap_bwt_int_t*)(sa_ptr + 2 * sizeof(tmap_bwt_int_t));
+  page_size = sysconf(_SC_PAGESIZE);
+  if(0 != mprotect(sa_ptr, page_size, PROT_READ | PROT_WRITE)) {
+      tmap_error("could not write to the mapped SA", Exit, ReadFileError);
+  }
+  sa->sa[0] = -1;
+  mprotect(sa_ptr, page_size, PROT_READ);
+#else
   if(1 != tmap_file_fread(&sa->primary, sizeof(tmap_bwt_int_t), 1, fp_sa)
      || 1 != tmap_file_fread(&sa->sa_intv, sizeof(tmap_bwt_int_t), 1, fp_sa)
      || 1 != tmap_file_fread(&sa->seq_len, sizeof(tmap_bwt_int_t), 1, fp_sa)) {
@@ -52,10 +82,11 @@ tmap_sa_read(const char *fn_fasta)
   if(sa->n_sa-1 != tmap_file_fread(sa->sa + 1, sizeof(tmap_bwt_int_t), sa->n_sa - 1, fp_sa)) {
       tmap_error(NULL, Exit, ReadFileError);
   }
+  tmap_file_fclose(fp_sa);
+#endif
 
   sa->sa_intv_log2 = tmap_log2(sa->sa_intv);
 
-  tmap_file_fclose(fp_sa);
   free(fn_sa);
 
   sa->is_shm = 0;
@@ -194,6 +225,11 @@ tmap_sa_destroy(tmap_sa_t *sa)
   if(1 == sa->is_shm) {
   free(sa);
   }
+  else if(NULL != sa->mmap_fp) {
+  // close and unmap the file
+  tmap_file_fclose((tmap_file_t*)sa->mmap_fp);
+  free(sa);
+  }
   else {
   free(sa->sa);
   free(sa);
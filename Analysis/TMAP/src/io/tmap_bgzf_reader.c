@@ -0,0 +1,248 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <config.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+#include "../util/tmap_error.h"
+#include "../util/tmap_alloc.h"
+#include "tmap_bgzf_reader.h"
+
+#ifdef HAVE_LIBPTHREAD
+// reads the next block from the file, returns 0 at the end of the file
+// NB: the caller holds the lock
+static int32_t
+tmap_bgzf_reader_read_block(tmap_bgzf_reader_t *reader, tmap_bgzf_reader_block_t *block)
+{
+  uint8_t *h = block->compressed;
+  size_t count, remaining;
+
+  count = fread(h, 1, TMAP_BGZF_READER_HEADER_LENGTH, reader->fp);
+  if(0 == count) return 0;
+  // same checks as bgzf
+  if(TMAP_BGZF_READER_HEADER_LENGTH != count
+     || 31 != h[0] || 139 != h[1] || 8 != h[2] || 0 == (h[3] & 4)
+     || 6 != (h[10] | (h[11] << 8))
+     || 'B' != h[12] || 'C' != h[13]
+     || 2 != (h[14] | (h[15] << 8))) {
+      tmap_error("malformed BGZF block header", Exit, ReadFileError);
+  }
+  block->compressed_length = (h[16] | (h[17] << 8)) + 1;
+  if(block->compressed_length < TMAP_BGZF_READER_HEADER_LENGTH + 8) {
+      tmap_error("malformed BGZF block header", Exit, ReadFileError);
+  }
+  remaining = block->compressed_length - TMAP_BGZF_READER_HEADER_LENGTH;
+  if(remaining != fread(h + TMAP_BGZF_READER_HEADER_LENGTH, 1, remaining, reader->fp)) {
+      tmap_error("truncated BGZF block", Exit, ReadFileError);
+  }
+  block->address = reader->address;
+  reader->address += block->compressed_length;
+
+  return 1;
+}
+
+static void
+tmap_bgzf_reader_inflate(z_stream *zs, tmap_bgzf_reader_block_t *block)
+{
+  uint8_t *footer = block->compressed + block->compressed_length - 4;
+  uint32_t isize;
+
+  if(Z_OK != inflateReset(zs)) {
+      tmap_error("could not reset the zlib stream", Exit, OutOfRange);
+  }
+  zs->next_in = block->compressed + TMAP_BGZF_READER_HEADER_LENGTH;
+  zs->avail_in = block->compressed_length - TMAP_BGZF_READER_HEADER_LENGTH - 8;
+  zs->next_out = block->data;
+  zs->avail_out = TMAP_BGZF_READER_MAX_BLOCK_SIZE;
+  if(Z_STREAM_END != inflate(zs, Z_FINISH)) {
+      tmap_error("could not decompress the BGZF block", Exit, ReadFileError);
+  }
+  block->length = TMAP_BGZF_READER_MAX_BLOCK_SIZE - zs->avail_out;
+
+  isize = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((uint32_t)footer[3] << 24);
+  if(isize != (uint32_t)block->length) {
+      tmap_error("the BGZF block size did not match", Exit, ReadFileError);
+  }
+}
+
+static void *
+tmap_bgzf_reader_worker(void *arg)
+{
+  tmap_bgzf_reader_t *reader = (tmap_bgzf_reader_t*)arg;
+  tmap_bgzf_reader_block_t *block = NULL;
+  z_stream zs;
+
+  memset(&zs, 0, sizeof(z_stream));
+  if(Z_OK != inflateInit2(&zs, -15)) { // raw deflate
+      tmap_error("could not initialize the zlib stream", Exit, OutOfRange);
+  }
+
+  pthread_mutex_lock(&reader->mutex);
+  while(0 == reader->stop && 0 == reader->eof) {
+      if(reader->num_blocks <= reader->num_read - reader->num_used) { // all the blocks are in use
+          pthread_cond_wait(&reader->free_cond, &reader->mutex);
+          continue;
+      }
+      // read in order
+      block = &reader->blocks[reader->num_read % reader->num_blocks];
+      if(0 == tmap_bgzf_reader_read_block(reader, block)) {
+          reader->eof = 1;
+          pthread_cond_broadcast(&reader->done_cond);
+          pthread_cond_broadcast(&reader->free_cond); // the other threads may exit
+          break;
+      }
+      block->state = TMAP_BGZF_READER_BLOCK_READ;
+      reader->num_read++;
+      pthread_mutex_unlock(&reader->mutex);
+
+      // decompress out of order
+      tmap_bgzf_reader_inflate(&zs, block);
+
+      pthread_mutex_lock(&reader->mutex);
+      block->state = TMAP_BGZF_READER_BLOCK_DONE;
+      pthread_cond_broadcast(&reader->done_cond);
+  }
+  pthread_mutex_unlock(&reader->mutex);
+
+  inflateEnd(&zs);
+
+  return arg;
+}
+
+// releases the current block and waits for the next, returns 0 at the end of the file
+static int32_t
+tmap_bgzf_reader_next_block(tmap_bgzf_reader_t *reader)
+{
+  tmap_bgzf_reader_block_t *block = NULL;
+
+  pthread_mutex_lock(&reader->mutex);
+  if(NULL != reader->block) {
+      reader->block->state = TMAP_BGZF_READER_BLOCK_FREE;
+      reader->block = NULL;
+      reader->num_used++;
+      pthread_cond_signal(&reader->free_cond);
+  }
+  while(1) {
+      if(reader->num_used < reader->num_read) {
+          block = &reader->blocks[reader->num_used % reader->num_blocks];
+          if(TMAP_BGZF_READER_BLOCK_DONE == block->state) break;
+      }
+      else if(1 == reader->eof) {
+          pthread_mutex_unlock(&reader->mutex);
+          return 0;
+      }
+      pthread_cond_wait(&reader->done_cond, &reader->mutex);
+  }
+  pthread_mutex_unlock(&reader->mutex);
+
+  reader->block = block;
+  reader->block_address = block->address;
+  reader->block_offset = reader->skip; // NB: only non-zero for the first block
+  reader->skip = 0;
+
+  return 1;
+}
+#endif
+
+tmap_bgzf_reader_t *
+tmap_bgzf_reader_init(const char *fn, int64_t vfo, int32_t num_threads)
+{
+#ifdef HAVE_LIBPTHREAD
+  tmap_bgzf_reader_t *reader = NULL;
+  FILE *fp = NULL;
+  int32_t i;
+
+  if(num_threads <= 0 || NULL == fn || 0 == strcmp("-", fn)) return NULL;
+  if(NULL == (fp = fopen(fn, "rb"))) return NULL;
+  if(0 != fseeko(fp, vfo >> 16, SEEK_SET)) {
+      fclose(fp);
+      return NULL;
+  }
+
+  reader = tmap_calloc(1, sizeof(tmap_bgzf_reader_t), "reader");
+  reader->fp = fp;
+  reader->address = reader->block_address = vfo >> 16;
+  reader->skip = reader->block_offset = vfo & 0xffff;
+  reader->num_blocks = num_threads * TMAP_BGZF_READER_BLOCKS_PER_THREAD;
+  reader->blocks = tmap_calloc(reader->num_blocks, sizeof(tmap_bgzf_reader_block_t), "reader->blocks");
+
+  pthread_mutex_init(&reader->mutex, NULL);
+  pthread_cond_init(&reader->done_cond, NULL);
+  pthread_cond_init(&reader->free_cond, NULL);
+  reader->num_threads = num_threads;
+  reader->threads = tmap_calloc(num_threads, sizeof(pthread_t), "reader->threads");
+  for(i=0;i<num_threads;i++) {
+      if(0 != pthread_create(&reader->threads[i], NULL, tmap_bgzf_reader_worker, reader)) {
+          tmap_error("error creating threads", Exit, ThreadError);
+      }
+  }
+
+  return reader;
+#else
+  return NULL;
+#endif
+}
+
+void
+tmap_bgzf_reader_destroy(tmap_bgzf_reader_t *reader)
+{
+#ifdef HAVE_LIBPTHREAD
+  int32_t i;
+
+  if(NULL == reader) return;
+
+  pthread_mutex_lock(&reader->mutex);
+  reader->stop = 1;
+  pthread_cond_broadcast(&reader->free_cond);
+  pthread_mutex_unlock(&reader->mutex);
+  for(i=0;i<reader->num_threads;i++) {
+      if(0 != pthread_join(reader->threads[i], NULL)) {
+          tmap_error("error joining threads", Exit, ThreadError);
+      }
+  }
+  pthread_mutex_destroy(&reader->mutex);
+  pthread_cond_destroy(&reader->done_cond);
+  pthread_cond_destroy(&reader->free_cond);
+
+  fclose(reader->fp);
+  free(reader->threads);
+  free(reader->blocks);
+  free(reader);
+#endif
+}
+
+int32_t
+tmap_bgzf_reader_read(tmap_bgzf_reader_t *reader, void *data, int32_t length)
+{
+#ifdef HAVE_LIBPTHREAD
+  uint8_t *output = (uint8_t*)data;
+  int32_t n = 0, l;
+
+  while(n < length) {
+      if(NULL == reader->block || reader->block->length <= reader->block_offset) {
+          if(0 == tmap_bgzf_reader_next_block(reader)) break;
+          continue;
+      }
+      l = reader->block->length - reader->block_offset;
+      if(length - n < l) l = length - n;
+      memcpy(output + n, reader->block->data + reader->block_offset, l);
+      reader->block_offset += l;
+      n += l;
+  }
+
+  return n;
+#else
+  return 0;
+#endif
+}
+
+int64_t
+tmap_bgzf_reader_tell(tmap_bgzf_reader_t *reader)
+{
+  return (reader->block_address << 16) | (reader->block_offset & 0xffff);
+}
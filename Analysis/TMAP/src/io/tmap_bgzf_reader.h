@@ -0,0 +1,113 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef TMAP_BGZF_READER_H
+#define TMAP_BGZF_READER_H
+
+#include <config.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/*!
+  A BGZF Reader that decompresses the blocks on several threads
+  */
+
+/*!
+  the maximum size of a BGZF block, compressed or not
+  */
+#define TMAP_BGZF_READER_MAX_BLOCK_SIZE 0x10000
+
+/*!
+  the length of the BGZF block header
+  */
+#define TMAP_BGZF_READER_HEADER_LENGTH 18
+
+/*!
+  the number of blocks read ahead per thread
+  */
+#define TMAP_BGZF_READER_BLOCKS_PER_THREAD 8
+
+/*!
+  the state of a block
+  */
+enum {
+    TMAP_BGZF_READER_BLOCK_FREE = 0, /*!< the block may be read into */
+    TMAP_BGZF_READER_BLOCK_READ, /*!< the block was read from the file, and is being decompressed */
+    TMAP_BGZF_READER_BLOCK_DONE /*!< the block was decompressed */
+};
+
+/*!
+  one BGZF block
+  */
+typedef struct {
+    int64_t address; /*!< the file offset of the compressed block */
+    int32_t compressed_length; /*!< the compressed length, including the header and footer */
+    int32_t length; /*!< the decompressed length */
+    int32_t state; /*!< the state of the block */
+    uint8_t compressed[TMAP_BGZF_READER_MAX_BLOCK_SIZE]; /*!< the compressed block */
+    uint8_t data[TMAP_BGZF_READER_MAX_BLOCK_SIZE]; /*!< the decompressed block */
+} tmap_bgzf_reader_block_t;
+
+/*!
+  The blocks are read from the file in order, under a lock, by whichever thread is free,
+  and then decompressed by that thread.  The reading thread consumes the blocks in order.
+  */
+typedef struct {
+    FILE *fp; /*!< the file pointer */
+    int64_t address; /*!< the file offset of the next block to read from the file */
+    int32_t num_blocks; /*!< the number of blocks read ahead */
+    tmap_bgzf_reader_block_t *blocks; /*!< the blocks read ahead, used as a ring */
+    int64_t num_read; /*!< the number of blocks read from the file */
+    int64_t num_used; /*!< the number of blocks released by the reading thread */
+    tmap_bgzf_reader_block_t *block; /*!< the block being consumed, NULL if none */
+    int64_t block_address; /*!< the file offset of the block being consumed */
+    int32_t block_offset; /*!< the offset in the block being consumed */
+    int32_t skip; /*!< the number of bytes to skip in the first block */
+    int32_t eof; /*!< 1 if the end of the file was reached, 0 otherwise */
+    int32_t stop; /*!< 1 if the threads should stop, 0 otherwise */
+#ifdef HAVE_LIBPTHREAD
+    int32_t num_threads; /*!< the number of decompression threads */
+    pthread_t *threads; /*!< the decompression threads */
+    pthread_mutex_t mutex; /*!< the mutex guarding the blocks */
+    pthread_cond_t done_cond; /*!< signaled when a block was decompressed */
+    pthread_cond_t free_cond; /*!< signaled when a block was released */
+#endif
+} tmap_bgzf_reader_t;
+
+/*!
+  initializes the reader, starting the decompression threads
+  @param  fn           the BGZF file name
+  @param  vfo          the virtual file offset at which to start reading
+  @param  num_threads  the number of decompression threads
+  @return              the initialized reader, NULL if the file cannot be read on multiple threads
+  */
+tmap_bgzf_reader_t *
+tmap_bgzf_reader_init(const char *fn, int64_t vfo, int32_t num_threads);
+
+/*!
+  stops the threads and destroys the reader
+  @param  reader  the reader to destroy
+  */
+void
+tmap_bgzf_reader_destroy(tmap_bgzf_reader_t *reader);
+
+/*!
+  reads decompressed data
+  @param  reader  the reader
+  @param  data    the buffer in which to store the data
+  @param  length  the number of bytes to read
+  @return         the number of bytes read, less than length at the end of the file
+  */
+int32_t
+tmap_bgzf_reader_read(tmap_bgzf_reader_t *reader, void *data, int32_t length);
+
+/*!
+  @param  reader  the reader
+  @return         the virtual file offset of the next byte to be read, as bgzf_tell
+  */
+int64_t
+tmap_bgzf_reader_tell(tmap_bgzf_reader_t *reader);
+
+#endif // TMAP_BGZF_READER_H
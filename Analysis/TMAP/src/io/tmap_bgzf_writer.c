@@ -0,0 +1,254 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <config.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+#include "../util/tmap_error.h"
+#include "../util/tmap_alloc.h"
+#include "../util/tmap_time.h"
+#include "tmap_bgzf_writer.h"
+
+#ifdef HAVE_LIBPTHREAD
+// the BGZF block header, the last two bytes hold the compressed length
+static const uint8_t tmap_bgzf_writer_magic[TMAP_BGZF_READER_HEADER_LENGTH] = "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\0\0";
+
+static inline void
+tmap_bgzf_writer_pack32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = value;
+  buffer[1] = value >> 8;
+  buffer[2] = value >> 16;
+  buffer[3] = value >> 24;
+}
+
+// same as bgzf_compress, but re-uses the zlib stream
+static int32_t
+tmap_bgzf_writer_compress(z_stream *zs, tmap_bgzf_writer_block_t *block)
+{
+  uint8_t *dst = block->compressed;
+  int32_t length;
+
+  if(Z_OK != deflateReset(zs)) return -1;
+  zs->next_in = block->data;
+  zs->avail_in = block->length;
+  zs->next_out = dst + TMAP_BGZF_READER_HEADER_LENGTH;
+  zs->avail_out = TMAP_BGZF_READER_MAX_BLOCK_SIZE - TMAP_BGZF_READER_HEADER_LENGTH - 8;
+  if(Z_STREAM_END != deflate(zs, Z_FINISH)) return -1;
+  length = zs->total_out + TMAP_BGZF_READER_HEADER_LENGTH + 8;
+
+  // header
+  memcpy(dst, tmap_bgzf_writer_magic, TMAP_BGZF_READER_HEADER_LENGTH);
+  dst[16] = (length - 1) & 0xff;
+  dst[17] = (length - 1) >> 8;
+  // footer
+  tmap_bgzf_writer_pack32(dst + length - 8, crc32(crc32(0L, NULL, 0L), block->data, block->length));
+  tmap_bgzf_writer_pack32(dst + length - 4, block->length);
+  block->compressed_length = length;
+
+  return 0;
+}
+
+static void *
+tmap_bgzf_writer_worker(void *arg)
+{
+  tmap_bgzf_writer_t *writer = (tmap_bgzf_writer_t*)arg;
+  tmap_bgzf_writer_block_t *block = NULL;
+  z_stream zs;
+  double t;
+  int32_t ret;
+  size_t n;
+
+  memset(&zs, 0, sizeof(z_stream));
+  if(Z_OK != deflateInit2(&zs, writer->compress_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) { // raw deflate
+      tmap_error("could not initialize the zlib stream", Exit, OutOfRange);
+  }
+
+  pthread_mutex_lock(&writer->mutex);
+  while(1) {
+      if(writer->num_compressing < writer->num_queued) {
+          // compress out of order
+          block = &writer->blocks[writer->num_compressing % writer->num_blocks];
+          writer->num_compressing++;
+          pthread_mutex_unlock(&writer->mutex);
+          t = tmap_time_realtime();
+          ret = tmap_bgzf_writer_compress(&zs, block);
+          t = tmap_time_realtime() - t;
+          pthread_mutex_lock(&writer->mutex);
+          writer->compress_time += t;
+          if(ret < 0) writer->errcode |= 1;
+          block->state = TMAP_BGZF_WRITER_BLOCK_DONE;
+
+          // write in order, one thread at a time
+          while(0 == writer->is_writing && writer->num_written < writer->num_compressing) {
+              block = &writer->blocks[writer->num_written % writer->num_blocks];
+              if(TMAP_BGZF_WRITER_BLOCK_DONE != block->state) break;
+              writer->is_writing = 1;
+              pthread_mutex_unlock(&writer->mutex);
+              n = fwrite(block->compressed, 1, block->compressed_length, writer->fp);
+              pthread_mutex_lock(&writer->mutex);
+              if(n != (size_t)block->compressed_length) writer->errcode |= 2;
+              block->state = TMAP_BGZF_WRITER_BLOCK_FREE;
+              writer->num_written++;
+              writer->is_writing = 0;
+              pthread_cond_broadcast(&writer->written_cond);
+          }
+      }
+      else if(1 == writer->stop) {
+          break;
+      }
+      else {
+          pthread_cond_wait(&writer->queued_cond, &writer->mutex);
+      }
+  }
+  pthread_mutex_unlock(&writer->mutex);
+
+  deflateEnd(&zs);
+
+  return arg;
+}
+
+// queues the block being filled, and waits for the next block to be free
+static void
+tmap_bgzf_writer_queue(tmap_bgzf_writer_t *writer)
+{
+  pthread_mutex_lock(&writer->mutex);
+  writer->block->state = TMAP_BGZF_WRITER_BLOCK_QUEUED;
+  writer->num_queued++;
+  pthread_cond_signal(&writer->queued_cond);
+  while(writer->num_blocks <= writer->num_queued - writer->num_written) {
+      pthread_cond_wait(&writer->written_cond, &writer->mutex);
+  }
+  writer->block = &writer->blocks[writer->num_queued % writer->num_blocks];
+  writer->block->length = 0;
+  pthread_mutex_unlock(&writer->mutex);
+}
+#endif
+
+tmap_bgzf_writer_t *
+tmap_bgzf_writer_init(FILE *fp, int32_t compress_level, int32_t num_threads)
+{
+#ifdef HAVE_LIBPTHREAD
+  tmap_bgzf_writer_t *writer = NULL;
+  int32_t i;
+
+  if(num_threads <= 0 || NULL == fp) return NULL;
+
+  writer = tmap_calloc(1, sizeof(tmap_bgzf_writer_t), "writer");
+  writer->fp = fp;
+  writer->compress_level = compress_level;
+  writer->num_blocks = num_threads * TMAP_BGZF_WRITER_BLOCKS_PER_THREAD;
+  writer->blocks = tmap_calloc(writer->num_blocks, sizeof(tmap_bgzf_writer_block_t), "writer->blocks");
+  writer->block = &writer->blocks[0];
+
+  pthread_mutex_init(&writer->mutex, NULL);
+  pthread_cond_init(&writer->queued_cond, NULL);
+  pthread_cond_init(&writer->written_cond, NULL);
+  writer->num_threads = num_threads;
+  writer->threads = tmap_calloc(num_threads, sizeof(pthread_t), "writer->threads");
+  for(i=0;i<num_threads;i++) {
+      if(0 != pthread_create(&writer->threads[i], NULL, tmap_bgzf_writer_worker, writer)) {
+          tmap_error("error creating threads", Exit, ThreadError);
+      }
+  }
+
+  return writer;
+#else
+  return NULL;
+#endif
+}
+
+int32_t
+tmap_bgzf_writer_flush(tmap_bgzf_writer_t *writer)
+{
+#ifdef HAVE_LIBPTHREAD
+  int32_t ret;
+
+  // queue the last block, and wait for all the blocks to be written
+  if(0 < writer->block->length) {
+      tmap_bgzf_writer_queue(writer);
+  }
+  pthread_mutex_lock(&writer->mutex);
+  while(writer->num_written < writer->num_queued) {
+      pthread_cond_wait(&writer->written_cond, &writer->mutex);
+  }
+  ret = (0 == writer->errcode) ? 0 : -1;
+  pthread_mutex_unlock(&writer->mutex);
+
+  return ret;
+#else
+  return 0;
+#endif
+}
+
+int32_t
+tmap_bgzf_writer_destroy(tmap_bgzf_writer_t *writer)
+{
+#ifdef HAVE_LIBPTHREAD
+  int32_t i, ret;
+
+  if(NULL == writer) return 0;
+
+  ret = tmap_bgzf_writer_flush(writer);
+  pthread_mutex_lock(&writer->mutex);
+  writer->stop = 1;
+  pthread_cond_broadcast(&writer->queued_cond);
+  pthread_mutex_unlock(&writer->mutex);
+  for(i=0;i<writer->num_threads;i++) {
+      if(0 != pthread_join(writer->threads[i], NULL)) {
+          tmap_error("error joining threads", Exit, ThreadError);
+      }
+  }
+  pthread_mutex_destroy(&writer->mutex);
+  pthread_cond_destroy(&writer->queued_cond);
+  pthread_cond_destroy(&writer->written_cond);
+
+  free(writer->threads);
+  free(writer->blocks);
+  free(writer);
+
+  return ret;
+#else
+  return 0;
+#endif
+}
+
+int32_t
+tmap_bgzf_writer_write(tmap_bgzf_writer_t *writer, const void *data, int32_t length)
+{
+#ifdef HAVE_LIBPTHREAD
+  const uint8_t *input = (const uint8_t*)data;
+  int32_t n = 0, l;
+
+  while(n < length) {
+      l = TMAP_BGZF_WRITER_BLOCK_SIZE - writer->block->length;
+      if(length - n < l) l = length - n;
+      memcpy(writer->block->data + writer->block->length, input + n, l);
+      writer->block->length += l;
+      n += l;
+      if(TMAP_BGZF_WRITER_BLOCK_SIZE == writer->block->length) {
+          tmap_bgzf_writer_queue(writer);
+      }
+  }
+
+  return n;
+#else
+  return 0;
+#endif
+}
+
+void
+tmap_bgzf_writer_flush_try(tmap_bgzf_writer_t *writer, int32_t length)
+{
+#ifdef HAVE_LIBPTHREAD
+  // NB: bgzf does not flush an empty block
+  if(0 < writer->block->length && TMAP_BGZF_WRITER_BLOCK_SIZE < writer->block->length + length) {
+      tmap_bgzf_writer_queue(writer);
+  }
+#endif
+}
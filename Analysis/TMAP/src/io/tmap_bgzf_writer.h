@@ -0,0 +1,122 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef TMAP_BGZF_WRITER_H
+#define TMAP_BGZF_WRITER_H
+
+#include <config.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#include "tmap_bgzf_reader.h"
+
+/*!
+  A BGZF Writer that compresses the blocks on several threads
+  */
+
+/*!
+  the number of uncompressed bytes in a block, as bgzf
+  */
+#define TMAP_BGZF_WRITER_BLOCK_SIZE 0xff00
+
+/*!
+  the number of blocks queued per thread
+  */
+#define TMAP_BGZF_WRITER_BLOCKS_PER_THREAD 8
+
+/*!
+  the state of a block
+  */
+enum {
+    TMAP_BGZF_WRITER_BLOCK_FREE = 0, /*!< the block is free, or being filled */
+    TMAP_BGZF_WRITER_BLOCK_QUEUED, /*!< the block is full, or flushed, and is waiting to be compressed */
+    TMAP_BGZF_WRITER_BLOCK_DONE /*!< the block was compressed, and is waiting to be written */
+};
+
+/*!
+  one BGZF block
+  */
+typedef struct {
+    int32_t length; /*!< the uncompressed length */
+    int32_t compressed_length; /*!< the compressed length, including the header and footer */
+    int32_t state; /*!< the state of the block */
+    uint8_t data[TMAP_BGZF_READER_MAX_BLOCK_SIZE]; /*!< the uncompressed block */
+    uint8_t compressed[TMAP_BGZF_READER_MAX_BLOCK_SIZE]; /*!< the compressed block */
+} tmap_bgzf_writer_block_t;
+
+/*!
+  The writing thread fills the blocks in order.  Full blocks are compressed by whichever
+  thread is free, and the compressed blocks are written to the file in order by the thread
+  that finds the oldest block compressed.  Blocks and their compressed bytes are the same
+  as those of bgzf, so the output is the same.
+  */
+typedef struct {
+    FILE *fp; /*!< the file pointer, not owned */
+    int32_t compress_level; /*!< the zlib compression level */
+    int32_t num_blocks; /*!< the number of blocks queued */
+    tmap_bgzf_writer_block_t *blocks; /*!< the blocks queued, used as a ring */
+    int64_t num_queued; /*!< the number of blocks queued by the writing thread */
+    int64_t num_compressing; /*!< the number of blocks taken for compression */
+    int64_t num_written; /*!< the number of blocks written to the file */
+    int32_t is_writing; /*!< 1 if a thread is writing blocks to the file, 0 otherwise */
+    tmap_bgzf_writer_block_t *block; /*!< the block being filled */
+    int32_t errcode; /*!< non-zero if compressing or writing failed */
+    int32_t stop; /*!< 1 if the threads should stop, 0 otherwise */
+    double compress_time; /*!< the time spent compressing, summed over the threads */
+#ifdef HAVE_LIBPTHREAD
+    int32_t num_threads; /*!< the number of compression threads */
+    pthread_t *threads; /*!< the compression threads */
+    pthread_mutex_t mutex; /*!< the mutex guarding the blocks */
+    pthread_cond_t queued_cond; /*!< signaled when a block was queued */
+    pthread_cond_t written_cond; /*!< signaled when a block was written */
+#endif
+} tmap_bgzf_writer_t;
+
+/*!
+  initializes the writer, starting the compression threads
+  @param  fp              the file pointer to write to; any data before must already be written
+  @param  compress_level  the zlib compression level
+  @param  num_threads     the number of compression threads
+  @return                 the initialized writer, NULL if the blocks cannot be compressed on multiple threads
+  */
+tmap_bgzf_writer_t *
+tmap_bgzf_writer_init(FILE *fp, int32_t compress_level, int32_t num_threads);
+
+/*!
+  writes all the blocks, stops the threads and destroys the writer
+  @param  writer  the writer to destroy
+  @return         0 on success, -1 if compressing or writing failed
+  @details  the file pointer is not closed, nor is an end-of-file block written
+  */
+int32_t
+tmap_bgzf_writer_destroy(tmap_bgzf_writer_t *writer);
+
+/*!
+  writes all the blocks, including the one being filled, as bgzf_flush
+  @param  writer  the writer
+  @return         0 on success, -1 if compressing or writing failed
+  @details  the compression time is final after this call
+  */
+int32_t
+tmap_bgzf_writer_flush(tmap_bgzf_writer_t *writer);
+
+/*!
+  writes data
+  @param  writer  the writer
+  @param  data    the data to write
+  @param  length  the number of bytes to write
+  @return         the number of bytes written, as bgzf_write
+  */
+int32_t
+tmap_bgzf_writer_write(tmap_bgzf_writer_t *writer, const void *data, int32_t length);
+
+/*!
+  queues the block being filled if the data will not fit, as bgzf_flush_try
+  @param  writer  the writer
+  @param  length  the number of bytes to be written
+  */
+void
+tmap_bgzf_writer_flush_try(tmap_bgzf_writer_t *writer, int32_t length);
+
+#endif // TMAP_BGZF_WRITER_H
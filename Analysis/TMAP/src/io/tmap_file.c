@@ -332,19 +332,44 @@ tmap_file_fread(void *ptr, size_t size, size_t count, tmap_file_t *fp)
   return num_read;
 }
 
+static int32_t tmap_file_mmap_hints = 0;
+
+void
+tmap_file_set_mmap_hints(int32_t hints)
+{
+  tmap_file_mmap_hints = hints;
+}
+
 void *
 tmap_file_mmap(tmap_file_t *fp, size_t *fp_length)
 {
-	  // size_t len;
-
 	  struct stat statbuf;
-	  fstat ( fileno(fp->fp),&statbuf );
+	  int flags = MAP_PRIVATE;
+	  char *ptr = NULL;
+
+	  if(0 != fstat ( fileno(fp->fp),&statbuf )) {
+		  return NULL;
+	  }
 	  fp->fileLen = statbuf.st_size;
 
 	  if(fp_length)
 		  *fp_length = fp->fileLen;
 
-	  fp->CurrentAllocPtr = ( char * ) mmap ( 0,fp->fileLen,PROT_READ,MAP_PRIVATE,fileno(fp->fp),0);
+#ifdef MAP_POPULATE
+	  if(tmap_file_mmap_hints & TMAP_FILE_MMAP_POPULATE)
+		  flags |= MAP_POPULATE;
+#endif
+	  ptr = ( char * ) mmap ( 0,fp->fileLen,PROT_READ,flags,fileno(fp->fp),0);
+	  if(MAP_FAILED == ptr) {
+		  return NULL;
+	  }
+#ifdef MADV_HUGEPAGE
+	  // NB: only a hint, file backed huge pages depend on the kernel and the file system
+	  if(tmap_file_mmap_hints & TMAP_FILE_MMAP_HUGEPAGE)
+		  madvise ( ptr,fp->fileLen,MADV_HUGEPAGE );
+#endif
+	  fp->CurrentAllocPtr = ptr;
+	  fp->CurrentAllocLen = fp->fileLen;
 
 	  return fp->CurrentAllocPtr;
 }
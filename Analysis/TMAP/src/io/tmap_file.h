@@ -31,6 +31,14 @@ enum {
     TMAP_FILE_BZ2_WRITE  /*!< a writing bzip2 stream */
 };
 
+/*! 
+  @details  hints for mapping files with tmap_file_mmap
+  */
+enum {
+    TMAP_FILE_MMAP_POPULATE=0x1,  /*!< read the whole file into the page cache and map it when mapping */
+    TMAP_FILE_MMAP_HUGEPAGE=0x2  /*!< advise the kernel to back the mapping with huge pages */
+};
+
 /*! 
   structure aggregating common file structures
   */
@@ -46,12 +54,11 @@ typedef struct {
     int32_t n_unused;  /*!< for bz2 function 'BZ2_bzReadGetUnused' */
     int32_t bzerror;  /*!< stores the last BZ2 error */
     int32_t open_type;  /*!< the type of bzip2 stream */
-    char *CurrentAllocPtr;
-    int CurrentAllocLen;
+#endif
+    char *CurrentAllocPtr;  /*!< the mmap'd file data, NULL if not mmap'd */
+    size_t CurrentAllocLen;  /*!< the length of the mmap'd file data */
     size_t PageSize;
     size_t fileLen;
-
-#endif
 } tmap_file_t;
 
 extern tmap_file_t *tmap_file_stdout; // to use, initialize this in your main
@@ -117,14 +124,22 @@ tmap_file_fread2(tmap_file_t *fp, void *ptr, unsigned int len);
 
 
 /*!
-  emulates mmap
+  emulates mmap; the file is mapped read-only, and the pages are shared through the
+  page cache with every other process mapping the same file
   @param  fp   pointer to the file structure from which to mmap
   @param  fp_length  return pointer to size of the file in bytes
-  @return      mmap'd pointer to the file data
+  @return      mmap'd pointer to the file data, NULL on failure
   */
 void *
 tmap_file_mmap(tmap_file_t *fp, size_t *fp_length);
 
+/*!
+  sets the hints used by later calls to tmap_file_mmap
+  @param  hints  zero or more of TMAP_FILE_MMAP_POPULATE and TMAP_FILE_MMAP_HUGEPAGE
+  */
+void
+tmap_file_set_mmap_hints(int32_t hints);
+
 
 /*! 
   emulates fgetc from stdio.h
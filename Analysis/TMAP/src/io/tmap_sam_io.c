@@ -35,6 +35,7 @@ tmap_sam_io_init_helper(const char *fn, int32_t is_bam)
       tmap_error(fn, Exit, OpenFileError);
   }
   samio->bam_end_vfo = 0;
+  samio->fn = (0 == is_bam) ? NULL : tmap_strdup(fn);
 
   // check if there are sequences in the header
   /*
@@ -68,6 +69,7 @@ tmap_sam_io_init2(const char *fn, const char *mode,
 
   // Open the file for writing
   io->fp = samopen(fn, mode, header);
+  io->is_bam_output = (NULL == strchr(mode, 'b')) ? 0 : 1;
 
   return io;
 }
@@ -75,7 +77,13 @@ tmap_sam_io_init2(const char *fn, const char *mode,
 void
 tmap_sam_io_destroy(tmap_sam_io_t *samio)
 {
+  tmap_bgzf_reader_destroy(samio->reader);
+  // NB: all the blocks must be written before the end-of-file block
+  if(0 != tmap_bgzf_writer_destroy(samio->writer)) {
+      tmap_error("could not write the BAM file", Exit, WriteFileError);
+  }
   samclose(samio->fp);
+  free(samio->fn);
   free(samio);
 }
 
@@ -106,24 +114,117 @@ tmap_sam_io_set_vfo(tmap_sam_io_t *samio, int64_t bam_start_vfo, int64_t bam_end
 }
 
 
+void
+tmap_sam_io_set_threads(tmap_sam_io_t *samio, int32_t num_threads)
+{
+  if(NULL != samio->reader || NULL == samio->fn) return;
+  if(1 == bam_is_be) return; // the records are read as in bam_read1, without swapping
+  // NB: the header was read, and any seek done, through the BGZF file
+  samio->reader = tmap_bgzf_reader_init(samio->fn, bam_tell(samio->fp->x.bam), num_threads);
+}
+
+void
+tmap_sam_io_set_write_threads(tmap_sam_io_t *samio, int32_t num_threads)
+{
+  BGZF *bgzf_fp = NULL;
+  if(NULL != samio->writer || 0 == samio->is_bam_output || NULL == samio->fp) return;
+  if(1 == bam_is_be) return; // the records are written as in bam_write1, without swapping
+  bgzf_fp = samio->fp->x.bam;
+  if(0 != bgzf_flush(bgzf_fp)) {
+      tmap_error("could not write the BAM file", Exit, WriteFileError);
+  }
+  samio->writer = tmap_bgzf_writer_init((FILE*)bgzf_fp->fp, bgzf_fp->compress_level, num_threads);
+}
+
+double
+tmap_sam_io_flush_write_threads(tmap_sam_io_t *samio)
+{
+  if(NULL == samio->writer) return 0.0;
+  if(0 != tmap_bgzf_writer_flush(samio->writer)) {
+      tmap_error("could not write the BAM file", Exit, WriteFileError);
+  }
+  return samio->writer->compress_time;
+}
+
+int32_t
+tmap_sam_io_write(tmap_sam_io_t *samio, const bam1_t *b)
+{
+  const bam1_core_t *c = &b->core;
+  uint32_t x[8], block_len;
+
+  if(NULL == samio->writer) return samwrite(samio->fp, b);
+
+  // same as bam_write1_core, but through the multi-threaded writer
+  block_len = b->data_len + BAM_CORE_SIZE;
+  x[0] = c->tid;
+  x[1] = c->pos;
+  x[2] = (uint32_t)c->bin<<16 | c->qual<<8 | c->l_qname;
+  x[3] = (uint32_t)c->flag<<16 | c->n_cigar;
+  x[4] = c->l_qseq;
+  x[5] = c->mtid;
+  x[6] = c->mpos;
+  x[7] = c->isize;
+  tmap_bgzf_writer_flush_try(samio->writer, 4 + block_len);
+  tmap_bgzf_writer_write(samio->writer, &block_len, 4);
+  tmap_bgzf_writer_write(samio->writer, x, BAM_CORE_SIZE);
+  tmap_bgzf_writer_write(samio->writer, b->data, b->data_len);
+
+  return 4 + block_len;
+}
+
+// same as bam_read1, but through the multi-threaded reader
+static int32_t
+tmap_sam_io_bam_read1(tmap_bgzf_reader_t *reader, bam1_t *b)
+{
+  bam1_core_t *c = &b->core;
+  int32_t block_len, ret;
+  uint32_t x[8];
+
+  if((ret = tmap_bgzf_reader_read(reader, &block_len, 4)) != 4) {
+      if(ret == 0) return -1; // normal end-of-file
+      else return -2; // truncated
+  }
+  if(tmap_bgzf_reader_read(reader, x, BAM_CORE_SIZE) != BAM_CORE_SIZE) return -3;
+  c->tid = x[0]; c->pos = x[1];
+  c->bin = x[2]>>16; c->qual = x[2]>>8&0xff; c->l_qname = x[2]&0xff;
+  c->flag = x[3]>>16; c->n_cigar = x[3]&0xffff;
+  c->l_qseq = x[4];
+  c->mtid = x[5]; c->mpos = x[6]; c->isize = x[7];
+  b->data_len = block_len - BAM_CORE_SIZE;
+  if(b->m_data < b->data_len) {
+      b->m_data = b->data_len;
+      tmap_roundup32(b->m_data);
+      b->data = tmap_realloc(b->data, b->m_data, "b->data");
+  }
+  if(tmap_bgzf_reader_read(reader, b->data, b->data_len) != b->data_len) return -4;
+  b->l_aux = b->data_len - c->n_cigar * 4 - c->l_qname - c->l_qseq - (c->l_qseq+1)/2;
+  if(bam_no_B) bam_remove_B(b);
+  return 4 + block_len;
+}
+
 int32_t
 tmap_sam_io_read(tmap_sam_io_t *samio, tmap_sam_t *sam)
 {
-  if(NULL != sam->b) {
-      bam_destroy1(sam->b);
+  int32_t ret;
+
+  // NB: the record is re-used, its memory is kept between reads
+  if(NULL == sam->b) {
+      sam->b = bam_init1();
   }
-  sam->b = bam_init1();
 
   // check if we're past optional end bam virtual file offset
   if (samio->bam_end_vfo > 0) {
-      BGZF* bgzf_fp = samio->fp->x.bam;
-      if (bam_tell(bgzf_fp) >= samio->bam_end_vfo) {
+      int64_t vfo = (NULL == samio->reader) ? bam_tell(samio->fp->x.bam) : tmap_bgzf_reader_tell(samio->reader);
+      if (vfo >= samio->bam_end_vfo) {
          fprintf(stderr, "stopping at bam virtual file offset %" PRId64 "\n", samio->bam_end_vfo);
          return -1;
       }
   }
 
-  if(0 < samread(samio->fp, sam->b)) {
+  if(NULL == samio->reader) ret = samread(samio->fp, sam->b);
+  else ret = tmap_sam_io_bam_read1(samio->reader, sam->b);
+
+  if(0 < ret) {
       char *str;
       int32_t i, len;
 
@@ -6,6 +6,8 @@
 
 #include "../samtools/bam.h"
 #include "../samtools/sam.h"
+#include "tmap_bgzf_reader.h"
+#include "tmap_bgzf_writer.h"
 
 /*! 
   A SAM/BAM Reading Library
@@ -16,6 +18,10 @@
 typedef struct _tmap_sam_io_t {
     samfile_t *fp;  /*!< the file pointer to the SAM/BAM file */
     int64_t bam_end_vfo;  /*!< virtual file offset at which to stop reading the BAM file; zero means disabled */
+    char *fn; /*!< the BAM input file name, NULL otherwise */
+    tmap_bgzf_reader_t *reader; /*!< the reader decompressing the BAM file on several threads, NULL if not used */
+    int32_t is_bam_output; /*!< 1 if writing a BAM file, 0 otherwise */
+    tmap_bgzf_writer_t *writer; /*!< the writer compressing the BAM file on several threads, NULL if not used */
 } tmap_sam_io_t;
 
 #include "../seq/tmap_sam.h"
@@ -63,6 +69,41 @@ tmap_sam_io_destroy(tmap_sam_io_t *samio);
 void
 tmap_sam_io_set_vfo(tmap_sam_io_t *samio, int64_t bam_start_vfo, int64_t bam_end_vfo);
 
+/*!
+  decompresses the BAM file on several threads from its current position
+  @param  samio        a pointer to a previously initialized SAM/BAM structure
+  @param  num_threads  the number of decompression threads
+  @details  has no effect for SAM files or when reading from the standard input; must be called after tmap_sam_io_set_vfo
+  */
+void
+tmap_sam_io_set_threads(tmap_sam_io_t *samio, int32_t num_threads);
+
+/*!
+  compresses the BAM output on several threads from its current position
+  @param  samio        a pointer to a previously initialized SAM/BAM structure
+  @param  num_threads  the number of compression threads
+  @details  has no effect for SAM files; must be called after the header was written
+  */
+void
+tmap_sam_io_set_write_threads(tmap_sam_io_t *samio, int32_t num_threads);
+
+/*!
+  writes all the BAM blocks compressed on several threads
+  @param  samio  a pointer to a previously initialized SAM/BAM structure
+  @return        the time spent compressing on those threads so far, in seconds
+  */
+double
+tmap_sam_io_flush_write_threads(tmap_sam_io_t *samio);
+
+/*!
+  writes a SAM/BAM record, as samwrite
+  @param  samio  a pointer to a previously initialized SAM/BAM structure
+  @param  b      the record to write
+  @return        the number of bytes written, zero or less on failure
+  */
+int32_t
+tmap_sam_io_write(tmap_sam_io_t *samio, const bam1_t *b);
+
 /*!
   reads in a reading structure
   @param  samio  a pointer to a previously initialized SAM/BAM structure
@@ -4,6 +4,9 @@
 #include <unistd.h>
 #include <math.h>
 #include <getopt.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "../util/tmap_error.h"
 #include "../util/tmap_alloc.h"
@@ -15,6 +18,25 @@
 #include "tmap_seq_io.h"
 #include "tmap_seqs_io.h"
 
+// the sequences read ahead on another thread, in a ring of batches
+struct __tmap_seqs_io_pipeline_t {
+    sam_header_t *header; // the (output) SAM header
+    tmap_seqs_t ***batches; // the batches, each of TMAP_SEQS_IO_PIPELINE_BATCH_SIZE sequences
+    int32_t *lengths; // the number of sequences read into each batch
+    int32_t num_batches; // the number of batches
+    int32_t head; // the oldest loaded batch
+    int32_t num_loaded; // the number of loaded batches
+    int32_t next; // the next sequence to hand over in the oldest loaded batch
+    int32_t eof; // 1 if all the sequences were read, 0 otherwise
+    int32_t stop; // 1 if the reading thread should stop, 0 otherwise
+#ifdef HAVE_LIBPTHREAD
+    pthread_t thread; // the reading thread
+    pthread_mutex_t mutex; // guards the batches
+    pthread_cond_t loaded_cond; // signaled when a batch was loaded
+    pthread_cond_t free_cond; // signaled when a batch was handed over
+#endif
+};
+
 inline tmap_seqs_io_t*
 tmap_seqs_io_init(char **fns, int32_t fn_num, int8_t seq_type, int32_t compression, int64_t bam_start_vfo, int64_t bam_end_vfo)
 {
@@ -50,7 +72,32 @@ tmap_seqs_io_init(char **fns, int32_t fn_num, int8_t seq_type, int32_t compressi
 inline void
 tmap_seqs_io_destroy(tmap_seqs_io_t *io)
 {
-  int32_t i;
+  int32_t i, j;
+  if(NULL != io->pipeline) {
+      struct __tmap_seqs_io_pipeline_t *p = io->pipeline;
+#ifdef HAVE_LIBPTHREAD
+      // stop the reading thread
+      pthread_mutex_lock(&p->mutex);
+      p->stop = 1;
+      pthread_cond_broadcast(&p->free_cond);
+      pthread_mutex_unlock(&p->mutex);
+      if(0 != pthread_join(p->thread, NULL)) {
+          tmap_error("error joining threads", Exit, ThreadError);
+      }
+      pthread_mutex_destroy(&p->mutex);
+      pthread_cond_destroy(&p->loaded_cond);
+      pthread_cond_destroy(&p->free_cond);
+#endif
+      for(i=0;i<p->num_batches;i++) {
+          for(j=0;j<TMAP_SEQS_IO_PIPELINE_BATCH_SIZE;j++) {
+              if(NULL != p->batches[i][j]) tmap_seqs_destroy(p->batches[i][j]);
+          }
+          free(p->batches[i]);
+      }
+      free(p->batches);
+      free(p->lengths);
+      free(p);
+  }
   for(i=0;i<io->n;i++) {
       tmap_seq_io_destroy(io->seqios[i]);
   }
@@ -102,13 +149,11 @@ tmap_seqs_io_read(tmap_seqs_io_t *io, tmap_seqs_t *seqs, sam_header_t *header)
   return 0;
 }
 
-int
-tmap_seqs_io_read_buffer(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t buffer_length, sam_header_t *header)
+static int
+tmap_seqs_io_read_buffer_core(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t buffer_length, sam_header_t *header)
 {
   int32_t n = 0;
 
-  if(buffer_length <= 0) return 0;
-
   while(n < buffer_length) {
       if(NULL == seqs_buffer[n]) {
           seqs_buffer[n] = tmap_seqs_init(io->type);
@@ -126,6 +171,123 @@ tmap_seqs_io_read_buffer(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t
   return n;
 }
 
+#ifdef HAVE_LIBPTHREAD
+static void *
+tmap_seqs_io_pipeline_worker(void *arg)
+{
+  tmap_seqs_io_t *io = (tmap_seqs_io_t*)arg;
+  struct __tmap_seqs_io_pipeline_t *p = io->pipeline;
+  int32_t b, n;
+
+  while(1) {
+      // wait for a free batch
+      pthread_mutex_lock(&p->mutex);
+      while(p->num_batches == p->num_loaded && 0 == p->stop) {
+          pthread_cond_wait(&p->free_cond, &p->mutex);
+      }
+      if(1 == p->stop) {
+          pthread_mutex_unlock(&p->mutex);
+          break;
+      }
+      b = (p->head + p->num_loaded) % p->num_batches;
+      pthread_mutex_unlock(&p->mutex);
+
+      // only this thread touches a free batch
+      n = tmap_seqs_io_read_buffer_core(io, p->batches[b], TMAP_SEQS_IO_PIPELINE_BATCH_SIZE, p->header);
+
+      pthread_mutex_lock(&p->mutex);
+      p->lengths[b] = n;
+      p->num_loaded++;
+      if(n < TMAP_SEQS_IO_PIPELINE_BATCH_SIZE) p->eof = 1;
+      pthread_cond_signal(&p->loaded_cond);
+      pthread_mutex_unlock(&p->mutex);
+      if(n < TMAP_SEQS_IO_PIPELINE_BATCH_SIZE) break;
+  }
+
+  return arg;
+}
+
+static int
+tmap_seqs_io_read_buffer_pipeline(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t buffer_length)
+{
+  struct __tmap_seqs_io_pipeline_t *p = io->pipeline;
+  tmap_seqs_t **batch = NULL, *seqs = NULL;
+  int32_t n = 0;
+
+  pthread_mutex_lock(&p->mutex);
+  while(n < buffer_length) {
+      while(0 == p->num_loaded && 0 == p->eof) {
+          pthread_cond_wait(&p->loaded_cond, &p->mutex);
+      }
+      if(0 == p->num_loaded) break; // no more sequences
+      // swap, so the sequences in the buffer are re-used
+      batch = p->batches[p->head];
+      while(n < buffer_length && p->next < p->lengths[p->head]) {
+          seqs = seqs_buffer[n];
+          seqs_buffer[n] = batch[p->next];
+          batch[p->next] = seqs;
+          n++;
+          p->next++;
+      }
+      if(p->lengths[p->head] == p->next) { // hand the batch back
+          p->head = (p->head + 1) % p->num_batches;
+          p->num_loaded--;
+          p->next = 0;
+          pthread_cond_signal(&p->free_cond);
+      }
+  }
+  pthread_mutex_unlock(&p->mutex);
+
+  return n;
+}
+#endif
+
+int
+tmap_seqs_io_read_buffer(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t buffer_length, sam_header_t *header)
+{
+  if(buffer_length <= 0) return 0;
+#ifdef HAVE_LIBPTHREAD
+  if(NULL != io->pipeline) {
+      return tmap_seqs_io_read_buffer_pipeline(io, seqs_buffer, buffer_length);
+  }
+#endif
+  return tmap_seqs_io_read_buffer_core(io, seqs_buffer, buffer_length, header);
+}
+
+void
+tmap_seqs_io_start(tmap_seqs_io_t *io, sam_header_t *header, int32_t buffer_length, int32_t bam_threads)
+{
+#ifdef HAVE_LIBPTHREAD
+  struct __tmap_seqs_io_pipeline_t *p = NULL;
+  int32_t i;
+
+  if(NULL != io->pipeline) return;
+
+  // decompress BAM input on several threads
+  if(0 < bam_threads && TMAP_SEQ_TYPE_BAM == io->type) {
+      tmap_sam_io_set_threads(io->seqios[0]->io.samio, bam_threads);
+  }
+
+  p = tmap_calloc(1, sizeof(struct __tmap_seqs_io_pipeline_t), "p");
+  p->header = header;
+  p->num_batches = (buffer_length + TMAP_SEQS_IO_PIPELINE_BATCH_SIZE - 1) / TMAP_SEQS_IO_PIPELINE_BATCH_SIZE;
+  if(p->num_batches < 2) p->num_batches = 2;
+  p->batches = tmap_malloc(sizeof(tmap_seqs_t**) * p->num_batches, "p->batches");
+  for(i=0;i<p->num_batches;i++) {
+      p->batches[i] = tmap_calloc(TMAP_SEQS_IO_PIPELINE_BATCH_SIZE, sizeof(tmap_seqs_t*), "p->batches[i]");
+  }
+  p->lengths = tmap_calloc(p->num_batches, sizeof(int32_t), "p->lengths");
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->loaded_cond, NULL);
+  pthread_cond_init(&p->free_cond, NULL);
+
+  io->pipeline = p;
+  if(0 != pthread_create(&p->thread, NULL, tmap_seqs_io_pipeline_worker, io)) {
+      tmap_error("error creating threads", Exit, ThreadError);
+  }
+#endif
+}
+
 static void
 tmap_seqs_io_init2_fs_and_add(tmap_seqs_io_t *io_in,
                               sam_header_t *header,
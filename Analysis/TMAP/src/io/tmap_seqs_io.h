@@ -17,12 +17,18 @@
   An Abstract DNA Sequence Reading Library
   */
 
+/*!
+  the number of sequences handed over at a time by the reading thread
+  */
+#define TMAP_SEQS_IO_PIPELINE_BATCH_SIZE 4096
+
 /*! 
 */
 typedef struct {
   int8_t type;  /*!< the type of io associated with this structure */
   tmap_seq_io_t **seqios; // TODO
   int32_t n; // TODO
+  struct __tmap_seqs_io_pipeline_t *pipeline; /*!< the sequences read ahead on another thread, NULL if read on the calling thread */
 } tmap_seqs_io_t;
 
 /*! 
@@ -62,10 +68,24 @@ tmap_seqs_io_read(tmap_seqs_io_t *io, tmap_seqs_t *seqs, sam_header_t *header);
   @param  buffer_length  the number of sequences to read
   @param  header         the (output) SAM header
   @return                the number of sequences read
+  @details  once tmap_seqs_io_start was called, the sequences already read are swapped
+  into the buffer, and the sequences in the buffer are re-used by the reading thread
   */
 int
 tmap_seqs_io_read_buffer(tmap_seqs_io_t *io, tmap_seqs_t **seqs_buffer, int32_t buffer_length, sam_header_t *header);
 
+/*!
+  starts reading (and parsing) the sequences ahead on another thread, in batches of
+  TMAP_SEQS_IO_PIPELINE_BATCH_SIZE
+  @param  io             a pointer to a previously initialized sequence structure
+  @param  header         the (output) SAM header
+  @param  buffer_length  the number of sequences to read ahead
+  @param  bam_threads    the number of threads decompressing BAM input, 0 to decompress on the reading thread
+  @details  the reading thread is stopped by tmap_seqs_io_destroy; has no effect without pthreads
+  */
+void
+tmap_seqs_io_start(tmap_seqs_io_t *io, sam_header_t *header, int32_t buffer_length, int32_t bam_threads);
+
 /*!
   creates a new BAM header
   @param  refseq  the reference sequence structure
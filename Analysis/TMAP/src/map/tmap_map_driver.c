@@ -1,5 +1,6 @@
 /* Copyright (C) 2010 Ion Torrent Systems, Inc. All Rights Reserved */
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include <config.h>
@@ -17,6 +18,7 @@
 #include "../util/tmap_sort.h"
 #include "../util/tmap_rand.h"
 #include "../util/tmap_hash.h"
+#include "../util/tmap_time.h"
 #include "../seq/tmap_seq.h"
 #include "../index/tmap_refseq.h"
 #include "../index/tmap_bwt_gen.h"
@@ -969,13 +971,207 @@ void tail_repeat_clip_reads (tmap_seqs_t *seqs_buffer, tmap_refseq_t* refseq, tm
     }
 }
 
+#ifdef HAVE_LIBPTHREAD
+#define tmap_map_driver_sched_lock(sched) pthread_mutex_lock(&(sched)->mutex)
+#define tmap_map_driver_sched_unlock(sched) pthread_mutex_unlock(&(sched)->mutex)
+#define tmap_map_driver_sched_wait(sched, cond) pthread_cond_wait(&(sched)->cond, &(sched)->mutex)
+#define tmap_map_driver_sched_broadcast(sched, cond) pthread_cond_broadcast(&(sched)->cond)
+#else
+#define tmap_map_driver_sched_lock(sched)
+#define tmap_map_driver_sched_unlock(sched)
+#define tmap_map_driver_sched_wait(sched, cond) tmap_bug()
+#define tmap_map_driver_sched_broadcast(sched, cond)
+#endif
+
+static void
+tmap_map_driver_sched_init(tmap_map_driver_sched_t *sched, int32_t reads_queue_size, int32_t seq_type)
+{
+  int32_t i, j;
+  for(i=0;i<TMAP_MAP_DRIVER_NUM_BATCHES;i++) {
+      tmap_map_driver_batch_t *batch = &sched->batches[i];
+      batch->seqs_buffer = tmap_malloc(sizeof(tmap_seqs_t*)*reads_queue_size, "batch->seqs_buffer");
+      for(j=0;j<reads_queue_size;j++) {
+          batch->seqs_buffer[j] = tmap_seqs_init(seq_type);
+      }
+      batch->records = tmap_calloc(reads_queue_size, sizeof(tmap_map_record_t*), "batch->records");
+      batch->bams = tmap_calloc(reads_queue_size, sizeof(tmap_map_bams_t*), "batch->bams");
+      batch->done = tmap_calloc(reads_queue_size, sizeof(int32_t), "batch->done");
+      batch->seqs_buffer_length = batch->next = 0;
+      batch->first_read = 0;
+      batch->do_pairing = 0;
+  }
+  sched->head = sched->num_loaded = 0;
+  sched->eof = sched->drain = 0;
+  sched->num_reads = 0;
+  sched->stat = NULL;
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_init(&sched->mutex, NULL);
+  pthread_cond_init(&sched->loaded_cond, NULL);
+  pthread_cond_init(&sched->done_cond, NULL);
+  pthread_cond_init(&sched->free_cond, NULL);
+#endif
+}
+
+static void
+tmap_map_driver_sched_destroy(tmap_map_driver_sched_t *sched, int32_t reads_queue_size)
+{
+  int32_t i, j;
+  for(i=0;i<TMAP_MAP_DRIVER_NUM_BATCHES;i++) {
+      tmap_map_driver_batch_t *batch = &sched->batches[i];
+      for(j=0;j<reads_queue_size;j++) {
+          tmap_seqs_destroy(batch->seqs_buffer[j]);
+      }
+      free(batch->seqs_buffer);
+      free(batch->records);
+      free(batch->bams);
+      free(batch->done);
+  }
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_destroy(&sched->mutex);
+  pthread_cond_destroy(&sched->loaded_cond);
+  pthread_cond_destroy(&sched->done_cond);
+  pthread_cond_destroy(&sched->free_cond);
+#endif
+}
+
+// reads the next batch from the input once a batch is free, returns the number of reads
+static int32_t
+tmap_map_driver_sched_load(tmap_map_driver_sched_t *sched, tmap_seqs_io_t *io_in, int32_t reads_queue_size, sam_header_t *header
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+                           , tmap_map_driver_t *driver, tmap_rand_t *rand_core
+#endif
+                           )
+{
+  tmap_map_driver_batch_t *batch = NULL;
+  int32_t seqs_buffer_length;
+
+  tmap_map_driver_sched_lock(sched);
+  while(TMAP_MAP_DRIVER_NUM_BATCHES == sched->num_loaded) {
+      tmap_map_driver_sched_wait(sched, free_cond);
+  }
+  batch = &sched->batches[(sched->head + sched->num_loaded) % TMAP_MAP_DRIVER_NUM_BATCHES];
+  tmap_map_driver_sched_unlock(sched);
+
+  // only this thread touches a free batch
+  seqs_buffer_length = tmap_seqs_io_read_buffer(io_in, batch->seqs_buffer, reads_queue_size, header);
+
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+  // sample reads
+  {
+      int32_t i, j;
+      if(driver->opt->sample_reads < 1) {
+          for(i=j=0;i<seqs_buffer_length;i++) {
+              if(driver->opt->sample_reads < tmap_rand_get(rand_core)) continue; // skip
+              if(j < i) {
+                  tmap_seqs_t *seqs;
+                  seqs = batch->seqs_buffer[j];
+                  batch->seqs_buffer[j] = batch->seqs_buffer[i]; 
+                  batch->seqs_buffer[i] = seqs;
+              }
+              j++;
+          }
+          tmap_progress_print2("sampling %d out of %d [%.2lf%%]", j, seqs_buffer_length, 100.0*j/(double)seqs_buffer_length);
+          seqs_buffer_length = j;
+      }
+  }
+#endif
+
+  memset(batch->done, 0, sizeof(int32_t) * reads_queue_size);
+  batch->next = 0;
+  batch->do_pairing = 0;
+
+  tmap_map_driver_sched_lock(sched);
+  batch->seqs_buffer_length = seqs_buffer_length;
+  batch->first_read = sched->num_reads;
+  sched->num_reads += seqs_buffer_length;
+  sched->num_loaded++;
+  if(0 == seqs_buffer_length) sched->eof = 1;
+  tmap_map_driver_sched_broadcast(sched, loaded_cond);
+  tmap_map_driver_sched_unlock(sched);
+
+  return seqs_buffer_length;
+}
+
+// the next read to map; a new chunk is taken from the oldest batch with reads left once
+// the current chunk [*next, *high) is used up. Returns -1 when there is nothing left to map.
+static int32_t
+tmap_map_driver_sched_next(tmap_map_driver_sched_t *sched, tmap_map_driver_batch_t **batch, int32_t *next, int32_t *high)
+{
+  int32_t i;
+  if(*next < *high) return (*next)++;
+
+  tmap_map_driver_sched_lock(sched);
+  while(1) {
+      for(i=0;i<sched->num_loaded;i++) {
+          tmap_map_driver_batch_t *b = &sched->batches[(sched->head + i) % TMAP_MAP_DRIVER_NUM_BATCHES];
+          if(b->next < b->seqs_buffer_length) {
+              (*batch) = b;
+              (*next) = b->next;
+              (*high) = (b->seqs_buffer_length < b->next + TMAP_MAP_DRIVER_CHUNK_SIZE) ? b->seqs_buffer_length : b->next + TMAP_MAP_DRIVER_CHUNK_SIZE;
+              b->next = (*high);
+              tmap_map_driver_sched_unlock(sched);
+              return (*next)++;
+          }
+      }
+      if(1 == sched->eof || 1 == sched->drain) break;
+      tmap_map_driver_sched_wait(sched, loaded_cond);
+  }
+  tmap_map_driver_sched_unlock(sched);
+  return -1;
+}
+
+// marks the read as mapped, and adds the thread statistics to the shared ones
+static void
+tmap_map_driver_sched_done(tmap_map_driver_sched_t *sched, tmap_map_driver_batch_t *batch, int32_t low, tmap_map_stats_t *stat)
+{
+  tmap_map_driver_sched_lock(sched);
+  batch->done[low] = 1;
+  if(NULL != sched->stat && NULL != stat && sched->stat != stat) {
+      tmap_map_stats_add(sched->stat, stat);
+      tmap_map_stats_zero(stat);
+  }
+  tmap_map_driver_sched_broadcast(sched, done_cond);
+  tmap_map_driver_sched_unlock(sched);
+}
+
+// the oldest loaded batch, once it is loaded
+static tmap_map_driver_batch_t *
+tmap_map_driver_sched_head(tmap_map_driver_sched_t *sched)
+{
+  tmap_map_driver_batch_t *batch = NULL;
+  tmap_map_driver_sched_lock(sched);
+  while(0 == sched->num_loaded) {
+      tmap_map_driver_sched_wait(sched, loaded_cond);
+  }
+  batch = &sched->batches[sched->head];
+  tmap_map_driver_sched_unlock(sched);
+  return batch;
+}
+
+// waits until the read of the batch is mapped
+static void
+tmap_map_driver_sched_wait_done(tmap_map_driver_sched_t *sched, tmap_map_driver_batch_t *batch, int32_t i)
+{
+  tmap_map_driver_sched_lock(sched);
+  while(0 == batch->done[i]) {
+      tmap_map_driver_sched_wait(sched, done_cond);
+  }
+  tmap_map_driver_sched_unlock(sched);
+}
+
+// frees the oldest batch for loading
+static void
+tmap_map_driver_sched_pop(tmap_map_driver_sched_t *sched)
+{
+  tmap_map_driver_sched_lock(sched);
+  sched->head = (sched->head + 1) % TMAP_MAP_DRIVER_NUM_BATCHES;
+  sched->num_loaded--;
+  tmap_map_driver_sched_broadcast(sched, free_cond);
+  tmap_map_driver_sched_unlock(sched);
+}
+
 void
-tmap_map_driver_core_worker(sam_header_t *sam_header,
-                            tmap_seqs_t **seqs_buffer, 
-                            tmap_map_record_t **records, 
-                            tmap_map_bams_t **bams,
-                            int32_t seqs_buffer_length,
-                            int32_t *buffer_idx,
+tmap_map_driver_core_worker(tmap_map_driver_sched_t *sched,
                             tmap_index_t *index,
                             tmap_map_driver_t *driver,
                             tmap_map_stats_t *stat,
@@ -983,14 +1179,18 @@ tmap_map_driver_core_worker(sam_header_t *sam_header,
                             // DVK - realigner
                             struct RealignProxy* realigner,
                             struct RealignProxy* context,
-                            int32_t do_pairing,
                             int32_t tid)
 {
-    int32_t i, j, k, low = 0;
+    int32_t i, j, k, low, next = 0, high = 0;
     int32_t found;
     tmap_seq_t*** seqs = NULL;
     tmap_bwt_match_hash_t* hash=NULL;
     int32_t max_num_ends = 0;
+    tmap_map_driver_batch_t *batch = NULL;
+    tmap_seqs_t **seqs_buffer = NULL;
+    tmap_map_record_t **records = NULL;
+    tmap_map_bams_t **bams = NULL;
+    int32_t do_pairing = 0;
 
     // common memory resource for all target fragments
     // common memory resource for WS traceback paths
@@ -1015,10 +1215,13 @@ tmap_map_driver_core_worker(sam_header_t *sam_header,
     // initialize thread data
     tmap_map_driver_do_threads_init (driver, tid);
 
-    // Go through the buffer
-    while (low < seqs_buffer_length) 
+    // Go through the reads, a chunk at a time
+    while (0 <= (low = tmap_map_driver_sched_next (sched, &batch, &next, &high))) 
     {
-        if (tid == (low % driver->opt->num_threads)) 
+        seqs_buffer = batch->seqs_buffer;
+        records = batch->records;
+        bams = batch->bams;
+        do_pairing = batch->do_pairing;
         {
             tmap_map_stats_t *stage_stat = NULL;
             tmap_map_record_t *record_prev = NULL;
@@ -1042,9 +1245,11 @@ tmap_map_driver_core_worker(sam_header_t *sam_header,
                 }
                 max_num_ends = num_ends;
             }
-            // re-initialize the random seed
+            // re-initialize the random seed, from the read and not from the thread that maps it
             if(driver->opt->rand_read_name)
                 tmap_rand_reinit(rand, tmap_hash_str_hash_func_exc(tmap_seq_get_name(seqs_buffer[low]->seqs[0])->s, driver->opt->prefix_exclude, driver->opt->suffix_exclude));
+            else
+                tmap_rand_reinit(rand, batch->first_read + low);
 
             // init
             for(i = 0; i < num_ends; i++) 
@@ -1413,10 +1618,8 @@ tmap_map_driver_core_worker(sam_header_t *sam_header,
             tmap_map_record_destroy (record_prev);
         }
         // next
-        (*buffer_idx) = low;
-        low++;
+        tmap_map_driver_sched_done (sched, batch, low, stat);
     }
-    (*buffer_idx) = seqs_buffer_length;
 
     // free thread variables
     for (i = 0; i < max_num_ends; i++) 
@@ -1438,134 +1641,90 @@ tmap_map_driver_core_thread_worker(void *arg)
 {
   tmap_map_driver_thread_data_t *thread_data = (tmap_map_driver_thread_data_t*)arg;
 
-  tmap_map_driver_core_worker(thread_data->sam_header, thread_data->seqs_buffer, thread_data->records, thread_data->bams, 
-                              thread_data->seqs_buffer_length, thread_data->buffer_idx, thread_data->index, thread_data->driver, 
-                              thread_data->stat, thread_data->rand, /* DVK - realigner */ thread_data->realigner, thread_data->context, thread_data->do_pairing, thread_data->tid);
+  tmap_map_driver_core_worker(thread_data->sched, thread_data->index, thread_data->driver, 
+                              thread_data->stat, thread_data->rand, /* DVK - realigner */ thread_data->realigner, thread_data->context, thread_data->tid);
 
   return arg;
 }
 
-//static inline void
-static int32_t
-tmap_map_driver_create_threads(sam_header_t *header,
-                               tmap_seqs_t **seqs_buffer, 
-                               tmap_map_record_t **records, 
-                               tmap_map_bams_t **bams,
-                               int32_t seqs_buffer_length,
+#ifdef HAVE_LIBPTHREAD
+// starts the mapping threads, they run until tmap_map_driver_sched_next runs out of reads
+static void
+tmap_map_driver_create_threads(tmap_map_driver_sched_t *sched,
                                tmap_index_t *index,
                                tmap_map_driver_t *driver,
-                               tmap_map_stats_t *stat,
-#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-                               tmap_rand_t *rand_core,
-#endif
-#ifdef HAVE_LIBPTHREAD
                                pthread_attr_t **attr,
                                pthread_t **threads,
                                tmap_map_driver_thread_data_t **thread_data,
                                tmap_rand_t **rand,
                                tmap_map_stats_t **stats,
                                struct RealignProxy** realigner,
-                               struct RealignProxy** context,
-#endif
-                               int32_t do_pairing)
+                               struct RealignProxy** context)
 {
-#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-  int32_t j;
-#endif
-  int32_t buffer_idx; // buffer index for processing data with a single thread
+  int32_t i;
+  (*attr) = tmap_calloc(1, sizeof(pthread_attr_t), "(*attr)");
+  pthread_attr_init((*attr));
+  pthread_attr_setdetachstate((*attr), PTHREAD_CREATE_JOINABLE);
 
-#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-  // sample reads
-  {
-      int32_t i;
-      if(driver->opt->sample_reads < 1) {
-          for(i=j=0;i<seqs_buffer_length;i++) {
-              if(driver->opt->sample_reads < tmap_rand_get(rand_core)) continue; // skip
-              if(j < i) {
-                  tmap_seqs_t *seqs;
-                  seqs = seqs_buffer[j];
-                  seqs_buffer[j] = seqs_buffer[i]; 
-                  seqs_buffer[i] = seqs;
-              }
-              j++;
-          }
-          tmap_progress_print2("sampling %d out of %d [%.2lf%%]", j, seqs_buffer_length, 100.0*j/(double)seqs_buffer_length);
-          seqs_buffer_length = j;
-          if(0 == seqs_buffer_length) return 0;
+  (*threads) = tmap_calloc(driver->opt->num_threads, sizeof(pthread_t), "(*threads)");
+  (*thread_data) = tmap_calloc(driver->opt->num_threads, sizeof(tmap_map_driver_thread_data_t), "(*thread_data)");
+
+  // create threads
+  for(i=0;i<driver->opt->num_threads;i++) {
+      (*thread_data)[i].sched = sched;
+      (*thread_data)[i].index = index;
+      (*thread_data)[i].driver = driver;
+      if(NULL != stats) (*thread_data)[i].stat = stats[i];
+      else (*thread_data)[i].stat = NULL;
+      (*thread_data)[i].rand = rand[i];
+      // DVK - realigner
+      (*thread_data)[i].realigner = realigner [i];
+      (*thread_data)[i].context = context [i];
+      (*thread_data)[i].tid = i;
+      if(0 != pthread_create(&(*threads)[i], (*attr), tmap_map_driver_core_thread_worker, &(*thread_data)[i])) {
+          tmap_error("error creating threads", Exit, ThreadError);
       }
   }
-#endif
+}
 
-  // do alignment
-#ifdef HAVE_LIBPTHREAD
-  if(1 == driver->opt->num_threads) {
-      buffer_idx = 0;
-      tmap_map_driver_core_worker(header, seqs_buffer, records, bams, 
-                                  seqs_buffer_length, &buffer_idx, index, driver, stat, rand[0], realigner [0], context [0], do_pairing, 0);
-  }
-  else {
-      int32_t i;
-      (*attr) = tmap_calloc(1, sizeof(pthread_attr_t), "(*attr)");
-      pthread_attr_init((*attr));
-      pthread_attr_setdetachstate((*attr), PTHREAD_CREATE_JOINABLE);
-
-      (*threads) = tmap_calloc(driver->opt->num_threads, sizeof(pthread_t), "(*threads)");
-      (*thread_data) = tmap_calloc(driver->opt->num_threads, sizeof(tmap_map_driver_thread_data_t), "(*thread_data)");
-
-      // create threads
-      for(i=0;i<driver->opt->num_threads;i++) {
-          (*thread_data)[i].sam_header = header;
-          (*thread_data)[i].seqs_buffer = seqs_buffer;
-          (*thread_data)[i].seqs_buffer_length = seqs_buffer_length;
-          (*thread_data)[i].buffer_idx = tmap_calloc(1, sizeof(int32_t), "(*thread_data)[i].buffer_id");
-          (*thread_data)[i].records = records;
-          (*thread_data)[i].bams = bams;
-          (*thread_data)[i].index = index;
-          (*thread_data)[i].driver = driver;
-          if(NULL != stats) (*thread_data)[i].stat = stats[i];
-          else (*thread_data)[i].stat = NULL;
-          (*thread_data)[i].rand = rand[i];
-          // DVK - realigner
-          (*thread_data)[i].realigner = realigner [i];
-          (*thread_data)[i].context = context [i];
-          (*thread_data)[i].do_pairing = do_pairing;
-          (*thread_data)[i].tid = i;
-          if(0 != pthread_create(&(*threads)[i], (*attr), tmap_map_driver_core_thread_worker, &(*thread_data)[i])) {
-              tmap_error("error creating threads", Exit, ThreadError);
-          }
+static void
+tmap_map_driver_join_threads(tmap_map_driver_t *driver,
+                             pthread_attr_t **attr,
+                             pthread_t **threads,
+                             tmap_map_driver_thread_data_t **thread_data)
+{
+  int32_t i;
+  for(i=0;i<driver->opt->num_threads;i++) {
+      if(0 != pthread_join((*threads)[i], NULL)) {
+          tmap_error("error joining threads", Exit, ThreadError);
       }
   }
-#else 
-  buffer_idx = 0;
-  tmap_map_driver_core_worker(header, seqs_buffer, records, bams, 
-                              seqs_buffer_length, &buffer_idx, index, driver, stat, rand, do_pairing, 0);
-#endif
-  return 1;
+  free((*threads)); (*threads) = NULL;
+  free((*thread_data)); (*thread_data) = NULL;
+  free((*attr)); (*attr) = NULL;
 }
+#endif
 
+// maps the first batch to infer the insert size, the batch is left loaded to be mapped again
 static int32_t
 tmap_map_driver_infer_pairing(tmap_seqs_io_t *io_in,
                               sam_header_t *header,
-                              tmap_seqs_t **seqs_buffer, 
-                              tmap_map_record_t **records, 
-                              tmap_map_bams_t **bams,
-                              int32_t seqs_buffer_length,
+                              tmap_map_driver_sched_t *sched,
                               int32_t reads_queue_size,
                               tmap_index_t *index,
                               tmap_map_driver_t *driver,
-                              tmap_map_stats_t *stat,
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
                               tmap_rand_t *rand_core,
 #endif
 #ifdef HAVE_LIBPTHREAD
-                              pthread_attr_t **attr,
-                              pthread_t **threads,
-                              tmap_map_driver_thread_data_t **thread_data,
                               tmap_rand_t **rand,
-                              tmap_map_stats_t **stats,
                               // DVK - realigner
                               struct RealignProxy** realigner,
                               struct RealignProxy** context
+#else
+                              tmap_rand_t *rand,
+                              struct RealignProxy* realigner,
+                              struct RealignProxy* context
 #endif
                               ) // NB: just so that the function definition is clean
 {
@@ -1573,6 +1732,15 @@ tmap_map_driver_infer_pairing(tmap_seqs_io_t *io_in,
   int32_t *isize = NULL;
   int32_t p25, p50, p75;
   int32_t max_len = 0;
+  int32_t seqs_buffer_length;
+  tmap_map_driver_batch_t *batch = NULL;
+  tmap_seqs_t **seqs_buffer = NULL;
+  tmap_map_record_t **records = NULL;
+#ifdef HAVE_LIBPTHREAD
+  pthread_attr_t *attr = NULL;
+  pthread_t *threads = NULL;
+  tmap_map_driver_thread_data_t *thread_data = NULL;
+#endif
 
   // check if we should do pairing
   if(driver->opt->strandedness < 0 || driver->opt->positioning < 0 || !(driver->opt->ins_size_std < 0)) return 0;
@@ -1580,41 +1748,35 @@ tmap_map_driver_infer_pairing(tmap_seqs_io_t *io_in,
   // NB: infers from the first chunk of reads
   tmap_progress_print("inferring pairing parameters");
   tmap_progress_print("loading reads");
-  seqs_buffer_length = tmap_seqs_io_read_buffer(io_in, seqs_buffer, reads_queue_size, header);
+  seqs_buffer_length = tmap_map_driver_sched_load(sched, io_in, reads_queue_size, header
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+                                                  , driver, rand_core
+#endif
+                                                  );
   tmap_progress_print2("loaded %d reads", seqs_buffer_length);
   if(0 == seqs_buffer_length) return 0;
+  batch = &sched->batches[sched->head];
+  seqs_buffer = batch->seqs_buffer;
+  records = batch->records;
 
   // holds the insert sizes
   isize = tmap_malloc(sizeof(int32_t) * seqs_buffer_length, "isize");
 
   // TODO: check that he data is paired...
   // TODO: check that we choose only the best scoring alignment
-  // create the threads
-  if(0 == tmap_map_driver_create_threads(header, seqs_buffer, records, 
-                                         bams, seqs_buffer_length, index, driver, NULL,
-#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-                                         rand_core,
-#endif
+  // map only this batch
+  batch->do_pairing = 1;
+  sched->drain = 1;
 #ifdef HAVE_LIBPTHREAD
-                                         attr, threads, thread_data, rand, NULL, realigner, context,
+  tmap_map_driver_create_threads(sched, index, driver, &attr, &threads, &thread_data, rand, NULL, realigner, context);
+#else
+  tmap_map_driver_core_worker(sched, index, driver, NULL, rand, realigner, context, 0);
 #endif
-                                         1)) {
-      return 0;
-  }
 
   // estimate pairing parameters
   for(i=0;i<seqs_buffer_length;i++) {
-#ifdef HAVE_LIBPTHREAD
-      if(1 < driver->opt->num_threads) {
-          // NB: we will write data as threads process the data.  This is to
-          // facilitate SAM/BAM writing, which may be slow, especially for
-          // BAM.
-          int32_t tid = (i % driver->opt->num_threads);
-          while((*(*thread_data)[tid].buffer_idx) <= i) {
-              usleep(1000*1000); // sleep
-          }
-      }
-#endif
+      // NB: we will use the records as threads process the data
+      tmap_map_driver_sched_wait_done(sched, batch, i);
       // only for paired ends
       if(NULL != records[i]
          && 2 == records[i]->n 
@@ -1654,25 +1816,19 @@ tmap_map_driver_infer_pairing(tmap_seqs_io_t *io_in,
 
 #ifdef HAVE_LIBPTHREAD
   // join threads
-  if(1 < driver->opt->num_threads) {
-      // join threads
-      for(i=0;i<driver->opt->num_threads;i++) {
-          if(0 != pthread_join((*threads)[i], NULL)) {
-              tmap_error("error joining threads", Exit, ThreadError);
-          }
-          // free the buffer index
-          free((*thread_data)[i].buffer_idx);
-          (*thread_data)[i].buffer_idx = NULL;
-      }
-      free((*threads)); (*threads) = NULL;
-      free(*(thread_data)); (*thread_data) = NULL;
-      free((*attr)); (*attr) = NULL;
-  }
+  tmap_map_driver_join_threads(driver, &attr, &threads, &thread_data);
 #endif
 
+  // the batch is mapped again with the inferred parameters
+  memset(batch->done, 0, sizeof(int32_t) * seqs_buffer_length);
+  batch->next = 0;
+  batch->do_pairing = 0;
+  sched->drain = 0;
+
   if(isize_num < 8) {
       tmap_error("failed to infer the insert size distribution (too few reads): turning pairing off", Warn, OutOfRange);
       driver->opt->pairing = -1;
+      free(isize);
       return seqs_buffer_length;
   }
 
@@ -1743,18 +1899,30 @@ tmap_map_driver_infer_pairing(tmap_seqs_io_t *io_in,
 
 #ifdef HAVE_LIBPTHREAD
 typedef struct {
+    tmap_map_driver_sched_t *sched;
     tmap_seqs_io_t *io_in;
-    tmap_sam_io_t *io_out;
-    tmap_seqs_t **seqs_buffer;
-    int32_t seqs_buffer_length;
+    sam_header_t *header;
     int32_t reads_queue_size;
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+    tmap_map_driver_t *driver;
+    tmap_rand_t *rand_core;
+#endif
 } tmap_map_driver_thread_io_data_t;
 
+// loads batches of reads until the end of the input, as soon as a batch is free
 static void *
 tmap_map_driver_thread_io_worker (void *arg)
 {
   tmap_map_driver_thread_io_data_t *d = (tmap_map_driver_thread_io_data_t*) arg;
-  d->seqs_buffer_length = tmap_seqs_io_read_buffer (d->io_in, d->seqs_buffer, d->reads_queue_size, d->io_out->fp->header->header);
+  int32_t seqs_buffer_length;
+  do {
+      seqs_buffer_length = tmap_map_driver_sched_load (d->sched, d->io_in, d->reads_queue_size, d->header
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+                                                       , d->driver, d->rand_core
+#endif
+                                                       );
+      tmap_progress_print2("loaded %d reads", seqs_buffer_length);
+  } while(0 < seqs_buffer_length);
   return d;
 }
 #endif
@@ -1766,17 +1934,14 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
 {
   uint32_t i, j, k, n_reads_processed = 0; // # of reads processed
   int32_t seqs_buffer_length = 0; // # of reads read in
-  int32_t seqs_loaded = 0; // 1 if the seq_buffer is loaded, 0 otherwse
   tmap_seqs_io_t *io_in = NULL; // input file(s)
   tmap_sam_io_t *io_out = NULL; // output file
-  tmap_seqs_t **seqs_buffer = NULL; // buffer for the reads
-#ifdef HAVE_LIBPTHREAD
-  tmap_seqs_t **seqs_buffer_next = NULL; // buffer for the reads
-#endif
-  tmap_map_record_t **records=NULL; // buffer for the mapped data
+  tmap_map_driver_sched_t sched; // batches of reads, loaded, mapped and written at the same time
+  tmap_map_driver_batch_t *batch = NULL; // the batch being written
   tmap_map_bams_t **bams=NULL;// buffer for the mapped BAM data
   tmap_index_t *index = NULL; // reference indes
   tmap_map_stats_t *stat = NULL; // alignment statistics
+  double write_time = 0.0; // the start of the current write
 #ifdef HAVE_LIBPTHREAD
   pthread_attr_t *attr = NULL;
   pthread_attr_t attr_io;
@@ -1837,7 +2002,14 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
                             driver->opt->bam_start_vfo, driver->opt->bam_end_vfo);
 
   // get the index
+  // NB: the index files are mapped in place, and shared through the page cache with
+  // every other process using the same reference
+  tmap_file_set_mmap_hints((driver->opt->index_mmap_populate ? TMAP_FILE_MMAP_POPULATE : 0)
+                           | (driver->opt->index_mmap_hugepage ? TMAP_FILE_MMAP_HUGEPAGE : 0));
   index = tmap_index_init(driver->opt->fn_fasta, driver->opt->shm_key);
+  if(1 == driver->opt->bwt_occ_lines) {
+      tmap_bwt_gen_occ_lines(index->bwt);
+  }
 
   // initialize the driver->options and print any relevant information
   tmap_map_driver_do_init(driver, index->refseq);
@@ -1851,18 +2023,7 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
   else {
       reads_queue_size = driver->opt->reads_queue_size;
   }
-  seqs_buffer = tmap_malloc(sizeof(tmap_seqs_t*)*reads_queue_size, "seqs_buffer");
-#ifdef HAVE_LIBPTHREAD
-  seqs_buffer_next = tmap_malloc(sizeof(tmap_seqs_t*)*reads_queue_size, "seqs_buffer_next");
-#endif
-  for(i=0;i<reads_queue_size;i++) { // initialize the buffer
-      seqs_buffer[i] = tmap_seqs_init(seq_type);
-#ifdef HAVE_LIBPTHREAD
-      seqs_buffer_next[i] = tmap_seqs_init(seq_type);
-#endif
-  }
-  records = tmap_malloc(sizeof(tmap_map_record_t*)*reads_queue_size, "records");
-  bams = tmap_malloc(sizeof(tmap_map_bams_t*)*reads_queue_size, "bams");
+  tmap_map_driver_sched_init(&sched, reads_queue_size, seq_type);
 
   stat = tmap_map_stats_init();
 #ifdef HAVE_LIBPTHREAD
@@ -1955,78 +2116,70 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
   header = NULL;
 
   // pairing
-  seqs_buffer_length = tmap_map_driver_infer_pairing(io_in, io_out->fp->header->header, seqs_buffer, records, 
-                                                     bams, seqs_buffer_length, reads_queue_size,
-                                                     index, driver, stat,
+  tmap_map_driver_infer_pairing(io_in, io_out->fp->header->header, &sched, reads_queue_size,
+                                index, driver,
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-                                                     rand_core,
-#endif
-#ifdef HAVE_LIBPTHREAD
-                                                     &attr, &threads, &thread_data, rand, stats, realigner, context
+                                rand_core,
 #endif
-                                                     );
-  if(0 == seqs_buffer_length) {
-      tmap_progress_print("loading reads");
-      seqs_buffer_length = tmap_seqs_io_read_buffer(io_in, seqs_buffer, reads_queue_size, io_out->fp->header->header);
-      tmap_progress_print2("loaded %d reads", seqs_buffer_length);
-  }
-  seqs_loaded = 1;
+                                rand, realigner, context);
 
   // main processing loop
+  // NB: reads are loaded, mapped and written at the same time.  The IO thread loads
+  // the next batches while the mapping threads take chunks of reads from the oldest
+  // loaded batches, and the reads are written in order as soon as they are mapped.
   tmap_progress_print("processing reads");
-  while(1) {
-      // get the reads
-      if(0 == seqs_loaded) { 
-          tmap_progress_print("loading reads");
-#ifdef HAVE_LIBPTHREAD
-          // join the thread that loads in the reads
-          if(0 != pthread_join((*thread_io), NULL)) {
-              tmap_error("error joining IO thread", Exit, ThreadError);
-          }
-          free(thread_io);
-          thread_io = NULL;
-          // swap buffers
-          seqs_buffer_length = thread_io_data.seqs_buffer_length;
-          seqs_buffer_next = seqs_buffer; // temporarily store this here
-          seqs_buffer = thread_io_data.seqs_buffer; 
-          thread_io_data.seqs_buffer = seqs_buffer_next;
-#else
-          seqs_buffer_length = tmap_seqs_io_read_buffer (io_in, seqs_buffer, reads_queue_size, io_out->fp->header->header);
-#endif
-          seqs_loaded = 1;
-          tmap_progress_print2("loaded %d reads", seqs_buffer_length);
-      }
-      if(0 == seqs_buffer_length) { // are there any more?
-          break;
-      }
-
+  sched.stat = stat;
 #ifdef HAVE_LIBPTHREAD
-      // launch a new thread that loads in the reads 
+  if(0 == sched.eof) {
+      // parse the reads ahead, and decompress BAM input, on their own threads
+      tmap_seqs_io_start(io_in, io_out->fp->header->header, reads_queue_size, driver->opt->bam_input_threads);
+      // compress BAM output on its own threads, overlapping the mapping of the next reads
+      tmap_sam_io_set_write_threads(io_out, driver->opt->bam_output_threads);
+      // launch the thread that loads in the reads 
       pthread_attr_init(&attr_io);
       pthread_attr_setdetachstate(&attr_io, PTHREAD_CREATE_JOINABLE);
       thread_io = tmap_malloc(sizeof(pthread_t), "thread_io");
+      thread_io_data.sched = &sched;
       thread_io_data.io_in = io_in;
-      thread_io_data.io_out = io_out;
-      thread_io_data.seqs_buffer_length = 0;
+      thread_io_data.header = io_out->fp->header->header;
       thread_io_data.reads_queue_size = reads_queue_size;
-      thread_io_data.seqs_buffer = seqs_buffer_next;
+#ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
+      thread_io_data.driver = driver;
+      thread_io_data.rand_core = rand_core;
+#endif
       if(0 != pthread_create(thread_io, &attr_io, tmap_map_driver_thread_io_worker, &thread_io_data)) {
           tmap_error("error creating threads", Exit, ThreadError);
       }
-#endif
+  }
 
-      // create the threads
-      if(0 == tmap_map_driver_create_threads(io_out->fp->header->header, seqs_buffer, records, 
-                                             bams, seqs_buffer_length, index, driver, stat,
+  // create the threads
+  tmap_map_driver_create_threads(&sched, index, driver, &attr, &threads, &thread_data, rand, stats, realigner, context);
+#endif
+  while(1) {
+      // get the reads
+#ifndef HAVE_LIBPTHREAD
+      if(0 == sched.num_loaded) { 
+          tmap_progress_print("loading reads");
+          seqs_buffer_length = tmap_map_driver_sched_load(&sched, io_in, reads_queue_size, io_out->fp->header->header
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
-                                             rand_core,
+                                                          , driver, rand_core
 #endif
-#ifdef HAVE_LIBPTHREAD
-                                             &attr, &threads, &thread_data, rand, stats, realigner, context,
+                                                          );
+          tmap_progress_print2("loaded %d reads", seqs_buffer_length);
+      }
 #endif
-                                             0)) {
+      batch = tmap_map_driver_sched_head(&sched);
+      seqs_buffer_length = batch->seqs_buffer_length;
+      if(0 == seqs_buffer_length) { // are there any more?
           break;
       }
+      bams = batch->bams;
+
+#ifndef HAVE_LIBPTHREAD
+      // map the batch
+      sched.drain = 1;
+      tmap_map_driver_core_worker(&sched, index, driver, stat, rand, realigner, context, 0);
+#endif
 
       /*
       if(-1 != driver->opt->reads_queue_size) {
@@ -2036,57 +2189,34 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
 
       // write data
       for(i=0;i<seqs_buffer_length;i++) {
-#ifdef HAVE_LIBPTHREAD
-          if(1 < driver->opt->num_threads) {
-              // NB: we will write data as threads process the data.  This is to
-              // facilitate SAM/BAM writing, which may be slow, especially for
-              // BAM.
-              int32_t tid = (i % driver->opt->num_threads);
-              while((*thread_data[tid].buffer_idx) <= i) {
-                  usleep(1000*1000); // sleep
-              }
-          }
-#endif
+          // NB: we will write data as threads process the data.  This is to
+          // facilitate SAM/BAM writing, which may be slow, especially for
+          // BAM.
+          tmap_map_driver_sched_wait_done(&sched, batch, i);
           // write
+          write_time = tmap_time_realtime();
           for(j=0;j<bams[i]->n;j++) { // for each end
               for(k=0;k<bams[i]->bams[j]->n;k++) { // for each hit
                   bam1_t *b = NULL;
                   b = bams[i]->bams[j]->bams[k]; // that's a lot of BAMs
                   if(NULL == b) tmap_bug();
-                  if(samwrite(io_out->fp, b) <= 0) {
+                  if(tmap_sam_io_write(io_out, b) <= 0) {
                       tmap_error("Error writing the SAM file", Exit, WriteFileError);
                   }
               }
           }
+          stat->write_time += tmap_time_realtime() - write_time;
           tmap_map_bams_destroy(bams[i]);
           bams[i] = NULL;
       }
-
-#ifdef HAVE_LIBPTHREAD
-      // join threads
-      if(1 < driver->opt->num_threads) {
-          // join threads
-          for(i=0;i<driver->opt->num_threads;i++) {
-              if(0 != pthread_join(threads[i], NULL)) {
-                  tmap_error("error joining threads", Exit, ThreadError);
-              }
-              // add the stats
-              tmap_map_stats_add (stat, stats[i]);
-              tmap_map_stats_zero (stats[i]);
-              // free the buffer index
-              free(thread_data[i].buffer_idx);
-          }
-          free(threads); threads = NULL;
-          free(thread_data); thread_data = NULL;
-          free(attr); attr = NULL;
-      }
-#endif
       // TODO: should we flush when writing SAM and processing one read at a time?
 
         // print statistics
         n_reads_processed += seqs_buffer_length;
         if (-1 != driver->opt->reads_queue_size) 
         {
+            // NB: the statistics include the reads of later batches mapped so far
+            tmap_map_driver_sched_lock(&sched);
             tmap_progress_print2("processed %d reads", n_reads_processed);
             tmap_progress_print2("stats [%.2lf,%.2lf,%.2lf,%.2lf,%.2lf,%.2lf]",
                                 stat->num_with_mapping * 100.0 / (double)stat->num_reads,
@@ -2104,10 +2234,31 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
                                     stat->num_fully_tailclipped,
                                     ((double) stat->bases_tailclipped) * 100 / stat->bases_seen_tailclipped);
             }
+            tmap_map_driver_sched_unlock(&sched);
         }
-        seqs_loaded = 0;
+        // free the batch for the next reads
+        tmap_map_driver_sched_pop(&sched);
     }
 
+#ifdef HAVE_LIBPTHREAD
+    // join the threads, all the reads are mapped
+    if(NULL != thread_io) {
+        if(0 != pthread_join((*thread_io), NULL)) {
+            tmap_error("error joining IO thread", Exit, ThreadError);
+        }
+    }
+    tmap_map_driver_join_threads(driver, &attr, &threads, &thread_data);
+    for(i=0;i<driver->opt->num_threads;i++) {
+        // add any statistics not added yet
+        tmap_map_stats_add (stat, stats[i]);
+        tmap_map_stats_zero (stats[i]);
+    }
+#endif
+    // write the BAM blocks still being compressed
+    write_time = tmap_time_realtime();
+    stat->compress_time = tmap_sam_io_flush_write_threads(io_out);
+    stat->write_time += tmap_time_realtime() - write_time;
+
     if(-1 == driver->opt->reads_queue_size) 
     {
         tmap_progress_print2("processed %d reads", n_reads_processed);
@@ -2132,6 +2283,9 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
         tmap_file_printf ("                  After scoring:  %llu\n", stat->num_after_scoring);
         tmap_file_printf ("             After dups removal:  %llu\n", stat->num_after_rmdup);
         tmap_file_printf ("                After filtering:  %llu\n", stat->num_after_filter);
+        tmap_file_printf ("             Writing alignments:  %.2f seconds\n", stat->write_time);
+        if (NULL != io_out->writer)
+            tmap_file_printf ("         Compressing BAM blocks:  %.2f seconds on %d threads\n", stat->compress_time, driver->opt->bam_output_threads);
 
         if (!driver->opt->do_realign)
             tmap_file_printf (  "No realignment perormed\n");
@@ -2309,16 +2463,7 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
   // free memory
   tmap_index_destroy(index);
   tmap_seqs_io_destroy(io_in);
-  for(i=0;i<reads_queue_size;i++) {
-      tmap_seqs_destroy(seqs_buffer[i]);
-#ifdef HAVE_LIBPTHREAD
-      tmap_seqs_destroy(seqs_buffer_next[i]);
-#endif
-  }
-  free(seqs_buffer);
-#ifdef HAVE_LIBPTHREAD
-  free(seqs_buffer_next);
-#endif
+  tmap_map_driver_sched_destroy(&sched, reads_queue_size);
 
 // DVK - realigner
 #ifdef HAVE_LIBPTHREAD
@@ -2339,8 +2484,6 @@ tmap_map_driver_core (tmap_map_driver_t *driver)
   if (logfile)
     fclose (logfile);
 
-  free(records);
-  free(bams);
   tmap_map_stats_destroy(stat);
 #ifdef HAVE_LIBPTHREAD
   for(i=0;i<driver->opt->num_threads;i++) {
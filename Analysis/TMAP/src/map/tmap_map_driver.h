@@ -10,9 +10,15 @@
 #include "../realign/realign_wrapper.h"
 
 #ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
 #define TMAP_MAP_DRIVER_THREAD_BLOCK_SIZE 512
 #endif
 
+/*! the number of reads a mapping thread takes from a batch at a time */
+#define TMAP_MAP_DRIVER_CHUNK_SIZE 16
+/*! the number of batches of reads being read, mapped and written at once */
+#define TMAP_MAP_DRIVER_NUM_BATCHES 3
+
 /*!
   This function will be invoked after reading in all the reference data
   to initialize any program options and print messages.
@@ -143,16 +149,45 @@ tmap_map_driver_run(tmap_map_driver_t *driver);
 void
 tmap_map_driver_destroy(tmap_map_driver_t *driver);
 
+/*!
+  A batch of reads in the mapping pipeline
+  */
+typedef struct {
+    tmap_seqs_t **seqs_buffer;  /*!< the buffers of sequences */
+    int32_t seqs_buffer_length;  /*!< the buffers length, zero at the end of the input */
+    tmap_map_record_t **records;  /*!< the alignments for each sequence */
+    tmap_map_bams_t **bams;  /*!< the BAM alignments for each sequence */
+    int32_t *done;  /*!< one if the sequence has been mapped, zero otherwise */
+    int32_t next;  /*!< the zero-based index of the next sequence not yet taken by a thread */
+    int64_t first_read;  /*!< the zero-based index of the first sequence in the input */
+    int32_t do_pairing;  /*!< 1 if we are performing pairing paramter calculation, 0 otherwise */
+} tmap_map_driver_batch_t;
+
+/*!
+  Hands out the reads of the loaded batches to the mapping threads in small chunks,
+  in input order, and tracks which reads are mapped so they can be written in order
+  */
+typedef struct {
+    tmap_map_driver_batch_t batches[TMAP_MAP_DRIVER_NUM_BATCHES];  /*!< a ring of batches */
+    int32_t head;  /*!< the oldest loaded batch, the next one to write */
+    int32_t num_loaded;  /*!< the number of loaded batches, starting at head */
+    int32_t eof;  /*!< 1 if the last batch of the input has been loaded */
+    int32_t drain;  /*!< 1 if threads should return once the loaded batches are taken */
+    int64_t num_reads;  /*!< the number of reads loaded so far */
+    tmap_map_stats_t *stat;  /*!< the statistics the threads add to, NULL if none */
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;  /*!< guards the above and the batches */
+    pthread_cond_t loaded_cond;  /*!< signalled when a batch is loaded */
+    pthread_cond_t done_cond;  /*!< signalled when a read is mapped */
+    pthread_cond_t free_cond;  /*!< signalled when a batch is written */
+#endif
+} tmap_map_driver_sched_t;
+
 /*! 
   Driver data to be passed to a thread                         
   */
 typedef struct {                                            
-    sam_header_t *sam_header;  /*!< the SAM Header */
-    tmap_seqs_t **seqs_buffer;  /*!< the buffers of sequences */    
-    int32_t seqs_buffer_length;  /*!< the buffers length */
-    int32_t *buffer_idx; /*!< the current zero-based index into the buffer */
-    tmap_map_record_t **records;  /*!< the alignments for each sequence */
-    tmap_map_bams_t **bams;  /*!< the BAM alignments for each sequence */
+    tmap_map_driver_sched_t *sched;  /*!< the source of reads to map */
     tmap_index_t *index;  /*!< pointer to the reference index */
     tmap_map_driver_t *driver;  /*!< the main driver object */
     tmap_map_stats_t *stat; /*!< the driver statistics */
@@ -160,32 +195,21 @@ typedef struct {
     // DVK - realigner
     struct RealignProxy *realigner; /*!< post-processing realigner engine */
     struct RealignProxy *context; /*!< post-processing context-dependent realignment engine */
-    int32_t do_pairing;  /*!< 1 if we are performing pairing paramter calculation, 0 otherwise */
     int32_t tid;  /*!< the zero-based thread id */
 } tmap_map_driver_thread_data_t;
 
 /*!
-  The core worker routine of mapall
-  @param  sam_header           the SAM Header
-  @param  seqs_buffer           the buffer of sequences
-  @param  records              the records to return
-  @param  bams                 the bams to return
-  @param  seqs_buffer_length    the number of sequences in the buffer
-  @param  buffer_idx            the current zero-based index into the buffer
+  The core worker routine of mapall. Maps chunks of reads taken from the loaded
+  batches until the input ends, or until all loaded reads are taken if draining.
+  @param  sched                the batches of reads
   @param  index                the reference index
   @param  driver               the driver
   @param  stat                 the driver statistics
   @param  rand                 the random number generator
-  @param  do_pairing           1 if we are performing pairing paramter calculation, 0 otherwise 
   @param  tid                  the thread ids
  */
 void
-tmap_map_driver_core_worker(sam_header_t *sam_header,
-                            tmap_seqs_t **seqs_buffer, 
-                            tmap_map_record_t **records,
-                            tmap_map_bams_t **bams,
-                            int32_t seqs_buffer_length,
-                            int32_t *buffer_idx,
+tmap_map_driver_core_worker(tmap_map_driver_sched_t *sched,
                             tmap_index_t *index,
                             tmap_map_driver_t *driver,
                             tmap_map_stats_t* stat,
@@ -193,7 +217,6 @@ tmap_map_driver_core_worker(sam_header_t *sam_header,
                             // DVK - realign
                             struct RealignProxy *realigner, 
                             struct RealignProxy *context, 
-                            int32_t do_pairing,
                             int32_t tid);
 
 /*!
@@ -155,6 +155,8 @@ __tmap_map_opt_option_print_func_reads_format_init(reads_format)
 __tmap_map_opt_option_print_func_chars_init(fn_sam, "stdout")
 __tmap_map_opt_option_print_func_int64_init(bam_start_vfo)
 __tmap_map_opt_option_print_func_int64_init(bam_end_vfo)
+__tmap_map_opt_option_print_func_int_init(bam_input_threads)
+__tmap_map_opt_option_print_func_int_init(bam_output_threads)
 __tmap_map_opt_option_print_func_int_init(score_match)
 __tmap_map_opt_option_print_func_int_init(pen_mm)
 __tmap_map_opt_option_print_func_int_init(pen_gapo)
@@ -190,10 +192,14 @@ __tmap_map_opt_option_print_func_int_init(max_adapter_bases_for_soft_clipping)
 __tmap_map_opt_option_print_func_tf_init(end_repair_5_prime_softclip)
 
 __tmap_map_opt_option_print_func_int_init(shm_key)
+__tmap_map_opt_option_print_func_tf_init(index_mmap_populate)
+__tmap_map_opt_option_print_func_tf_init(index_mmap_hugepage)
+__tmap_map_opt_option_print_func_tf_init(bwt_occ_lines)
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
 __tmap_map_opt_option_print_func_double_init(sample_reads)
 #endif
 __tmap_map_opt_option_print_func_int_init(vsw_type)
+__tmap_map_opt_option_print_func_tf_init(vsw_batch)
 __tmap_map_opt_option_print_func_verbosity_init()
 
 __tmap_map_opt_option_print_func_tf_init(do_realign)
@@ -556,6 +562,18 @@ tmap_map_opt_init_helper(tmap_map_opt_t *opt)
                            NULL,
                            tmap_map_opt_option_print_func_bam_end_vfo,
                            TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "bam-input-threads", required_argument, 0, 0,
+                           TMAP_MAP_OPT_TYPE_INT,
+                           "the number of threads decompressing BAM input (0 to decompress with the thread reading the input)",
+                           NULL,
+                           tmap_map_opt_option_print_func_bam_input_threads,
+                           TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "bam-output-threads", required_argument, 0, 0,
+                           TMAP_MAP_OPT_TYPE_INT,
+                           "the number of threads compressing BAM output (0 to compress with the thread writing the output)",
+                           NULL,
+                           tmap_map_opt_option_print_func_bam_output_threads,
+                           TMAP_MAP_ALGO_GLOBAL);
   tmap_map_opt_options_add(opt->options, "score-match", required_argument, 0, 'A', 
                            TMAP_MAP_OPT_TYPE_INT,
                            "score for a match",
@@ -763,6 +781,24 @@ tmap_map_opt_init_helper(tmap_map_opt_t *opt)
                            NULL,
                            tmap_map_opt_option_print_func_shm_key,
                            TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "index-mmap-populate", no_argument, 0, 0, 
+                           TMAP_MAP_OPT_TYPE_NONE,
+                           "read the whole memory mapped reference index at startup",
+                           NULL,
+                           tmap_map_opt_option_print_func_index_mmap_populate,
+                           TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "index-mmap-hugepage", no_argument, 0, 0, 
+                           TMAP_MAP_OPT_TYPE_NONE,
+                           "advise huge pages for the memory mapped reference index",
+                           NULL,
+                           tmap_map_opt_option_print_func_index_mmap_hugepage,
+                           TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "bwt-occ-lines", no_argument, 0, 0, 
+                           TMAP_MAP_OPT_TYPE_NONE,
+                           "copy the BWT occurrence array into cache line sized blocks at startup (faster seeding, more private memory)",
+                           NULL,
+                           tmap_map_opt_option_print_func_bwt_occ_lines,
+                           TMAP_MAP_ALGO_GLOBAL);
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
   tmap_map_opt_options_add(opt->options, "sample-reads", required_argument, 0, 'x',
                            TMAP_MAP_OPT_TYPE_FLOAT,
@@ -777,6 +813,12 @@ tmap_map_opt_init_helper(tmap_map_opt_t *opt)
                            vsw_type,
                            tmap_map_opt_option_print_func_vsw_type,
                            TMAP_MAP_ALGO_GLOBAL);
+  tmap_map_opt_options_add(opt->options, "vsw-batch", no_argument, 0, 0, 
+                           TMAP_MAP_OPT_TYPE_NONE,
+                           "score the candidate windows of a read together, one window per SIMD lane (same results as -H 1)",
+                           NULL,
+                           tmap_map_opt_option_print_func_vsw_batch,
+                           TMAP_MAP_ALGO_GLOBAL);
   tmap_map_opt_options_add(opt->options, "help", no_argument, 0, 'h', 
                            TMAP_MAP_OPT_TYPE_NONE,
                            "print this message",
@@ -1381,6 +1423,8 @@ tmap_map_opt_init(int32_t algo_id)
   opt->fn_sam = NULL;
   opt->bam_start_vfo = 0;
   opt->bam_end_vfo = 0;
+  opt->bam_input_threads = 2;
+  opt->bam_output_threads = 2;
   opt->score_match = TMAP_MAP_OPT_SCORE_MATCH;
   opt->pen_mm = TMAP_MAP_OPT_PEN_MM;
   opt->pen_gapo = TMAP_MAP_OPT_PEN_GAPO;
@@ -1413,12 +1457,16 @@ tmap_map_opt_init(int32_t algo_id)
   opt->max_adapter_bases_for_soft_clipping = INT32_MAX;
   opt->end_repair_5_prime_softclip = 0;
   opt->shm_key = 0;
+  opt->index_mmap_populate = 0;
+  opt->index_mmap_hugepage = 0;
+  opt->bwt_occ_lines = 0;
   opt->min_seq_len = -1;
   opt->max_seq_len = -1;
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
   opt->sample_reads = 1.0;
 #endif
   opt->vsw_type = 4;
+  opt->vsw_batch = 0;
 
   opt->do_realign = 0;
   opt->realign_mat_score =  4;
@@ -1803,6 +1851,12 @@ tmap_map_opt_parse(int argc, char *argv[], tmap_map_opt_t *opt)
       else if(0 == c && 0 == strcmp("bam-end-vfo", options[option_index].name)) {
           opt->bam_end_vfo = strtol(optarg,NULL,0);
       }
+      else if(0 == c && 0 == strcmp("bam-input-threads", options[option_index].name)) {
+          opt->bam_input_threads = atoi(optarg);
+      }
+      else if(0 == c && 0 == strcmp("bam-output-threads", options[option_index].name)) {
+          opt->bam_output_threads = atoi(optarg);
+      }
       else if(c == 'A' || (0 == c && 0 == strcmp("score-match", options[option_index].name))) {       
           opt->score_match = atoi(optarg);
       }
@@ -1824,6 +1878,9 @@ tmap_map_opt_parse(int argc, char *argv[], tmap_map_opt_t *opt)
       else if(c == 'H' || (0 == c && 0 == strcmp("vsw-type", options[option_index].name))) {       
           opt->vsw_type = atoi(optarg); 
       }
+      else if(0 == c && 0 == strcmp("vsw-batch", options[option_index].name)) {
+          opt->vsw_batch = 1;
+      }
       else if(c == 'I' || (0 == c && 0 == strcmp("use-seq-equal", options[option_index].name))) {       
           opt->seq_eq = 1;
       }
@@ -1946,6 +2003,15 @@ tmap_map_opt_parse(int argc, char *argv[], tmap_map_opt_t *opt)
       else if (0 == c && 0 == strcmp ("er-5clip", options [option_index].name)) {
           opt->end_repair_5_prime_softclip = 1;
       }
+      else if (0 == c && 0 == strcmp ("index-mmap-populate", options [option_index].name)) {
+          opt->index_mmap_populate = 1;
+      }
+      else if (0 == c && 0 == strcmp ("index-mmap-hugepage", options [option_index].name)) {
+          opt->index_mmap_hugepage = 1;
+      }
+      else if (0 == c && 0 == strcmp ("bwt-occ-lines", options [option_index].name)) {
+          opt->bwt_occ_lines = 1;
+      }
       // End of global options
 
       // realignment options
@@ -2306,6 +2372,12 @@ tmap_map_opt_check_global(tmap_map_opt_t *opt_a, tmap_map_opt_t *opt_b)
     if(opt_a->bam_end_vfo != opt_b->bam_end_vfo) {
         tmap_error("option --bam-end-vfo was specified outside of the common options", Exit, CommandLineArgument);
     }
+    if(opt_a->bam_input_threads != opt_b->bam_input_threads) {
+        tmap_error("option --bam-input-threads was specified outside of the common options", Exit, CommandLineArgument);
+    }
+    if(opt_a->bam_output_threads != opt_b->bam_output_threads) {
+        tmap_error("option --bam-output-threads was specified outside of the common options", Exit, CommandLineArgument);
+    }
     if(opt_a->score_match != opt_b->score_match) {
         tmap_error("option -A was specified outside of the common options", Exit, CommandLineArgument);
     }
@@ -2372,6 +2444,15 @@ tmap_map_opt_check_global(tmap_map_opt_t *opt_a, tmap_map_opt_t *opt_b)
     if(opt_a->shm_key != opt_b->shm_key) {
         tmap_error("option -k was specified outside of the common options", Exit, CommandLineArgument);
     }
+    if(opt_a->index_mmap_populate != opt_b->index_mmap_populate) {
+        tmap_error("option --index-mmap-populate was specified outside of the common options", Exit, CommandLineArgument);
+    }
+    if(opt_a->index_mmap_hugepage != opt_b->index_mmap_hugepage) {
+        tmap_error("option --index-mmap-hugepage was specified outside of the common options", Exit, CommandLineArgument);
+    }
+    if(opt_a->bwt_occ_lines != opt_b->bwt_occ_lines) {
+        tmap_error("option --bwt-occ-lines was specified outside of the common options", Exit, CommandLineArgument);
+    }
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
     if(opt_a->sample_reads != opt_b->sample_reads) {
         tmap_error("option -x was specified outside of the common options", Exit, CommandLineArgument);
@@ -2380,6 +2461,9 @@ tmap_map_opt_check_global(tmap_map_opt_t *opt_a, tmap_map_opt_t *opt_b)
     if(opt_a->vsw_type != opt_b->vsw_type) {
         tmap_error("option -H was specified outside of the common options", Exit, CommandLineArgument);
     }
+    if(opt_a->vsw_batch != opt_b->vsw_batch) {
+        tmap_error("option --vsw-batch was specified outside of the common options", Exit, CommandLineArgument);
+    }
     if(opt_a->long_hit_mult != opt_b->long_hit_mult) {
         tmap_error("option --long-hit-mult was specified outside of the common options", Exit, CommandLineArgument);
     }
@@ -2517,6 +2601,8 @@ tmap_map_opt_check(tmap_map_opt_t *opt)
   }
   tmap_error_cmd_check_int64(opt->bam_start_vfo, 0, INT64_MAX, "--bam-start-vfo");
   tmap_error_cmd_check_int64(opt->bam_end_vfo, 0, INT64_MAX, "--bam-end-vfo");
+  tmap_error_cmd_check_int(opt->bam_input_threads, 0, INT32_MAX, "--bam-input-threads");
+  tmap_error_cmd_check_int(opt->bam_output_threads, 0, INT32_MAX, "--bam-output-threads");
   tmap_error_cmd_check_int(opt->score_match, 1, INT32_MAX, "-A");
   tmap_error_cmd_check_int(opt->pen_mm, 1, INT32_MAX, "-M");
   tmap_error_cmd_check_int(opt->pen_gapo, 1, INT32_MAX, "-O");
@@ -2733,6 +2819,8 @@ tmap_map_opt_copy_global(tmap_map_opt_t *opt_dest, tmap_map_opt_t *opt_src)
     opt_dest->fn_sam = tmap_strdup(opt_src->fn_sam);
     opt_dest->bam_start_vfo = opt_src->bam_start_vfo;
     opt_dest->bam_end_vfo = opt_src->bam_end_vfo;
+    opt_dest->bam_input_threads = opt_src->bam_input_threads;
+    opt_dest->bam_output_threads = opt_src->bam_output_threads;
     opt_dest->score_match = opt_src->score_match;
     opt_dest->pen_mm = opt_src->pen_mm;
     opt_dest->pen_gapo = opt_src->pen_gapo;
@@ -2775,10 +2863,14 @@ tmap_map_opt_copy_global(tmap_map_opt_t *opt_dest, tmap_map_opt_t *opt_src)
     opt_dest->max_adapter_bases_for_soft_clipping = opt_src->max_adapter_bases_for_soft_clipping;
     opt_dest->end_repair_5_prime_softclip = opt_src->end_repair_5_prime_softclip;
     opt_dest->shm_key = opt_src->shm_key;
+    opt_dest->index_mmap_populate = opt_src->index_mmap_populate;
+    opt_dest->index_mmap_hugepage = opt_src->index_mmap_hugepage;
+    opt_dest->bwt_occ_lines = opt_src->bwt_occ_lines;
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
     opt_dest->sample_reads = opt_src->sample_reads;
 #endif
     opt_dest->vsw_type = opt_src->vsw_type;
+    opt_dest->vsw_batch = opt_src->vsw_batch;
 
     opt_dest->cigar_sanity_check = opt_src->cigar_sanity_check;
 
@@ -2831,6 +2923,8 @@ tmap_map_opt_print(tmap_map_opt_t *opt)
   fprintf(stderr, "reads_format=%d\n", opt->reads_format);
   fprintf(stderr, "bam_start_vfo=%ld\n", opt->bam_start_vfo);
   fprintf(stderr, "bam_end_vfo=%ld\n", opt->bam_end_vfo);
+  fprintf(stderr, "bam_input_threads=%d\n", opt->bam_input_threads);
+  fprintf(stderr, "bam_output_threads=%d\n", opt->bam_output_threads);
   fprintf(stderr, "score_match=%d\n", opt->score_match);
   fprintf(stderr, "pen_mm=%d\n", opt->pen_mm);
   fprintf(stderr, "pen_gapo=%d\n", opt->pen_gapo);
@@ -2869,10 +2963,14 @@ tmap_map_opt_print(tmap_map_opt_t *opt)
   fprintf(stderr, "max_adapter_bases_for_soft_clipping=%d\n", opt->max_adapter_bases_for_soft_clipping);
   fprintf(stderr, "end_repair_5_prime_softclip=%d\n", opt->end_repair_5_prime_softclip);
   fprintf(stderr, "shm_key=%d\n", (int)opt->shm_key);
+  fprintf(stderr, "index_mmap_populate=%d\n", opt->index_mmap_populate);
+  fprintf(stderr, "index_mmap_hugepage=%d\n", opt->index_mmap_hugepage);
+  fprintf(stderr, "bwt_occ_lines=%d\n", opt->bwt_occ_lines);
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
   fprintf(stderr, "sample_reads=%lf\n", opt->sample_reads);
 #endif
   fprintf(stderr, "vsw_type=%d\n", opt->vsw_type);
+  fprintf(stderr, "vsw_batch=%d\n", opt->vsw_batch);
   fprintf(stderr, "min_seq_len=%d\n", opt->min_seq_len);
   fprintf(stderr, "max_seq_len=%d\n", opt->max_seq_len);
   fprintf(stderr, "seed_length=%d\n", opt->seed_length);
@@ -202,6 +202,8 @@ typedef struct __tmap_map_opt_t {
     char *fn_sam; /*!< the output file name (-s,--fn-sam) */
     int64_t bam_start_vfo; /*!< starting virtual file offset (--bam-start-vfo) */
     int64_t bam_end_vfo; /*!< ending virtual file offset (--bam-end-vfo) */
+    int32_t bam_input_threads; /*!< the number of threads decompressing BAM input (--bam-input-threads) */
+    int32_t bam_output_threads; /*!< the number of threads compressing BAM output (--bam-output-threads) */
     int32_t score_match;  /*!< the match score (-A,--score-match) */
     int32_t pen_mm;  /*!< the mismatch penalty (-M,--pen-mismatch) */
     int32_t pen_gapo;  /*!< the indel open penalty (-O,--pen-gap-open) */
@@ -238,10 +240,14 @@ typedef struct __tmap_map_opt_t {
     int32_t end_repair_5_prime_softclip; /*!< end-repair is allowed to introduce 5' softclip */
 
     key_t shm_key;  /*!< the shared memory key (-k,--shared-memory-key) */
+    int32_t index_mmap_populate;  /*!< read the whole mapped index at startup (--index-mmap-populate) */
+    int32_t index_mmap_hugepage;  /*!< advise huge pages for the mapped index (--index-mmap-hugepage) */
+    int32_t bwt_occ_lines;  /*!< copy the occurrence array into cache lines (--bwt-occ-lines) */
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
     double sample_reads;  /*!< sample the reads at this fraction (-x,--sample-reads) */
 #endif
     int32_t vsw_type; /*!< the vectorized smith waterman algorithm (-H,--vsw-type) */
+    int32_t vsw_batch; /*!< score the candidate windows of a read across SIMD lanes (--vsw-batch) */
 
     // DVK: realignment control
     int32_t do_realign; /*!< perform realignment after mapping */
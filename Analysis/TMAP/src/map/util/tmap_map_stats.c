@@ -87,6 +87,9 @@ tmap_map_stats_add(tmap_map_stats_t *dest, tmap_map_stats_t *src)
   dest->bases_fully_tailclipped += src->bases_fully_tailclipped;
 
   dest->num_filtered_als += src->num_filtered_als;
+
+  dest->write_time += src->write_time;
+  dest->compress_time += src->compress_time;
 }
 
 void
@@ -201,4 +204,7 @@ tmap_map_stats_print(tmap_map_stats_t *s)
 
   fprintf (stderr, "num_filtered_als=%llu\n", (unsigned long long int)s->num_filtered_als);
 
+  fprintf (stderr, "write_time=%.2lf\n", s->write_time);
+  fprintf (stderr, "compress_time=%.2lf\n", s->compress_time);
+
 }
@@ -63,6 +63,9 @@ typedef struct
     uint64_t bases_fully_tailclipped;
     // number of filtered alignments 
     uint64_t num_filtered_als;
+    // output stage
+    double write_time; /*!< the time spent writing the alignments by the writing thread, in seconds */
+    double compress_time; /*!< the time spent compressing BAM blocks by the output threads, in seconds */
 } tmap_map_stats_t;
 
 /*!
@@ -1153,6 +1153,41 @@ tmap_map_util_sw_get_start_and_end_pos(tmap_map_sam_t *sam, int32_t seq_len, uin
   }
 }
 
+// adds the band width to the window of a group of hits
+static inline void
+tmap_map_util_sw_gen_score_window(tmap_refseq_t *refseq, uint32_t seqid,
+                                  uint32_t *start_pos, uint32_t *end_pos,
+                                  tmap_map_opt_t *opt)
+{
+  // one-based
+  if((*start_pos) < opt->bw) {
+      (*start_pos) = 1;
+  }
+  else {
+      (*start_pos) -= opt->bw - 1;
+  }
+  (*end_pos) += opt->bw - 1;
+  if(refseq->annos[seqid].len < (*end_pos)) {
+      (*end_pos) = refseq->annos[seqid].len; // one-based
+  }
+}
+
+// gets the target sequence of a window, in the read's orientation
+static inline void
+tmap_map_util_sw_gen_score_target(tmap_refseq_t *refseq, uint32_t seqid, uint8_t strand,
+                                  uint32_t start_pos, uint32_t end_pos, uint8_t *target)
+{
+  // NB: IUPAC codes are turned into mismatches
+  if(NULL == tmap_refseq_subseq2(refseq, seqid+1, start_pos, end_pos, target, 1, NULL)) {
+      tmap_error("bug encountered", Exit, OutOfRange);
+  }
+
+  // reverse compliment the target
+  if(1 == strand) {
+      tmap_reverse_compliment_int(target, end_pos - start_pos + 1);
+  }
+}
+
 // NB: this function unrolls banding in some cases
 static int32_t
 tmap_map_util_sw_gen_score_helper
@@ -1167,6 +1202,8 @@ tmap_map_util_sw_gen_score_helper
     int32_t prev_n_best,
     int32_t max_seed_band, // NB: this may be modified as banding is unrolled
     int32_t prev_score, // NB: must be greater than or equal to the scoring threshold
+    tmap_vsw_result_t *first_result, // the result of the first alignment if already scored, NULL otherwise
+    int32_t first_score,
     tmap_vsw_opt_t *vsw_opt,
     tmap_rand_t *rand,
     tmap_map_opt_t *opt
@@ -1196,33 +1233,17 @@ tmap_map_util_sw_gen_score_helper
   qlen = tmap_seq_get_bases_length(seq);
 
   // add in band width
-  // one-based
-  if(start_pos < opt->bw) {
-      start_pos = 1;
-  }
-  else {
-      start_pos -= opt->bw - 1;
-  }
-  end_pos += opt->bw - 1;
-  if(refseq->annos[sams->sams[end].seqid].len < end_pos) {
-      end_pos = refseq->annos[sams->sams[end].seqid].len; // one-based
-  }
+  tmap_map_util_sw_gen_score_window(refseq, sams->sams[end].seqid, &start_pos, &end_pos, opt);
 
   // get the target sequence
   tlen = end_pos - start_pos + 1;
-  if((*target_mem) < tlen) { // more memory?
-      (*target_mem) = tlen;
-      tmap_roundup32((*target_mem));
-      (*target) = tmap_realloc((*target), sizeof(uint8_t)*(*target_mem), "target");
-  }
-  // NB: IUPAC codes are turned into mismatches
-  if(NULL == tmap_refseq_subseq2(refseq, sams->sams[end].seqid+1, start_pos, end_pos, (*target), 1, NULL)) {
-      tmap_error("bug encountered", Exit, OutOfRange);
-  }
-
-  // reverse compliment the target
-  if(1 == strand) {
-      tmap_reverse_compliment_int((*target), tlen);
+  if(NULL == first_result) { // not needed if already aligned
+      if((*target_mem) < tlen) { // more memory?
+          (*target_mem) = tlen;
+          tmap_roundup32((*target_mem));
+          (*target) = tmap_realloc((*target), sizeof(uint8_t)*(*target_mem), "target");
+      }
+      tmap_map_util_sw_gen_score_target(refseq, sams->sams[end].seqid, strand, start_pos, end_pos, (*target));
   }
 
   // Debugging
@@ -1284,11 +1305,17 @@ tmap_map_util_sw_gen_score_helper
         // initial assumption  
         target_causes_read_clipping = 0;
 
-        // initialize the bounds - why?
-        result.query_start = result.query_end = 0;
-        result.target_start = result.target_end = 0;
-        score = tmap_vsw_process_fwd(vsw, query, qlen, (*target), tlen,
-                                       &result, &overflow, opt->score_thr, 1);
+        if(1 == first_run && NULL != first_result) {
+            result = (*first_result);
+            score = first_score;
+        }
+        else {
+            // initialize the bounds - why?
+            result.query_start = result.query_end = 0;
+            result.target_start = result.target_end = 0;
+            score = tmap_vsw_process_fwd(vsw, query, qlen, (*target), tlen,
+                                           &result, &overflow, opt->score_thr, 1);
+        }
 
         if (1 == overflow) 
             return INT32_MIN;
@@ -1433,6 +1460,7 @@ tmap_map_util_sw_gen_score_helper
                                                                 tmp_sam.result.n_best,
                                                                 (max_seed_band <= 0) ? -1 : (max_seed_band >> 1),
                                                                 tmp_sam.score,
+                                                                NULL, 0,
                                                                 vsw_opt, rand, opt);
 
                   if(cur_score == tmp_sam.score) add_current = 0; // do not add the current alignment, we found it during unrolling
@@ -1559,6 +1587,8 @@ tmap_map_util_sw_gen_score
   int32_t num_groups = 0, num_groups_filtered = 0;
   double stage_seed_freqc = opt->stage_seed_freqc;
   int32_t max_group_size = 0, repr_hit, filter_ok = 0;
+  tmap_vsw_result_t *batch_results = NULL;
+  int32_t *batch_scores = NULL, *batch_idx = NULL;
 
   if(NULL != num_after_grouping) (*num_after_grouping) = 0;
 
@@ -1766,6 +1796,48 @@ tmap_map_util_sw_gen_score
           num_groups_filtered);
           */
 
+  // score the first window of each unfiltered group together
+  if(1 == opt->vsw_batch) {
+      uint8_t **batch_targets = NULL, *batch_mem = NULL;
+      int32_t *batch_tlens = NULL, n_batch = 0;
+      size_t batch_mem_len = 0;
+
+      batch_results = tmap_calloc(num_groups, sizeof(tmap_vsw_result_t), "batch_results"); // NB: zero bounds
+      batch_scores = tmap_malloc(num_groups * sizeof(int32_t), "batch_scores");
+      batch_idx = tmap_malloc(num_groups * sizeof(int32_t), "batch_idx");
+      batch_targets = tmap_malloc(num_groups * sizeof(uint8_t*), "batch_targets");
+      batch_tlens = tmap_malloc(num_groups * sizeof(int32_t), "batch_tlens");
+      for(i=0;i<num_groups;i++) {
+          tmap_map_util_gen_score_t *group = &groups[i];
+          batch_idx[i] = -1;
+          if(1 == group->filtered && 0 == group->repr_hit) continue;
+          start_pos = group->start_pos;
+          end_pos = group->end_pos;
+          tmap_map_util_sw_gen_score_window(refseq, group->seqid, &start_pos, &end_pos, opt);
+          batch_idx[i] = n_batch;
+          batch_tlens[n_batch] = end_pos - start_pos + 1;
+          batch_mem_len += batch_tlens[n_batch];
+          n_batch++;
+      }
+      batch_mem = tmap_malloc(batch_mem_len, "batch_mem");
+      for(i=0,batch_mem_len=0;i<num_groups;i++) {
+          tmap_map_util_gen_score_t *group = &groups[i];
+          if(batch_idx[i] < 0) continue;
+          start_pos = group->start_pos;
+          end_pos = group->end_pos;
+          tmap_map_util_sw_gen_score_window(refseq, group->seqid, &start_pos, &end_pos, opt);
+          batch_targets[batch_idx[i]] = batch_mem + batch_mem_len;
+          tmap_map_util_sw_gen_score_target(refseq, group->seqid, group->strand, start_pos, end_pos, batch_targets[batch_idx[i]]);
+          batch_mem_len += batch_tlens[batch_idx[i]];
+      }
+      tmap_vsw_process_fwd_batch(vsw, (uint8_t*)tmap_seq_get_bases(seqs[0])->s, seq_len,
+                                 batch_targets, batch_tlens, n_batch,
+                                 batch_results, batch_scores, opt->score_thr, 1);
+      free(batch_mem);
+      free(batch_targets);
+      free(batch_tlens);
+  }
+
   // process unfiltered...
   for(i=j=0;i<num_groups;i++) { // go through each group
       tmap_map_util_gen_score_t *group = &groups[i];
@@ -1802,6 +1874,8 @@ tmap_map_util_sw_gen_score
                                         -1, // this is our first call
                                         opt->max_seed_band, // NB: this may be modified as banding is unrolled
                                         opt->score_thr-1,
+                                        (NULL == batch_results) ? NULL : &batch_results[batch_idx[i]],
+                                        (NULL == batch_results) ? 0 : batch_scores[batch_idx[i]],
                                         vsw_opt, rand, opt);
       // save the number of groups
       if(NULL != num_after_grouping) (*num_after_grouping)++;
@@ -1852,6 +1926,7 @@ tmap_map_util_sw_gen_score
                                                 -1, // this is our first call
                                                 opt->max_seed_band, // NB: this may be modified as banding is unrolled
                                                 opt->score_thr-1,
+                                                NULL, 0,
                                                 vsw_opt, rand, opt);
               group->filtered = 0; // no longer filtered
           }
@@ -1871,6 +1946,7 @@ tmap_map_util_sw_gen_score
                                                     -1, // this is our first call
                                                     opt->max_seed_band, // NB: this may be modified as banding is unrolled
                                                     opt->score_thr-1,
+                                                    NULL, 0,
                                                     vsw_opt, rand, opt);
                   group->filtered = 0; // no longer filtered
                   n++;
@@ -1905,6 +1981,7 @@ tmap_map_util_sw_gen_score
                                                     -1, // this is our first call
                                                     opt->max_seed_band, // NB: this may be modified as banding is unrolled
                                                     opt->score_thr-1,
+                                                    NULL, 0,
                                                     vsw_opt, rand, opt);
               }
           }
@@ -1931,6 +2008,9 @@ tmap_map_util_sw_gen_score
   tmap_vsw_opt_destroy(vsw_opt);
   tmap_vsw_destroy(vsw);
   free(groups);
+  free(batch_results);
+  free(batch_scores);
+  free(batch_idx);
 
   return sams_tmp;
 }
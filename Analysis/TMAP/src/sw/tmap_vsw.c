@@ -59,6 +59,7 @@ tmap_vsw_destroy(tmap_vsw_t *vsw)
   if(NULL == vsw) return;
   tmap_vsw_wrapper_destroy(vsw->algorithm);
   tmap_vsw_wrapper_destroy(vsw->algorithm_default);
+  tmap_vsw_batch_destroy(vsw->batch);
   free(vsw);
 }
 
@@ -224,6 +225,60 @@ tmap_vsw_process_compare(tmap_vsw_t *vsw,
 }
 #endif
 
+// stores the results of the forward alignment
+static int32_t
+tmap_vsw_process_fwd_result(tmap_vsw_result_t *result,
+                            int32_t *overflow, int32_t score_thr,
+                            int32_t score, int32_t query_end, int32_t target_end, int32_t n_best)
+{
+  int32_t found_forward = 1;
+
+  result->query_end = query_end;
+  result->target_end = target_end;
+  result->n_best = n_best;
+  result->score_fwd = score;
+
+  // check forward results
+  if(NULL != overflow && 1 == (*overflow)) {
+      found_forward = 0;
+  }
+  else if(result->score_fwd <- score_thr) {
+      found_forward = 0;
+  }
+  else if((result->query_end == result->query_start || result->target_end == result->target_start)
+          && result->score_fwd <= 0) {
+      found_forward = 0;
+  }
+  else if(n_best <= 0) {
+      found_forward = 0;
+  }
+  else if(-1 == result->query_end) {
+      tmap_bug();
+  }
+
+  // return if we found no legal/good forward results
+  if(0 == found_forward) {
+      result->query_end = result->query_start = 0;
+      result->target_end = result->target_start = 0;
+      result->score_fwd = result->score_rev = INT16_MIN;
+      result->n_best = 0;
+      return INT32_MIN;
+  }
+
+  result->query_start = result->target_start = 0;
+  result->score_rev = INT16_MIN;
+
+#ifdef TMAP_VSW_DEBUG
+  fprintf(stderr, "result->score_fwd=%d result->score_rev=%d\n",
+          result->score_fwd, result->score_rev);
+  fprintf(stderr, "{?-%d] {?-%d}\n",
+          result->query_end,
+          result->target_end);
+#endif
+
+  return result->score_fwd;
+}
+
 static int32_t
 tmap_vsw_process(tmap_vsw_t *vsw,
               const uint8_t *query, int32_t qlen,
@@ -232,7 +287,7 @@ tmap_vsw_process(tmap_vsw_t *vsw,
               int32_t *overflow, int32_t score_thr, 
               int32_t is_rev, int32_t direction)
 {
-  int32_t found_forward = 1, query_end, target_end, n_best, score = INT32_MIN;
+  int32_t query_end, target_end, n_best, score = INT32_MIN;
   // TODO: check potential overflow
   // TODO: check that gap penalties will not result in an overflow
   // TODO: check that the max/min alignment score do not result in an overflow
@@ -300,51 +355,7 @@ tmap_vsw_process(tmap_vsw_t *vsw,
   }
   
   if(0 == is_rev) {
-
-      result->query_end = query_end;
-      result->target_end = target_end;
-      result->n_best = n_best;
-      result->score_fwd = score;
-
-      // check forward results
-      if(NULL != overflow && 1 == (*overflow)) {
-          found_forward = 0;
-      }
-      else if(result->score_fwd <- score_thr) {
-          found_forward = 0;
-      }
-      else if((result->query_end == result->query_start || result->target_end == result->target_start)
-              && result->score_fwd <= 0) {
-          found_forward = 0;
-      }
-      else if(n_best <= 0) {
-          found_forward = 0;
-      }
-      else if(-1 == result->query_end) {
-          tmap_bug();
-      }
-
-      // return if we found no legal/good forward results
-      if(0 == found_forward) {
-          result->query_end = result->query_start = 0;
-          result->target_end = result->target_start = 0;
-          result->score_fwd = result->score_rev = INT16_MIN;
-          result->n_best = 0;
-          return INT32_MIN;
-      }
-
-      result->query_start = result->target_start = 0;
-      result->score_rev = INT16_MIN;
-
-#ifdef TMAP_VSW_DEBUG
-      fprintf(stderr, "result->score_fwd=%d result->score_rev=%d\n",
-              result->score_fwd, result->score_rev);
-      fprintf(stderr, "{?-%d] {?-%d}\n",
-              result->query_end,
-              result->target_end);
-#endif
-
-      return result->score_fwd;
+      return tmap_vsw_process_fwd_result(result, overflow, score_thr, score, query_end, target_end, n_best);
   }
   else {
 
@@ -444,3 +455,48 @@ tmap_vsw_process_rev(tmap_vsw_t *vsw,
 {
   return tmap_vsw_process(vsw, query, qlen, target, tlen, result, overflow, score_thr, 1, direction);
 }
+
+void
+tmap_vsw_process_fwd_batch(tmap_vsw_t *vsw,
+                           const uint8_t *query, int32_t qlen,
+                           uint8_t **targets, int32_t *tlens, int32_t n,
+                           tmap_vsw_result_t *results, int32_t *scores,
+                           int32_t score_thr, int32_t direction)
+{
+  int32_t i, overflow;
+  int32_t *score = NULL, *query_end = NULL, *target_end = NULL, *n_best = NULL;
+
+  if(0 == tmap_vsw_batch_supported(query, qlen, vsw->opt)) { // one at a time
+      for(i = 0; i < n; i++) {
+          scores[i] = tmap_vsw_process_fwd(vsw, query, qlen, targets[i], tlens[i],
+                                           &results[i], &overflow, score_thr, direction);
+      }
+      return;
+  }
+  if(NULL == vsw->batch) vsw->batch = tmap_vsw_batch_init();
+
+  score = tmap_malloc(sizeof(int32_t) * n * 4, "score");
+  query_end = score + n;
+  target_end = query_end + n;
+  n_best = target_end + n;
+  tmap_vsw_batch_process(vsw->batch, query, qlen, targets, tlens, n,
+                         vsw->query_start_clip, vsw->query_end_clip,
+                         vsw->opt, direction,
+                         score, query_end, target_end, n_best);
+  for(i = 0; i < n; i++) {
+      if(n_best[i] < 0) { // not aligned in the lanes
+          scores[i] = tmap_vsw_process_fwd(vsw, query, qlen, targets[i], tlens[i],
+                                           &results[i], &overflow, score_thr, direction);
+          continue;
+      }
+      // as in tmap_vsw_process
+      if(score[i] < score_thr || 0 == n_best[i]) {
+          query_end[i] = target_end[i] = -1;
+          n_best[i] = 0;
+          score[i] = INT32_MIN;
+      }
+      scores[i] = tmap_vsw_process_fwd_result(&results[i], NULL, score_thr,
+                                              score[i], query_end[i], target_end[i], n_best[i]);
+  }
+  free(score);
+}
@@ -34,6 +34,7 @@
 #include <stdint.h>
 #include <unistd.h>
 #include "tmap_vsw_definitions.h"
+#include "tmap_vsw_batch.h"
 #include "lib/AffineSWOptimizationWrapper.h"
   
 /*!
@@ -46,6 +47,7 @@ typedef struct {
     int32_t query_start_clip; /*!< 1 if we are to clip the start of the query, 0 otherwise */
     int32_t query_end_clip; /*!< 1 if we are to clip the end of the query, 0 otherwise */
     tmap_vsw_opt_t *opt; /*!< the alignment parameters */
+    tmap_vsw_batch_t *batch; /*!< the memory for aligning many targets at once, NULL until used */
 } tmap_vsw_t;
 
 /*!
@@ -119,4 +121,27 @@ tmap_vsw_process_rev(tmap_vsw_t *vsw,
                  tmap_vsw_result_t *result,
                  int32_t *overflow, int32_t score_thr, int32_t direction);
 
+/*!
+  Performs alignment in the sequencing direction against many targets at once, aligning the
+  targets across SIMD lanes (see tmap_vsw_batch_process).  The results are those of
+  tmap_vsw_process_fwd with the reference VSW algorithm (type 1).  If the query cannot be
+  aligned in the lanes, each target is aligned with tmap_vsw_process_fwd.
+  @param  vsw               the query in its vectorized form
+  @param  query             the query sequence
+  @param  qlen              the query sequence length
+  @param  targets           the target sequences
+  @param  tlens             the target sequence lengths
+  @param  n                 the number of targets
+  @param  results           the structure in which to store the results for each target, initialized as for tmap_vsw_process_fwd
+  @param  scores            the alignment score for each target
+  @param  score_thr         the minimum scoring threshold (inclusive)
+  @param  direction         how to break ties, see tmap_vsw_process_fwd
+  */
+void
+tmap_vsw_process_fwd_batch(tmap_vsw_t *vsw,
+                           const uint8_t *query, int32_t qlen,
+                           uint8_t **targets, int32_t *tlens, int32_t n,
+                           tmap_vsw_result_t *results, int32_t *scores,
+                           int32_t score_thr, int32_t direction);
+
 #endif // TMAP_VSW_H
@@ -0,0 +1,313 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <x86intrin.h>
+#include "../util/tmap_alloc.h"
+#include "../util/tmap_definitions.h"
+#include "tmap_vsw_definitions.h"
+#include "tmap_vsw_batch.h"
+
+/** Lane macros, 16-bit values **/
+#ifdef __AVX2__
+#define __tmap_vsw_batch_set1(_val) _mm256_set1_epi16(_val)
+#define __tmap_vsw_batch_adds(_a, _b) _mm256_adds_epi16(_a, _b)
+#define __tmap_vsw_batch_subs(_a, _b) _mm256_subs_epi16(_a, _b)
+#define __tmap_vsw_batch_max(_a, _b) _mm256_max_epi16(_a, _b)
+#define __tmap_vsw_batch_cmpeq(_a, _b) _mm256_cmpeq_epi16(_a, _b)
+#define __tmap_vsw_batch_cmpgt(_a, _b) _mm256_cmpgt_epi16(_a, _b)
+#define __tmap_vsw_batch_and(_a, _b) _mm256_and_si256(_a, _b)
+#define __tmap_vsw_batch_andnot(_a, _b) _mm256_andnot_si256(_a, _b)
+#define __tmap_vsw_batch_or(_a, _b) _mm256_or_si256(_a, _b)
+#define __tmap_vsw_batch_movemask(_a) _mm256_movemask_epi8(_a)
+#define __tmap_vsw_batch_load(_src) _mm256_load_si256(_src)
+#define __tmap_vsw_batch_store(_dest, _val) _mm256_store_si256(_dest, _val)
+#define __tmap_vsw_batch_loadu(_src) _mm256_loadu_si256((const __m256i*)(_src))
+#define __tmap_vsw_batch_storeu(_dest, _val) _mm256_storeu_si256((__m256i*)(_dest), _val)
+#else
+#define __tmap_vsw_batch_set1(_val) _mm_set1_epi16(_val)
+#define __tmap_vsw_batch_adds(_a, _b) _mm_adds_epi16(_a, _b)
+#define __tmap_vsw_batch_subs(_a, _b) _mm_subs_epi16(_a, _b)
+#define __tmap_vsw_batch_max(_a, _b) _mm_max_epi16(_a, _b)
+#define __tmap_vsw_batch_cmpeq(_a, _b) _mm_cmpeq_epi16(_a, _b)
+#define __tmap_vsw_batch_cmpgt(_a, _b) _mm_cmpgt_epi16(_a, _b)
+#define __tmap_vsw_batch_and(_a, _b) _mm_and_si128(_a, _b)
+#define __tmap_vsw_batch_andnot(_a, _b) _mm_andnot_si128(_a, _b)
+#define __tmap_vsw_batch_or(_a, _b) _mm_or_si128(_a, _b)
+#define __tmap_vsw_batch_movemask(_a) _mm_movemask_epi8(_a)
+#define __tmap_vsw_batch_load(_src) _mm_load_si128(_src)
+#define __tmap_vsw_batch_store(_dest, _val) _mm_store_si128(_dest, _val)
+#define __tmap_vsw_batch_loadu(_src) _mm_loadu_si128((const __m128i*)(_src))
+#define __tmap_vsw_batch_storeu(_dest, _val) _mm_storeu_si128((__m128i*)(_dest), _val)
+#endif
+
+tmap_vsw_batch_t *
+tmap_vsw_batch_init()
+{
+  return tmap_calloc(1, sizeof(tmap_vsw_batch_t), "batch");
+}
+
+void
+tmap_vsw_batch_destroy(tmap_vsw_batch_t *batch)
+{
+  if(NULL == batch) return;
+  free(batch->mem);
+  free(batch);
+}
+
+int32_t
+tmap_vsw_batch_supported(const uint8_t *query, int32_t qlen, tmap_vsw_opt_t *opt)
+{
+  int32_t i, min_edit_score, zero_aln_score, zero;
+
+  if(qlen <= 0 || INT16_MAX <= qlen) return 0;
+  // the query profile of the striped algorithms only scores A/C/G/T
+  for(i = 0; i < qlen; i++) {
+      if(3 < query[i]) return 0;
+  }
+  // an insertion next to a deletion must cost more than a mismatch, otherwise
+  // the striped algorithms, which do not allow adjacent insertions and
+  // deletions, may find different ends
+  if(opt->pen_gapo + 2 * opt->pen_gape <= opt->pen_mm) return 0;
+  // the range of scores of the 16-bit striped algorithms, see vsw16_query_init
+  min_edit_score = (opt->pen_gapo + opt->pen_gape < opt->pen_mm) ? -opt->pen_mm : -(opt->pen_gapo + opt->pen_gape);
+  min_edit_score--;
+  zero_aln_score = qlen * -opt->pen_mm;
+  if(-opt->pen_gapo - (opt->pen_gape * qlen) < zero_aln_score) zero_aln_score = -opt->pen_gapo - (opt->pen_gape * qlen);
+  zero = INT16_MIN - ((zero_aln_score << 1) + min_edit_score) - zero_aln_score;
+  if(INT16_MAX - (opt->score_match << 1) < zero + (qlen * opt->score_match)) return 0;
+  if((INT16_MAX >> 1) <= qlen * opt->score_match) return 0;
+  if((INT16_MAX >> 1) <= opt->pen_gapo + opt->pen_gape * qlen + opt->pen_mm) return 0;
+  return 1;
+}
+
+static void
+tmap_vsw_batch_alloc(tmap_vsw_batch_t *batch, int32_t qlen)
+{
+  if(batch->qlen_max < qlen) {
+      batch->qlen_max = qlen;
+      tmap_roundup32(batch->qlen_max);
+      free(batch->mem);
+      batch->mem = tmap_memalign(sizeof(tmap_vsw_batch_vec_t), 2 * batch->qlen_max * sizeof(tmap_vsw_batch_vec_t), "batch->mem");
+      batch->H = (tmap_vsw_batch_vec_t*)batch->mem;
+      batch->E = batch->H + batch->qlen_max;
+  }
+}
+
+// Aligns the query to up to TMAP_VSW_BATCH_LANES targets, one per lane.
+// Unused lanes have zero length.
+static void
+tmap_vsw_batch_core(tmap_vsw_batch_t *batch,
+                    const uint8_t *query, int32_t qlen,
+                    uint8_t **targets, const int32_t *tlens,
+                    int32_t query_start_clip, int32_t query_end_clip,
+                    tmap_vsw_opt_t *opt, int32_t direction,
+                    int32_t *score, int32_t *query_end, int32_t *target_end, int32_t *n_best)
+{
+  int16_t lane_base[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int16_t lane_tlen[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int16_t lane_best[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int16_t lane_cm[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int16_t lane_cnt[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int16_t lane_j[TMAP_VSW_BATCH_LANES] __attribute__((aligned(32)));
+  int32_t best[TMAP_VSW_BATCH_LANES], qe[TMAP_VSW_BATCH_LANES], te[TMAP_VSW_BATCH_LANES], nb[TMAP_VSW_BATCH_LANES];
+  tmap_vsw_batch_vec_t P[4], *H, *E;
+  tmap_vsw_batch_vec_t zero_mm, min_mm, match_mm, mm_mm, gapoe_mm, gape_mm, low_start_mm, tlen_mm;
+  int32_t i, j, k, tlen_max = 0, j_start;
+
+  tmap_vsw_batch_alloc(batch, qlen);
+  H = batch->H;
+  E = batch->E;
+
+  zero_mm = __tmap_vsw_batch_set1(0);
+  min_mm = __tmap_vsw_batch_set1(INT16_MIN);
+  match_mm = __tmap_vsw_batch_set1(opt->score_match + opt->pen_mm);
+  mm_mm = __tmap_vsw_batch_set1(-opt->pen_mm);
+  gapoe_mm = __tmap_vsw_batch_set1(opt->pen_gapo + opt->pen_gape);
+  gape_mm = __tmap_vsw_batch_set1(opt->pen_gape);
+  // the H value before the first query base: zero if we can start within the query,
+  // otherwise the query bases before it must be inserted
+  low_start_mm = (0 == query_start_clip) ? __tmap_vsw_batch_set1(-opt->pen_gapo) : zero_mm;
+
+  for(k = 0; k < TMAP_VSW_BATCH_LANES; k++) {
+      lane_tlen[k] = tlens[k];
+      if(tlen_max < tlens[k]) tlen_max = tlens[k];
+      best[k] = -1; // only non-negative scores are reported
+      lane_best[k] = -1;
+      qe[k] = te[k] = -1;
+      nb[k] = 0;
+  }
+  tlen_mm = __tmap_vsw_batch_loadu(lane_tlen);
+
+  // H(-1,j) and E(0,j)
+  for(j = 0; j < qlen; j++) {
+      __tmap_vsw_batch_store(H + j, min_mm);
+      __tmap_vsw_batch_store(E + j, (0 == query_start_clip) ? min_mm : zero_mm);
+  }
+  // only the last query base may end the alignment without end clipping
+  j_start = (0 == query_end_clip) ? (qlen - 1) : 0;
+
+  for(i = 0; i < tlen_max; i++) { // for each target base
+      tmap_vsw_batch_vec_t h, e, f, diag, low, cm, valid, target_mm, best_mm;
+
+      // the query profile for this target base, lanes past the end of their target mismatch
+      for(k = 0; k < TMAP_VSW_BATCH_LANES; k++) {
+          lane_base[k] = (i < tlens[k]) ? targets[k][i] : 4;
+      }
+      target_mm = __tmap_vsw_batch_loadu(lane_base);
+      for(k = 0; k < 4; k++) {
+          P[k] = __tmap_vsw_batch_adds(mm_mm, __tmap_vsw_batch_and(__tmap_vsw_batch_cmpeq(target_mm, __tmap_vsw_batch_set1(k)), match_mm));
+      }
+
+      diag = zero_mm; // H(i-1,-1)
+      low = low_start_mm;
+      f = min_mm;
+      cm = min_mm;
+      for(j = 0; j < qlen; j++) { // for each query base
+          /* SW cells are computed in the following order:
+           *   H(i,j)   = max{max{H(i-1,j-1), low(j)}+S(i,j), E(i,j), F(i,j)}
+           *   E(i+1,j) = max{H(i,j)-q, E(i,j)-r}
+           *   F(i,j+1) = max{H(i,j)-q, F(i,j)-r}
+           * where low(j) is zero with start clipping, otherwise the leading insertion score
+           */
+          h = __tmap_vsw_batch_max(diag, low);
+          if(0 == query_start_clip) low = __tmap_vsw_batch_subs(low, gape_mm);
+          h = __tmap_vsw_batch_adds(h, P[query[j]]);
+          e = __tmap_vsw_batch_load(E + j);
+          h = __tmap_vsw_batch_max(h, e);
+          h = __tmap_vsw_batch_max(h, f);
+          cm = __tmap_vsw_batch_max(cm, h);
+          diag = __tmap_vsw_batch_load(H + j);
+          __tmap_vsw_batch_store(H + j, h);
+          h = __tmap_vsw_batch_subs(h, gapoe_mm);
+          e = __tmap_vsw_batch_max(__tmap_vsw_batch_subs(e, gape_mm), h);
+          __tmap_vsw_batch_store(E + j, e);
+          f = __tmap_vsw_batch_max(__tmap_vsw_batch_subs(f, gape_mm), h);
+      }
+      if(0 == query_end_clip) cm = __tmap_vsw_batch_load(H + qlen - 1);
+
+      // mask lanes past the end of their target
+      valid = __tmap_vsw_batch_cmpgt(tlen_mm, __tmap_vsw_batch_set1(i));
+      cm = __tmap_vsw_batch_or(__tmap_vsw_batch_and(valid, cm), __tmap_vsw_batch_andnot(valid, min_mm));
+      best_mm = __tmap_vsw_batch_loadu(lane_best);
+      if(0 == __tmap_vsw_batch_movemask(__tmap_vsw_batch_cmpgt(cm, __tmap_vsw_batch_subs(best_mm, __tmap_vsw_batch_set1(1))))) {
+          continue; // no lane reached its best score
+      }
+
+      // count the cells with the best score, and find the query end to keep
+      {
+        tmap_vsw_batch_vec_t cnt, last, pos, one_mm, eq;
+        best_mm = __tmap_vsw_batch_max(best_mm, cm);
+        one_mm = __tmap_vsw_batch_set1(1);
+        cnt = zero_mm;
+        last = zero_mm;
+        // 1 + j when keeping the largest query end, qlen - j when keeping the smallest
+        pos = __tmap_vsw_batch_set1((1 == direction) ? (j_start + 1) : (qlen - j_start));
+        for(j = j_start; j < qlen; j++) {
+            eq = __tmap_vsw_batch_and(valid, __tmap_vsw_batch_cmpeq(__tmap_vsw_batch_load(H + j), best_mm));
+            cnt = __tmap_vsw_batch_subs(cnt, eq);
+            last = __tmap_vsw_batch_max(last, __tmap_vsw_batch_and(eq, pos));
+            pos = (1 == direction) ? __tmap_vsw_batch_adds(pos, one_mm) : __tmap_vsw_batch_subs(pos, one_mm);
+        }
+        __tmap_vsw_batch_storeu(lane_cm, cm);
+        __tmap_vsw_batch_storeu(lane_cnt, cnt);
+        __tmap_vsw_batch_storeu(lane_j, last);
+      }
+      for(k = 0; k < TMAP_VSW_BATCH_LANES; k++) {
+          int32_t cur_qe;
+          if(i >= tlens[k] || lane_cm[k] < best[k]) continue;
+          cur_qe = (1 == direction) ? (lane_j[k] - 1) : (qlen - lane_j[k]);
+          if(best[k] < lane_cm[k]) {
+              best[k] = lane_best[k] = lane_cm[k];
+              nb[k] = lane_cnt[k];
+              qe[k] = cur_qe;
+              te[k] = i;
+          }
+          else {
+              nb[k] += lane_cnt[k];
+              // break ties by query end, then by the largest target end
+              if((1 == direction && qe[k] <= cur_qe) || (0 == direction && cur_qe <= qe[k])) {
+                  qe[k] = cur_qe;
+                  te[k] = i;
+              }
+          }
+      }
+  }
+
+  for(k = 0; k < TMAP_VSW_BATCH_LANES; k++) {
+      if(best[k] < 0) {
+          score[k] = INT16_MIN;
+          query_end[k] = target_end[k] = -1;
+          n_best[k] = 0;
+      }
+      else {
+          score[k] = best[k];
+          query_end[k] = qe[k];
+          target_end[k] = te[k];
+          n_best[k] = nb[k];
+      }
+  }
+}
+
+int32_t
+tmap_vsw_batch_process(tmap_vsw_batch_t *batch,
+                       const uint8_t *query, int32_t qlen,
+                       uint8_t **targets, const int32_t *tlens, int32_t n,
+                       int32_t query_start_clip, int32_t query_end_clip,
+                       tmap_vsw_opt_t *opt, int32_t direction,
+                       int32_t *score, int32_t *query_end, int32_t *target_end, int32_t *n_best)
+{
+  uint8_t *lane_targets[TMAP_VSW_BATCH_LANES];
+  int32_t lane_tlens[TMAP_VSW_BATCH_LANES], lane_idx[TMAP_VSW_BATCH_LANES];
+  int32_t lane_score[TMAP_VSW_BATCH_LANES], lane_qe[TMAP_VSW_BATCH_LANES], lane_te[TMAP_VSW_BATCH_LANES], lane_nb[TMAP_VSW_BATCH_LANES];
+  int32_t *order = NULL;
+  int32_t i, k, l, m, n_aligned = 0;
+
+  // fill the lanes with targets of similar lengths, longest first
+  order = tmap_malloc(sizeof(int32_t) * n, "order");
+  for(i = m = 0; i < n; i++) {
+      if(0 < tlens[i] && tlens[i] < INT16_MAX) {
+          order[m++] = i;
+      }
+      else {
+          score[i] = INT16_MIN;
+          query_end[i] = target_end[i] = -1;
+          n_best[i] = -1;
+      }
+  }
+  for(i = 1; i < m; i++) { // insertion sort, n is the number of candidate windows
+      int32_t x = order[i];
+      for(l = i; 0 < l && tlens[order[l-1]] < tlens[x]; l--) {
+          order[l] = order[l-1];
+      }
+      order[l] = x;
+  }
+
+  for(i = 0; i < m; i += TMAP_VSW_BATCH_LANES) {
+      for(k = 0; k < TMAP_VSW_BATCH_LANES; k++) {
+          if(i + k < m) {
+              lane_idx[k] = order[i + k];
+              lane_targets[k] = targets[lane_idx[k]];
+              lane_tlens[k] = tlens[lane_idx[k]];
+          }
+          else {
+              lane_idx[k] = -1;
+              lane_targets[k] = NULL;
+              lane_tlens[k] = 0;
+          }
+      }
+      tmap_vsw_batch_core(batch, query, qlen, lane_targets, lane_tlens,
+                          query_start_clip, query_end_clip, opt, direction,
+                          lane_score, lane_qe, lane_te, lane_nb);
+      for(k = 0; k < TMAP_VSW_BATCH_LANES && 0 <= lane_idx[k]; k++) {
+          score[lane_idx[k]] = lane_score[k];
+          query_end[lane_idx[k]] = lane_qe[k];
+          target_end[lane_idx[k]] = lane_te[k];
+          n_best[lane_idx[k]] = lane_nb[k];
+          n_aligned++;
+      }
+  }
+  free(order);
+
+  return n_aligned;
+}
@@ -0,0 +1,86 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef TMAP_VSW_BATCH_H
+#define TMAP_VSW_BATCH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <x86intrin.h>
+#include "tmap_vsw_definitions.h"
+
+/*!
+  Inter-sequence vectorized smith waterman: one query against many targets,
+  one target per 16-bit SIMD lane.  The query is aligned to each target with
+  the same clipping and tie-breaking rules as the striped (intra-sequence)
+  algorithms, so the results match those of tmap_vsw_wrapper_process.
+  */
+
+#ifdef __AVX2__
+#define TMAP_VSW_BATCH_LANES 16
+typedef __m256i tmap_vsw_batch_vec_t;
+#else
+#define TMAP_VSW_BATCH_LANES 8
+typedef __m128i tmap_vsw_batch_vec_t;
+#endif
+
+/*!
+  The DP memory, re-used across calls.
+  */
+typedef struct {
+    int32_t qlen_max; /*!< the maximum query length the memory holds */
+    void *mem; /*!< the allocated memory */
+    tmap_vsw_batch_vec_t *H; /*!< the H values of the last target column */
+    tmap_vsw_batch_vec_t *E; /*!< the E values of the next target column */
+} tmap_vsw_batch_t;
+
+/*!
+  @return  the initialized DP memory
+  */
+tmap_vsw_batch_t *
+tmap_vsw_batch_init();
+
+/*!
+  @param  batch  the DP memory to destroy
+  */
+void
+tmap_vsw_batch_destroy(tmap_vsw_batch_t *batch);
+
+/*!
+  @param  query  the query sequence
+  @param  qlen   the query sequence length
+  @param  opt    the alignment parameters
+  @return        1 if the query can be aligned in the 16-bit lanes, 0 otherwise
+  @details  the query may not contain ambiguous bases, and the range of alignment
+  scores must fit in 16-bits for the striped algorithms as well, otherwise they
+  would overflow or fall back to a different algorithm.
+  */
+int32_t
+tmap_vsw_batch_supported(const uint8_t *query, int32_t qlen, tmap_vsw_opt_t *opt);
+
+/*!
+  @param  batch             the DP memory
+  @param  query             the query sequence
+  @param  qlen              the query sequence length
+  @param  targets           the target sequences
+  @param  tlens             the target sequence lengths
+  @param  n                 the number of targets
+  @param  query_start_clip  1 if we are to clip the start of the query, 0 otherwise
+  @param  query_end_clip    1 if we are to clip the end of the query, 0 otherwise
+  @param  opt               the alignment parameters
+  @param  direction         how to break ties, see tmap_vsw_process_fwd
+  @param  score             the alignment score of each target, INT16_MIN if none was found
+  @param  query_end         the query end of each target (0-based), -1 if none was found
+  @param  target_end        the target end of each target (0-based), -1 if none was found
+  @param  n_best            the number of best scoring alignments of each target
+  @return                   the number of targets aligned, the rest must be aligned one at a time
+  @details  tmap_vsw_batch_supported must be true for the query.  Targets longer than
+  INT16_MAX are not aligned, and have n_best set to -1.
+  */
+int32_t
+tmap_vsw_batch_process(tmap_vsw_batch_t *batch,
+                       const uint8_t *query, int32_t qlen,
+                       uint8_t **targets, const int32_t *tlens, int32_t n,
+                       int32_t query_start_clip, int32_t query_end_clip,
+                       tmap_vsw_opt_t *opt, int32_t direction,
+                       int32_t *score, int32_t *query_end, int32_t *target_end, int32_t *n_best);
+
+#endif // TMAP_VSW_BATCH_H
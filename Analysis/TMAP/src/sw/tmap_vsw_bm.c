@@ -23,9 +23,9 @@
 #ifdef ENABLE_TMAP_DEBUG_FUNCTIONS
 void
 tmap_vsw_bm_core(int32_t seq_len, int32_t tlen, int32_t n_iter,
-                 int32_t n_sub_iter, int32_t vsw_type)
+                 int32_t n_sub_iter, int32_t vsw_type, int32_t n_batch)
 {
-  int32_t i, j, k;
+  int32_t i, j, k, b;
   tmap_vsw_t *vsw = NULL;
   tmap_vsw_opt_t *vsw_opt = NULL;
   int32_t softclip_start, softclip_end;
@@ -34,11 +34,22 @@ tmap_vsw_bm_core(int32_t seq_len, int32_t tlen, int32_t n_iter,
 
   tmap_map_opt_t *opt = tmap_map_opt_init(TMAP_MAP_ALGO_NONE);
 
-  uint8_t *seq, *target;
+  uint8_t *seq, *target, **targets;
+  int32_t *tlens, *scores;
+  tmap_vsw_result_t *results;
   tmap_rand_t *rand = tmap_rand_init(0);
 
+  if(n_batch < 1) n_batch = 1;
   seq = tmap_malloc(sizeof(uint8_t) * seq_len, "seq");
-  target = tmap_malloc(sizeof(uint8_t) * tlen, "target");
+  target = tmap_malloc(sizeof(uint8_t) * tlen * n_batch, "target");
+  targets = tmap_malloc(sizeof(uint8_t*) * n_batch, "targets");
+  tlens = tmap_malloc(sizeof(int32_t) * n_batch, "tlens");
+  scores = tmap_malloc(sizeof(int32_t) * n_batch, "scores");
+  results = tmap_calloc(n_batch, sizeof(tmap_vsw_result_t), "results");
+  for(b=0;b<n_batch;b++) {
+      targets[b] = target + b * tlen;
+      tlens[b] = tlen;
+  }
 
   // random sequence
   for(i=0;i<seq_len;i++) {
@@ -63,17 +74,24 @@ tmap_vsw_bm_core(int32_t seq_len, int32_t tlen, int32_t n_iter,
   while(i<n_iter) {
       tmap_map_sam_t tmp_sam;
       int32_t overflow;
-      for(j=k=0;j<front;j++,k++) {
-          target[k] = (uint8_t)(4*tmap_rand_get(rand));
-      }
-      for(j=0;j<seq_len;j++,k++) {
-          target[k] = seq[j];
-      }
-      for(j=0;j<end;j++,k++) {
-          target[k] = (uint8_t)(4*tmap_rand_get(rand));
+      for(b=k=0;b<n_batch;b++) {
+          for(j=0;j<front;j++,k++) {
+              target[k] = (uint8_t)(4*tmap_rand_get(rand));
+          }
+          for(j=0;j<seq_len;j++,k++) {
+              target[k] = seq[j];
+          }
+          for(j=0;j<end;j++,k++) {
+              target[k] = (uint8_t)(4*tmap_rand_get(rand));
+          }
       }
       for(j=0;j<n_sub_iter&&i<n_iter;j++,i++) {
-          if(0 <= vsw_type) { 
+          if(0 <= vsw_type && 1 < n_batch) {
+              // run the vsw on all the targets at once
+              tmap_vsw_process_fwd_batch(vsw, seq, seq_len, targets, tlens, n_batch,
+                                         results, scores, opt->score_thr, 0);
+          }
+          else if(0 <= vsw_type) { 
               // initialize the bounds
               tmp_sam.result.query_start = tmp_sam.result.query_end = 0;
               tmp_sam.result.target_start = tmp_sam.result.target_end = 0;
@@ -91,6 +109,10 @@ tmap_vsw_bm_core(int32_t seq_len, int32_t tlen, int32_t n_iter,
 
   // free memory
   free(target);
+  free(targets);
+  free(tlens);
+  free(scores);
+  free(results);
   free(seq);
   if(0 <= vsw_type) {
       tmap_vsw_opt_destroy(vsw_opt);
@@ -102,7 +124,7 @@ tmap_vsw_bm_core(int32_t seq_len, int32_t tlen, int32_t n_iter,
 
 static int
 usage(int32_t seq_len, int32_t tlen, int32_t n_iter, 
-      int32_t n_sub_iter, int32_t vsw_type)
+      int32_t n_sub_iter, int32_t vsw_type, int32_t n_batch)
 {
   tmap_file_fprintf(tmap_file_stderr, "\n");
   tmap_file_fprintf(tmap_file_stderr, "Usage: %s vswbm [options]", PACKAGE);
@@ -113,6 +135,7 @@ usage(int32_t seq_len, int32_t tlen, int32_t n_iter,
   tmap_file_fprintf(tmap_file_stderr, "         -n INT      the number of iterations [%d]\n", n_iter);
   tmap_file_fprintf(tmap_file_stderr, "         -N INT      the number of re-evaluations of the same query/target combination [%d]\n", n_sub_iter);
   tmap_file_fprintf(tmap_file_stderr, "         -H INT      smith waterman algorithm [%d]\n", vsw_type);
+  tmap_file_fprintf(tmap_file_stderr, "         -B INT      the number of targets aligned together per iteration [%d]\n", n_batch);
   tmap_file_fprintf(tmap_file_stderr, "Options (optional):\n");
   tmap_file_fprintf(tmap_file_stderr, "         -h          print this message\n");
   tmap_file_fprintf(tmap_file_stderr, "\n");
@@ -128,9 +151,10 @@ tmap_vswbm_main(int argc, char *argv[])
   int32_t n_iter = 1000;
   int32_t n_sub_iter = 1;
   int32_t vsw_type = 0;
+  int32_t n_batch = 1;
   int c;
 
-  while((c = getopt(argc, argv, "q:t:n:N:H:h")) >= 0) {
+  while((c = getopt(argc, argv, "q:t:n:N:H:B:h")) >= 0) {
       switch(c) {
         case 'q':
           seq_len = atoi(optarg); break;
@@ -142,19 +166,21 @@ tmap_vswbm_main(int argc, char *argv[])
           n_sub_iter = atoi(optarg); break;
         case 'H':
           vsw_type = atoi(optarg); break;
+        case 'B':
+          n_batch = atoi(optarg); break;
         case 'h':
         default:
-          return usage(seq_len, tlen, n_iter, n_sub_iter, vsw_type);
+          return usage(seq_len, tlen, n_iter, n_sub_iter, vsw_type, n_batch);
       }
   }
   if(argc != optind || seq_len > tlen) {
-      return usage(seq_len, tlen, n_iter, n_sub_iter, vsw_type);
+      return usage(seq_len, tlen, n_iter, n_sub_iter, vsw_type, n_batch);
   }
 
   tmap_progress_set_verbosity(1);
   tmap_progress_print2("starting benchmark");
 
-  tmap_vsw_bm_core(seq_len, tlen, n_iter, n_sub_iter, vsw_type);
+  tmap_vsw_bm_core(seq_len, tlen, n_iter, n_sub_iter, vsw_type, n_batch);
   
   tmap_progress_print2("ending benchmark");
 
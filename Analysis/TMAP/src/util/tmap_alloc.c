@@ -6,7 +6,6 @@
 #include "tmap_alloc.h"
 #include "tmap_error.h"
 
-/*
 inline void *
 tmap_memalign1(size_t alignment, size_t size, const char *function_name, const char *variable_name)
 {
@@ -16,7 +15,6 @@ tmap_memalign1(size_t alignment, size_t size, const char *function_name, const c
   }
   return ptr;
 }
-*/
 
 inline void *
 tmap_malloc1(size_t size, const char *function_name, const char *variable_name)
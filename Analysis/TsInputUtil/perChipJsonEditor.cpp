@@ -128,6 +128,7 @@ int main(int argc, const char *argv[])
     mapOptType["bkg-prefilter-beads"] = OT_BOOL;
     mapOptType["bkg-recompress-tail-raw-trace"] = OT_BOOL;
     mapOptType["bkg-single-gauss-newton"] = OT_BOOL;
+    mapOptType["bkg-single-flow-batch"] = OT_BOOL;
     mapOptType["bkg-use-duds"] = OT_BOOL;
     mapOptType["bkg-use-proton-well-correction"] = OT_BOOL;
     mapOptType["bkg-washout-flow-detection"] = OT_INT;
@@ -187,7 +188,9 @@ int main(int argc, const char *argv[])
     mapOptType["hilowfilter"] = OT_BOOL;
     mapOptType["ignore-checksum-errors"] = OT_BOOL;
     mapOptType["ignore-checksum-errors-1frame"] = OT_BOOL;
+    mapOptType["img-decode-threads"] = OT_INT;
     mapOptType["img-gain-correct"] = OT_BOOL;
+    mapOptType["img-noise-correct-threads"] = OT_INT;
     mapOptType["incorporation-type"] = OT_INT;
     mapOptType["kmult-hi-limit"] = OT_DOUBLE;
     mapOptType["kmult-low-limit"] = OT_DOUBLE;
@@ -583,6 +583,14 @@ int main(int argc, const char *argv[])
     jsonBase["ImageControlOpts"]["no-threaded-file-access"]["value"] = false;
     jsonBase["ImageControlOpts"]["no-threaded-file-access"]["min"] = "";
     jsonBase["ImageControlOpts"]["no-threaded-file-access"]["max"] = "";
+    jsonBase["ImageControlOpts"]["img-decode-threads"]["type"] = OT_INT;
+    jsonBase["ImageControlOpts"]["img-decode-threads"]["value"] = 4;
+    jsonBase["ImageControlOpts"]["img-decode-threads"]["min"] = "";
+    jsonBase["ImageControlOpts"]["img-decode-threads"]["max"] = "";
+    jsonBase["ImageControlOpts"]["img-noise-correct-threads"]["type"] = OT_INT;
+    jsonBase["ImageControlOpts"]["img-noise-correct-threads"]["value"] = 1;
+    jsonBase["ImageControlOpts"]["img-noise-correct-threads"]["min"] = "";
+    jsonBase["ImageControlOpts"]["img-noise-correct-threads"]["max"] = "";
     jsonBase["ImageControlOpts"]["frames"]["type"] = OT_INT;
     jsonBase["ImageControlOpts"]["frames"]["value"] = -1;
     jsonBase["ImageControlOpts"]["frames"]["min"] = "";
@@ -905,6 +913,10 @@ int main(int argc, const char *argv[])
     jsonBase["LocalSigProcControl"]["bkg-single-gauss-newton"]["value"] = true;
     jsonBase["LocalSigProcControl"]["bkg-single-gauss-newton"]["min"] = "";
     jsonBase["LocalSigProcControl"]["bkg-single-gauss-newton"]["max"] = "";
+    jsonBase["LocalSigProcControl"]["bkg-single-flow-batch"]["type"] = OT_BOOL;
+    jsonBase["LocalSigProcControl"]["bkg-single-flow-batch"]["value"] = false;
+    jsonBase["LocalSigProcControl"]["bkg-single-flow-batch"]["min"] = "";
+    jsonBase["LocalSigProcControl"]["bkg-single-flow-batch"]["max"] = "";
     jsonBase["LocalSigProcControl"]["fit-region-kmult"]["type"] = OT_BOOL;
     jsonBase["LocalSigProcControl"]["fit-region-kmult"]["value"] = false;
     jsonBase["LocalSigProcControl"]["fit-region-kmult"]["min"] = "";
@@ -8,10 +8,14 @@
 #ifndef BAMWALKERENGINE_H
 #define BAMWALKERENGINE_H
 
+#include <algorithm>
 #include <list>
 #include <map>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
 #include "api/BamMultiReader.h"
 #include "api/BamWriter.h"
 #include "TargetsManager.h"
@@ -46,6 +50,62 @@ struct Allele {
 };
 
 
+// Per-read arrays indexed by position on the reference, carved out of one buffer sized to the read.
+// The buffer is kept when the read is recycled, so unpacking a recycled read does not allocate.
+struct ReadRefmap {
+
+  ReadRefmap() { Clear(); }
+  ReadRefmap(const ReadRefmap& other) { Clear(); *this = other; }
+  ReadRefmap& operator=(const ReadRefmap& other) {
+    if (this == &other)
+      return *this;
+    if (not other.allele) {
+      Clear();
+      return *this;
+    }
+    Allocate(other.length);
+    memcpy(&slab_[0], &other.slab_[0], SlabSize(length)); // Allele is trivially copyable
+    return *this;
+  }
+
+  void Clear() {
+    length = 0;
+    start = NULL;
+    code = NULL;
+    has_allele = NULL;
+    allele = NULL;
+  }
+
+  // start and code hold one more entry, for the position after the last one
+  void Allocate(int ref_length) {
+    length = ref_length > 0 ? ref_length : 0;
+    if (slab_.size() < SlabSize(length))
+      slab_.resize(SlabSize(length));
+    char *slab = &slab_[0];
+    allele = reinterpret_cast<Allele*>(slab);
+    std::uninitialized_fill_n(allele, length, Allele());
+    start = reinterpret_cast<const char**>(slab + length * sizeof(Allele));
+    code = reinterpret_cast<char*>(start + length + 1);
+    has_allele = code + length + 1;
+    memset(has_allele, 'N', length);
+  }
+
+  int                   length;             //! Number of reference positions covered by the read
+  const char**          start;              //! Read base aligned to each reference position
+  char*                 code;               //! Alignment code of each reference position: M, X, D or N
+  char*                 has_allele;         //! Whether an allele covers each reference position: R, A or N
+  Allele*               allele;             //! Allele covering each reference position
+
+private:
+  static size_t SlabSize(int ref_length) {
+    // Allele first, then the pointers, then the codes: each array stays aligned
+    return ref_length * sizeof(Allele) + (ref_length + 1) * sizeof(const char*) + 2 * ref_length + 1;
+  }
+
+  vector<char>          slab_;              //! Buffer holding the arrays, aligned as returned by new
+};
+
+
 // structure to encapsulate registered reads and alleles
 struct Alignment {
 
@@ -68,17 +128,14 @@ struct Alignment {
     primary_sample = false;
     snp_count = 0;
     is_read_allele_unpacked = false;
-    refmap_start.clear();
-    refmap_code.clear();
-    refmap_has_allele.clear();
-    refmap_allele.clear();
+    refmap.Clear();
     target_coverage_indices.clear();
     best_coverage_target_idx = -1;
     is_reverse_strand = false;
-    measurements.clear();
+    quantized_measurements.clear();
     measurements_length = 0;
     phase_params.clear();
-    measurements_sd.clear();
+    quantized_measurements_sd.clear();
     runid.clear();
     well_rowcol.clear();
     read_bases.clear();
@@ -98,6 +155,21 @@ struct Alignment {
     tag_info.Clear();
   }
 
+  // Expands the quantized measurements, zero padded to num_flows
+  void GetMeasurements(vector<float>& measurements, int num_flows) const {
+    ExpandMeasurements(quantized_measurements, measurements, num_flows);
+  }
+  // Expands the quantized standard deviation of measurements, empty for non-consensus reads
+  void GetMeasurementsSd(vector<float>& measurements_sd) const {
+    ExpandMeasurements(quantized_measurements_sd, measurements_sd, (int)quantized_measurements_sd.size());
+  }
+  static void ExpandMeasurements(const vector<int16_t>& quantized, vector<float>& values, int num_flows) {
+    values.assign(num_flows, 0.0f);
+    int num_quantized = min((int)quantized.size(), num_flows);
+    for (int flow = 0; flow < num_quantized; ++flow)
+      values[flow] = (float)quantized[flow] / 256.0f;
+  }
+
   BamAlignment          alignment;          //! Raw BamTools alignment
   Alignment*            next;               //! Singly-linked list for durable alignments iterator
   int                   read_number;        //! Sequential number of this read
@@ -120,19 +192,16 @@ struct Alignment {
   bool                  primary_sample;     //! This sample is being called by evaluator
   int                   snp_count;
   bool                  is_read_allele_unpacked;  //! The flag that indicates the reads alleles is unpacked by AlleleParser::UnpackReadAlleles or not.
-  vector<const char*>   refmap_start;
-  vector<char>          refmap_code;
-  vector<char>          refmap_has_allele;
-  vector<Allele>        refmap_allele;
+  ReadRefmap            refmap;             //! Read bases, alignment codes and alleles by reference position
   vector<int>           target_coverage_indices;  //! The sorted vector of the indices of the "unmerged" regions covered by the read
   int                   best_coverage_target_idx;
 
   // Candidate evaluator information
   bool                  is_reverse_strand;  //! Indicates whether read is from the forward or reverse strand
-  vector<float>         measurements;       //! The measurement values for this read blown up to the length of the flow order
+  vector<int16_t>       quantized_measurements;    //! The ZM measurement values for this read, times 256; see GetMeasurements
   int                   measurements_length;//! Original trimmed length of the ZM measurements vector
   vector<float>         phase_params;       //! cf, ie, droop parameters of this read
-  vector<float>         measurements_sd;    //! The standard deviation of measurements for consensus reads
+  vector<int16_t>       quantized_measurements_sd; //! The ZS standard deviation of measurements for consensus reads, times 256
   string                runid;              //! Identify the run from which this read came: used to find run-specific parameters
   vector<int>           well_rowcol;        //! 2 element int vector 0-based row, col in that order mapping to row,col in chip
   string                read_bases;         //! Read sequence as base called (minus hard but including soft clips)
@@ -335,9 +335,43 @@ PersistingThreadObjects::PersistingThreadObjects(const InputStructures &global_c
 #ifdef __SSE3__
     }
 #endif
+    model_phase_params_.resize(global_context.flow_order_vector.size());
+    model_As_.assign(global_context.flow_order_vector.size(), NULL);
+    model_Bs_.assign(global_context.flow_order_vector.size(), NULL);
 };
 
 // ------------------------------------------------------------------------------------
+// A fully simulated read does not look at its measurements, so its prediction is determined by
+// the phasing model, the recalibration model, the simulated bases, and the last simulated flow.
+
+void PersistingThreadObjects::BuildPredictionKey(const int & flow_order_index, const vector<char> & sequence, const int & end_flow)
+{
+    const vector<float> & phase_params = model_phase_params_.at(flow_order_index);
+    const void * recal_ptrs[2] = {model_As_.at(flow_order_index), model_Bs_.at(flow_order_index)};
+
+    prediction_key_.clear();
+    prediction_key_.append((const char*)&flow_order_index, sizeof(int));
+    prediction_key_.append((const char*)&end_flow, sizeof(int));
+    prediction_key_.append((const char*)recal_ptrs, sizeof(recal_ptrs));
+    if (not phase_params.empty())
+      prediction_key_.append((const char*)&phase_params[0], phase_params.size()*sizeof(float));
+    prediction_key_.push_back('\0');
+    prediction_key_.append(sequence.begin(), sequence.end());
+}
+
+vector<float> & PersistingThreadObjects::CachedPrediction(const int & flow_order_index, const vector<char> & sequence, const int & end_flow)
+{
+    BuildPredictionKey(flow_order_index, sequence, end_flow);
+    map<string, vector<float> >::iterator it = prediction_cache_.find(prediction_key_);
+    if (it != prediction_cache_.end())
+      return it->second;
+    // Reads at one position share most of their predictions; start over once we moved on
+    if (prediction_cache_.size() >= kMaxCachedPredictions)
+      prediction_cache_.clear();
+    return prediction_cache_[prediction_key_];
+}
+
+// ------------------------------------------------------------------------------------
 
 
 
@@ -222,6 +222,7 @@ public:
       else
 #endif
         dpTreephaser_vector.at(flow_order_index).SetModelParameters(phase_params.at(0), phase_params.at(1), phase_params.at(2));
+      model_phase_params_.at(flow_order_index) = phase_params;
     };
 
     //@brief Interface for setting the phasing model parameters
@@ -233,17 +234,23 @@ public:
        else
 #endif
          dpTreephaser_vector.at(flow_order_index).DisableRecalibration();
+       model_As_.at(flow_order_index) = NULL;
+       model_Bs_.at(flow_order_index) = NULL;
     };
 
     //@brief Interface set the calibration coefficients
     bool SetAsBs(const int & flow_order_index, const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs)
     {
+      bool is_live;
 #ifdef __SSE3__
       if (use_SSE_basecaller)
-        return (treephaserSSE_vector.at(flow_order_index).SetAsBs(As, Bs));
+        is_live = treephaserSSE_vector.at(flow_order_index).SetAsBs(As, Bs);
       else
 #endif
-        return (dpTreephaser_vector.at(flow_order_index).SetAsBs(As, Bs));
+        is_live = dpTreephaser_vector.at(flow_order_index).SetAsBs(As, Bs);
+      model_As_.at(flow_order_index) = is_live ? As : NULL;
+      model_Bs_.at(flow_order_index) = is_live ? Bs : NULL;
+      return is_live;
     };
 
     //@brief Interface for simulating and solving read bases
@@ -256,6 +263,12 @@ public:
         dpTreephaser_vector.at(flow_order_index).Solve(read, end_flow, begin_flow);
     };
 
+    //@brief Memoized prediction of a read that is simulated up to end_flow without solving
+    //@brief Returns an empty vector for the caller to fill if the read has not been simulated under the current model yet
+    vector<float> & CachedPrediction(const int & flow_order_index, const vector<char> & sequence, const int & end_flow);
+
+    static const unsigned int kMaxCachedPredictions = 1024;  // the cache starts over once it holds this many
+
 
     bool                   use_SSE_basecaller;    // Switch that tells us which basecaller is active
 
@@ -265,6 +278,17 @@ public:
     vector<TreephaserSSE>  treephaserSSE_vector;  // vectorized treephaser
 #endif
 
+private:
+    void BuildPredictionKey(const int & flow_order_index, const vector<char> & sequence, const int & end_flow);
+
+    // Model the treephasers currently simulate with, per flow order
+    vector<vector<float> > model_phase_params_;
+    vector<const vector<vector< vector<float> > > *> model_As_;
+    vector<const vector<vector< vector<float> > > *> model_Bs_;
+
+    string                        prediction_key_;    // scratch space for the cache key
+    map<string, vector<float> >   prediction_cache_;  // predictions of fully simulated reads
+
 
 
 
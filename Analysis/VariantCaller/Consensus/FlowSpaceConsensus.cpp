@@ -594,7 +594,7 @@ bool FlowSpaceConsensusMaster::CalculateConsensusMeasurements(const vector<vecto
 // this->InitializeForBaseCalling(short, const vector<float>&) must be done first.
 // Input: flow_synchronized_measurements, trim_info
 // Outputs: consensus_measurements, prefix_trimmed_consensus_base, measurements_sd
-// Call this function if I use void GetMeasurements(const vector<const Alignment*>&, vector< vector <float> *>&) to get flow_synchronized_measurements
+// Call this function if the flow_synchronized_measurements are held elsewhere
 bool FlowSpaceConsensusMaster::CalculateConsensusMeasurements(const vector<const vector <float> *>& flow_synchronized_measurements,
 		 const TrimInfo& trim_info,
 		 vector<float>& consensus_measurements,
@@ -707,26 +707,18 @@ void FlowSpaceConsensusMaster::TrimPrefixSuffixBases(const TrimInfo& trim_info,
 	}
 }
 
-// This function works for the case where the measurements have been written in Alignment
-void FlowSpaceConsensusMaster::GetMeasurements(const vector<const Alignment*>& cluster_members, vector<const vector <float> *>& flow_synchronized_measurements_ptr)
-{
-	flow_synchronized_measurements_ptr.assign(cluster_members.size(), NULL);
-	for (unsigned int read_idx = 0; read_idx < cluster_members.size(); ++read_idx)
-	{
-		if (cluster_members[read_idx]->measurements.empty()){
-			cerr << "ERROR: Normalized measurements not initialized in read " << cluster_members[read_idx]->alignment.Name << endl;
-			exit(1);
-		}
-		flow_synchronized_measurements_ptr[read_idx] = &(cluster_members[read_idx]->measurements);
-	}
-}
-
-// This function works for the case where the measurements were not written in Alignment
+// Alignment only keeps the quantized measurements, so they are expanded here
 void FlowSpaceConsensusMaster::GetMeasurements(const vector<const Alignment*>& cluster_members,  vector< vector <float> >& flow_synchronized_measurements)
 {
 	flow_synchronized_measurements.reserve(cluster_members.size());
 	for (vector<const Alignment *>::const_iterator read_it = cluster_members.begin(); read_it != cluster_members.end(); ++read_it)
 	{
+	    if (not (*read_it)->quantized_measurements.empty()){
+	    	// The measurements have been written in Alignment
+	    	flow_synchronized_measurements.push_back(vector<float>());
+	    	(*read_it)->GetMeasurements(flow_synchronized_measurements.back(), (*read_it)->measurements_length);
+	    	continue;
+	    }
 	    vector<int16_t> quantized_measurements;
 	    if (not (*read_it)->alignment.GetTag("ZM", quantized_measurements)) {
 		    cerr << "ERROR: Normalized measurements ZM:tag is not present in read " << (*read_it)->alignment.Name << endl;
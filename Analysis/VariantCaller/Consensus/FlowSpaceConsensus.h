@@ -99,7 +99,6 @@ public:
 
 	void PropagateFlowspaceConsensusParameters(const ConsensusParameters& my_param, bool use_mol_tag);
 	void CalculateConsensusPhaseParams(const vector<const Alignment*>& cluster_members, vector<float>& consensus_phase_params, bool is_zero_droop = true);
-	void GetMeasurements(const vector<const Alignment*>& cluster_members, vector<const vector <float> *>& flow_synchronized_measurements_ptr);
 	void GetMeasurements(const vector<const Alignment*>& cluster_members, vector< vector <float> >& flow_synchronized_measurements);
 	void InitializeForBaseCalling(const FlowSpaceCluster& my_cluster, const vector<float>& consensus_phase_params, bool suppress_recal, string &consensus_read_name);
 	void InitializeConsensusCounter();
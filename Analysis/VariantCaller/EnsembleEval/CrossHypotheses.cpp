@@ -2,6 +2,8 @@
 
 #include "CrossHypotheses.h"
 #include "RandSchrange.h"
+#include "Vecs.h"
+#include <string.h>
 
 // model as a t-distribution to slightly resist outliers
 
@@ -71,6 +73,84 @@ float PrecomputeTDistOddN::LogTDistOddN(float res, float sigma, float skew){
   return my_log_likelihood;
 }
 
+// Natural logarithm of four positive, normal floats (cephes polynomial, within a few ulp of logf)
+static inline v4f LogVec4f(v4f x)
+{
+  v4i bits = (v4i)x;
+  v4i exponent = ((bits >> LD_VEC4I(23)) & LD_VEC4I(0xff)) - LD_VEC4I(126);
+  // mantissa in [0.5, 1), folded to [sqrt(0.5), sqrt(2)) around 1
+  v4f mantissa = (v4f)((bits & ~LD_VEC4I(0x7f800000)) | LD_VEC4I(0x3f000000));
+  v4i is_small = (mantissa < LD_VEC4F(0.707106781186547524f));
+  exponent += is_small;
+  v4f m = mantissa - LD_VEC4F(1.0f) + (v4f)((v4i)mantissa & is_small);
+  // exact int to float conversion for small exponents: 1.5*2^23 + e
+  v4f e = (v4f)(exponent + LD_VEC4I(0x4b400000)) - LD_VEC4F(12582912.0f);
+
+  v4f z = m * m;
+  v4f y = LD_VEC4F(7.0376836292E-2f);
+  y = y * m + LD_VEC4F(-1.1514610310E-1f);
+  y = y * m + LD_VEC4F(1.1676998740E-1f);
+  y = y * m + LD_VEC4F(-1.2420140846E-1f);
+  y = y * m + LD_VEC4F(1.4249322787E-1f);
+  y = y * m + LD_VEC4F(-1.6668057665E-1f);
+  y = y * m + LD_VEC4F(2.0000714765E-1f);
+  y = y * m + LD_VEC4F(-2.4999993993E-1f);
+  y = y * m + LD_VEC4F(3.3333331174E-1f);
+  y = y * m * z;
+  y += e * LD_VEC4F(-2.12194440E-4f);
+  y -= LD_VEC4F(0.5f) * z;
+  return m + y + e * LD_VEC4F(0.693359375f);
+}
+
+// Same as LogTDistOddN for n residuals of one hypothesis, four test flows at a time
+void PrecomputeTDistOddN::LogTDistOddN(const float *res, const float *sigma, float sigma_factor, float skew, float *log_likelihood, int n){
+  float skew_factor = (skew == 1.0f) ? 0.0f : log(2.0f*skew/(skew*skew+1.0f));
+  v4f v_vec = LD_VEC4F(v);
+  v4f_u r, l_sigma, ll;
+  v4i_u is_normal;
+
+  for (int i_start = 0; i_start < n; i_start += VEC4_SIZE) {
+    int num_lanes = min(VEC4_SIZE, n - i_start);
+    if (num_lanes == VEC4_SIZE) {
+      memcpy(r.A, res + i_start, sizeof(r));
+      memcpy(l_sigma.A, sigma + i_start, sizeof(l_sigma));
+      l_sigma.V *= LD_VEC4F(sigma_factor);
+    }
+    else {
+      // pad the last block with harmless values
+      for (int k = 0; k < VEC4_SIZE; k++) {
+        r.A[k] = (k < num_lanes) ? res[i_start+k] : 0.0f;
+        l_sigma.A[k] = (k < num_lanes) ? sigma[i_start+k] * sigma_factor : 1.0f;
+      }
+    }
+    if (skew != 1.0f) {
+      v4i is_positive = (r.V > LD_VEC4F(0.0f));
+      l_sigma.V = (v4f)(((v4i)(l_sigma.V * LD_VEC4F(skew)) & is_positive) | ((v4i)(l_sigma.V / LD_VEC4F(skew)) & ~is_positive));
+    }
+    v4f x = r.V / l_sigma.V;
+    v4f t = v_vec + x * x;
+
+    // zero, negative, denormal, infinite or nan values take the scalar route;
+    // the signed compares also reject nans with the sign bit set, such as 0/0
+    is_normal.V = ((v4i)t >= LD_VEC4I(0x00800000)) & ((v4i)t < LD_VEC4I(0x7f800000))
+                & ((v4i)l_sigma.V >= LD_VEC4I(0x00800000)) & ((v4i)l_sigma.V < LD_VEC4I(0x7f800000));
+    if (not (is_normal.A[0] and is_normal.A[1] and is_normal.A[2] and is_normal.A[3])) {
+      for (int k = 0; k < num_lanes; k++)
+        log_likelihood[i_start+k] = LogTDistOddN(res[i_start+k], sigma[i_start+k] * sigma_factor, skew);
+      continue;
+    }
+
+    ll.V = LD_VEC4F(log_factor) + LD_VEC4F((float) half_n) * (LD_VEC4F(log_v) - LogVec4f(t));
+    ll.V -= LogVec4f(l_sigma.V);
+    ll.V += LD_VEC4F(skew_factor);
+    if (num_lanes == VEC4_SIZE)
+      memcpy(log_likelihood + i_start, ll.A, sizeof(ll));
+    else
+      for (int k = 0; k < num_lanes; k++)
+        log_likelihood[i_start+k] = ll.A[k];
+  }
+}
+
 HiddenBasis::HiddenBasis(){
   delta_correlation = 0.0f ;
 }
@@ -153,7 +233,7 @@ void CrossHypotheses::FillInPrediction(PersistingThreadObjects &thread_objects,
   read_counter = my_read.read_count;
   read_counter_f = (float) read_counter;
   if (read_counter > 1){
-    measurement_sd_all_flows = my_read.measurements_sd;
+    my_read.GetMeasurementsSd(measurement_sd_all_flows);
   }
   for (unsigned int i_hyp = 1; i_hyp < same_as_null_hypothesis.size(); ++i_hyp){
     at_least_one_same_as_null += same_as_null_hypothesis[i_hyp];
@@ -441,17 +521,11 @@ void CrossHypotheses::ResetRelevantResiduals() {
 }
 
 void CrossHypotheses::ComputeBasicLogLikelihoods() {
-	// Non consensus case
-	if (read_counter == 1){
-		for (unsigned int i_hyp=0; i_hyp < basic_log_likelihoods.size(); i_hyp++) {
-			for (unsigned int t_flow=0; t_flow<test_flow.size(); t_flow++) {
-				float my_sigma = adjust_sigma? sigma_estimate[i_hyp][t_flow] * sigma_factor : sigma_estimate[i_hyp][t_flow];
-				basic_log_likelihoods[i_hyp][t_flow] = my_t.LogTDistOddN(residuals[i_hyp][t_flow], my_sigma, skew_estimate);  // pure observational likelihood depends on residual + current estimated sigma under each hypothesis
-			}
-		}
-	}
-	else{
-		for (unsigned int i_hyp=0; i_hyp < basic_log_likelihoods.size(); i_hyp++) {
+	float my_sigma_factor = adjust_sigma? sigma_factor : 1.0f;
+	for (unsigned int i_hyp=0; i_hyp < basic_log_likelihoods.size(); i_hyp++) {
+		const float *my_residuals = residuals[i_hyp].data();
+		// Consensus case
+		if (read_counter > 1){
 			for (unsigned int t_flow=0; t_flow<test_flow.size(); t_flow++) {
 				// Super simple adjustment to capture the effect of the variation of the measurement for consensus reads just for now.
 				//@TODO: Improve the adjustment or estimation for likelihood calculation.
@@ -459,10 +533,12 @@ void CrossHypotheses::ComputeBasicLogLikelihoods() {
 				if (measurement_var[t_flow] != 0.0f){
 					adj_res = (adj_res > 0.0f) ? sqrt(adj_res * adj_res + measurement_var[t_flow]) : -sqrt(adj_res * adj_res + measurement_var[t_flow]);
 				}
-				float my_sigma = adjust_sigma? sigma_estimate[i_hyp][t_flow] * sigma_factor : sigma_estimate[i_hyp][t_flow];
-				basic_log_likelihoods[i_hyp][t_flow] = my_t.LogTDistOddN(adj_res, my_sigma, skew_estimate);  // pure observational likelihood depends on residual + current estimated sigma under each hypothesis
+				basic_log_likelihoods[i_hyp][t_flow] = adj_res;
 			}
+			my_residuals = basic_log_likelihoods[i_hyp].data();
 		}
+		// pure observational likelihood depends on residual + current estimated sigma under each hypothesis
+		my_t.LogTDistOddN(my_residuals, sigma_estimate[i_hyp].data(), my_sigma_factor, skew_estimate, basic_log_likelihoods[i_hyp].data(), (int) test_flow.size());
 	}
 }
 
@@ -36,6 +36,7 @@ class PrecomputeTDistOddN{
     void SetV(int _half_n);
     float TDistOddN(float res, float sigma, float skew);
     float LogTDistOddN(float res, float sigma, float skew);
+    void  LogTDistOddN(const float *res, const float *sigma, float sigma_factor, float skew, float *log_likelihood, int n);
 
 };
 
@@ -0,0 +1,181 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     TDistSpeed.cpp
+//! @ingroup  VariantCaller
+//! @brief    TDistSpeed. Throughput of the vector LogTDistOddN against the scalar one
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "CrossHypotheses.h"
+#include "Utils.h"
+
+using namespace std;
+
+void PrintUsage()
+{
+  printf ("Usage: TDistSpeed [num_rows=200000] [row_length=10]\n");
+  printf ("  Evaluates rows of residuals and sigmas, as ComputeBasicLogLikelihoods does for each\n");
+  printf ("  hypothesis, with the scalar LogTDistOddN one value at a time and with the vector\n");
+  printf ("  overload, and reports values/sec for both. The vector results must be within 1e-5\n");
+  printf ("  relative of the scalar ones. Rows holding nan, infinite, zero, negative or denormal\n");
+  printf ("  values must match the scalar results exactly, nans included.\n");
+}
+
+// ----------------------------------------------------------------------------
+
+struct TDistRow {
+  vector<float> res;
+  vector<float> sigma;
+  float         sigma_factor;
+  float         skew;
+};
+
+void SimulateRows(int num_rows, int row_length, vector<TDistRow>& rows)
+{
+  srand48(1);
+  rows.resize(num_rows);
+  for (int r = 0; r < num_rows; ++r) {
+    rows[r].res.resize(row_length);
+    rows[r].sigma.resize(row_length);
+    for (int i = 0; i < row_length; ++i) {
+      rows[r].res[i]   = (drand48() - 0.5) * (r % 3 == 0 ? 4.0 : 0.5);
+      rows[r].sigma[i] = 0.05 + 0.3 * drand48();
+    }
+    rows[r].sigma_factor = (r % 5 == 0) ? 1.0f : 0.8f + 0.4f * drand48();
+    rows[r].skew = (r % 2 == 0) ? 1.0f : 0.7f + 0.6f * drand48();
+  }
+}
+
+// Rows with one value the vector path can't take, in every lane position and row tail
+void SpecialRows(vector<TDistRow>& rows)
+{
+  volatile float zero = 0.0f;
+  float default_nan = zero / zero;   // sign bit set on x86
+  float special[] = { default_nan, -default_nan, numeric_limits<float>::infinity(),
+                      -numeric_limits<float>::infinity(), 0.0f, -0.0f, -0.1f,
+                      numeric_limits<float>::denorm_min(), 1e-39f, numeric_limits<float>::max() };
+  int num_special = sizeof(special) / sizeof(special[0]);
+
+  for (int s = 0; s < num_special; ++s) {
+    for (int row_length = 1; row_length <= 9; ++row_length) {
+      for (int pos = 0; pos < row_length; ++pos) {
+        for (int in_sigma = 0; in_sigma < 2; ++in_sigma) {
+          for (int skewed = 0; skewed < 2; ++skewed) {
+            TDistRow row;
+            row.res.assign(row_length, 0.2f);
+            row.sigma.assign(row_length, 0.1f);
+            for (int i = 0; i < row_length; i += 2)
+              row.res[i] = -0.3f;
+            if (in_sigma)
+              row.sigma[pos] = special[s];
+            else
+              row.res[pos] = special[s];
+            row.sigma_factor = 1.0f;
+            row.skew = skewed ? 1.2f : 1.0f;
+            rows.push_back(row);
+          }
+        }
+      }
+    }
+  }
+}
+
+bool SameValue(float a, float b)
+{
+  if (isnan(a) or isnan(b))
+    return isnan(a) and isnan(b);
+  return a == b;
+}
+
+bool CloseValue(float a, float b)
+{
+  if (isnan(a) or isnan(b) or isinf(a) or isinf(b))
+    return SameValue(a, b);
+  return fabs(a - b) <= 1e-5 * max(1.0f, fabs(b));
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  int num_rows = argc > 1 ? atoi(argv[1]) : 200000;
+  int row_length = argc > 2 ? atoi(argv[2]) : 10;
+  if (num_rows <= 0 or row_length <= 0 or argc > 3) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  PrecomputeTDistOddN t_dist;
+  t_dist.SetV(3);
+
+  vector<TDistRow> rows;
+  SimulateRows(num_rows, row_length, rows);
+  vector<float> scalar_ll(row_length), vector_ll(row_length);
+
+  // One value at a time, as before
+  float checksum = 0.0f;
+  Timer timer;
+  for (int r = 0; r < num_rows; ++r) {
+    const TDistRow& row = rows[r];
+    for (int i = 0; i < row_length; ++i)
+      scalar_ll[i] = t_dist.LogTDistOddN(row.res[i], row.sigma[i] * row.sigma_factor, row.skew);
+    checksum += scalar_ll[0];
+  }
+  double scalar_time = timer.elapsed();
+
+  // Four values at a time
+  timer.restart();
+  for (int r = 0; r < num_rows; ++r) {
+    const TDistRow& row = rows[r];
+    t_dist.LogTDistOddN(&row.res[0], &row.sigma[0], row.sigma_factor, row.skew, &vector_ll[0], row_length);
+    checksum += vector_ll[0];
+  }
+  double vector_time = timer.elapsed();
+
+  int num_values = 0, num_mismatches = 0;
+  float max_relative_diff = 0.0f;
+  for (int r = 0; r < num_rows; ++r) {
+    const TDistRow& row = rows[r];
+    t_dist.LogTDistOddN(&row.res[0], &row.sigma[0], row.sigma_factor, row.skew, &vector_ll[0], row_length);
+    for (int i = 0; i < row_length; ++i) {
+      float scalar = t_dist.LogTDistOddN(row.res[i], row.sigma[i] * row.sigma_factor, row.skew);
+      max_relative_diff = max(max_relative_diff, fabs(vector_ll[i] - scalar) / max(1.0f, fabs(scalar)));
+      if (not CloseValue(vector_ll[i], scalar))
+        num_mismatches++;
+      num_values++;
+    }
+  }
+
+  vector<TDistRow> special_rows;
+  SpecialRows(special_rows);
+  int num_special_mismatches = 0;
+  for (unsigned int r = 0; r < special_rows.size(); ++r) {
+    const TDistRow& row = special_rows[r];
+    int n = row.res.size();
+    vector_ll.assign(n, 0.0f);
+    t_dist.LogTDistOddN(&row.res[0], &row.sigma[0], row.sigma_factor, row.skew, &vector_ll[0], n);
+    for (int i = 0; i < n; ++i) {
+      if (not SameValue(vector_ll[i], t_dist.LogTDistOddN(row.res[i], row.sigma[i] * row.sigma_factor, row.skew))) {
+        if (num_special_mismatches < 5)
+          printf ("  special row %u value %d: res %g sigma %g skew %g gives %g, scalar %g\n", r, i, row.res[i], row.sigma[i],
+                  row.skew, vector_ll[i], t_dist.LogTDistOddN(row.res[i], row.sigma[i] * row.sigma_factor, row.skew));
+        num_special_mismatches++;
+      }
+    }
+  }
+
+  printf ("TDistSpeed: %d rows of %d values, checksum %g\n", num_rows, row_length, checksum);
+  printf ("  %-10s %14s %10s\n", "kernel", "values/sec", "speedup");
+  printf ("  %-10s %14.1f %10.2f\n", "scalar", num_values / max(scalar_time, 1e-9), 1.0);
+  printf ("  %-10s %14.1f %10.2f\n", "vector", num_values / max(vector_time, 1e-9), scalar_time / max(vector_time, 1e-9));
+  printf ("  max relative difference %g, mismatches %d\n", max_relative_diff, num_mismatches);
+  printf ("  special value rows %d, mismatches %d\n", (int)special_rows.size(), num_special_mismatches);
+
+  return (num_mismatches == 0 and num_special_mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
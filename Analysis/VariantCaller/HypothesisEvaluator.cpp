@@ -31,7 +31,9 @@ void CalculateHypPredictions(
     int prefix_flow = 0;
 
     BasecallerRead master_read;
-    master_read.SetData(my_read.measurements, flow_order.num_flows());
+    vector<float> measurements;
+    my_read.GetMeasurements(measurements, flow_order.num_flows());
+    master_read.SetData(measurements, flow_order.num_flows());
     InitializeBasecallers(thread_objects, my_read, global_context);
 
     // --- Step 2: Processing read prefix or solve beginning of the read if desired
@@ -75,6 +77,7 @@ void CalculateHypPredictions(
             unsigned int i_base = 0;
             unsigned int max_bases = 2*(unsigned int)flow_order.num_flows()-prefix_size; // Our maximum allocated memory for the sequence vector
             int i_flow = prefix_flow;
+            bool is_simulated_only = false;
 
             // Add bases to read object sequence
             // We add one more base beyond 'flow_upper_bound' (if available) to signal Treephaser to not even start the solver
@@ -83,6 +86,7 @@ void CalculateHypPredictions(
               hypothesesReads[i_hyp].sequence.push_back(Hypotheses[i_hyp][i_base]);
               if (i_flow >= flow_upper_bound) {
             	i_flow = flow_upper_bound;
+            	is_simulated_only = true;
                 break;
               }
               i_base++;
@@ -98,11 +102,25 @@ void CalculateHypPredictions(
             min_last_flow = min(min_last_flow, i_flow);
             // Solver simulates beginning of the read and then fills in the remaining clipped bases
             // Above checks on flow_upper_bound and i_flow guarantee that i_flow <= flow_upper_bound <= num_flows
-            thread_objects.SolveRead(my_read.flow_order_index, hypothesesReads[i_hyp], min(i_flow,flow_upper_bound), flow_upper_bound);
+            // The solver does not touch the measurements of a read that reaches flow_upper_bound,
+            // so reads of the same region and position share the simulated predictions.
+            vector<float> *cached_prediction = NULL;
+            if (is_simulated_only)
+              cached_prediction = &thread_objects.CachedPrediction(my_read.flow_order_index, hypothesesReads[i_hyp].sequence, flow_upper_bound);
+
+            if (cached_prediction != NULL and not cached_prediction->empty()) {
+              predictions[i_hyp] = *cached_prediction;
+            }
+            else {
+              thread_objects.SolveRead(my_read.flow_order_index, hypothesesReads[i_hyp], min(i_flow,flow_upper_bound), flow_upper_bound);
+              // Store predictions
+              predictions[i_hyp].swap(hypothesesReads[i_hyp].prediction);
+              predictions[i_hyp].resize(flow_order.num_flows(), 0);
+              if (cached_prediction != NULL)
+                *cached_prediction = predictions[i_hyp];
+            }
 
-            // Store predictions and adaptively normalized measurements
-            predictions[i_hyp].swap(hypothesesReads[i_hyp].prediction);
-            predictions[i_hyp].resize(flow_order.num_flows(), 0);
+            // Store adaptively normalized measurements
             if(i_hyp == 0){
             	normalizedMeasurements.swap(hypothesesReads[i_hyp].normalized_measurements);
             	normalizedMeasurements.resize(flow_order.num_flows(), 0);
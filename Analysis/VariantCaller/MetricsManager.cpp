@@ -41,10 +41,10 @@ void MetricsAccumulator::CollectMetrics(list<PositionInProgress>::iterator& posi
         continue;
 
       int read_pos = pos - rai->alignment.Position;
-      if (rai->refmap_code[read_pos] != 'X' and rai->refmap_code[read_pos] != 'M')    // match or substitution
+      if (rai->refmap.code[read_pos] != 'X' and rai->refmap.code[read_pos] != 'M')    // match or substitution
         continue;
 
-      char read_base = *(rai->refmap_start[read_pos]);
+      char read_base = *(rai->refmap.start[read_pos]);
 
       if (rai->alignment.IsReverseStrand()) {
         reverse_total++;
@@ -606,10 +606,7 @@ void ConsensusAlignmentManager::PartiallyCopyAlignmentFromAnother_(Alignment& al
 	alignment.end = template_alignment.end;
 	alignment.snp_count = template_alignment.snp_count;
 	alignment.is_read_allele_unpacked = template_alignment.is_read_allele_unpacked;
-	alignment.refmap_start = template_alignment.refmap_start;
-	alignment.refmap_code = template_alignment.refmap_code;
-	alignment.refmap_has_allele = template_alignment.refmap_has_allele;
-	alignment.refmap_allele = template_alignment.refmap_allele;
+	alignment.refmap = template_alignment.refmap;
 	// By TrimAmpliseqPrimer
 	alignment.target_coverage_indices = template_alignment.target_coverage_indices;
 	alignment.best_coverage_target_idx = template_alignment.best_coverage_target_idx;
@@ -148,38 +148,33 @@ void UnpackOnLoad(Alignment *rai, const InputStructures &global_context)
 
   // Retrieve measurements from ZM tag
 
-  vector<int16_t> quantized_measurements;
-  if (not rai->alignment.GetTag("ZM", quantized_measurements)) {
+  // Kept quantized: expanded to the length of the flow order by Alignment::GetMeasurements when needed
+  if (not rai->alignment.GetTag("ZM", rai->quantized_measurements)) {
     cerr << "ERROR: Normalized measurements ZM:tag is not present in read " << rai->alignment.Name << endl;
     exit(1);
   }
-  if ((int)quantized_measurements.size() > global_context.num_flows_by_run_id.at(rai->runid)) {
-    cerr << "ERROR: Normalized measurements ZM:tag length " << quantized_measurements.size()
+  if ((int)rai->quantized_measurements.size() > global_context.num_flows_by_run_id.at(rai->runid)) {
+    cerr << "ERROR: Normalized measurements ZM:tag length " << rai->quantized_measurements.size()
          << " exceeds flow order length " << global_context.num_flows_by_run_id.at(rai->runid)
          <<" in read " << rai->alignment.Name << endl;
     exit(1);
   }
-  rai->measurements.assign(global_context.num_flows_by_run_id.at(rai->runid), 0.0);
-  for (size_t counter = 0; counter < quantized_measurements.size(); ++counter)
-    rai->measurements[counter] = (float) quantized_measurements[counter] / 256.0f;
-  rai->measurements_length = quantized_measurements.size();
+  rai->measurements_length = rai->quantized_measurements.size();
 
   // Retrieve measurements standard deviation from ZS tag
-  quantized_measurements.resize(0); // I reuse quantized_measurements for getting the ZS tag.
   // measurements_sd appears only if it is a consensus read
   if (rai->read_count > 1){
-	  if (rai->alignment.GetTag("ZS", quantized_measurements)) {
-		  if ((int) quantized_measurements.size() != rai->measurements_length){
+	  if (rai->alignment.GetTag("ZS", rai->quantized_measurements_sd)) {
+		  if ((int) rai->quantized_measurements_sd.size() != rai->measurements_length){
 		      cerr << "ERROR: Normalized measurements ZM:tag length " << rai->measurements_length
-			       << " != measurements standard deviation ZS:tag length " << quantized_measurements.size()
+			       << " != measurements standard deviation ZS:tag length " << rai->quantized_measurements_sd.size()
 			       <<" in read " << rai->alignment.Name << endl;
 			  exit(1);
 		  }
-		  rai->measurements_sd.assign(quantized_measurements.size(), 0.0f);
-		  for (size_t counter = 0; counter < quantized_measurements.size(); ++counter)
-		    rai->measurements_sd[counter] = (float) quantized_measurements[counter] / 256.0f;
 	  }
-
+	  else {
+		  rai->quantized_measurements_sd.clear();
+	  }
   }
 
 
@@ -331,26 +326,8 @@ void UnpackOnLoadLight(Alignment *rai, const InputStructures &global_context)
 	rai->flow_order_index = fo_it->second;
     const ion::FlowOrder & flow_order = global_context.flow_order_vector.at(rai->flow_order_index);
 
-    // Retrieve measurements from ZM tag
-    // No need to do it here to reduce memory usage
-    /*
-	vector<int16_t> quantized_measurements;
-	if (not rai->alignment.GetTag("ZM", quantized_measurements)) {
-	    cerr << "ERROR: Normalized measurements ZM:tag is not present in read " << rai->alignment.Name << endl;
-	    exit(1);
-	}
-	if ((int)quantized_measurements.size() > global_context.num_flows_by_run_id.at(rai->runid)) {
-	    cerr << "ERROR: Normalized measurements ZM:tag length " << quantized_measurements.size()
-	         << " exceeds flow order length " << global_context.num_flows_by_run_id.at(rai->runid)
-	         <<" in read " << rai->alignment.Name << endl;
-	    exit(1);
-	}
-
-	rai->measurements.assign(global_context.num_flows_by_run_id.at(rai->runid), 0.0);
-	for (size_t counter = 0; counter < quantized_measurements.size(); ++counter)
-	    rai->measurements[counter] = (float) quantized_measurements[counter] / 256.0f;
-	rai->measurements_length = quantized_measurements.size();
-	*/
+    // Measurements are left in the ZM tag to reduce memory usage; only check that the tag is there.
+    // Readers fall back to the tag when quantized_measurements is empty, see FlowSpaceConsensusMaster::GetMeasurements.
 	if (not rai->alignment.HasTag("ZM")) {
 	    cerr << "ERROR: Normalized measurements ZM:tag is not present in read " << rai->alignment.Name << endl;
 	    exit(1);
@@ -45,7 +45,7 @@ int merge_wells(int total_nb_cols,
             std::cerr << "offsety: " << yoffsets[f] << std::endl;
         }
         RawWells wells_in(folders[f].c_str(), wellsFileName);
-        bool stat = wells_in.OpenForRead();
+        bool stat = wells_in.OpenForRead(true);
         if (stat) {
             fprintf (stdout, "# ERROR: Could not open %s/%s\n", folders[f].c_str(), wellsFileName);
             exit (1);
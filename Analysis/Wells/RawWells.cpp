@@ -6,6 +6,10 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <algorithm>
 #include <iostream>
 #include "Utils.h"
@@ -318,6 +322,13 @@ void RawWells::Init ( const char *experimentPath, const char *rawWellsName, int
   mSaveRes = false;
   mConvertWithCopies = true;
   mIsLegacy = false;
+  mUseBlocks = false;
+  mBlocksAsHalf = false;
+  mContiguous = false;
+  mWantMemMap = false;
+  mMappedWells = NULL;
+  mMapBase = NULL;
+  mMapSize = 0;
   WELL_NOT_LOADED = -1;
   WELL_NOT_SUBSET = -2;
   mWellChunkSizeRow  = 50;
@@ -371,13 +382,57 @@ void RawWells::SetRegion ( int rowStart, int height, int colStart, int width )
   SetChunk ( rowStart, height, colStart, width, 0, NumFlows() );
 }
 
+void RawWells::SetStorageFormat ( const std::string &format )
+{
+  if ( format == "hdf5" || format == "hdf5-contiguous" )
+  {
+    mUseBlocks = false;
+    mBlocksAsHalf = false;
+    mContiguous = ( format == "hdf5-contiguous" );
+  }
+  else if ( format == "blocks" )
+  {
+    mUseBlocks = true;
+    mBlocksAsHalf = false;
+    mContiguous = false;
+  }
+  else if ( format == "blocks-half" )
+  {
+    mUseBlocks = true;
+    mBlocksAsHalf = true;
+    mContiguous = false;
+    mSaveAsUShort = true;
+  }
+  else
+  {
+    ION_ABORT ( "Unknown wells format: " + format + " (expected hdf5, hdf5-contiguous, blocks or blocks-half)" );
+  }
+}
+
 void RawWells::OpenForWrite()
 {
   //  mWriteOnClose = true;
   CreateBuffers();
+  if ( mUseBlocks )
+  {
+    WellsBlockFile::Encoding encoding = mBlocksAsHalf ? WellsBlockFile::FLOAT16
+                                      : mSaveAsUShort ? WellsBlockFile::USHORT : WellsBlockFile::FLOAT32;
+    bool ushort = ( encoding == WellsBlockFile::USHORT );
+    mIsLegacy = false;
+    mBlockFile.Create ( mFilePath, mRows, mCols, mFlows, mWellChunkSizeRow, mWellChunkSizeCol, encoding,
+                        ushort ? mLower : -5.0f, ushort ? mUpper : 28.0f );
+    return;
+  }
   if ( mHFile == RWH5DataSet::EMPTY )
   {
-    mHFile = H5Fcreate ( mFilePath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+    hid_t fapl = H5Pcreate ( H5P_FILE_ACCESS );
+    if ( mContiguous )
+    {
+      // Page align the big datasets so the wells can be mapped straight into memory
+      H5Pset_alignment ( fapl, 1024 * 1024, 4096 );
+    }
+    mHFile = H5Fcreate ( mFilePath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    H5Pclose ( fapl );
   }
   if ( mHFile < 0 )
   {
@@ -489,7 +544,12 @@ void RawWells::ReadWell ( int wellIdx, WellData *_data )
   {
     ION_ABORT ( "Well: " + ToStr ( wellIdx ) + " is not loaded." );
   }
-  if ( mIndexes[wellIdx] >= 0 )
+  if ( mIndexes[wellIdx] >= 0 && mMappedWells && mChunk.flowStart == 0 && mChunk.flowDepth == mFlows )
+  {
+    // Straight from the mapping, which is read only
+    _data->flowValues = const_cast<float *> ( FlowValues ( wellIdx ) );
+  }
+  else if ( mIndexes[wellIdx] >= 0 )
   {
     for ( size_t i = 0; i < mFlows; i++ )
     {
@@ -632,6 +692,11 @@ void RawWells::WriteToHdf5 ( const std::string &file )
 void RawWells::WriteWells()
 {
 	//printf("WriteWells %d  %d %d %d \n", mChunk.flowDepth, mChunk.flowStart, mChunk.rowStart, mChunk.colStart);
+  if ( mUseBlocks )
+  {
+    WriteWellsBlocks();
+    return;
+  }
   writeTimer.StartInterval();
   mInputBuffer.resize ( mStepSize*mStepSize*mChunk.flowDepth );
   fill ( mInputBuffer.begin(), mInputBuffer.end(), 0 );
@@ -780,10 +845,22 @@ void RawWells::OpenWellsForWrite()
   hid_t plist;
   plist = H5Pcreate ( H5P_DATASET_CREATE );
   assert ( ( cdims[0]>0 ) && ( cdims[1] >0 ) && ( cdims[2]>0 ) );
-  H5Pset_chunk ( plist, 3, cdims );
-  if ( mCompression > 0 )
+  if ( mContiguous )
   {
-    H5Pset_deflate ( plist, mCompression );
+    // One uncompressed run of [row][col][flow] values, placed when the dataset is
+    // created so its file offset is known to readers. Every well gets written, so
+    // skip filling it first.
+    H5Pset_layout ( plist, H5D_CONTIGUOUS );
+    H5Pset_alloc_time ( plist, H5D_ALLOC_TIME_EARLY );
+    H5Pset_fill_time ( plist, H5D_FILL_TIME_NEVER );
+  }
+  else
+  {
+    H5Pset_chunk ( plist, 3, cdims );
+    if ( mCompression > 0 )
+    {
+      H5Pset_deflate ( plist, mCompression );
+    }
   }
   hid_t dapl;
   dapl = H5Pcreate ( H5P_DATASET_ACCESS );
@@ -851,6 +928,10 @@ void RawWells::OpenResForWrite()
 
 void RawWells::WriteRanks()
 {
+  if ( mUseBlocks )
+  {
+    return; // ranks are all zero, block files don't store them
+  }
   mRanks.mName = RANKS;
   // Create wells data space
   hsize_t dimsf[2];
@@ -886,7 +967,18 @@ void RawWells::WriteRanks()
 void RawWells::SetSaveCopies(bool saveCopies)
 {
     mSaveCopies = saveCopies;
-    if(mSaveCopies)
+    if(mSaveCopies && mUseBlocks)
+    {
+        WellsBlockFile blocks;
+        blocks.OpenForRead(mFilePath);
+        if(blocks.HasCopies())
+        {
+            mSaveCopies = false;
+            cout << "RawWells::SetSaveCopies() WARNING: wells copies already exist, skip writing wells copies." << endl;
+            return;
+        }
+    }
+    else if(mSaveCopies)
     {
         bool closeFile = false;
         if ( mHFile == RWH5DataSet::EMPTY )
@@ -965,6 +1057,22 @@ void RawWells::WriteWellsCopies()
 
 	mSaveCopies = false;
 
+    if ( mUseBlocks )
+    {
+      // Waits for a writer thread still appending flows to the file
+      mBlockFile.OpenForAppend ( mFilePath );
+      if ( mBlockFile.HasCopies() )
+      {
+        cout << "RawWells::WriteWellsCopies() WARNING: wells copies already exist, skip writing wells copies." << endl;
+      }
+      else
+      {
+        mBlockFile.SetCopies ( mWellsCopies );
+      }
+      mBlockFile.Close();
+      return;
+    }
+
     bool closeFile = false;
     if ( mHFile == RWH5DataSet::EMPTY )
     {
@@ -1165,6 +1273,15 @@ void RawWells::WriteInfo()
     valuesBuff[i] = values[i].c_str();
   }
 
+  if ( mUseBlocks )
+  {
+    if ( !mBlockFile.IsWritable() )
+    {
+      mBlockFile.OpenForAppend ( mFilePath );
+    }
+    mBlockFile.SetInfo ( keys, values );
+    return;
+  }
   WriteStringVector ( mHFile, INFO_KEYS, &keysBuff[0], keysBuff.size() );
   WriteStringVector ( mHFile, INFO_VALUES, &valuesBuff[0], keysBuff.size() );
 }
@@ -1175,9 +1292,19 @@ bool RawWells::OpenMetaData()
   return true;
 }
 
-bool RawWells::OpenForRead ( bool memmap_dummy )
+bool RawWells::OpenForRead ( bool memMap )
 {
   //  mWriteOnClose = false;
+  if ( memMap )
+  {
+    mWantMemMap = true;
+  }
+  if ( WellsBlockFile::IsBlockFile ( mFilePath ) )
+  {
+    OpenBlocksToRead();
+    ReadWells();
+    return false;
+  }
   H5E_auto2_t old_func;
   void *old_client_data;
   /* Turn off error printing as we're not sure this is actually an hdf5 file. */
@@ -1212,6 +1339,14 @@ bool RawWells::OpenForRead ( bool memmap_dummy )
 bool RawWells::OpenForReadWrite()
 {
   //  mWriteOnClose = false;
+  if ( WellsBlockFile::IsBlockFile ( mFilePath ) )
+  {
+    // Blocks are only appended, WriteWells() opens the file for that. Nothing to read
+    // back either, the data read here would be reset by InitIndexes() below.
+    OpenBlocksToRead();
+    InitIndexes();
+    return false;
+  }
   H5E_auto2_t old_func;
   void *old_client_data;
   /* Turn off error printing as we're not sure this is actually an hdf5 file. */
@@ -1352,19 +1487,30 @@ void RawWells::OpenWellsToRead()
     mChunk.flowDepth = mFlows;
   }
 
-  // Read the chunk size from the wells file creation property list
+  // Read the chunk size from the wells file creation property list.
+  // Contiguous datasets have none, reads keep the default region size.
   hid_t create_plist = H5Dget_create_plist( mWells.mDataset );
   hsize_t cdims[3]; // We checked above that the rank is 3.
-  int rval = H5Pget_chunk ( create_plist, 3, cdims );
-  if (rval < 0) {
-    ION_WARN ( "RawWells::OpenWellsToRead: Unable to read wells file chunk size." );
-  } else {
-    mWellChunkSizeRow  = cdims[0];
-    mWellChunkSizeCol  = cdims[1];
-    mWellChunkSizeFlow = cdims[2];
+  if ( H5Pget_layout ( create_plist ) == H5D_CHUNKED ) {
+    int rval = H5Pget_chunk ( create_plist, 3, cdims );
+    if (rval < 0) {
+      ION_WARN ( "RawWells::OpenWellsToRead: Unable to read wells file chunk size." );
+    } else {
+      mWellChunkSizeRow  = cdims[0];
+      mWellChunkSizeCol  = cdims[1];
+      mWellChunkSizeFlow = cdims[2];
+    }
   }
   H5Pclose( create_plist );
 
+  // Files opened for writing are never mapped
+  UnmapWells();
+  unsigned int intent = 0;
+  if ( mWantMemMap && H5Fget_intent ( mHFile, &intent ) >= 0 && intent == H5F_ACC_RDONLY )
+  {
+    MapWells();
+  }
+
   mWellsCopies2.resize(mRows * mCols, 1.0);
   if(mSaveAsUShort && mConvertWithCopies)
   {
@@ -1431,6 +1577,57 @@ void RawWells::OpenWellsToRead()
   InitIndexes();
 }
 
+bool RawWells::MapWells()
+{
+  // Only native floats in one uncompressed run can be used in place
+  hid_t create_plist = H5Dget_create_plist ( mWells.mDataset );
+  bool contiguous = H5Pget_layout ( create_plist ) == H5D_CONTIGUOUS && H5Pget_nfilters ( create_plist ) == 0;
+  H5Pclose ( create_plist );
+  haddr_t offset = H5Dget_offset ( mWells.mDataset );
+  if ( !contiguous || mSaveAsUShort || H5Tequal ( mWells.mDatatype, H5T_NATIVE_FLOAT ) <= 0 ||
+       offset == HADDR_UNDEF || offset % sizeof ( float ) != 0 )
+  {
+    return false;
+  }
+
+  uint64_t size = ( uint64_t ) mRows * mCols * mFlows * sizeof ( float );
+  int fd = open ( mFilePath.c_str(), O_RDONLY );
+  if ( fd < 0 )
+  {
+    return false;
+  }
+  struct stat st;
+  if ( fstat ( fd, &st ) != 0 || ( uint64_t ) st.st_size < offset + size )
+  {
+    close ( fd );
+    return false;
+  }
+  uint64_t pageSize = sysconf ( _SC_PAGESIZE );
+  uint64_t mapStart = offset - offset % pageSize;
+  void *map = mmap ( NULL, offset + size - mapStart, PROT_READ, MAP_SHARED, fd, mapStart );
+  close ( fd );
+  if ( map == MAP_FAILED )
+  {
+    ION_WARN ( "Couldn't memory map: " + mFilePath + ", reading wells into memory." );
+    return false;
+  }
+  mMapBase = map;
+  mMapSize = offset + size - mapStart;
+  mMappedWells = ( const float * ) ( ( const char * ) map + ( offset - mapStart ) );
+  return true;
+}
+
+void RawWells::UnmapWells()
+{
+  if ( mMapBase != NULL )
+  {
+    munmap ( mMapBase, mMapSize );
+  }
+  mMappedWells = NULL;
+  mMapBase = NULL;
+  mMapSize = 0;
+}
+
 void RawWells::OpenResToRead()
 {
   mResErr.Close();
@@ -1570,7 +1767,11 @@ void RawWells::OpenForIncrementalRead()
   /* Turn off error printing as we're not sure this is actually an hdf5 file. */
   H5Eget_auto2 ( H5E_DEFAULT, &old_func, &old_client_data );
   H5Eset_auto2 ( H5E_DEFAULT, NULL, NULL );
-  mHFile = H5Fopen ( mFilePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT );
+  bool blocks = WellsBlockFile::IsBlockFile ( mFilePath );
+  if ( !blocks )
+  {
+    mHFile = H5Fopen ( mFilePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT );
+  }
   if ( mChunk.rowHeight <= 0 )
   {
     mChunk.rowStart = 0;
@@ -1586,7 +1787,11 @@ void RawWells::OpenForIncrementalRead()
     mChunk.flowStart = 0;
     mChunk.flowDepth = 1;
   }
-  if ( mHFile >= 0 )
+  if ( blocks )
+  {
+    OpenBlocksToRead();
+  }
+  else if ( mHFile >= 0 )
   {
     mIsLegacy = false;
     mCurrentWell = 0;
@@ -1614,6 +1819,15 @@ void RawWells::ReadWells()
   {
     return;
   }
+  if ( mUseBlocks )
+  {
+    ReadWellsBlocks();
+    return;
+  }
+  if ( mMappedWells )
+  {
+    return;
+  }
   vector<float> inputBuffer; // 100x100
   uint64_t stepSize = (uint64_t)mWellChunkSizeRow*(uint64_t)mWellChunkSizeCol;
   inputBuffer.resize ( stepSize*mChunk.flowDepth,0.0f );
@@ -1653,7 +1867,7 @@ void RawWells::ReadWells()
         hsize_t offset_out[3];  /* hyperslab offset in memory */
         offset[0] = currentRowStart;
         offset[1] = currentColStart;
-        offset[2] = 0;
+        offset[2] = mChunk.flowStart;
         count[0] = currentRowEnd - currentRowStart;
         count[1] = currentColEnd - currentColStart;
         count[2] = mChunk.flowDepth;
@@ -1739,7 +1953,7 @@ void RawWells::ReadWells()
             {
               for ( size_t flow = mChunk.flowStart; flow < mChunk.flowStart + mChunk.flowDepth; flow++ )
               {
-				float val = inputBuffer[localCount * mChunk.flowDepth + flow];
+				float val = inputBuffer[localCount * mChunk.flowDepth + flow - mChunk.flowStart];
 				if(mSaveAsUShort && mConvertWithCopies)
 				{
 					if(mWellsCopies2[ row * mCols + col] > 0)
@@ -1758,6 +1972,160 @@ void RawWells::ReadWells()
   }
 }
 
+void RawWells::OpenBlocksToRead()
+{
+  mBlockFile.OpenForRead ( mFilePath );
+  mUseBlocks = true;
+  mBlocksAsHalf = ( mBlockFile.GetEncoding() == WellsBlockFile::FLOAT16 );
+  mIsLegacy = false;
+  mCurrentWell = 0;
+  mRows = mBlockFile.NumRows();
+  mCols = mBlockFile.NumCols();
+  mFlows = mBlockFile.NumFlows();
+  // Assume whole chip if region if region isn't set
+  if ( mChunk.rowHeight <= 0 )
+  {
+    mChunk.rowStart = 0;
+    mChunk.rowHeight = mRows;
+  }
+  if ( mChunk.colWidth <= 0 )
+  {
+    mChunk.colStart = 0;
+    mChunk.colWidth = mCols;
+  }
+  if ( mChunk.flowDepth <= 0 )
+  {
+    mChunk.flowStart = 0;
+    mChunk.flowDepth = mFlows;
+  }
+  // Regions aligned to the tiles read each block once
+  mWellChunkSizeRow = mBlockFile.TileRows();
+  mWellChunkSizeCol = mBlockFile.TileCols();
+
+  mSaveAsUShort = ( mBlockFile.GetEncoding() != WellsBlockFile::FLOAT32 );
+  mLower = mBlockFile.Lower();
+  mUpper = mBlockFile.Upper();
+  mWellsCopies2.assign ( mRows * mCols, 1.0f );
+  if ( mSaveAsUShort && mConvertWithCopies && mBlockFile.HasCopies() )
+  {
+    mWellsCopies2 = mBlockFile.Copies();
+  }
+  mRankData.assign ( mRows * mCols, 0 );
+
+  mInfo.Clear();
+  const vector<string> &keys = mBlockFile.InfoKeys();
+  const vector<string> &values = mBlockFile.InfoValues();
+  for ( size_t i = 0; i < keys.size(); i++ )
+  {
+    if ( !mInfo.SetValue ( keys[i], values[i] ) )
+    {
+      ION_ABORT ( "Error: Could not set key: " + keys[i] + " with value: " + values[i] );
+    }
+  }
+  if ( !mInfo.GetValue ( FLOW_ORDER, mFlowOrder ) )
+  {
+    ION_ABORT ( "Error - Flow order is not set." );
+  }
+  InitIndexes();
+}
+
+void RawWells::WriteWellsBlocks()
+{
+  writeTimer.StartInterval();
+  if ( !mBlockFile.IsWritable() )
+  {
+    mBlockFile.OpenForAppend ( mFilePath );
+  }
+  size_t tileRows = mBlockFile.TileRows();
+  size_t tileCols = mBlockFile.TileCols();
+  size_t rowEnd = min ( mRows, mChunk.rowStart + mChunk.rowHeight );
+  size_t colEnd = min ( mCols, mChunk.colStart + mChunk.colWidth );
+  size_t flowDepth = mChunk.flowDepth;
+  for ( size_t tileRow = mChunk.rowStart - mChunk.rowStart % tileRows; tileRow < rowEnd; tileRow += tileRows )
+  {
+    size_t tileRowEnd = min ( mRows, tileRow + tileRows );
+    for ( size_t tileCol = mChunk.colStart - mChunk.colStart % tileCols; tileCol < colEnd; tileCol += tileCols )
+    {
+      size_t tileColEnd = min ( mCols, tileCol + tileCols );
+      mInputBuffer.resize ( ( tileRowEnd - tileRow ) * ( tileColEnd - tileCol ) * flowDepth );
+      float *dst = &mInputBuffer[0];
+      for ( size_t row = tileRow; row < tileRowEnd; row++ )
+      {
+        for ( size_t col = tileCol; col < tileColEnd; col++, dst += flowDepth )
+        {
+          int32_t index = mIndexes[ToIndex ( col, row )];
+          if ( index >= 0 )
+          {
+            copy ( &mFlowData[0] + ( uint64_t ) index * flowDepth, &mFlowData[0] + ( uint64_t ) ( index + 1 ) * flowDepth, dst );
+          }
+          else
+          {
+            fill ( dst, dst + flowDepth, 0.0f );
+          }
+        }
+      }
+      mBlockFile.WriteTile ( tileRow, tileCol, mChunk.flowStart, flowDepth, &mInputBuffer[0] );
+    }
+  }
+  writeTimer.EndInterval();
+}
+
+void RawWells::ReadWellsBlocks()
+{
+  vector<float> inputBuffer;
+  size_t tileRows = mBlockFile.TileRows();
+  size_t tileCols = mBlockFile.TileCols();
+  size_t rowEnd = min ( mRows, mChunk.rowStart + mChunk.rowHeight );
+  size_t colEnd = min ( mCols, mChunk.colStart + mChunk.colWidth );
+  size_t flowDepth = mChunk.flowDepth;
+  bool withCopies = mSaveAsUShort && mConvertWithCopies;
+
+  fill ( mFlowData.begin(), mFlowData.end(), -1.0f );
+  for ( size_t tileRow = mChunk.rowStart - mChunk.rowStart % tileRows; tileRow < rowEnd; tileRow += tileRows )
+  {
+    size_t tileRowEnd = min ( mRows, tileRow + tileRows );
+    size_t rowBegin = max ( tileRow, mChunk.rowStart );
+    for ( size_t tileCol = mChunk.colStart - mChunk.colStart % tileCols; tileCol < colEnd; tileCol += tileCols )
+    {
+      size_t tileColEnd = min ( mCols, tileCol + tileCols );
+      size_t colBegin = max ( tileCol, mChunk.colStart );
+      // Don't go to disk unless we actually have a well to load.
+      if ( !WellsInSubset ( rowBegin, min ( rowEnd, tileRowEnd ), colBegin, min ( colEnd, tileColEnd ) ) )
+      {
+        continue;
+      }
+      inputBuffer.resize ( ( tileRowEnd - tileRow ) * ( tileColEnd - tileCol ) * flowDepth );
+      mBlockFile.ReadTile ( tileRow, tileCol, mChunk.flowStart, flowDepth, &inputBuffer[0] );
+
+      for ( size_t row = rowBegin; row < min ( rowEnd, tileRowEnd ); row++ )
+      {
+        for ( size_t col = colBegin; col < min ( colEnd, tileColEnd ); col++ )
+        {
+          size_t idx = ToIndex ( col, row );
+          if ( mIndexes[idx] < 0 )
+          {
+            continue;
+          }
+          const float *src = &inputBuffer[ ( ( row - tileRow ) * ( tileColEnd - tileCol ) + col - tileCol ) * flowDepth];
+          float *dst = &mFlowData[ ( uint64_t ) mIndexes[idx] * flowDepth];
+          if ( withCopies )
+          {
+            float copies = mWellsCopies2[idx];
+            for ( size_t flow = 0; flow < flowDepth; flow++ )
+            {
+              dst[flow] = ( copies > 0 ) ? src[flow] * copies : -1.0f;
+            }
+          }
+          else
+          {
+            copy ( src, src + flowDepth, dst );
+          }
+        }
+      }
+    }
+  }
+}
+
 void RawWells::ReadRes()
 {
   if ( mIsLegacy )
@@ -1918,6 +2286,10 @@ float RawWells::At ( size_t well, size_t flow ) const
   }
   if ( mIndexes[well] >= 0 )
   {
+    if ( mMappedWells )
+    {
+      return mMappedWells[( uint64_t ) well * mFlows + flow];
+    }
     uint64_t ii = ( uint64_t ) mIndexes[well] * mChunk.flowDepth + flow - mChunk.flowStart;
     assert ( ii < mFlowData.size() );
     return mFlowData[ii];
@@ -1942,10 +2314,27 @@ float RawWells::AtWithoutChecking ( size_t row, size_t col, size_t flow ) const
 
 float RawWells::AtWithoutChecking ( size_t well, size_t flow ) const
 {
+  if ( mMappedWells )
+  {
+    return mMappedWells[( uint64_t ) well * mFlows + flow];
+  }
   uint64_t ii = ( uint64_t ) mIndexes[well] * mChunk.flowDepth + flow - mChunk.flowStart;
   return mFlowData[ii];
 }
 
+const float *RawWells::FlowValues ( size_t well ) const
+{
+  if ( mIndexes[well] < 0 )
+  {
+    return NULL;
+  }
+  if ( mMappedWells )
+  {
+    return mMappedWells + ( uint64_t ) well * mFlows + mChunk.flowStart;
+  }
+  return &mFlowData[0] + ( uint64_t ) mIndexes[well] * mChunk.flowDepth;
+}
+
 float RawWells::ResAtWithoutChecking ( size_t well, size_t flow ) const
 {
   uint64_t ii = ( uint64_t ) mIndexes[well] * mChunk.flowDepth + flow - mChunk.flowStart;
@@ -2055,6 +2444,8 @@ void RawWells::CleanupHdf5()
   mWells.Close();
   mInfoKeys.Close();
   mInfoValues.Close();
+  mBlockFile.Close();
+  UnmapWells();
   if ( mHFile != RWH5DataSet::EMPTY )
   {
     H5Fclose ( mHFile );
@@ -2113,6 +2504,10 @@ void RawWells::IndexToXY ( size_t index, size_t &x, size_t &y ) const
 
 void RawWells::Set ( size_t idx, size_t flow, float val )
 {
+  if ( mMappedWells )
+  {
+    ION_ABORT ( "Can't set well: " + ToStr ( idx ) + ", " + mFilePath + " is memory mapped read only." );
+  }
   if ( mIndexes[idx] >= 0 )
   {
     uint64_t ii = ( uint64_t ) mIndexes[idx] * mChunk.flowDepth + flow - mChunk.flowStart;
@@ -2210,7 +2605,8 @@ void RawWells::InitIndexes()
       }
     }
   }
-  mFlowData.resize ( count * mChunk.flowDepth );
+  // Mapped wells are read in place
+  mFlowData.resize ( mMappedWells ? 0 : count * mChunk.flowDepth );
   fill ( mFlowData.begin(), mFlowData.end(), -1.0f );
   //Chao- need to find another default value for res data
   //mResData.resize ( count * mChunk.flowDepth );
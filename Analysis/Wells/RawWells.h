@@ -10,6 +10,7 @@
 #include <iostream>
 #include "hdf5.h"
 #include "Utils.h"
+#include "WellsBlockFile.h"
 
 #include <pthread.h>
 #include <semaphore.h>
@@ -279,12 +280,36 @@ public:
   void SetCompression(int level) { mCompression = level; }
   int GetCompression() { return mCompression; }
 
+  /**
+   * Storage used by OpenForWrite(): "hdf5" (default), "blocks" for a WellsBlockFile
+   * with float or ushort values following the save as ushort flag, or "blocks-half"
+   * for a WellsBlockFile with half precision values. Like ushort, half precision
+   * stores amplitudes per copy, so GetSaveAsUShort() is true. Opening for read
+   * detects the storage of the file. Block files are written a whole tile at a time:
+   * wells of a tile that are outside the current chunk are written as zero.
+   * "hdf5-contiguous" writes the hdf5 wells dataset unchunked and uncompressed,
+   * page aligned in the file, so that float wells can be memory mapped on read.
+   */
+  void SetStorageFormat(const std::string &format);
+  bool IsBlockFormat() const { return mUseBlocks; }
+
+  /**
+   * Ask OpenForRead() and OpenForIncrementalRead() to memory map the wells instead
+   * of copying them into memory. Only float wells stored contiguously in an hdf5
+   * file (see SetStorageFormat()) can be mapped, other files are read as usual.
+   * When mapped, ReadWells() does no I/O and At() and FlowValues() read straight
+   * from the page cache, shared between every process and thread reading the file.
+   * Mapped wells are read only, Set() aborts.
+   */
+  void SetMemMap(bool memMap) { mWantMemMap = memMap; }
+  bool IsMemMapped() const { return mMappedWells != NULL; }
+
   /* Opening and closing file and subsets of file. */
   bool OpenMetaData();
   void SetSubsetToLoad(const std::vector<int32_t> &xSubset, const std::vector<int32_t> &ySubset);
   void SetSubsetToWrite(const std::vector<int32_t> &subset);
   void SetSubsetToLoad(int32_t *xSubset, int32_t *ySubset, int count);
-  bool OpenForRead(bool dummyMemMap = false);
+  bool OpenForRead(bool memMap = false);
   void OpenForWrite();
   bool OpenForReadWrite();
   void WriteLegacyWells();
@@ -318,6 +343,12 @@ public:
   float At(size_t well, size_t flow) const;
   float AtWithoutChecking(size_t row, size_t col, size_t flow) const;
   float AtWithoutChecking(size_t well, size_t flow) const;
+  /**
+   * The flowDepth values of a loaded well, starting at the first flow of the chunk.
+   * NULL for wells that are not loaded or not in the subset.
+   */
+  const float *FlowValues(size_t row, size_t col) const { return FlowValues(ToIndex(col, row)); }
+  const float *FlowValues(size_t well) const;
 
   float ResAtWithoutChecking(size_t row, size_t col, size_t flow) const;
   float ResAtWithoutChecking(size_t well, size_t flow) const;
@@ -415,6 +446,11 @@ public:
 
   void ReadWellsRegion();
   void ReadWellsSubset();
+  bool MapWells();
+  void UnmapWells();
+  void OpenBlocksToRead();
+  void WriteWellsBlocks();
+  void ReadWellsBlocks();
   void ReadRanks();
   void ReadInfo();
 
@@ -466,6 +502,14 @@ private:
   RWH5DataSet mResErr;       ///< residual hdf5 dataset
   RWH5DataSet mInfoKeys;    ///< Dataset for keys matching mInfoValues order
   RWH5DataSet mInfoValues;  ///< Dataset for values matching mInfoKeys order
+  WellsBlockFile mBlockFile; ///< Block storage, used instead of the datasets when mUseBlocks
+  bool mUseBlocks;
+  bool mBlocksAsHalf;
+  bool mContiguous;   ///< Write the hdf5 wells dataset contiguous rather than chunked
+  bool mWantMemMap;
+  const float *mMappedWells; ///< Wells dataset in the mapping, NULL unless memory mapped
+  void *mMapBase;
+  size_t mMapSize;
   size_t mWellChunkSizeRow;
   size_t mWellChunkSizeCol;
   size_t mWellChunkSizeFlow;
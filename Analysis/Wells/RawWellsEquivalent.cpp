@@ -89,9 +89,9 @@ NumericalComparison<double> CompareWells(
   struct WellData queryData;
   queryData.flowValues = NULL;
   cout << "Opening query." << endl;
-  queryW.OpenForRead();
+  queryW.OpenForRead(true);
   cout << "Opening gold." << endl;
-  goldW.OpenForRead();
+  goldW.OpenForRead(true);
 
   // check if any 1.wells is saved as unsigned short
   bool ushortg = goldW.GetSaveAsUShort();
@@ -0,0 +1,661 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include "WellsBlockFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <emmintrin.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define WELLS_BLOCK_F16C
+#endif
+
+#include "IonErr.h"
+#include "Utils.h"
+
+using namespace std;
+
+#define WELLS_BLOCK_MAGIC "IONWBLK1"
+#define WELLS_BLOCK_VERSION 1
+
+/** On disk header, at offset zero. */
+struct WellsBlockHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t encoding;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t flows;
+  uint32_t tileRows;
+  uint32_t tileCols;
+  float    lower;
+  float    upper;
+  uint64_t trailerOffset;    ///< Zero while a writer has the file open.
+  uint64_t trailerSize;
+  uint32_t trailerChecksum;
+  uint32_t reserved;
+};
+
+// ----------------------------------------------------------------------------
+// File access
+
+static void WriteAll(int fd, const void *data, size_t size, uint64_t offset, const string &path)
+{
+  const char *p = (const char *)data;
+  while (size > 0) {
+    ssize_t n = pwrite(fd, p, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      ION_ABORT("Couldn't write wells file: " + path + " " + strerror(errno));
+    p += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+static void ReadAll(int fd, void *data, size_t size, uint64_t offset, const string &path)
+{
+  char *p = (char *)data;
+  while (size > 0) {
+    ssize_t n = pread(fd, p, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      ION_ABORT("Couldn't read wells file: " + path + " (truncated?)");
+    p += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+// Trailer serialization
+static void PutU64(vector<char> &out, uint64_t v)
+{
+  out.insert(out.end(), (const char *)&v, (const char *)&v + sizeof(v));
+}
+
+static void PutString(vector<char> &out, const string &s)
+{
+  PutU64(out, s.size());
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+class TrailerReader {
+public:
+  TrailerReader(const char *data, size_t size, const string &path) : mData(data), mSize(size), mPos(0), mPath(path) {}
+  void Get(void *out, size_t size) {
+    if (size > mSize - mPos)
+      ION_ABORT("Corrupt trailer in wells file: " + mPath);
+    memcpy(out, mData + mPos, size);
+    mPos += size;
+  }
+  uint64_t GetU64() { uint64_t v; Get(&v, sizeof(v)); return v; }
+  string GetString() {
+    uint64_t size = GetU64();
+    if (size > mSize - mPos)
+      ION_ABORT("Corrupt trailer in wells file: " + mPath);
+    string s(mData + mPos, size);
+    mPos += size;
+    return s;
+  }
+private:
+  const char *mData;
+  size_t mSize;
+  size_t mPos;
+  const string &mPath;
+};
+
+// ----------------------------------------------------------------------------
+// Encodings. The ushort mapping is bit for bit WellsConverter, with NaN stored as 0.
+
+static void EncodeUShort(float lower, float upper, const float *in, size_t count, uint16_t *out)
+{
+  float factor = 65535.0f / (upper - lower);
+  const __m128 vLower = _mm_set1_ps(lower);
+  const __m128 vUpper = _mm_set1_ps(upper);
+  const __m128 vFactor = _mm_set1_ps(factor);
+  const __m128i vMax = _mm_set1_epi32(65535);
+  const __m128i vBias32 = _mm_set1_epi32(32768);
+  const __m128i vBias16 = _mm_set1_epi16((short)0x8000);
+  float tail[8];
+  uint16_t tailOut[8];
+  for (size_t i = 0; i < count; i += 8) {
+    const float *src = in + i;
+    if (i + 8 > count) {
+      fill(tail, tail + 8, 0.0f);
+      copy(in + i, in + count, tail);
+      src = tail;
+    }
+    __m128i packed[2];
+    for (int h = 0; h < 2; h++) {
+      __m128 v = _mm_loadu_ps(src + 4 * h);
+      __m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(v, vLower), vFactor));
+      __m128i low = _mm_castps_si128(_mm_cmpngt_ps(v, vLower));   // v <= lower, or NaN
+      __m128i high = _mm_castps_si128(_mm_cmpge_ps(v, vUpper));
+      q = _mm_andnot_si128(low, q);
+      q = _mm_or_si128(_mm_andnot_si128(high, q), _mm_and_si128(high, vMax));
+      packed[h] = _mm_sub_epi32(q, vBias32);  // signed saturation in the pack below is then exact
+    }
+    __m128i words = _mm_xor_si128(_mm_packs_epi32(packed[0], packed[1]), vBias16);
+    if (i + 8 > count) {
+      _mm_storeu_si128((__m128i *)tailOut, words);
+      copy(tailOut, tailOut + (count - i), out + i);
+    }
+    else
+      _mm_storeu_si128((__m128i *)(out + i), words);
+  }
+}
+
+static void DecodeUShort(float lower, float upper, const uint16_t *in, size_t count, float *out)
+{
+  float factor = 65535.0f / (upper - lower);
+  const __m128 vLower = _mm_set1_ps(lower);
+  const __m128 vFactor = _mm_set1_ps(factor);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i words = _mm_loadu_si128((const __m128i *)(in + i));
+    __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+    __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_div_ps(lo, vFactor), vLower));
+    _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_div_ps(hi, vFactor), vLower));
+  }
+  for (; i < count; i++)
+    out[i] = (float)in[i] / factor + lower;
+}
+
+// Portable half precision conversions, matching the F16C instructions bit for bit
+static inline uint16_t FloatToHalf(float f)
+{
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t absx = x & 0x7fffffff;
+  if (absx >= 0x7f800000)    // inf and NaN, NaN payload truncated and made quiet
+    return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 | ((absx >> 13) & 0x3ff) : 0);
+  if (absx >= 0x477ff000)    // rounds past the largest half
+    return sign | 0x7c00;
+  if (absx >= 0x38800000) {  // normal half
+    uint32_t h = (absx - 0x38000000) >> 13;
+    uint32_t rem = absx & 0x1fff;
+    h += (rem > 0x1000 || (rem == 0x1000 && (h & 1)));
+    return sign | h;
+  }
+  if (absx < 0x33000000)     // rounds to zero
+    return sign;
+  // subnormal half
+  uint32_t mant = (absx & 0x7fffff) | 0x800000;
+  int shift = 126 - (int)(absx >> 23);
+  uint32_t h = mant >> shift;
+  uint32_t rem = mant & ((1u << shift) - 1);
+  uint32_t half = 1u << (shift - 1);
+  h += (rem > half || (rem == half && (h & 1)));
+  return sign | h;
+}
+
+static inline float HalfToFloat(uint16_t h)
+{
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t x;
+  if (exp == 0x1f)
+    x = sign | 0x7f800000 | (mant ? 0x400000 | (mant << 13) : 0);
+  else if (exp != 0)
+    x = sign | ((exp + 112) << 23) | (mant << 13);
+  else if (mant == 0)
+    x = sign;
+  else {
+    exp = 113;
+    while (!(mant & 0x400)) {
+      mant <<= 1;
+      exp--;
+    }
+    x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+#ifdef WELLS_BLOCK_F16C
+#pragma GCC push_options
+#pragma GCC target("f16c")
+
+static void EncodeHalfF16C(const float *in, size_t count, uint16_t *out)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm_storeu_si128((__m128i *)(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+  for (; i < count; i++)
+    out[i] = FloatToHalf(in[i]);
+}
+
+static void DecodeHalfF16C(const uint16_t *in, size_t count, float *out)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(in + i))));
+  for (; i < count; i++)
+    out[i] = HalfToFloat(in[i]);
+}
+
+#pragma GCC pop_options
+#endif
+
+bool WellsBlockFile::HalfConversionInHardware()
+{
+#ifdef WELLS_BLOCK_F16C
+  // CPU features do not change while we run; check them once
+  static const bool f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return f16c;
+#else
+  return false;
+#endif
+}
+
+size_t WellsBlockFile::EncodedSize(Encoding encoding, size_t count)
+{
+  size_t bytes = count * (encoding == FLOAT32 ? sizeof(float) : sizeof(uint16_t));
+  return (bytes + 7) & ~(size_t)7;
+}
+
+void WellsBlockFile::Encode(Encoding encoding, float lower, float upper, const float *in, size_t count, void *out)
+{
+  size_t bytes = count * (encoding == FLOAT32 ? sizeof(float) : sizeof(uint16_t));
+  memset((char *)out + bytes, 0, EncodedSize(encoding, count) - bytes);
+  switch (encoding) {
+    case FLOAT32:
+      memcpy(out, in, bytes);
+      break;
+    case USHORT:
+      EncodeUShort(lower, upper, in, count, (uint16_t *)out);
+      break;
+    case FLOAT16:
+#ifdef WELLS_BLOCK_F16C
+      if (HalfConversionInHardware()) {
+        EncodeHalfF16C(in, count, (uint16_t *)out);
+        break;
+      }
+#endif
+      for (size_t i = 0; i < count; i++)
+        ((uint16_t *)out)[i] = FloatToHalf(in[i]);
+      break;
+    default:
+      ION_ABORT("Unknown wells block encoding: " + ToStr((int)encoding));
+  }
+}
+
+void WellsBlockFile::Decode(Encoding encoding, float lower, float upper, const void *in, size_t count, float *out)
+{
+  switch (encoding) {
+    case FLOAT32:
+      memcpy(out, in, count * sizeof(float));
+      break;
+    case USHORT:
+      DecodeUShort(lower, upper, (const uint16_t *)in, count, out);
+      break;
+    case FLOAT16:
+#ifdef WELLS_BLOCK_F16C
+      if (HalfConversionInHardware()) {
+        DecodeHalfF16C((const uint16_t *)in, count, out);
+        break;
+      }
+#endif
+      for (size_t i = 0; i < count; i++)
+        out[i] = HalfToFloat(((const uint16_t *)in)[i]);
+      break;
+    default:
+      ION_ABORT("Unknown wells block encoding: " + ToStr((int)encoding));
+  }
+}
+
+uint32_t WellsBlockFile::Checksum(const void *data, size_t size)
+{
+  // Fletcher-64 over 32 bit words, folded to 32 bits. Sizes are multiples of 4.
+  // The sums are reduced often enough that they can't overflow.
+  const uint32_t *words = (const uint32_t *)data;
+  size_t numWords = size / 4;
+  uint64_t a = 0, b = 0;
+  while (numWords > 0) {
+    size_t n = min(numWords, (size_t)65536);
+    for (size_t i = 0; i < n; i++) {
+      a += words[i];
+      b += a;
+    }
+    a %= 0xffffffffull;
+    b %= 0xffffffffull;
+    words += n;
+    numWords -= n;
+  }
+  return (uint32_t)(a ^ (b << 16) ^ (b >> 16) ^ size);
+}
+
+// ----------------------------------------------------------------------------
+
+WellsBlockFile::WellsBlockFile()
+{
+  mFd = -1;
+  mWritable = false;
+  mEnd = 0;
+  mRows = mCols = mFlows = 0;
+  mTileRows = mTileCols = mNumTileCols = 0;
+  mEncoding = FLOAT32;
+  mLower = -5.0f;
+  mUpper = 28.0f;
+}
+
+WellsBlockFile::~WellsBlockFile()
+{
+  Close();
+}
+
+bool WellsBlockFile::IsBlockFile(const std::string &path)
+{
+  char magic[8];
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  bool match = (read(fd, magic, sizeof(magic)) == (ssize_t)sizeof(magic))
+               && memcmp(magic, WELLS_BLOCK_MAGIC, sizeof(magic)) == 0;
+  close(fd);
+  return match;
+}
+
+void WellsBlockFile::Create(const std::string &path, size_t rows, size_t cols, size_t flows,
+                            size_t tileRows, size_t tileCols, Encoding encoding, float lower, float upper)
+{
+  Close();
+  if (rows == 0 || cols == 0 || flows == 0 || tileRows == 0 || tileCols == 0)
+    ION_ABORT("Illegal wells dimensions for: " + path);
+  if (encoding == USHORT && !(upper > lower))
+    ION_ABORT("Illegal wells conversion range for: " + path);
+
+  mPath = path;
+  mFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (mFd < 0)
+    ION_ABORT("Couldn't create file: " + path);
+  if (flock(mFd, LOCK_EX) != 0)
+    ION_ABORT("Couldn't lock file: " + path);
+
+  mRows = rows;
+  mCols = cols;
+  mFlows = flows;
+  mTileRows = min(tileRows, rows);
+  mTileCols = min(tileCols, cols);
+  mNumTileCols = (mCols + mTileCols - 1) / mTileCols;
+  mEncoding = encoding;
+  mLower = lower;
+  mUpper = upper;
+  mBlocks.clear();
+  mTileBlocks.assign(((mRows + mTileRows - 1) / mTileRows) * mNumTileCols, vector<uint32_t>());
+  mInfoKeys.clear();
+  mInfoValues.clear();
+  mCopies.clear();
+
+  mWritable = true;
+  mEnd = sizeof(WellsBlockHeader);
+  WriteHeader(0, 0, 0);
+}
+
+void WellsBlockFile::OpenForRead(const std::string &path)
+{
+  Open(path, false);
+}
+
+void WellsBlockFile::OpenForAppend(const std::string &path)
+{
+  Open(path, true);
+}
+
+void WellsBlockFile::Open(const std::string &path, bool forAppend)
+{
+  Close();
+  mPath = path;
+  mFd = open(path.c_str(), forAppend ? O_RDWR : O_RDONLY);
+  if (mFd < 0)
+    ION_ABORT("Couldn't open: " + path + (forAppend ? " to write." : " to read."));
+  // Readers take a shared lock while loading the index, so they wait for a writer to finish
+  if (flock(mFd, forAppend ? LOCK_EX : LOCK_SH) != 0)
+    ION_ABORT("Couldn't lock file: " + path);
+
+  WellsBlockHeader header;
+  ReadAll(mFd, &header, sizeof(header), 0, path);
+  if (memcmp(header.magic, WELLS_BLOCK_MAGIC, sizeof(header.magic)) != 0)
+    ION_ABORT("Not a block wells file: " + path);
+  if (header.version != WELLS_BLOCK_VERSION)
+    ION_ABORT("Unsupported block wells file version " + ToStr(header.version) + " in: " + path);
+  if (header.trailerOffset == 0)
+    ION_ABORT("Incomplete wells file, the writer did not close it: " + path);
+  if (header.encoding > FLOAT16 || header.rows == 0 || header.cols == 0 || header.flows == 0
+      || header.tileRows == 0 || header.tileCols == 0)
+    ION_ABORT("Corrupt header in wells file: " + path);
+
+  mRows = header.rows;
+  mCols = header.cols;
+  mFlows = header.flows;
+  mTileRows = header.tileRows;
+  mTileCols = header.tileCols;
+  mNumTileCols = (mCols + mTileCols - 1) / mTileCols;
+  mEncoding = (Encoding)header.encoding;
+  mLower = header.lower;
+  mUpper = header.upper;
+  mTileBlocks.assign(((mRows + mTileRows - 1) / mTileRows) * mNumTileCols, vector<uint32_t>());
+  ReadTrailer(header.trailerOffset, header.trailerSize, header.trailerChecksum);
+
+  if (forAppend) {
+    // New blocks overwrite the old trailer; the header says incomplete until Close()
+    mEnd = header.trailerOffset;
+    if (ftruncate(mFd, mEnd) != 0)
+      ION_ABORT("Couldn't truncate file: " + path);
+    mWritable = true;
+    WriteHeader(0, 0, 0);
+  }
+  else
+    flock(mFd, LOCK_UN);
+}
+
+void WellsBlockFile::Close()
+{
+  if (mFd < 0)
+    return;
+  if (mWritable)
+    WriteTrailer();
+  close(mFd);   // releases the lock
+  mFd = -1;
+  mWritable = false;
+}
+
+void WellsBlockFile::WriteHeader(uint64_t trailerOffset, uint64_t trailerSize, uint32_t trailerChecksum)
+{
+  WellsBlockHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, WELLS_BLOCK_MAGIC, sizeof(header.magic));
+  header.version = WELLS_BLOCK_VERSION;
+  header.encoding = mEncoding;
+  header.rows = mRows;
+  header.cols = mCols;
+  header.flows = mFlows;
+  header.tileRows = mTileRows;
+  header.tileCols = mTileCols;
+  header.lower = mLower;
+  header.upper = mUpper;
+  header.trailerOffset = trailerOffset;
+  header.trailerSize = trailerSize;
+  header.trailerChecksum = trailerChecksum;
+  WriteAll(mFd, &header, sizeof(header), 0, mPath);
+}
+
+void WellsBlockFile::WriteTrailer()
+{
+  vector<char> trailer;
+  PutU64(trailer, mBlocks.size());
+  if (!mBlocks.empty())
+    trailer.insert(trailer.end(), (const char *)&mBlocks[0], (const char *)(&mBlocks[0] + mBlocks.size()));
+  PutU64(trailer, mInfoKeys.size());
+  for (size_t i = 0; i < mInfoKeys.size(); i++) {
+    PutString(trailer, mInfoKeys[i]);
+    PutString(trailer, mInfoValues[i]);
+  }
+  PutU64(trailer, mCopies.size());
+  if (!mCopies.empty())
+    trailer.insert(trailer.end(), (const char *)&mCopies[0], (const char *)(&mCopies[0] + mCopies.size()));
+  trailer.resize((trailer.size() + 7) & ~(size_t)7, 0);
+
+  WriteAll(mFd, &trailer[0], trailer.size(), mEnd, mPath);
+  WriteHeader(mEnd, trailer.size(), Checksum(&trailer[0], trailer.size()));
+}
+
+void WellsBlockFile::ReadTrailer(uint64_t offset, uint64_t size, uint32_t checksum)
+{
+  struct stat st;
+  if (fstat(mFd, &st) != 0 || offset < sizeof(WellsBlockHeader) || offset + size > (uint64_t)st.st_size || size % 8 != 0)
+    ION_ABORT("Corrupt trailer in wells file: " + mPath);
+  vector<uint64_t> buffer(size / 8);
+  ReadAll(mFd, &buffer[0], size, offset, mPath);
+  if (Checksum(&buffer[0], size) != checksum)
+    ION_ABORT("Checksum mismatch in trailer of wells file: " + mPath);
+
+  TrailerReader in((const char *)&buffer[0], size, mPath);
+  uint64_t numBlocks = in.GetU64();
+  if (numBlocks > size / sizeof(BlockEntry))
+    ION_ABORT("Corrupt trailer in wells file: " + mPath);
+  mBlocks.resize(numBlocks);
+  if (numBlocks > 0)
+    in.Get(&mBlocks[0], numBlocks * sizeof(BlockEntry));
+  for (size_t b = 0; b < mBlocks.size(); b++) {
+    const BlockEntry &e = mBlocks[b];
+    if (e.tile >= mTileBlocks.size() || e.flowDepth == 0 || (uint64_t)e.flowStart + e.flowDepth > mFlows
+        || e.offset < sizeof(WellsBlockHeader) || e.offset + e.size > offset
+        || e.size != EncodedSize(mEncoding, TileWells(e.tile) * e.flowDepth))
+      ION_ABORT("Corrupt block index in wells file: " + mPath);
+    IndexBlock(b);
+  }
+
+  uint64_t numInfo = in.GetU64();
+  if (numInfo > size)
+    ION_ABORT("Corrupt trailer in wells file: " + mPath);
+  mInfoKeys.resize(numInfo);
+  mInfoValues.resize(numInfo);
+  for (size_t i = 0; i < numInfo; i++) {
+    mInfoKeys[i] = in.GetString();
+    mInfoValues[i] = in.GetString();
+  }
+
+  uint64_t numCopies = in.GetU64();
+  if (numCopies != 0 && numCopies != mRows * mCols)
+    ION_ABORT("Corrupt trailer in wells file: " + mPath);
+  mCopies.resize(numCopies);
+  if (numCopies > 0)
+    in.Get(&mCopies[0], numCopies * sizeof(float));
+}
+
+void WellsBlockFile::IndexBlock(size_t block)
+{
+  mTileBlocks[mBlocks[block].tile].push_back(block);
+}
+
+size_t WellsBlockFile::TileIndex(size_t rowStart, size_t colStart) const
+{
+  if (rowStart % mTileRows != 0 || colStart % mTileCols != 0 || rowStart >= mRows || colStart >= mCols)
+    ION_ABORT("Not the corner of a wells tile: " + ToStr(rowStart) + "," + ToStr(colStart) + " in: " + mPath);
+  return (rowStart / mTileRows) * mNumTileCols + colStart / mTileCols;
+}
+
+size_t WellsBlockFile::TileWells(size_t tile) const
+{
+  size_t rowStart = (tile / mNumTileCols) * mTileRows;
+  size_t colStart = (tile % mNumTileCols) * mTileCols;
+  return min(mTileRows, mRows - rowStart) * min(mTileCols, mCols - colStart);
+}
+
+// ----------------------------------------------------------------------------
+
+void WellsBlockFile::WriteTile(size_t rowStart, size_t colStart, size_t flowStart, size_t flowDepth, const float *data)
+{
+  if (!IsWritable())
+    ION_ABORT("Wells file is not open for writing: " + mPath);
+  size_t tile = TileIndex(rowStart, colStart);
+  if (flowDepth == 0 || flowStart + flowDepth > mFlows)
+    ION_ABORT("Illegal flows " + ToStr(flowStart) + "," + ToStr(flowDepth) + " for: " + mPath);
+
+  size_t count = TileWells(tile) * flowDepth;
+  size_t size = EncodedSize(mEncoding, count);
+  mEncoded.resize(size / 8);
+  Encode(mEncoding, mLower, mUpper, data, count, &mEncoded[0]);
+
+  BlockEntry entry;
+  entry.tile = tile;
+  entry.flowStart = flowStart;
+  entry.flowDepth = flowDepth;
+  entry.checksum = Checksum(&mEncoded[0], size);
+  entry.offset = mEnd;
+  entry.size = size;
+  WriteAll(mFd, &mEncoded[0], size, mEnd, mPath);
+  mEnd += size;
+  mBlocks.push_back(entry);
+  IndexBlock(mBlocks.size() - 1);
+}
+
+void WellsBlockFile::ReadTile(size_t rowStart, size_t colStart, size_t flowStart, size_t flowDepth, float *data)
+{
+  if (!IsOpen())
+    ION_ABORT("Wells file is not open: " + mPath);
+  size_t tile = TileIndex(rowStart, colStart);
+  if (flowStart + flowDepth > mFlows)
+    ION_ABORT("Illegal flows " + ToStr(flowStart) + "," + ToStr(flowDepth) + " for: " + mPath);
+  size_t numWells = TileWells(tile);
+  const vector<uint32_t> &blocks = mTileBlocks[tile];
+
+  // Usually a single block covers exactly the flows asked for
+  bool exact = !blocks.empty() && mBlocks[blocks.back()].flowStart == flowStart
+               && mBlocks[blocks.back()].flowDepth == flowDepth;
+  if (!exact)
+    fill(data, data + numWells * flowDepth, 0.0f);
+
+  for (size_t b = exact ? blocks.size() - 1 : 0; b < blocks.size(); b++) {
+    const BlockEntry &e = mBlocks[blocks[b]];
+    size_t begin = max(flowStart, (size_t)e.flowStart);
+    size_t end = min(flowStart + flowDepth, (size_t)e.flowStart + e.flowDepth);
+    if (begin >= end)
+      continue;
+
+    mEncoded.resize(e.size / 8);
+    ReadAll(mFd, &mEncoded[0], e.size, e.offset, mPath);
+    if (Checksum(&mEncoded[0], e.size) != e.checksum)
+      ION_ABORT("Checksum mismatch in wells file: " + mPath + " block of tile " + ToStr(rowStart) + "," +
+                ToStr(colStart) + " flows " + ToStr(e.flowStart) + "," + ToStr(e.flowDepth));
+
+    if (exact) {
+      Decode(mEncoding, mLower, mUpper, &mEncoded[0], numWells * flowDepth, data);
+      continue;
+    }
+    mDecoded.resize(numWells * e.flowDepth);
+    Decode(mEncoding, mLower, mUpper, &mEncoded[0], mDecoded.size(), &mDecoded[0]);
+    for (size_t w = 0; w < numWells; w++) {
+      const float *src = &mDecoded[0] + w * e.flowDepth - e.flowStart;
+      copy(src + begin, src + end, data + w * flowDepth + begin - flowStart);
+    }
+  }
+}
+
+void WellsBlockFile::SetInfo(const std::vector<std::string> &keys, const std::vector<std::string> &values)
+{
+  if (keys.size() != values.size())
+    ION_ABORT("Keys and Values don't match in size.");
+  mInfoKeys = keys;
+  mInfoValues = values;
+}
+
+void WellsBlockFile::SetCopies(const std::vector<float> &copies)
+{
+  if (!copies.empty() && copies.size() != mRows * mCols)
+    ION_ABORT("Copies don't match wells dimensions in: " + mPath);
+  mCopies = copies;
+}
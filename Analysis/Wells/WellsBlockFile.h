@@ -0,0 +1,153 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#ifndef WELLSBLOCKFILE_H
+#define WELLSBLOCKFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/**
+ * Streaming storage for the wells cube, an alternative to the hdf5 "wells" dataset.
+ *
+ * The chip is cut into tiles of tileRows x tileCols wells. Data is appended as
+ * blocks, each holding one tile for a contiguous range of flows, so a writer can
+ * stream out a flow block at a time and a reader only touches the tiles of the
+ * region it loads. Within a block values are stored well by well (row major
+ * inside the tile) with the flows of a well contiguous, like the hdf5 layout.
+ *
+ * File layout:
+ *   header | block | block | ... | trailer
+ * The trailer holds the block index, the key/value metadata and the optional
+ * per well copy counts. The header points to it; while a writer has the file
+ * open the pointer is zero, so files left behind by a crashed writer are
+ * rejected rather than read. Appending truncates the old trailer and writes a
+ * new one on Close(). Blocks written later override earlier blocks for the
+ * same tile and flows. Every block and the trailer carry a checksum that is
+ * verified on read. Integers and floats are stored in host (little endian)
+ * byte order.
+ *
+ * Appending takes an exclusive flock() on the file, so writers in different
+ * threads or processes take turns instead of corrupting the trailer, and
+ * readers opening the file wait for the writer to close it.
+ */
+class WellsBlockFile {
+
+public:
+
+  /** How values are stored inside blocks. */
+  enum Encoding {
+    FLOAT32 = 0,  /**< Values as is. */
+    USHORT  = 1,  /**< WellsConverter mapping of [lower, upper] onto 0..65535. */
+    FLOAT16 = 2   /**< IEEE half precision, rounded to nearest even. */
+  };
+
+  WellsBlockFile();
+  ~WellsBlockFile();
+
+  /** True if the file at path starts with the block file magic. */
+  static bool IsBlockFile(const std::string &path);
+
+  /** Create (truncate) a file and leave it open for appending blocks. */
+  void Create(const std::string &path, size_t rows, size_t cols, size_t flows,
+              size_t tileRows, size_t tileCols, Encoding encoding, float lower, float upper);
+
+  /** Open a complete file for reading blocks. */
+  void OpenForRead(const std::string &path);
+
+  /** Open a complete file for appending blocks, waiting for other writers to finish. */
+  void OpenForAppend(const std::string &path);
+
+  /** Write the trailer if open for appending, and close the file. */
+  void Close();
+
+  bool IsOpen() const { return mFd >= 0; }
+  bool IsWritable() const { return mFd >= 0 && mWritable; }
+
+  /* Accessors */
+  size_t NumRows() const { return mRows; }
+  size_t NumCols() const { return mCols; }
+  size_t NumFlows() const { return mFlows; }
+  size_t TileRows() const { return mTileRows; }
+  size_t TileCols() const { return mTileCols; }
+  Encoding GetEncoding() const { return mEncoding; }
+  float Lower() const { return mLower; }
+  float Upper() const { return mUpper; }
+  size_t NumBlocks() const { return mBlocks.size(); }
+
+  /**
+   * Append one block. rowStart and colStart must be the corner of a tile; data
+   * holds the wells of that tile (clipped to the chip) row major, flowDepth
+   * values per well.
+   */
+  void WriteTile(size_t rowStart, size_t colStart, size_t flowStart, size_t flowDepth, const float *data);
+
+  /**
+   * Read flows [flowStart, flowStart + flowDepth) of the tile with corner rowStart,
+   * colStart into data, laid out like WriteTile(). Flows never written read as zero.
+   */
+  void ReadTile(size_t rowStart, size_t colStart, size_t flowStart, size_t flowDepth, float *data);
+
+  /** Key/value metadata, written with the trailer. */
+  void SetInfo(const std::vector<std::string> &keys, const std::vector<std::string> &values);
+  const std::vector<std::string> & InfoKeys() const { return mInfoKeys; }
+  const std::vector<std::string> & InfoValues() const { return mInfoValues; }
+
+  /** Per well copy counts, rows x cols or empty, written with the trailer. */
+  void SetCopies(const std::vector<float> &copies);
+  const std::vector<float> & Copies() const { return mCopies; }
+  bool HasCopies() const { return !mCopies.empty(); }
+
+  /* Block encodings, exposed for benchmarks and tests. */
+  static size_t EncodedSize(Encoding encoding, size_t count);
+  static void Encode(Encoding encoding, float lower, float upper, const float *in, size_t count, void *out);
+  static void Decode(Encoding encoding, float lower, float upper, const void *in, size_t count, float *out);
+  static uint32_t Checksum(const void *data, size_t size);
+
+  /** True if half precision conversions use the F16C instructions on this CPU. */
+  static bool HalfConversionInHardware();
+
+private:
+  struct BlockEntry {
+    uint32_t tile;
+    uint32_t flowStart;
+    uint32_t flowDepth;
+    uint32_t checksum;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  void Open(const std::string &path, bool forAppend);
+  void ReadTrailer(uint64_t offset, uint64_t size, uint32_t checksum);
+  void WriteTrailer();
+  void WriteHeader(uint64_t trailerOffset, uint64_t trailerSize, uint32_t trailerChecksum);
+  void IndexBlock(size_t block);
+  size_t TileIndex(size_t rowStart, size_t colStart) const;
+  size_t TileWells(size_t tile) const;
+
+  std::string mPath;
+  int mFd;
+  bool mWritable;
+  uint64_t mEnd;       ///< Offset where the next block goes.
+
+  size_t mRows;
+  size_t mCols;
+  size_t mFlows;
+  size_t mTileRows;
+  size_t mTileCols;
+  size_t mNumTileCols;
+  Encoding mEncoding;
+  float mLower;
+  float mUpper;
+
+  std::vector<BlockEntry> mBlocks;
+  std::vector< std::vector<uint32_t> > mTileBlocks;  ///< Blocks of each tile, in write order.
+  std::vector<std::string> mInfoKeys;
+  std::vector<std::string> mInfoValues;
+  std::vector<float> mCopies;
+
+  std::vector<uint64_t> mEncoded;  ///< Scratch, 8 byte aligned for the encoders.
+  std::vector<float> mDecoded;
+};
+
+#endif // WELLSBLOCKFILE_H
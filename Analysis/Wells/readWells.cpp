@@ -86,7 +86,7 @@ int main(int argc, const char *argv[]) {
     //RawWells wells(wellDir.c_str(), wellFile.c_str());
     RawWells wells(wellFiles[iFile].c_str(),0,0);
     wells.SetSubsetToLoad(&col[0], &row[0], col.size());
-    wells.OpenForRead();
+    wells.OpenForRead(true);
     uint64_t nFlow = wells.NumFlows();
     cout << "#nFlow=" << nFlow << endl;
     string flowOrder = wells.FlowOrder();
@@ -19,9 +19,11 @@ BbcCreate::BbcCreate( const BamTools::RefVector& references, uint32_t bufferSize
 	: m_references(references)
     , m_bufsize(bufferSize)
 	, m_bbcfile(NULL)
+	, m_anchorOffsets(NULL)
 {
 	m_totalReads = m_contigReads = m_reads = m_wordsize = m_covtype = 0;
     m_srtPos = m_lstPos = m_curPos = m_curCov = m_curWsz = m_backWrdsz = m_backStep = 0;
+    m_lastAnchorPos = 0;
     m_markAnchor = true;
     m_printOutput = m_onTargetOnly = false;
     m_newContig = s_versionNumber;			// reset after first used
@@ -42,9 +44,12 @@ void BbcCreate::Close() {
 		m_reads = 0;
 	}
 	if( m_bbcfile ) {
-		fclose(m_bbcfile);
+		// segment files are owned by the caller
+		if( m_anchorOffsets ) fflush(m_bbcfile);
+		else fclose(m_bbcfile);
 		m_bbcfile = NULL;
 	}
+	m_anchorOffsets = NULL;
 }
 
 void BbcCreate::CollectBaseCoverage(
@@ -172,6 +177,53 @@ bool BbcCreate::Open( const string &filename ) {
 	return true;
 }
 
+void BbcCreate::OpenSegment( FILE *segfile, vector<long> *anchorOffsets )
+{
+	Close();
+	m_bbcfile = segfile;
+	m_anchorOffsets = anchorOffsets;
+}
+
+bool BbcCreate::AppendSegment( FILE *segfile, const vector<long> &anchorOffsets )
+{
+	static const uint16_t NOP = 0x8000;
+	static const size_t s_copyBufSize = 1 << 20;
+	if( !m_bbcfile || m_anchorOffsets ) return false;
+	if( fseek( segfile, 0, SEEK_END ) ) return false;
+	long segSize = ftell(segfile);
+	rewind(segfile);
+	if( segSize <= 0 ) return true;	// no coverage for contigs of this segment
+	// segment starts with a new contig record - replace its version number marker if not file start
+	uint16_t head;
+	if( fread( &head, 1, sizeof(uint16_t), segfile ) != sizeof(uint16_t) ) return false;
+	fwrite( &m_newContig, 1, sizeof(uint16_t), m_bbcfile );
+	m_newContig = 0;
+	// copy remaining records, adding NOPs where anchors would otherwise fall on a 32bit boundary
+	char *buf = (char *)malloc(s_copyBufSize);
+	long pos = sizeof(uint16_t);
+	size_t nextAnchor = 0;
+	bool ok = true;
+	while( ok && pos < segSize ) {
+		long end = nextAnchor < anchorOffsets.size() ? anchorOffsets[nextAnchor] : segSize;
+		while( pos < end ) {
+			size_t nbytes = end - pos < (long)s_copyBufSize ? end - pos : s_copyBufSize;
+			if( fread( buf, 1, nbytes, segfile ) != nbytes || fwrite( buf, 1, nbytes, m_bbcfile ) != nbytes ) {
+				ok = false;
+				break;
+			}
+			pos += nbytes;
+		}
+		if( ok && nextAnchor < anchorOffsets.size() ) {
+			if( !(ftell(m_bbcfile) & 0xFFFFFFFF) ) {
+				fwrite( &NOP, 1, sizeof(uint16_t), m_bbcfile );
+			}
+			++nextAnchor;
+		}
+	}
+	free(buf);
+	return ok;
+}
+
 void BbcCreate::SetNoOffTargetPositions( bool hide )
 {
 	m_onTargetOnly = hide;
@@ -186,7 +238,6 @@ float BbcCreate::VersionNumber() {
 void BbcCreate::FlushReads( bool markAnchor )
 {
 	static const uint16_t NOP = 0x8000;
-	static uint32_t s_lastAnchorPos = 0;
 	if( m_reads ) {
 		uint32_t ws = m_wordsize == 8 ? 3 : (m_wordsize >> 1);
 		if( m_bbcfile ) {
@@ -194,21 +245,24 @@ void BbcCreate::FlushReads( bool markAnchor )
 			// - only necessary where whole index block (100K) are covered (and typically no target regions)
 			if( (m_srtPos+m_reads-1)/s_flushAtIndexBlockSize > (m_srtPos-1)/s_flushAtIndexBlockSize ) {
 				// this saves need for unnecessary extra anchor insertions - e.g. 2-3K for AmpliSeq Exome
-				if( s_lastAnchorPos - m_srtPos > m_bufsize ) {
+				if( m_lastAnchorPos - m_srtPos > m_bufsize ) {
 					m_markAnchor = true;
 				}
 			}
 			// pack flag-pos.length.wordSizeCode.onTargetBit [+ anchor position]
 			uint16_t head = (m_reads << 3) | (ws << 1) | m_covtype;
 			if( m_markAnchor ) {
-				if( !(ftell(m_bbcfile) & 0xFFFFFFFF) ) {
+				if( m_anchorOffsets ) {
+					// segment offsets are not final - padding is deferred to AppendSegment()
+					m_anchorOffsets->push_back( ftell(m_bbcfile) );
+				} else if( !(ftell(m_bbcfile) & 0xFFFFFFFF) ) {
 					// anchor points must not be on 32bit boundary due to conflict with indexing
 					// (64bit wrap around vs. 0-coverage blocks). Insert NOP -> 0 read length region
 					fwrite( &NOP, 1, sizeof(uint16_t), m_bbcfile );
 				}
 				fwrite( &head, 1, sizeof(uint16_t), m_bbcfile );
 				fwrite( &m_srtPos, 1, sizeof(uint32_t), m_bbcfile );
-				s_lastAnchorPos = m_srtPos;
+				m_lastAnchorPos = m_srtPos;
 			} else {
 				head |= 0x8000;
 				fwrite( &head, 1, sizeof(uint16_t), m_bbcfile );
@@ -12,6 +12,7 @@
 #include "api/BamAux.h"
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <cstdio>
 using namespace std;
@@ -29,6 +30,14 @@ class BbcCreate
 
 		bool Open( const string &filename );
 
+		// Write coverage records only (no header) to an already open file, e.g. by a worker thread
+		// creating coverage for a subset of contigs. File offsets of anchor records are collected
+		// so AppendSegment() can reproduce the NOP padding used where the whole file is written.
+		void OpenSegment( FILE *segfile, vector<long> *anchorOffsets );
+
+		// Append a segment created by OpenSegment() to the currently open BBC file
+		bool AppendSegment( FILE *segfile, const vector<long> &anchorOffsets );
+
 		void SetNoOffTargetPositions( bool hide = true );
 
 		float VersionNumber(void);
@@ -49,6 +58,7 @@ class BbcCreate
 		uint32_t m_curCov;
 		uint32_t m_backWrdsz;
 		uint32_t m_backStep;
+		uint32_t m_lastAnchorPos;
 		uint16_t m_newContig;
 		bool m_onTargetOnly;
 		bool m_markAnchor;
@@ -57,6 +67,7 @@ class BbcCreate
 
 		uint32_t *m_buffer;
 		FILE *m_bbcfile;
+		vector<long> *m_anchorOffsets;
 
 		void FlushReads( bool markPosition = true );
 		void BackFlushReads(void);
@@ -22,6 +22,10 @@ using namespace BamTools;
 #include "BbcDepth.h"
 #include "TrackReads.h"
 
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdlib>
+
 // Number alignments returned using SetRegion() appears incorrect when using closed regions!
 // It appears to work when using right-open regions but has MASSIVE performance issue.
 // Direct index Jump() mostly works! (With care to avoid reviewing reads more than once.)
@@ -36,6 +40,9 @@ const int s_initialMinJumpLen = 1000000;
 // Read length is tracked as an offset to target for Jump() - this does not appear to be necessary?
 const int s_initialMaxReadLen = 1000;
 
+// Contig runs queued per thread for multi-threaded BBC creation - allows for widely varying contig lengths
+const int s_shardsPerThread = 4;
+
 // Current version number string for bbctools executable
 const uint16_t s_versionNumber = 1301;
 
@@ -45,6 +52,10 @@ int bbctools_report( BbcUtils::OptParser &optParser );
 int bbctools_view( BbcUtils::OptParser &optParser );
 int bbctools_version( BbcUtils::OptParser &optParser );
 
+int bbctools_create_threaded(
+	const vector<string> &bamFiles, const RefVector &references, BbcCreate *bbcCreate, const string &bbcfile,
+	int numThreads, uint32_t skipFlag, uint16_t minMapQuality, int32_t minAlignLength, bool onlyOnTargetBases );
+
 int main( int argc, char* argv[] ) {
 	//
 	// general command line argument validation
@@ -60,7 +71,7 @@ int main( int argc, char* argv[] ) {
 	int minArgs = 1, maxArgs = 1;
 	if( subcmd == "create" ) {
 		subcmdFunc = &bbctools_create;
-		parseString =  "A=annotationFields:B=bbc:C=covStats:D=covDepths:E=e2eGap,L=minAlignLength,M=minPcCov;";
+		parseString =  "A=annotationFields:B=bbc:C=covStats:D=covDepths:E=e2eGap,L=minAlignLength,M=minPcCov;N=numThreads,";
 		parseString += "O=readOrigin:P=primerLength,Q=minMAPQ,R=regions:S=sumStats:T=readType:W=widenRegions,";
 		parseString += "a=autoCreateBamIndex b=onTargetBases c=coarse i=index d=noDups r=onTargetReads s=samdepth u=unique";
 		maxArgs = 0;
@@ -138,6 +149,7 @@ int bbctools_create( BbcUtils::OptParser &optParser ) {
 	bool     samdepth         = optParser.getOptBoolean("samdepth");
 	int32_t  filterQuality    = optParser.getOptInteger("minMAPQ");
 	int32_t  minAlignLength   = optParser.getOptInteger("minAlignLength");
+	int32_t  numThreads       = optParser.getOptInteger("numThreads",1);
 	int32_t  regionsPadding   = optParser.getOptInteger( "widenRegions", (readType == "AmpliSeq" ? 2 : 0) );
 	bool     filterDuplicates = optParser.getOptBoolean("noDups");
 	bool     filterUnique     = optParser.getOptBoolean("unique");
@@ -313,6 +325,18 @@ int bbctools_create( BbcUtils::OptParser &optParser ) {
 		bbcCreate->SetNoOffTargetPositions(onlyOnTargetBases);
 	}
 	bbcView.SetNoOffTargetPositions(onlyOnTargetBases);
+	// BAM reads may be divided between threads by contig where only a BBC file is being created
+	bool createThreaded = false;
+	if( numThreads > 1 && !haveBbcFile ) {
+		if( !bbcCreate || bbcfileRoot == "-" || regions || !readOrigFile.empty() ) {
+			cerr << "Warning: --numThreads (-N) option ignored for options other than BBC file (-B) creation without regions." << endl;
+		} else if( !bamReader.LocateIndexes() ) {
+			cerr << "Warning: BAM index file" << (cmdArgs.size() > 1 ? "s" : "");
+			cerr << " not located for multi-threaded BBC file creation. Using one thread." << endl;
+		} else {
+			createThreaded = true;
+		}
+	}
 	// Stream input to output creators
 	if( haveBbcFile ) {
 		// BBC reader and driver via BbcView object
@@ -328,6 +352,10 @@ int bbctools_create( BbcUtils::OptParser &optParser ) {
 		if( bbcCreate || regions || bbcfileRoot == "-" ) {
 			bbcView.ReadAll();
 		}
+	} else if( createThreaded ) {
+		int status = bbctools_create_threaded( cmdArgs, references, bbcCreate, bbcfileRoot+".bbc",
+			numThreads, skipFlag, minMapQuality, minAlignLength, onlyOnTargetBases );
+		if( status ) return status;
 	} else {
 		// Test read tracking option for file write
 		TrackReads *readTracker = NULL;
@@ -518,6 +546,176 @@ int bbctools_create( BbcUtils::OptParser &optParser ) {
 	return 0;
 }
 
+//
+// Multi-threaded BBC file creation from BAM input.
+// Contigs are grouped into runs (shards) that are read and encoded independently, each to a temporary
+// file, then appended to the BBC file in contig order. The result is identical to single thread output.
+//
+
+struct BbcCreateShard {
+	int firstContig;
+	int lastContig;
+	FILE *segfile;
+	vector<long> anchorOffsets;
+	int status;
+};
+
+struct BbcCreateThreadData {
+	const vector<string> *bamFiles;
+	const RefVector *references;
+	vector<BbcCreateShard> *shards;
+	size_t nextShard;
+	pthread_mutex_t mutex;
+	uint32_t skipFlag;
+	uint16_t minMapQuality;
+	int32_t minAlignLength;
+	bool onlyOnTargetBases;
+};
+
+// Create BBC records for one contig run. Returns 0 (success), 1 (BAM read failure) or 2 (BAM not sorted).
+static int bbctools_create_shard( const BbcCreateThreadData &data, BbcCreateShard &shard )
+{
+	BbcCreate bbcCreate(*data.references);
+	bbcCreate.OpenSegment( shard.segfile, &shard.anchorOffsets );
+	bbcCreate.SetNoOffTargetPositions(data.onlyOnTargetBases);
+	BaseCoverage baseCov(*data.references);
+	baseCov.SetBbcCreate(&bbcCreate);
+	BamAlignment aln;
+	// Jump() is only reliable for the first region on a reader so a new reader is used if the Jump()
+	// to a contig did not locate any reads, e.g. for a contig with no aligned reads
+	for( int contig = shard.firstContig; contig <= shard.lastContig; ++contig ) {
+		BamMultiReader bamReader;
+		if( !bamReader.Open(*data.bamFiles) || !bamReader.LocateIndexes() ) {
+			return 1;
+		}
+		if( !bamReader.Jump( contig, 0 ) ) continue;
+		bool located = false;
+		while( bamReader.GetNextAlignmentCore(aln) ) {
+			// also skips unmapped reads that may be merged in from the end of another BAM
+			if( aln.RefID < contig ) continue;
+			located = true;
+			if( aln.RefID > shard.lastContig ) break;
+			// skip filtered reads by flag, length or mapping quality
+			if( aln.AlignmentFlag & data.skipFlag ) continue;
+			if( aln.MapQuality < data.minMapQuality ) continue;
+			int32_t endPos = aln.GetEndPosition();
+			if( data.minAlignLength > 0 ) {
+				if( endPos - aln.Position < data.minAlignLength ) continue;
+			}
+			if( baseCov.AddAlignment(aln,endPos) < 0 ) {
+				return 2;
+			}
+		}
+		if( located ) break;
+	}
+	baseCov.Flush();
+	bbcCreate.Close();
+	return 0;
+}
+
+static void *bbctools_create_worker( void *arg )
+{
+	BbcCreateThreadData *data = (BbcCreateThreadData *)arg;
+	while( true ) {
+		pthread_mutex_lock( &data->mutex );
+		size_t idx = data->nextShard++;
+		pthread_mutex_unlock( &data->mutex );
+		if( idx >= data->shards->size() ) break;
+		BbcCreateShard &shard = (*data->shards)[idx];
+		shard.status = bbctools_create_shard( *data, shard );
+	}
+	return NULL;
+}
+
+int bbctools_create_threaded(
+	const vector<string> &bamFiles, const RefVector &references, BbcCreate *bbcCreate, const string &bbcfile,
+	int numThreads, uint32_t skipFlag, uint16_t minMapQuality, int32_t minAlignLength, bool onlyOnTargetBases )
+{
+	// group consecutive contigs to give runs of similar total length
+	uint64_t totalLength = 0;
+	for( size_t i = 0; i < references.size(); ++i ) {
+		totalLength += references[i].RefLength;
+	}
+	uint64_t shardLength = totalLength / (numThreads * s_shardsPerThread) + 1;
+	vector<BbcCreateShard> shards;
+	uint64_t runLength = 0;
+	for( size_t i = 0; i < references.size(); ++i ) {
+		if( runLength == 0 ) {
+			BbcCreateShard shard;
+			shard.firstContig = i;
+			shard.segfile = NULL;
+			shard.status = 0;
+			shards.push_back(shard);
+		}
+		shards.back().lastContig = i;
+		runLength += references[i].RefLength;
+		if( runLength >= shardLength ) runLength = 0;
+	}
+	// temporary files are created next to the BBC file and removed on close
+	int status = 0;
+	for( size_t i = 0; i < shards.size(); ++i ) {
+		string tmpName = bbcfile + ".XXXXXX";
+		vector<char> tmpPath( tmpName.begin(), tmpName.end() );
+		tmpPath.push_back('\0');
+		int fd = mkstemp( &tmpPath[0] );
+		if( fd < 0 || !(shards[i].segfile = fdopen( fd, "w+b" )) ) {
+			cerr << "ERROR: Failed to create temporary file for BBC file creation." << endl;
+			if( fd >= 0 ) close(fd);
+			status = 1;
+			break;
+		}
+		unlink( &tmpPath[0] );
+	}
+	if( status == 0 ) {
+		BbcCreateThreadData data;
+		data.bamFiles = &bamFiles;
+		data.references = &references;
+		data.shards = &shards;
+		data.nextShard = 0;
+		data.skipFlag = skipFlag;
+		data.minMapQuality = minMapQuality;
+		data.minAlignLength = minAlignLength;
+		data.onlyOnTargetBases = onlyOnTargetBases;
+		pthread_mutex_init( &data.mutex, NULL );
+		if( numThreads > (int)shards.size() ) numThreads = shards.size();
+		vector<pthread_t> threads(numThreads);
+		int numStarted = 0;
+		while( numStarted < numThreads ) {
+			if( pthread_create( &threads[numStarted], NULL, bbctools_create_worker, &data ) ) break;
+			++numStarted;
+		}
+		// shards are taken from a shared queue, so the calling thread takes the place of any thread not started
+		if( numStarted < numThreads ) {
+			bbctools_create_worker( &data );
+		}
+		for( int t = 0; t < numStarted; ++t ) {
+			pthread_join( threads[t], NULL );
+		}
+		pthread_mutex_destroy( &data.mutex );
+		// append contig runs in order
+		for( size_t i = 0; i < shards.size(); ++i ) {
+			if( shards[i].status == 1 ) {
+				cerr << "ERROR: Failed to read BAM file(s) for contig " << references[shards[i].firstContig].RefName << endl;
+				status = 1;
+				break;
+			} else if( shards[i].status == 2 ) {
+				cerr << "ERROR: BAM file is not correctly sorted vs. reference." << endl;
+				status = 1;
+				break;
+			}
+			if( !bbcCreate->AppendSegment( shards[i].segfile, shards[i].anchorOffsets ) ) {
+				cerr << "ERROR: Failed to write to BBC file '" << bbcfile << "'" << endl;
+				status = 1;
+				break;
+			}
+		}
+	}
+	for( size_t i = 0; i < shards.size(); ++i ) {
+		if( shards[i].segfile ) fclose( shards[i].segfile );
+	}
+	return status;
+}
+
 int bbctools_report( BbcUtils::OptParser &optParser )
 {
     const vector<string> cmdArgs = optParser.getArgs();
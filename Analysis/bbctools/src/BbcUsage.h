@@ -112,6 +112,10 @@ static void Usage( string subcmd, bool verbose = false ) {
 			"      to be counted as a 'covering' read. If the value is positive then the counts of covering reads per\n"
 			"      target per strand will be output to the --covStats (-C) file as the 'fwd_cov' and 'rev_cov' fields\n"
 			"      in preference to the end-to-end read counts ('fwd_e2e' and 'rev_e2e'). Default value is 0.\n"
+			"  -N,--numThreads <int>     Number of threads used to read BAM file(s) for BBC file creation. Contigs are\n"
+			"      divided between threads and the BBC file created is identical to that using one thread. This option\n"
+			"      requires BAM index (BAI) files and is ignored with the --regions (-R) option or if files other than\n"
+			"      BBC, BCI and CBC files are output. Default value is 1.\n"
 			"  -P,--primerLength <int>   Specifies the assumed length of (digested) primer when assigning reads to\n"
 			"      targets using --covStats (-C) for --readType 'amplicon' or 'AmpliSeq' options. Default value is 0.\n"
 			"  -Q,--minMAPQ <int>        Minimum aligned read MAPQ value for excluding reads when reading BAM files.\n"
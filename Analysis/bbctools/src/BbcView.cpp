@@ -9,13 +9,70 @@
 #include "BbcView.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "BbcUtils.h"
 
 const uint16_t s_maxVersionNumber = 1000;
 
+// Locus of an output coverage bin and end of the list of targeted sub-regions it covers
+struct BinLocus {
+	uint32_t srtContig;
+	uint32_t srtPosition;
+	uint32_t endContig;
+	uint32_t endPosition;
+	size_t   endSubRegion;
+};
+
+// Sum forward and reverse base reads for a number of bases packed as for a BBC coverage region of given word
+// size, where word size 0 is a half-byte pair. The max. region length (4095) cannot overflow 32bit sums unless
+// word size is 4. These are kept as simple loops over the packed array so the compiler can vectorize them.
+static void SumPackedCoverage(
+	const unsigned char *data, uint32_t wordsize, uint32_t nbases, uint64_t &fcovSum, uint64_t &rcovSum )
+{
+	if( wordsize == 0 ) {
+		uint32_t fsum = 0, rsum = 0;
+		for( uint32_t i = 0; i < nbases; ++i ) {
+			fsum += data[i] & 15;
+			rsum += data[i] >> 4;
+		}
+		fcovSum += fsum;
+		rcovSum += rsum;
+	} else if( wordsize == 1 ) {
+		uint32_t fsum = 0, rsum = 0;
+		for( uint32_t i = 0; i < nbases; ++i ) {
+			fsum += data[2*i];
+			rsum += data[2*i+1];
+		}
+		fcovSum += fsum;
+		rcovSum += rsum;
+	} else if( wordsize == 2 ) {
+		uint32_t fsum = 0, rsum = 0;
+		for( uint32_t i = 0; i < nbases; ++i ) {
+			uint16_t cov[2];
+			memcpy( cov, data + 4*i, sizeof(cov) );
+			fsum += cov[0];
+			rsum += cov[1];
+		}
+		fcovSum += fsum;
+		rcovSum += rsum;
+	} else {
+		uint64_t fsum = 0, rsum = 0;
+		for( uint32_t i = 0; i < nbases; ++i ) {
+			uint32_t cov[2];
+			memcpy( cov, data + 8*i, sizeof(cov) );
+			fsum += cov[0];
+			rsum += cov[1];
+		}
+		fcovSum += fsum;
+		rcovSum += rsum;
+	}
+}
+
 BbcView::BbcView()
 	: m_bbcfile(NULL)
 	, m_noOffTargetPositions(false)
@@ -54,6 +111,9 @@ BbcView::BbcView()
 	, m_bbcIndex(NULL)
 	, m_bbcCoarse(NULL)
 	, m_bcStream(NULL)
+	, m_mapData(NULL)
+	, m_mapSize(0)
+	, m_mapPos(0)
 {
 	m_contigStr = "";
 }
@@ -65,6 +125,11 @@ BbcView::~BbcView()
 
 void BbcView::Close()
 {
+	if( m_mapData ) {
+		munmap( (void *)m_mapData, m_mapSize );
+		m_mapData = NULL;
+		m_mapSize = m_mapPos = 0;
+	}
 	if( m_bbcfile ) {
 		fclose(m_bbcfile);
 		m_bbcfile = NULL;
@@ -173,6 +238,16 @@ bool BbcView::Open( const string &filename, bool test )
 		m_bbcfile = NULL;
 		return false;
 	}
+	// map the file for reading coverage data - falls back to buffered file reads if this fails
+	struct stat st;
+	if( !fstat( fileno(m_bbcfile), &st ) && st.st_size > 0 ) {
+		void *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(m_bbcfile), 0 );
+		if( data != MAP_FAILED ) {
+			m_mapData = (const unsigned char *)data;
+			m_mapSize = st.st_size;
+			m_mapPos = m_bbcfileRewindPos;
+		}
+	}
 	return true;
 }
 
@@ -418,7 +493,10 @@ string BbcView::ReadRange( const string &range, bool isolateRegions,
 			return "ERROR: Unexpected failure returned from SetCursorOnRegion() in BbcView::Read().";
 		}
 		uint32_t srtContig = rangeSrtContig, srtPosition = 0;
-		// for N bins pull reference regions covered
+		// for N bins pull reference regions covered, collecting the targeted sub-regions for output bins
+		// so that coverage over all of these may be summed in a single pass through the BBC file
+		vector<BbcRegionSum> subRegions;
+		vector<BinLocus> binLoci;
 		uint32_t holder = 0, pullSize;
 		for( uint32_t bin = 1; bin <= numBins; ++bin ) {
 			if( contigBins ) {
@@ -436,8 +514,7 @@ string BbcView::ReadRange( const string &range, bool isolateRegions,
 				pullSize = binEnd - holder;
 				holder = binEnd;
 			}
-			// collect the total coverage for the targeted regions covered by this bin section
-			uint64_t fcovSum = 0, rcovSum = 0, fcovSumTrg = 0, rcovSumTrg = 0;
+			// collect the targeted regions covered by this bin section
 			uint32_t endContig, srtPos, endPos;
 			bool newContigRegion = true, firstPull = true;
 			bool outputBin = bin >= firstBin && bin <= lastBin;
@@ -450,14 +527,11 @@ string BbcView::ReadRange( const string &range, bool isolateRegions,
 					return "ERROR: Unexpected failure to collect data from targeted sub-region\n";
 				}
 				if( outputBin ) {
-					if( !ReadSum( endContig, srtPos, endPos+1 ) ) {
-						delete [] contigBins;
-						return "ERROR: Unexpected failure to collect data from targeted sub-region\n";
-					}
-					fcovSum += m_fcovSum;
-					rcovSum += m_rcovSum;
-					fcovSumTrg += m_fcovSumTrg;
-					rcovSumTrg += m_rcovSumTrg;
+					BbcRegionSum subRegion;
+					subRegion.contig = endContig;
+					subRegion.srtPosition = srtPos;
+					subRegion.endPosition = endPos;
+					subRegions.push_back(subRegion);
 				}
 				// record start position for target region - little use when sub-region spans regions
 				if( !srtPosition ) srtPosition = srtPos;
@@ -469,11 +543,28 @@ string BbcView::ReadRange( const string &range, bool isolateRegions,
 				pullSize -= reglen;
 			}
 			if( outputBin ) {
-				PrintRegionCoverage( srtContig, srtPosition, endContig, endPos, fcovSum, rcovSum, fcovSumTrg, rcovSumTrg );
+				BinLocus locus = { srtContig, srtPosition, endContig, endPos, subRegions.size() };
+				binLoci.push_back(locus);
 			}
 			srtContig = endContig;
 			srtPosition = 0;
 		}
+		if( !ReadRegionSums(subRegions) ) {
+			delete [] contigBins;
+			return "ERROR: Unexpected failure to collect data from targeted sub-region\n";
+		}
+		for( size_t i = 0, j = 0; i < binLoci.size(); ++i ) {
+			uint64_t fcovSum = 0, rcovSum = 0, fcovSumTrg = 0, rcovSumTrg = 0;
+			for( ; j < binLoci[i].endSubRegion; ++j ) {
+				fcovSum += subRegions[j].fcovSum;
+				rcovSum += subRegions[j].rcovSum;
+				fcovSumTrg += subRegions[j].fcovSumTrg;
+				rcovSumTrg += subRegions[j].rcovSumTrg;
+			}
+			const BinLocus &locus = binLoci[i];
+			PrintRegionCoverage( locus.srtContig, locus.srtPosition, locus.endContig, locus.endPosition,
+				fcovSum, rcovSum, fcovSumTrg, rcovSumTrg );
+		}
 	} else {
 		// the range directly corresponds to the reference but is binned vs a contiguous sequence of contigs
 		string annotation;
@@ -610,12 +701,118 @@ bool BbcView::ReadRegions( uint32_t srtContig, uint32_t srtPosition, uint32_t en
 	return true;
 }
 
+bool BbcView::ReadRegionSums( vector<BbcRegionSum> &regionSums )
+{
+	if( !m_bbcfile ) return false;
+	// regions spanning CBC bins are summed separately (as by ReadSum()), as are all regions if not in order
+	vector<size_t> passRegions, sepRegions;
+	bool inOrder = m_mapData != NULL;
+	for( size_t i = 0; i < regionSums.size(); ++i ) {
+		BbcRegionSum &rs = regionSums[i];
+		if( rs.contig >= m_numContigs || rs.endPosition < rs.srtPosition ) return false;
+		rs.fcovSum = rs.rcovSum = rs.fcovSumTrg = rs.rcovSumTrg = 0;
+		if( m_bbcCoarse && rs.endPosition - rs.srtPosition >= m_cbcMinorWidth ) {
+			sepRegions.push_back(i);
+			continue;
+		}
+		if( !passRegions.empty() ) {
+			const BbcRegionSum &ls = regionSums[passRegions.back()];
+			if( rs.contig < ls.contig || (rs.contig == ls.contig && rs.srtPosition < ls.srtPosition) ) {
+				inOrder = false;
+			}
+		}
+		passRegions.push_back(i);
+	}
+	if( !inOrder ) {
+		sepRegions.insert( sepRegions.end(), passRegions.begin(), passRegions.end() );
+		passRegions.clear();
+	}
+	// Single pass: each region is added to the active list when the cursor reaches its start and the coverage
+	// of each region of the BBC file is added to all active regions it overlaps, directly from the mapped data
+	vector<size_t> active;
+	size_t next = 0;
+	if( !passRegions.empty() ) {
+		const BbcRegionSum &rs = regionSums[passRegions[0]];
+		if( !SeekStart( rs.contig, rs.srtPosition ) ) return false;
+	}
+	while( next < passRegions.size() || !active.empty() ) {
+		// no more coverage at end of file
+		if( m_contigIdx >= m_numContigs ) break;
+		uint32_t contig = m_contigIdx;
+		uint32_t spanSrt = m_position, spanEnd = m_position + m_readlen;
+		uint32_t ws = m_wordsize ? m_wordsize << 1 : 1;
+		if( m_mapPos + (uint64_t)ws * m_readlen > m_mapSize ) return false;
+		// seek forward if no region is active
+		// - a new contig is entered at its start, since seeking to a contig without coverage may otherwise
+		//   skip coverage at the start of the next contig
+		if( active.empty() ) {
+			const BbcRegionSum &rs = regionSums[passRegions[next]];
+			if( rs.contig > contig || (rs.contig == contig && rs.srtPosition > spanEnd) ) {
+				if( !SeekStart( rs.contig, rs.contig > contig ? 1 : rs.srtPosition ) ) return false;
+				continue;
+			}
+		}
+		// include regions starting within the current coverage region, or those already passed over
+		while( next < passRegions.size() ) {
+			const BbcRegionSum &rs = regionSums[passRegions[next]];
+			if( rs.contig > contig || (rs.contig == contig && rs.srtPosition > spanEnd) ) break;
+			active.push_back( passRegions[next++] );
+		}
+		size_t nactive = 0;
+		for( size_t i = 0; i < active.size(); ++i ) {
+			BbcRegionSum &rs = regionSums[active[i]];
+			// regions of a contig passed over have no (further) coverage
+			if( rs.contig != contig ) continue;
+			if( rs.endPosition >= spanSrt ) {
+				uint32_t srt = rs.srtPosition > spanSrt ? rs.srtPosition : spanSrt;
+				uint32_t end = rs.endPosition < spanEnd ? rs.endPosition : spanEnd;
+				uint64_t fcovSum = 0, rcovSum = 0;
+				// coverage at the cursor has already been read from file
+				if( srt == spanSrt ) {
+					fcovSum = m_fcov;
+					rcovSum = m_rcov;
+					++srt;
+				}
+				if( srt <= end ) {
+					SumPackedCoverage( m_mapData + m_mapPos + ws * (srt-spanSrt-1), m_wordsize, end-srt+1, fcovSum, rcovSum );
+				}
+				rs.fcovSum += fcovSum;
+				rs.rcovSum += rcovSum;
+				if( m_ontarg ) {
+					rs.fcovSumTrg += fcovSum;
+					rs.rcovSumTrg += rcovSum;
+				}
+			}
+			if( rs.endPosition > spanEnd ) active[nactive++] = active[i];
+		}
+		active.resize(nactive);
+		// move cursor to the next region of coverage
+		if( m_readlen ) {
+			SkipData( ws * m_readlen );
+			m_position += m_readlen;
+			m_readlen = 0;
+		}
+		if( !(m_versionNumber == 1000 ? ReadBaseCov1000() : ReadBaseCov0()) ) return false;
+	}
+	// the cursor is left past earlier separate regions, which are read forward from a clean start
+	if( !passRegions.empty() && !sepRegions.empty() ) Rewind();
+	for( size_t i = 0; i < sepRegions.size(); ++i ) {
+		BbcRegionSum &rs = regionSums[sepRegions[i]];
+		if( !ReadSum( rs.contig, rs.srtPosition, rs.endPosition+1 ) ) return false;
+		rs.fcovSum = m_fcovSum;
+		rs.rcovSum = m_rcovSum;
+		rs.fcovSumTrg = m_fcovSumTrg;
+		rs.rcovSumTrg = m_rcovSumTrg;
+	}
+	return true;
+}
+
 void BbcView::Rewind()
 {
 	if( !m_bbcfile ) return;
 	m_contigIdx = m_firstContigIdx;
 	m_contigStr = m_references[m_contigIdx].RefName.c_str();
-	fseek( m_bbcfile, m_bbcfileRewindPos, SEEK_SET );
+	SeekData( m_bbcfileRewindPos );
 	m_wordsize = m_readlen = m_ontarg = 0;
 	m_lastSeekContig = m_lastSeekPos = 0;
 	m_position = 0;
@@ -844,11 +1041,11 @@ bool BbcView::CreateIndexVersion0( BbcIndex &indexer )
 	if( !indexer.SetContig(m_firstContigIdx) ) return false;
 	uint32_t position, reg_head, wordsize, reglen;
 	while(1) {
-		long fpos = ftell(m_bbcfile);
+		long fpos = TellData();
 		// assume correctly read to the end of the file if can't grab another more bytes at this point
-		if( fread( &position, sizeof(uint32_t), 1, m_bbcfile) != 1 ) return true;
+		if( !ReadData( &position, sizeof(uint32_t) ) ) return true;
 		// expecting data here so failure to read is an error
-		if( fread( &reg_head, sizeof(uint32_t), 1, m_bbcfile) != 1 ) break;
+		if( !ReadData( &reg_head, sizeof(uint32_t) ) ) break;
 		if( !position ) {
 			m_contigIdx = reg_head - 1;
 			if( !indexer.SetContig(m_contigIdx) ) break;
@@ -859,7 +1056,7 @@ bool BbcView::CreateIndexVersion0( BbcIndex &indexer )
 		if( wordsize == 6 ) wordsize = 8;
 		reglen = reg_head >> 3;
 		indexer.PassAnchor( position+reglen, fpos );
-		fseek( m_bbcfile, wordsize * reglen, SEEK_CUR );
+		SkipData( wordsize * reglen );
 	}
 	return false;
 }
@@ -872,14 +1069,14 @@ bool BbcView::CreateIndexVersion1000( BbcIndex &indexer )
 	uint16_t reg_head;
 	long anchorFpos = 0;
 	while(1) {
-		long fpos = ftell(m_bbcfile);
+		long fpos = TellData();
 		// assume correctly read to the end of the file if can't grab another more bytes at this point
-		if( fread( &reg_head, 1, sizeof(uint16_t), m_bbcfile) != sizeof(uint16_t) ) return true;
+		if( !ReadData( &reg_head, sizeof(uint16_t) ) ) return true;
 		if( reg_head & 0x8000 ) {
 			reg_head &= 0x7FFF;
 		} else {
 			// expecting data here so failure to read is an error
-			if( fread( &position, 1, sizeof(uint32_t), m_bbcfile) != sizeof(uint32_t) ) break;
+			if( !ReadData( &position, sizeof(uint32_t) ) ) break;
 			anchorFpos = fpos;	// last valid anchor prior to region length overlapping an index site
 		}
 		if( !reg_head ) {
@@ -894,7 +1091,7 @@ bool BbcView::CreateIndexVersion1000( BbcIndex &indexer )
 		// record last anchor if this region overlaps an index site
 		position += reglen;
 		indexer.PassAnchor( position, anchorFpos );
-		fseek( m_bbcfile, wordsize * reglen, SEEK_CUR );
+		SkipData( wordsize * reglen );
 	}
 	return false;
 }
@@ -962,22 +1159,22 @@ bool BbcView::ReadBaseCov0( uint32_t skipToPosition ) {
 				uint32_t ws = m_wordsize ? m_wordsize << 1 : 1;
 				if( m_position + m_readlen < skipToPosition ) {
 					// skip over current segment and look at next
-					fseek( m_bbcfile, ws * m_readlen, SEEK_CUR );
+					SkipData( ws * m_readlen );
 					m_position += m_readlen;
 					m_readlen = 0;
 					continue;
 				}
 				// skip partial segment (>= 0) and read next base coverage
 				uint32_t skiplen = skipToPosition - m_position - 1;
-				fseek( m_bbcfile, ws * skiplen, SEEK_CUR );
+				SkipData( ws * skiplen );
 				m_position += skiplen;
 				m_readlen -= skiplen;
 			}
 			if( m_wordsize ) {
-				if( fread( &m_fcov, m_wordsize, 1, m_bbcfile) != 1 ) break;
-				if( fread( &m_rcov, m_wordsize, 1, m_bbcfile) != 1 ) break;
+				if( !ReadData( &m_fcov, m_wordsize ) ) break;
+				if( !ReadData( &m_rcov, m_wordsize ) ) break;
 			} else {
-				if( fread( &m_fcov, 1, 1, m_bbcfile) != 1 ) break;
+				if( !ReadData( &m_fcov, 1 ) ) break;
 				m_rcov = m_fcov >> 4 & 15;
 				m_fcov &= 15;
 			}
@@ -987,12 +1184,12 @@ bool BbcView::ReadBaseCov0( uint32_t skipToPosition ) {
 		}
 		// a non-resumed call begins here
 		uint32_t reg_head;
-		if( fread( &m_position, sizeof(uint32_t), 1, m_bbcfile) != 1 ) {
+		if( !ReadData( &m_position, sizeof(uint32_t) ) ) {
 			// assume if it break here then this is EOF (otherwise need ftell() vs. file size)
 			m_contigIdx = m_numContigs;
 			return true;
 		}
-		if( fread( &reg_head, sizeof(uint32_t), 1, m_bbcfile) != 1 ) break;
+		if( !ReadData( &reg_head, sizeof(uint32_t) ) ) break;
 		if( !m_position ) {
 			m_contigIdx = reg_head - 1;
 			if( m_contigIdx >= m_numContigs ) return false;
@@ -1030,22 +1227,22 @@ bool BbcView::ReadBaseCov1000( uint32_t skipToPosition ) {
 				uint32_t ws = m_wordsize ? m_wordsize << 1 : 1;
 				if( m_position + m_readlen < skipToPosition ) {
 					// skip over current segment and look at next
-					fseek( m_bbcfile, ws * m_readlen, SEEK_CUR );
+					SkipData( ws * m_readlen );
 					m_position += m_readlen;
 					m_readlen = 0;
 					continue;
 				}
 				// skip partial segment (>= 0) and read next base coverage
 				uint32_t skiplen = skipToPosition - m_position - 1;
-				fseek( m_bbcfile, ws * skiplen, SEEK_CUR );
+				SkipData( ws * skiplen );
 				m_position += skiplen;
 				m_readlen -= skiplen;
 			}
 			if( m_wordsize ) {
-				if( fread( &m_fcov, m_wordsize, 1, m_bbcfile) != 1 ) break;
-				if( fread( &m_rcov, m_wordsize, 1, m_bbcfile) != 1 ) break;
+				if( !ReadData( &m_fcov, m_wordsize ) ) break;
+				if( !ReadData( &m_rcov, m_wordsize ) ) break;
 			} else {
-				if( fread( &m_fcov, 1, 1, m_bbcfile) != 1 ) break;
+				if( !ReadData( &m_fcov, 1 ) ) break;
 				m_rcov = m_fcov >> 4 & 15;
 				m_fcov &= 15;
 			}
@@ -1055,7 +1252,7 @@ bool BbcView::ReadBaseCov1000( uint32_t skipToPosition ) {
 		}
 		// a non-resumed call begins here
 		uint16_t reg_head;
-		if( fread( &reg_head, 1, sizeof(uint16_t), m_bbcfile) != sizeof(uint16_t) ) {
+		if( !ReadData( &reg_head, sizeof(uint16_t) ) ) {
 			// assume if it break here then this is EOF (otherwise need ftell() vs. file size)
 			m_contigIdx = m_numContigs;
 			return true;
@@ -1065,7 +1262,7 @@ bool BbcView::ReadBaseCov1000( uint32_t skipToPosition ) {
 			if( reg_head & 0x8000 ) {
 				reg_head &= 0x7FFF;	// remove to get region length
 			} else {
-				if( fread( &m_position, 1, sizeof(uint32_t), m_bbcfile) != sizeof(uint32_t) ) break;
+				if( !ReadData( &m_position, sizeof(uint32_t) ) ) break;
 				--m_position;	// unfortunate trick to have ++m_position correct above
 			}
 			m_wordsize = (reg_head & 6) >> 1;
@@ -1075,7 +1272,7 @@ bool BbcView::ReadBaseCov1000( uint32_t skipToPosition ) {
 			m_fcov = m_rcov = 0;	// clear top bytes & for skip to just prior to coverage
 		} else {
 			// reg_head == 0  =>  grab new position
-			if( fread( &m_contigIdx, 1, sizeof(uint32_t), m_bbcfile) != sizeof(uint32_t) ) break;
+			if( !ReadData( &m_contigIdx, sizeof(uint32_t) ) ) break;
 			if( m_contigIdx >= m_numContigs ) break;	// fail safe
 			m_contigStr = m_references[m_contigIdx].RefName.c_str();
 			skipToPosition = 0;
@@ -1208,6 +1405,7 @@ bool BbcView::ReadSumFragment( uint32_t srtContig, uint32_t srtPosition, uint32_
 			fcovSumTrg += m_fcov;
 			rcovSumTrg += m_rcov;
 		}
+		SumCoverageRun( endPosition, fcovSum, rcovSum, fcovSumTrg, rcovSumTrg );
 		if( !(m_versionNumber == 1000 ? ReadBaseCov1000() : ReadBaseCov0()) ) return false;
 	}
 	return true;
@@ -1248,6 +1446,7 @@ bool BbcView::ReadSumNoCbc(
 			m_fcovSumTrg += m_fcov;
 			m_rcovSumTrg += m_rcov;
 		}
+		SumCoverageRun( endPos, m_fcovSum, m_rcovSum, m_fcovSumTrg, m_rcovSumTrg );
 		srtPosition = m_position;
 		// read next covered base location (to be consistent for start of next call)
 		if( !(m_versionNumber == 1000 ? ReadBaseCov1000() : ReadBaseCov0()) ) return false;
@@ -1376,7 +1575,7 @@ bool BbcView::SeekStart( uint32_t contigIdx, uint32_t position, bool softRewind
 		// 0 return means either (1) no need to reset file pointer (within range)
 		// (2) no more coverage at or beyond requested locus or (3) an (unlikely) coding issue
 		if( fpos ) {
-			fseek( m_bbcfile, fpos, SEEK_SET );
+			SeekData( fpos );
 			m_contigIdx = m_bbcIndex->GetContigIdx();
 			m_contigStr = m_references[m_contigIdx].RefName.c_str();
 			// ensure the new position is read from file
@@ -1403,6 +1602,57 @@ bool BbcView::SeekStart( uint32_t contigIdx, uint32_t position, bool softRewind
 	return m_versionNumber == 1000 ? ReadBaseCov1000(position) : ReadBaseCov0(position);
 }
 
+void BbcView::SumCoverageRun( uint32_t endPosition,
+	uint64_t &fcovSum, uint64_t &rcovSum, uint64_t &fcovSumTrg, uint64_t &rcovSumTrg )
+{
+	// Add coverage for bases following the cursor up to endPosition-1 within the current coverage region,
+	// directly from mapped file data. The last base of the region is left to be read to the cursor as usual.
+	if( !m_mapData || m_readlen <= 1 || m_position+1 >= endPosition ) return;
+	uint32_t nbases = endPosition - m_position - 1;
+	if( nbases >= m_readlen ) nbases = m_readlen - 1;
+	uint32_t nbytes = nbases * (m_wordsize ? m_wordsize << 1 : 1);
+	if( m_mapPos + nbytes > m_mapSize ) return;	// leave truncated file error to ReadBaseCov*()
+	uint64_t fcov = 0, rcov = 0;
+	SumPackedCoverage( m_mapData + m_mapPos, m_wordsize, nbases, fcov, rcov );
+	fcovSum += fcov;
+	rcovSum += rcov;
+	if( m_ontarg ) {
+		fcovSumTrg += fcov;
+		rcovSumTrg += rcov;
+	}
+	m_mapPos += nbytes;
+	m_position += nbases;
+	m_readlen -= nbases;
+}
+
+bool BbcView::ReadData( void *data, size_t nbytes )
+{
+	if( !m_mapData ) {
+		return fread( data, 1, nbytes, m_bbcfile ) == nbytes;
+	}
+	if( m_mapPos + nbytes > m_mapSize ) return false;
+	memcpy( data, m_mapData + m_mapPos, nbytes );
+	m_mapPos += nbytes;
+	return true;
+}
+
+void BbcView::SeekData( long fpos )
+{
+	if( m_mapData ) m_mapPos = fpos;
+	else fseek( m_bbcfile, fpos, SEEK_SET );
+}
+
+void BbcView::SkipData( long nbytes )
+{
+	if( m_mapData ) m_mapPos += nbytes;
+	else fseek( m_bbcfile, nbytes, SEEK_CUR );
+}
+
+long BbcView::TellData() const
+{
+	return m_mapData ? (long)m_mapPos : ftell(m_bbcfile);
+}
+
 void BbcView::StreamCoverage( uint32_t position, uint32_t fwdReads, uint32_t revReads, uint32_t covType )
 {
 	// RegionCoverage is used for overriding streamed coverage to new targets, e.g. for new BBC
@@ -24,6 +24,17 @@ using namespace std;
 
 #define MEMBER_FUNCTION(obj,func) ((obj).*(func))
 
+// Summed base coverage over a region of a single contig, as used for BbcView::ReadRegionSums()
+struct BbcRegionSum {
+	uint32_t contig;
+	uint32_t srtPosition;	// 1-based
+	uint32_t endPosition;	// inclusive
+	uint64_t fcovSum;
+	uint64_t rcovSum;
+	uint64_t fcovSumTrg;
+	uint64_t rcovSumTrg;
+};
+
 class BbcView
 {
     public:
@@ -94,6 +105,11 @@ class BbcView
 		bool ReadRegions(
 			uint32_t srtContig, uint32_t srtPosition, uint32_t endPosition = 0, uint32_t endContig = 0 );
 
+		// Sum base coverage over each of a list of regions, returning the sums in the list.
+		// Regions sorted by contig and start position are collected in a single pass through the BBC file,
+		// with regions allowed to overlap. Otherwise, each region is summed separately.
+		bool ReadRegionSums( vector<BbcRegionSum> &regionSums );
+
 		// Rewind the BBC file to the start of data - after header.
 		void Rewind(void);
 
@@ -198,6 +214,11 @@ class BbcView
 
 		string m_headerLine;
 
+		// BBC file data is read through a read-only memory map, if available
+		const unsigned char *m_mapData;
+		size_t      m_mapSize;
+		size_t      m_mapPos;
+
 		// ---- BBC file version readers ----
 		// If adding more probably best to derive from a base class or interface
 
@@ -207,6 +228,13 @@ class BbcView
 		bool ReadBaseCov0( uint32_t skipToPosition = 0 );
 		bool ReadBaseCov1000( uint32_t skipToPosition = 0 );
 
+		// ---- File data access - from memory map if available ----
+
+		bool ReadData( void *data, size_t nbytes );
+		void SeekData( long fpos );
+		void SkipData( long nbytes );
+		long TellData(void) const;
+
 		// ---- Private methods ----
 
 		void BaseCoveragePrint( uint32_t position, uint32_t fwdReads, uint32_t revReads, uint32_t covType );
@@ -230,6 +258,9 @@ class BbcView
 
 		bool SeekStart( uint32_t contigIdx, uint32_t position, bool softRewind = true );
 
+		void SumCoverageRun( uint32_t endPosition,
+			uint64_t &fcovSum, uint64_t &rcovSum, uint64_t &fcovSumTrg, uint64_t &rcovSumTrg );
+
 		// ---- Print stream formats as member functions ----
 
 		void BbcViewPrint(
@@ -46,6 +46,7 @@ typedef struct ProcessAlignmentContext {
   pthread_mutex_t  *read_mutex;
   pthread_mutex_t  *write_mutex;
   pthread_mutex_t  *results_mutex;
+  IonstatsAlignmentShardReader *shard_reader;
   
 } ProcessAlignmentContext;
 
@@ -187,6 +188,9 @@ void IonstatsAlignmentOptions::WriteHelp(void)
   cerr << "  --max-subregion-hp           INT       max HP length for regional summary [" << DEFAULT_SUBREGION_MAX_HP << "]" << endl;
   cerr << "  --n-threads                  INT       number of threads for analysis, set to 0 to use numCores() [" << DEFAULT_N_THREADS << "]" << endl;
   cerr << "  --threads-share-memory       BOOL      controls whether threads write results to private or common mem [" << DEFAULT_THREADS_SHARE_MEMORY << "]" << endl;
+  cerr << "  --shard-by-region            BOOL      threads read indexed, sorted input BAMs in parallel by reference region [" << DEFAULT_SHARD_BY_REGION << "]" << endl;
+  cerr << "                                         one thread decompresses each whole BAM to find its reads without coordinates," << endl;
+  cerr << "                                         which limits the speedup" << endl;
   cerr << endl;
   cerr << "Options for spatial stratification of results.  All 3 options must be used together." << endl;
   cerr << "  Each option specifies two comma-separated values in the form x,y" << endl;
@@ -252,6 +256,7 @@ void IonstatsAlignmentOptions::InitializeFromOptArgs(OptArgs &opts, const string
   debug_positive_ref_flow_     = opts.GetFirstInt    ('-', "debug-positive-ref-flow",    DEFAULT_DEBUG_POSITIVE_REF_FLOW);
   n_threads_                   = opts.GetFirstInt    ('-', "n-threads",                  DEFAULT_N_THREADS);
   threads_share_memory_        = opts.GetFirstBoolean('-', "threads-share-memory",       DEFAULT_THREADS_SHARE_MEMORY);
+  shard_by_region_             = opts.GetFirstBoolean('-', "shard-by-region",            DEFAULT_SHARD_BY_REGION);
 
 
   if(evaluate_per_read_per_flow_) {
@@ -304,6 +309,10 @@ void IonstatsAlignmentOptions::InitializeFromOptArgs(OptArgs &opts, const string
     cerr << "ERROR: " << program_ << ": when writing BAM output, buffer size must be positive" << endl;
     exit(EXIT_FAILURE);
   }
+  if(shard_by_region_ && (have_stdin || output_bam_filename_ != "")) {
+    cerr << "WARNING: " << program_ << ": --shard-by-region cannot be used when reading from /dev/stdin or writing --output-bam, reading sequentially" << endl;
+    shard_by_region_ = false;
+  }
 
   qv_to_error_rate_.assign(256,0);
   for (unsigned int qv = 0; qv < qv_to_error_rate_.size(); qv++)
@@ -431,6 +440,119 @@ bool IonstatsAlignmentBamReader::GetNextAlignment(BamAlignment &alignment, strin
   }
 }
 
+bool IonstatsAlignmentBamReader::InitializeShards(unsigned int n_threads, const string &program) {
+  shards_.clear();
+  next_shard_ = 0;
+
+  // Every input needs an index and coordinate order, so that a shard ends at the first read past its region
+  vector<RefVector> reference_data(input_bam_filename_.size());
+  uint64_t total_length = 0;
+  for(unsigned int file_idx=0; file_idx < input_bam_filename_.size(); ++file_idx) {
+    BamReader input_bam;
+    if (!input_bam.Open(input_bam_filename_[file_idx])) {
+      cerr << program << ": ERROR: cannot open " << input_bam_filename_[file_idx] << " for read" << endl;
+      exit(EXIT_FAILURE);
+    }
+    if(input_bam.GetHeader().SortOrder != "coordinate") {
+      cerr << "WARNING: " << program << ": " << input_bam_filename_[file_idx] << " is not sorted by coordinate" << endl;
+      return(false);
+    }
+    if(!input_bam.LocateIndex()) {
+      cerr << "WARNING: " << program << ": no index found for " << input_bam_filename_[file_idx] << endl;
+      return(false);
+    }
+    reference_data[file_idx] = input_bam.GetReferenceData();
+    for(RefVector::iterator ref_it = reference_data[file_idx].begin(); ref_it != reference_data[file_idx].end(); ++ref_it)
+      total_length += ref_it->RefLength;
+    input_bam.Close();
+  }
+
+  // A few shards per thread to balance the load
+  uint64_t shard_length = max(total_length / (SHARDS_PER_THREAD*max(n_threads,1u)), (uint64_t) MIN_SHARD_LENGTH);
+  IonstatsAlignmentShard shard;
+  for(unsigned int file_idx=0; file_idx < input_bam_filename_.size(); ++file_idx) {
+    // The unplaced reads at the end of a BAM can only be found by a scan over the whole file: a BamTools region
+    // stops at the first read without coordinates, and there is no public seek to an index offset.
+    // Hand these shards out first, so the scan overlaps the reference shards.
+    shard.file_idx = file_idx;
+    shard.ref_id = -1;
+    shard.left = 0;
+    shard.right = 0;
+    shards_.push_back(shard);
+  }
+  for(unsigned int file_idx=0; file_idx < input_bam_filename_.size(); ++file_idx) {
+    for(int ref_id=0; ref_id < (int) reference_data[file_idx].size(); ++ref_id) {
+      shard.file_idx = file_idx;
+      shard.ref_id = ref_id;
+      uint64_t ref_length = reference_data[file_idx][ref_id].RefLength;
+      for(uint64_t left=0; left == 0 || left < ref_length; left += shard_length) {
+        shard.left = left;
+        // the last shard of a reference takes anything placed beyond its length
+        shard.right = (left + shard_length < ref_length) ? (int) (left + shard_length) : numeric_limits<int>::max();
+        shards_.push_back(shard);
+      }
+    }
+  }
+
+  return(true);
+}
+
+bool IonstatsAlignmentBamReader::GetNextShard(IonstatsAlignmentShard &shard) {
+  if(next_shard_ >= shards_.size())
+    return(false);
+  shard = shards_[next_shard_++];
+  return(true);
+}
+
+bool IonstatsAlignmentShardReader::OpenNextShard(string &program) {
+  if(input_bam_.IsOpen())
+    input_bam_.Close();
+  pthread_mutex_lock(shard_mutex_);
+  have_shard_ = shards_->GetNextShard(shard_);
+  pthread_mutex_unlock(shard_mutex_);
+  if(!have_shard_)
+    return(false);
+
+  // A fresh reader per shard: repeated jumps on one BamReader are not reliable
+  const string &input_bam_filename = shards_->InputBamFilename(shard_.file_idx);
+  if (!input_bam_.Open(input_bam_filename)) {
+    cerr << program << ": ERROR: cannot open " << input_bam_filename << " for read" << endl;
+    exit(EXIT_FAILURE);
+  }
+  if(shard_.ref_id >= 0) {
+    if(!input_bam_.LocateIndex() || !input_bam_.Jump(shard_.ref_id, shard_.left)) {
+      cerr << program << ": ERROR: cannot jump to region " << shard_.ref_id << ":" << shard_.left << " of " << input_bam_filename << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  return(true);
+}
+
+bool IonstatsAlignmentShardReader::GetNextAlignment(BamAlignment &alignment, string &program) {
+  while(have_shard_ || OpenNextShard(program)) {
+    if(shard_.ref_id < 0) {
+      // Skip over the placed reads without decoding them
+      while(input_bam_.GetNextAlignmentCore(alignment)) {
+        if(alignment.RefID >= 0 && alignment.Position >= 0)
+          continue;
+        alignment.BuildCharData();
+        return(true);
+      }
+    } else {
+      while(input_bam_.GetNextAlignment(alignment)) {
+        if(alignment.RefID != shard_.ref_id || alignment.Position >= shard_.right)
+          break;
+        // Reads starting left of the shard belong to the previous one, reads without position to the unplaced shard
+        if(alignment.Position < shard_.left)
+          continue;
+        return(true);
+      }
+    }
+    have_shard_ = false;
+  }
+  return(false);
+}
+
 int IonstatsAlignment(OptArgs &opts, const string &program_str)
 {
   IonstatsAlignmentOptions opt;
@@ -457,6 +579,10 @@ int IonstatsAlignment(OptArgs &opts, const string &program_str)
     output_sam_header,
     output_reference_data
   );
+  if(opt.ShardByRegion() && !input_bam.InitializeShards(opt.NThreads(), opt.Program())) {
+    cerr << "WARNING: " << opt.Program() << ": cannot shard input by region, reading sequentially" << endl;
+    opt.DisableShardByRegion();
+  }
 
   // Initialize output BAM and write header using info returned from initialization of input BAM reader
   BamWriter output_bam;
@@ -489,6 +615,7 @@ int IonstatsAlignment(OptArgs &opts, const string &program_str)
   pthread_mutex_init(&write_mutex, NULL);
   pthread_mutex_init(&results_mutex, NULL);
   pthread_mutex_init(&region_mutex, NULL);
+  vector< IonstatsAlignmentShardReader > shard_reader(opt.NThreads());
   for(unsigned int i=0; i<opt.NThreads(); ++i) {
     pac[i].input_bam = & input_bam;
     if(opt.ThreadsShareMemory())
@@ -500,6 +627,11 @@ int IonstatsAlignment(OptArgs &opts, const string &program_str)
     pac[i].read_mutex = &read_mutex;
     pac[i].write_mutex = &write_mutex;
     pac[i].results_mutex = &results_mutex;
+    pac[i].shard_reader = NULL;
+    if(opt.ShardByRegion()) {
+      shard_reader[i].Initialize(&input_bam, &read_mutex);
+      pac[i].shard_reader = & (shard_reader[i]);
+    }
   }
 
   // Do the heavy work - process all alignment data
@@ -2425,11 +2557,17 @@ void * processAlignments(void *in) {
   BamAlignment alignment;
   bool done=false;
   while(!done) {
-    // Lock the read_mutex while we get the next alignment
-    pthread_mutex_lock(pac->read_mutex);
-    if(!pac->input_bam->GetNextAlignment(alignment,pac->opt->Program()))
-      done=true;
-    pthread_mutex_unlock(pac->read_mutex);
+    if(pac->shard_reader) {
+      // Shards are decoded in parallel, the read_mutex is only taken to get the next shard
+      if(!pac->shard_reader->GetNextAlignment(alignment,pac->opt->Program()))
+        done=true;
+    } else {
+      // Lock the read_mutex while we get the next alignment
+      pthread_mutex_lock(pac->read_mutex);
+      if(!pac->input_bam->GetNextAlignment(alignment,pac->opt->Program()))
+        done=true;
+      pthread_mutex_unlock(pac->read_mutex);
+    }
     if(done)
       continue;
 
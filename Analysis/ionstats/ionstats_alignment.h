@@ -4,6 +4,7 @@
 #ifndef IONSTATS_ALIGNMENT_H
 #define IONSTATS_ALIGNMENT_H
 
+#include <pthread.h>
 #include "api/BamWriter.h"
 #include "api/BamReader.h"
 #include "api/SamHeader.h"
@@ -41,6 +42,9 @@
 #define DEFAULT_DEBUG_POSITIVE_REF_FLOW    -1
 #define DEFAULT_N_THREADS                  5
 #define DEFAULT_THREADS_SHARE_MEMORY       "false"
+#define DEFAULT_SHARD_BY_REGION            "false"
+#define MIN_SHARD_LENGTH                   1000000
+#define SHARDS_PER_THREAD                  4
 
 using namespace std;
 using namespace BamTools;
@@ -81,7 +85,8 @@ public:
   n_error_rates_(0),
   max_flow_order_len_(0),
   n_threads_(0),
-  threads_share_memory_(false)
+  threads_share_memory_(false),
+  shard_by_region_(false)
   {}
   ~IonstatsAlignmentOptions () {}
 
@@ -134,6 +139,8 @@ public:
   double                 QvToErrorRate(int i)                 { return(qv_to_error_rate_[i]); };
   unsigned int           NThreads(void)                       { return(n_threads_); };
   bool                   ThreadsShareMemory(void)             { return(threads_share_memory_); };
+  bool                   ShardByRegion(void)                  { return(shard_by_region_); };
+  void                   DisableShardByRegion(void)           { shard_by_region_ = false; };
 
 private:
 
@@ -180,12 +187,22 @@ private:
   unsigned int max_flow_order_len_;
   unsigned int n_threads_;
   bool threads_share_memory_;
+  bool shard_by_region_;
 };
 
+// A part of one input BAM: reads of ref_id starting in [left, right),
+// or the reads without coordinates at the end of the BAM if ref_id is negative
+typedef struct IonstatsAlignmentShard {
+  unsigned int file_idx;
+  int ref_id;
+  int left;
+  int right;
+} IonstatsAlignmentShard;
+
 class IonstatsAlignmentBamReader {
 
 public:
-  IonstatsAlignmentBamReader() : max_flow_order_len_(0) {}
+  IonstatsAlignmentBamReader() : max_flow_order_len_(0), next_shard_(0) {}
   ~IonstatsAlignmentBamReader() {
     if(input_bam_.IsOpen())
       input_bam_.Close();
@@ -201,6 +218,11 @@ public:
   );
   bool GetNextAlignment(BamAlignment &alignment, string &program);
 
+  // Split indexed, coordinate-sorted input BAMs into shards, returns false if some input does not qualify
+  bool InitializeShards(unsigned int n_threads, const string &program);
+  bool GetNextShard(IonstatsAlignmentShard &shard);
+  const string & InputBamFilename(unsigned int file_idx) { return(input_bam_filename_[file_idx]); };
+
   map< string, int > &    ReadGroups(void)      { return(read_groups_); };
   map< string, string > & FlowOrders(void)      { return(flow_orders_); };
   map< string, string > & KeyBases(void)        { return(key_bases_); };
@@ -216,6 +238,32 @@ private:
   unsigned int max_flow_order_len_;
   BamReader input_bam_;
   vector<string>::iterator input_bam_filename_it_;
+  vector<IonstatsAlignmentShard> shards_;
+  unsigned int next_shard_;
+};
+
+// Reads the shards handed out by an IonstatsAlignmentBamReader through a private BamReader,
+// so that threads decode their reads in parallel
+class IonstatsAlignmentShardReader {
+
+public:
+  IonstatsAlignmentShardReader() : shards_(NULL), shard_mutex_(NULL), have_shard_(false) {}
+  ~IonstatsAlignmentShardReader() {
+    if(input_bam_.IsOpen())
+      input_bam_.Close();
+  }
+
+  void Initialize(IonstatsAlignmentBamReader *shards, pthread_mutex_t *shard_mutex) { shards_ = shards; shard_mutex_ = shard_mutex; };
+  bool GetNextAlignment(BamAlignment &alignment, string &program);
+
+private:
+  bool OpenNextShard(string &program);
+
+  IonstatsAlignmentBamReader *shards_;
+  pthread_mutex_t *shard_mutex_;
+  IonstatsAlignmentShard shard_;
+  bool have_shard_;
+  BamReader input_bam_;
 };
 
 #endif // IONSTATS_ALIGNMENT_H
@@ -0,0 +1,169 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "InputStructures.h"
+#include "SpliceVariantHypotheses.h"
+
+using namespace std;
+
+static const char *kFlowOrder = "TACGTACGTCTGAGCATCGATCGATGTACAGC";
+static const int   kNumFlows = 400;
+
+// Random bases up to and including the first base that reaches end_flow,
+// the way CalculateHypPredictions builds a read it only needs to simulate
+static vector<char> SimulatedOnlySequence(const ion::FlowOrder& flow_order, int end_flow)
+{
+  vector<char> sequence;
+  int flow = 0;
+  while (flow < end_flow) {
+    char base = "ACGT"[lrand48() % 4];
+    IncrementFlow(flow_order, base, flow);
+    sequence.push_back(base);
+  }
+  return sequence;
+}
+
+// Prediction of the hypothesis read, simulated without looking at the cache
+static vector<float> SolvedPrediction(PersistingThreadObjects& thread_objects, const vector<char>& sequence, int end_flow)
+{
+  vector<float> measurements(kNumFlows);
+  for (int flow = 0; flow < kNumFlows; ++flow)
+    measurements[flow] = 2.0 * drand48();
+  BasecallerRead read;
+  read.SetData(measurements, kNumFlows);
+  read.sequence = sequence;
+  thread_objects.SolveRead(0, read, end_flow, end_flow);
+  read.prediction.resize(kNumFlows, 0);
+  return read.prediction;
+}
+
+// Prediction as CalculateHypPredictions gets it: from the cache, or solved and stored
+static vector<float> CachedOrSolvedPrediction(PersistingThreadObjects& thread_objects, const vector<char>& sequence, int end_flow, bool& hit)
+{
+  vector<float>& cached_prediction = thread_objects.CachedPrediction(0, sequence, end_flow);
+  hit = not cached_prediction.empty();
+  if (not hit)
+    cached_prediction = SolvedPrediction(thread_objects, sequence, end_flow);
+  return cached_prediction;
+}
+
+static bool SameFloats(const vector<float>& a, const vector<float>& b)
+{
+  return a.size() == b.size() and (a.empty() or memcmp(&a[0], &b[0], a.size() * sizeof(float)) == 0);
+}
+
+class PredictionCache_Test : public ::testing::TestWithParam<bool> {
+protected:
+  virtual void SetUp() {
+    srand48(1);
+    global_context.use_SSE_basecaller = GetParam();
+    global_context.flow_order_vector.push_back(ion::FlowOrder(kFlowOrder, kNumFlows));
+  }
+  InputStructures global_context;
+};
+
+
+// The same bases simulated again, with other measurements, give the stored prediction
+TEST_P(PredictionCache_Test, HitMatchesSolve) {
+  PersistingThreadObjects thread_objects(global_context);
+  const ion::FlowOrder& flow_order = global_context.flow_order_vector[0];
+  vector<float> phase_params(3, 0.0f);
+  phase_params[0] = 0.01f;
+  phase_params[1] = 0.008f;
+  thread_objects.SetModelParameters(0, phase_params);
+  thread_objects.DisableRecalibration(0);
+
+  for (int r = 0; r < 50; ++r) {
+    int end_flow = 100 + lrand48() % 200;
+    vector<char> sequence = SimulatedOnlySequence(flow_order, end_flow);
+    bool hit;
+    vector<float> first = CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+    EXPECT_FALSE(hit);
+    vector<float> second = CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+    EXPECT_TRUE(hit);
+    EXPECT_TRUE(SameFloats(second, SolvedPrediction(thread_objects, sequence, end_flow)));
+    EXPECT_TRUE(SameFloats(first, second));
+  }
+}
+
+// A different last flow or phasing model must not return the stored prediction
+TEST_P(PredictionCache_Test, KeyedOnEndFlowAndPhaseParams) {
+  PersistingThreadObjects thread_objects(global_context);
+  const ion::FlowOrder& flow_order = global_context.flow_order_vector[0];
+  vector<float> phase_params(3, 0.0f);
+  phase_params[0] = 0.01f;
+  phase_params[1] = 0.008f;
+  thread_objects.SetModelParameters(0, phase_params);
+  thread_objects.DisableRecalibration(0);
+
+  int end_flow = 200;
+  vector<char> sequence = SimulatedOnlySequence(flow_order, end_flow + 20);
+  bool hit;
+  CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+  ASSERT_FALSE(hit);
+
+  vector<float> other_end = CachedOrSolvedPrediction(thread_objects, sequence, end_flow + 10, hit);
+  EXPECT_FALSE(hit);
+  EXPECT_TRUE(SameFloats(other_end, SolvedPrediction(thread_objects, sequence, end_flow + 10)));
+
+  vector<float> other_phase_params = phase_params;
+  other_phase_params[0] = 0.02f;
+  thread_objects.SetModelParameters(0, other_phase_params);
+  vector<float> other_phase = CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+  EXPECT_FALSE(hit);
+  EXPECT_TRUE(SameFloats(other_phase, SolvedPrediction(thread_objects, sequence, end_flow)));
+
+  // Going back to the first model finds its prediction again
+  thread_objects.SetModelParameters(0, phase_params);
+  vector<float> first_phase = CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+  EXPECT_TRUE(hit);
+  EXPECT_TRUE(SameFloats(first_phase, SolvedPrediction(thread_objects, sequence, end_flow)));
+  EXPECT_FALSE(SameFloats(first_phase, other_phase));
+}
+
+// Past kMaxCachedPredictions entries the cache starts over and keeps giving the solved predictions
+TEST_P(PredictionCache_Test, EvictionKeepsPredictions) {
+  PersistingThreadObjects thread_objects(global_context);
+  const ion::FlowOrder& flow_order = global_context.flow_order_vector[0];
+  vector<float> phase_params(3, 0.0f);
+  phase_params[0] = 0.01f;
+  phase_params[1] = 0.008f;
+  thread_objects.SetModelParameters(0, phase_params);
+  thread_objects.DisableRecalibration(0);
+
+  int max_cached = PersistingThreadObjects::kMaxCachedPredictions;
+  int end_flow = 60;
+  vector<vector<char> > sequences;
+  while ((int)sequences.size() < max_cached + 10) {
+    vector<char> sequence = SimulatedOnlySequence(flow_order, end_flow);
+    bool hit;
+    CachedOrSolvedPrediction(thread_objects, sequence, end_flow, hit);
+    if (not hit)
+      sequences.push_back(sequence);
+  }
+
+  // The first sequence was dropped when the cache filled up, the last ones are still there
+  bool hit;
+  vector<float> first = CachedOrSolvedPrediction(thread_objects, sequences.front(), end_flow, hit);
+  EXPECT_FALSE(hit);
+  EXPECT_TRUE(SameFloats(first, SolvedPrediction(thread_objects, sequences.front(), end_flow)));
+  vector<float> last = CachedOrSolvedPrediction(thread_objects, sequences.back(), end_flow, hit);
+  EXPECT_TRUE(hit);
+  EXPECT_TRUE(SameFloats(last, SolvedPrediction(thread_objects, sequences.back(), end_flow)));
+
+  int num_mismatches = 0;
+  for (unsigned int s = 0; s < sequences.size(); ++s) {
+    vector<float> prediction = CachedOrSolvedPrediction(thread_objects, sequences[s], end_flow, hit);
+    if (not SameFloats(prediction, SolvedPrediction(thread_objects, sequences[s], end_flow)))
+      num_mismatches++;
+  }
+  EXPECT_EQ(0, num_mismatches);
+}
+
+#ifdef __SSE3__
+INSTANTIATE_TEST_CASE_P(Basecallers, PredictionCache_Test, ::testing::Values(false, true));
+#else
+INSTANTIATE_TEST_CASE_P(Basecallers, PredictionCache_Test, ::testing::Values(false));
+#endif
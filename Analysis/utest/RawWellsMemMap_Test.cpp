@@ -0,0 +1,125 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "RawWells.h"
+
+using namespace std;
+
+static const size_t kRows = 37;
+static const size_t kCols = 29;
+static const size_t kFlows = 24;
+
+static float TestValue(size_t row, size_t col, size_t flow)
+{
+  return (float)((row * 11 + col * 5 + flow) % 50) * 0.5f - 3.0f;
+}
+
+class RawWellsMemMapTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char dir[] = "/tmp/RawWellsMemMapTestXXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    dir_ = dir;
+  }
+  virtual void TearDown() {
+    for (unsigned int i = 0; i < files_.size(); ++i)
+      unlink(files_[i].c_str());
+    rmdir(dir_.c_str());
+  }
+
+  // Write the whole chip in two flow blocks, like Analysis
+  string WriteWells(const char *name, const char *storage, bool ushort) {
+    string path = dir_ + "/" + name;
+    files_.push_back(path);
+    RawWells wells("", path.c_str(), ushort, -5.0f, 28.0f);
+    wells.SetCompression(0);
+    wells.SetStorageFormat(storage);
+    wells.SetRows(kRows);
+    wells.SetCols(kCols);
+    wells.SetFlows(kFlows);
+    wells.SetFlowOrder("TACG");
+    wells.OpenForWrite();
+    for (size_t flowStart = 0; flowStart < kFlows; flowStart += kFlows / 2) {
+      wells.SetChunk(0, kRows, 0, kCols, flowStart, kFlows / 2);
+      for (size_t row = 0; row < kRows; ++row)
+        for (size_t col = 0; col < kCols; ++col)
+          for (size_t flow = flowStart; flow < flowStart + kFlows / 2; ++flow)
+            wells.Set(row, col, flow, TestValue(row, col, flow));
+      wells.WriteWells();
+    }
+    wells.WriteRanks();
+    wells.WriteInfo();
+    wells.Close();
+    return path;
+  }
+
+  string dir_;
+  vector<string> files_;
+};
+
+TEST_F(RawWellsMemMapTest, MapsContiguousFloats) {
+  string path = WriteWells("1.wells", "hdf5-contiguous", false);
+  RawWells wells("", path.c_str());
+  wells.OpenForRead(true);
+  ASSERT_TRUE(wells.IsMemMapped());
+  EXPECT_EQ(kRows, wells.NumRows());
+  EXPECT_EQ(kFlows, wells.NumFlows());
+  EXPECT_EQ(string("TACG"), string(wells.FlowOrder()).substr(0, 4));
+  for (size_t row = 0; row < kRows; ++row)
+    for (size_t col = 0; col < kCols; ++col)
+      for (size_t flow = 0; flow < kFlows; ++flow)
+        ASSERT_EQ(TestValue(row, col, flow), wells.At(row, col, flow));
+  const WellData *data = wells.ReadXY(3, 4);
+  EXPECT_EQ(TestValue(4, 3, 7), data->flowValues[7]);
+  wells.Close();
+}
+
+TEST_F(RawWellsMemMapTest, RegionsMatchBufferedReads) {
+  string path = WriteWells("1.wells", "hdf5-contiguous", false);
+  RawWells mapped("", path.c_str());
+  RawWells buffered("", path.c_str());
+  mapped.SetMemMap(true);
+  mapped.OpenForIncrementalRead();
+  buffered.OpenForIncrementalRead();
+  ASSERT_TRUE(mapped.IsMemMapped());
+  ASSERT_FALSE(buffered.IsMemMapped());
+
+  // A region off the tile grid, not starting at the first flow
+  mapped.SetChunk(5, 20, 3, 17, 6, 10);
+  buffered.SetChunk(5, 20, 3, 17, 6, 10);
+  mapped.ReadWells();
+  buffered.ReadWells();
+  for (size_t row = 5; row < 25; ++row) {
+    for (size_t col = 3; col < 20; ++col) {
+      const float *values = mapped.FlowValues(row, col);
+      const float *expected = buffered.FlowValues(row, col);
+      ASSERT_TRUE(values != NULL && expected != NULL);
+      for (size_t flow = 6; flow < 16; ++flow) {
+        ASSERT_EQ(TestValue(row, col, flow), buffered.At(row, col, flow));
+        ASSERT_EQ(TestValue(row, col, flow), mapped.At(row, col, flow));
+        ASSERT_EQ(expected[flow - 6], values[flow - 6]);
+      }
+    }
+  }
+  EXPECT_TRUE(mapped.FlowValues(0, 0) == NULL);
+  mapped.Close();
+  buffered.Close();
+}
+
+TEST_F(RawWellsMemMapTest, OtherLayoutsAreRead) {
+  // Chunked and unsigned short files can't be used in place, they load as usual
+  const char *storage[] = { "hdf5", "hdf5-contiguous" };
+  bool ushort[] = { false, true };
+  for (int f = 0; f < 2; ++f) {
+    string path = WriteWells(f == 0 ? "2.wells" : "3.wells", storage[f], ushort[f]);
+    RawWells wells("", path.c_str());
+    wells.SetConvertWithCopies(false);
+    wells.OpenForRead(true);
+    EXPECT_FALSE(wells.IsMemMapped());
+    EXPECT_NEAR(TestValue(9, 8, 13), wells.At(9, 8, 13), 1e-3);
+    wells.Close();
+  }
+}
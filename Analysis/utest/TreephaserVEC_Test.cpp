@@ -0,0 +1,118 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "DPTreephaser.h"
+#include "TreephaserVEC.h"
+
+using namespace std;
+
+// Simulated reads with a fixed seed, shared by all tests
+struct RecordedRead {
+  double        cf;
+  double        ie;
+  vector<float> measurements;
+};
+
+static void RecordReads(const ion::FlowOrder& flow_order, int num_reads, vector<RecordedRead>& reads)
+{
+  DPTreephaser simulator(flow_order, DPTreephaser::kWindowSizeDefault_);
+  int num_flows = flow_order.num_flows();
+  srand48(1);
+  reads.resize(num_reads);
+  for (int r = 0; r < num_reads; ++r) {
+    BasecallerRead truth;
+    int length = 150 + lrand48() % 150;
+    for (int base = 0; base < length; ++base)
+      truth.sequence.push_back("ACGT"[lrand48() % 4]);
+    reads[r].cf = 0.005 + 0.01 * drand48();
+    reads[r].ie = 0.005 + 0.01 * drand48();
+    simulator.SetModelParameters(reads[r].cf, reads[r].ie);
+    truth.prediction.assign(num_flows, 0);
+    simulator.Simulate(truth, num_flows);
+    reads[r].measurements.resize(num_flows);
+    for (int flow = 0; flow < num_flows; ++flow)
+      reads[r].measurements[flow] = truth.prediction[flow] * (0.9 + 0.2 * drand48()) + 0.1 * (drand48() - 0.5);
+  }
+}
+
+static bool SameFloats(const vector<float>& a, const vector<float>& b)
+{
+  return a.size() == b.size() and (a.empty() or memcmp(&a[0], &b[0], a.size() * sizeof(float)) == 0);
+}
+
+
+TEST(TreephaserVEC_Test, SolveMatchesDPTreephaser) {
+  ion::FlowOrder flow_order("TACGTACGTCTGAGCATCGATCGATGTACAGC", 400);
+  int num_flows = flow_order.num_flows();
+  vector<RecordedRead> reads;
+  RecordReads(flow_order, 200, reads);
+  DPTreephaser dp_treephaser(flow_order, DPTreephaser::kWindowSizeDefault_);
+
+  for (int b = 0; b < TreephaserVEC::kNumBackends; ++b) {
+    TreephaserVEC::Backend backend = (TreephaserVEC::Backend)b;
+    if (not TreephaserVEC::BackendAvailable(backend))
+      continue;
+    TreephaserVEC treephaser(flow_order, DPTreephaser::kWindowSizeDefault_, backend);
+
+    int num_same_sequence = 0;
+    for (unsigned int r = 0; r < reads.size(); ++r) {
+      BasecallerRead vec_read, dp_read;
+      vec_read.SetData(reads[r].measurements, num_flows);
+      dp_read.SetData(reads[r].measurements, num_flows);
+      treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+      dp_treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+      treephaser.SolveRead(vec_read, 0, num_flows);
+      dp_treephaser.Solve(dp_read, num_flows);
+
+      if (vec_read.sequence != dp_read.sequence)
+        continue;
+      num_same_sequence++;
+      // The vectorized solver trims state windows slightly differently
+      for (int flow = 0; flow < num_flows; ++flow)
+        ASSERT_NEAR(vec_read.prediction[flow], dp_read.prediction[flow], 0.1) << TreephaserVEC::BackendName(backend);
+    }
+    EXPECT_GE(num_same_sequence, 0.97 * reads.size()) << TreephaserVEC::BackendName(backend);
+  }
+}
+
+TEST(TreephaserVEC_Test, BackendsAreBitIdentical) {
+  ion::FlowOrder flow_order("TACGTACGTCTGAGCATCGATCGATGTACAGC", 400);
+  int num_flows = flow_order.num_flows();
+  vector<RecordedRead> reads;
+  RecordReads(flow_order, 100, reads);
+
+  TreephaserVEC reference(flow_order, DPTreephaser::kWindowSizeDefault_, TreephaserVEC::kBackendGeneric);
+  for (int b = TreephaserVEC::kBackendGeneric + 1; b < TreephaserVEC::kNumBackends; ++b) {
+    TreephaserVEC::Backend backend = (TreephaserVEC::Backend)b;
+    if (not TreephaserVEC::BackendAvailable(backend))
+      continue;
+    TreephaserVEC treephaser(flow_order, DPTreephaser::kWindowSizeDefault_, backend);
+
+    for (unsigned int r = 0; r < reads.size(); ++r) {
+      BasecallerRead ref_read, read;
+      ref_read.SetData(reads[r].measurements, num_flows);
+      read.SetData(reads[r].measurements, num_flows);
+      reference.SetModelParameters(reads[r].cf, reads[r].ie);
+      treephaser.SetModelParameters(reads[r].cf, reads[r].ie);
+      reference.NormalizeAndSolve(ref_read);
+      treephaser.NormalizeAndSolve(read);
+      reference.ComputeQVmetrics(ref_read);
+      treephaser.ComputeQVmetrics(read);
+
+      ASSERT_TRUE(read.sequence == ref_read.sequence) << TreephaserVEC::BackendName(backend) << " read " << r;
+      ASSERT_TRUE(SameFloats(read.normalized_measurements, ref_read.normalized_measurements)) << TreephaserVEC::BackendName(backend);
+      ASSERT_TRUE(SameFloats(read.prediction, ref_read.prediction)) << TreephaserVEC::BackendName(backend);
+      ASSERT_TRUE(SameFloats(read.penalty_residual, ref_read.penalty_residual)) << TreephaserVEC::BackendName(backend);
+      ASSERT_TRUE(SameFloats(read.penalty_mismatch, ref_read.penalty_mismatch)) << TreephaserVEC::BackendName(backend);
+      ASSERT_TRUE(SameFloats(read.state_inphase, ref_read.state_inphase)) << TreephaserVEC::BackendName(backend);
+    }
+  }
+}
+
+TEST(TreephaserVEC_Test, BestBackendIsAvailable) {
+  EXPECT_TRUE(TreephaserVEC::BackendAvailable(TreephaserVEC::kBackendGeneric));
+  EXPECT_TRUE(TreephaserVEC::BackendAvailable(TreephaserVEC::BestBackend()));
+}
@@ -0,0 +1,167 @@
+/* Copyright (C) 2017 Ion Torrent Systems, Inc. All Rights Reserved */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "RawWells.h"
+#include "WellsBlockFile.h"
+
+using namespace std;
+
+static float TestValue(size_t row, size_t col, size_t flow)
+{
+  return (float)((row * 7 + col * 3 + flow) % 40) * 0.75f - 4.5f;
+}
+
+static string TempFileName(const char *name)
+{
+  char dir[] = "/tmp/WellsBlockFileTestXXXXXX";
+  EXPECT_TRUE(mkdtemp(dir) != NULL);
+  return string(dir) + "/" + name;
+}
+
+static void RemoveTempFile(const string& path)
+{
+  unlink(path.c_str());
+  rmdir(path.substr(0, path.rfind('/')).c_str());
+}
+
+// Write a chip the way Analysis does, one flow block at a time
+static void WriteWells(const string& path, const char *storage, bool ushort,
+                       size_t rows, size_t cols, size_t flows, size_t flowBlock)
+{
+  RawWells wells("", path.c_str(), ushort, -5.0f, 28.0f);
+  wells.SetStorageFormat(storage);
+  wells.SetRows(rows);
+  wells.SetCols(cols);
+  wells.SetFlows(flows);
+  wells.SetFlowOrder("TACG");
+  uint tileRows = 8, tileCols = 6, tileFlows = flows;
+  wells.SetH5ChunkSize(tileRows, tileCols, tileFlows);
+  wells.OpenForWrite();
+  wells.WriteRanks();
+  wells.WriteInfo();
+  wells.Close();
+  for (size_t flowStart = 0; flowStart < flows; flowStart += flowBlock) {
+    size_t depth = min(flowBlock, flows - flowStart);
+    wells.OpenExistingWellsForOneChunk(flowStart, depth);
+    for (size_t row = 0; row < rows; ++row)
+      for (size_t col = 0; col < cols; ++col)
+        for (size_t flow = flowStart; flow < flowStart + depth; ++flow)
+          wells.Set(row, col, flow, TestValue(row, col, flow));
+    wells.WriteWells();
+    wells.Close();
+  }
+}
+
+static double MaxDifference(const string& path, size_t rowStart, size_t height,
+                            size_t colStart, size_t width, size_t flowStart, size_t depth)
+{
+  RawWells wells("", path.c_str());
+  wells.SetConvertWithCopies(false);
+  wells.OpenForIncrementalRead();
+  wells.SetChunk(rowStart, height, colStart, width, flowStart, depth);
+  wells.ReadWells();
+  double maxDiff = 0;
+  for (size_t row = rowStart; row < rowStart + height; ++row)
+    for (size_t col = colStart; col < colStart + width; ++col)
+      for (size_t flow = flowStart; flow < flowStart + depth; ++flow)
+        maxDiff = max(maxDiff, (double)fabs(wells.At(row, col, flow) - TestValue(row, col, flow)));
+  wells.Close();
+  return maxDiff;
+}
+
+TEST(WellsBlockFile_Test, RoundTripFormats_Test) {
+  const char *storage[] = { "blocks", "blocks", "blocks-half" };
+  bool ushort[] = { false, true, false };
+  double tolerance[] = { 0.0, 33.0 / 65535.0, 28.0 / 2048.0 };
+  for (int f = 0; f < 3; ++f) {
+    string path = TempFileName("1.wells");
+    WriteWells(path, storage[f], ushort[f], 21, 17, 30, 7);
+    EXPECT_TRUE(WellsBlockFile::IsBlockFile(path));
+    // whole chip, then a region that does not line up with the tiles
+    EXPECT_LE(MaxDifference(path, 0, 21, 0, 17, 0, 30), tolerance[f]) << storage[f];
+    EXPECT_LE(MaxDifference(path, 5, 9, 4, 11, 3, 20), tolerance[f]) << storage[f];
+
+    RawWells wells("", path.c_str());
+    wells.OpenForIncrementalRead();
+    EXPECT_EQ(21u, wells.NumRows());
+    EXPECT_EQ(17u, wells.NumCols());
+    EXPECT_EQ(30u, wells.NumFlows());
+    EXPECT_EQ(string("TACG"), string(wells.FlowOrder()).substr(0, 4));
+    EXPECT_EQ(ushort[f] || f == 2, wells.GetSaveAsUShort());
+    wells.Close();
+    RemoveTempFile(path);
+  }
+}
+
+TEST(WellsBlockFile_Test, UShortMatchesConverter_Test) {
+  vector<float> values;
+  for (int i = -800; i <= 3400; ++i)
+    values.push_back(i * 0.01f + 0.001f * (i % 7));
+  values.push_back(NAN);
+  vector<unsigned short> encoded(WellsBlockFile::EncodedSize(WellsBlockFile::USHORT, values.size()) / 2);
+  WellsBlockFile::Encode(WellsBlockFile::USHORT, -5.0f, 28.0f, &values[0], values.size(), &encoded[0]);
+  vector<float> decoded(values.size());
+  WellsBlockFile::Decode(WellsBlockFile::USHORT, -5.0f, 28.0f, &encoded[0], values.size(), &decoded[0]);
+
+  WellsConverter converter(-5.0f, 28.0f);
+  for (size_t i = 0; i + 1 < values.size(); ++i) {
+    unsigned short expected = converter.FloatToUInt16(values[i]);
+    ASSERT_EQ(expected, encoded[i]) << values[i];
+    ASSERT_EQ(converter.UInt16ToFloat(expected), decoded[i]);
+  }
+  EXPECT_EQ(0, encoded[values.size() - 1]);   // NaN
+}
+
+TEST(WellsBlockFile_Test, HalfRounding_Test) {
+  // exactly representable, halfway cases rounding to even, overflow and underflow
+  float values[] = { 0.0f, -2.25f, 1.5f, 65504.0f, 1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f,
+                     1e6f, 1e-9f, 6.1035156e-05f };
+  float expected[] = { 0.0f, -2.25f, 1.5f, 65504.0f, 1.0f, 1.0f + 2.0f / 1024.0f,
+                       INFINITY, 0.0f, 6.1035156e-05f };
+  int count = sizeof(values) / sizeof(values[0]);
+  vector<uint64_t> encoded(WellsBlockFile::EncodedSize(WellsBlockFile::FLOAT16, count) / 8);
+  vector<float> decoded(count);
+  WellsBlockFile::Encode(WellsBlockFile::FLOAT16, 0, 0, values, count, &encoded[0]);
+  WellsBlockFile::Decode(WellsBlockFile::FLOAT16, 0, 0, &encoded[0], count, &decoded[0]);
+  for (int i = 0; i < count; ++i)
+    EXPECT_EQ(expected[i], decoded[i]) << values[i];
+}
+
+TEST(WellsBlockFile_Test, InfoAndCopies_Test) {
+  string path = TempFileName("2.wells");
+  WellsBlockFile file;
+  file.Create(path, 4, 5, 3, 2, 2, WellsBlockFile::FLOAT32, -5.0f, 28.0f);
+  vector<float> tile(2 * 2 * 3, 1.0f);
+  file.WriteTile(2, 2, 0, 3, &tile[0]);
+  file.Close();
+
+  file.OpenForAppend(path);
+  vector<string> keys(1, "FLOW_ORDER"), values(1, "TACG");
+  file.SetInfo(keys, values);
+  vector<float> copies(4 * 5, 2.0f);
+  file.SetCopies(copies);
+  tile.assign(2 * 2 * 1, 3.0f);
+  file.WriteTile(2, 2, 1, 1, &tile[0]);
+  file.Close();
+
+  WellsBlockFile reader;
+  reader.OpenForRead(path);
+  EXPECT_EQ(2u, reader.NumBlocks());
+  ASSERT_EQ(1u, reader.InfoKeys().size());
+  EXPECT_EQ("TACG", reader.InfoValues()[0]);
+  ASSERT_TRUE(reader.HasCopies());
+  EXPECT_EQ(2.0f, reader.Copies()[7]);
+  vector<float> data(2 * 2 * 3);
+  reader.ReadTile(2, 2, 0, 3, &data[0]);
+  EXPECT_EQ(1.0f, data[0]);
+  EXPECT_EQ(3.0f, data[1]);   // later block wins
+  EXPECT_EQ(1.0f, data[2]);
+  reader.ReadTile(0, 0, 0, 3, &data[0]);
+  EXPECT_EQ(0.0f, data[0]);   // never written
+  reader.Close();
+  RemoveTempFile(path);
+}
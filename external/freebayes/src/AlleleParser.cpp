@@ -158,10 +158,13 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
   // Parse read into alleles and store them in generator-friendly format
   ra.is_read_allele_unpacked = true;
   int ref_length = ra.end - ra.alignment.Position;
-  ra.refmap_start.reserve(ref_length+1);
-  ra.refmap_code.reserve(ref_length+1);
-  ra.refmap_has_allele.assign(ref_length,'N');
-  ra.refmap_allele.resize(ref_length);
+  // The refmap arrays are not resized while parsing: make sure the cigar fits
+  int cigar_ref_length = 0;
+  for (vector<CigarOp>::const_iterator cigar = ra.alignment.CigarData.begin(); cigar != ra.alignment.CigarData.end(); ++cigar)
+    if (cigar->Type == 'M' or cigar->Type == '=' or cigar->Type == 'D' or cigar->Type == 'N')
+      cigar_ref_length += cigar->Length;
+  ra.refmap.Allocate(max(ref_length, cigar_ref_length));
+  int refmap_pos = 0;
 
   int mismatch_count = 0;
   ra.snp_count = 0;
@@ -198,8 +201,8 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
         // record mismatch if we have a mismatch here
         // when the reference is N, we should always call a mismatch
         if (*read_ptr == *ref_ptr and *ref_ptr != 'N') {
-          ra.refmap_start.push_back(read_ptr);
-          ra.refmap_code.push_back('M');
+          ra.refmap.start[refmap_pos] = read_ptr;
+          ra.refmap.code[refmap_pos++] = 'M';
           ++ref_pos;
           ++ref_ptr;
           ++read_ptr;
@@ -214,13 +217,13 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
         ++mismatch_count;
         ++ra.snp_count;
 
-        ra.refmap_start.push_back(read_ptr);
+        ra.refmap.start[refmap_pos] = read_ptr;
         length = 0;
         if (*read_ptr == 'A' or *read_ptr == 'T' or *read_ptr == 'G' or *read_ptr == 'C') {
-          ra.refmap_code.push_back('X');
+          ra.refmap.code[refmap_pos++] = 'X';
           MakeAllele(alleles, ALLELE_SNP, ref_pos, 1, read_ptr);
         } else {
-          ra.refmap_code.push_back('N');
+          ra.refmap.code[refmap_pos++] = 'N';
           MakeAllele(alleles, ALLELE_NULL, ref_pos, 1, read_ptr);
         }
 
@@ -241,8 +244,8 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
       mismatch_count += cigar_len;
 
       for (unsigned int i = 0; i < cigar_len; ++i) {
-        ra.refmap_start.push_back(read_ptr);
-        ra.refmap_code.push_back('D');
+        ra.refmap.start[refmap_pos] = read_ptr;
+        ra.refmap.code[refmap_pos++] = 'D';
       }
 
       ref_pos += cigar_len;  // update sample position
@@ -269,16 +272,16 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
 
     } else if (cigar->Type == 'N') { // skipped region in the reference not present in read, aka splice
       for (unsigned int i = 0; i < cigar_len; ++i) {
-        ra.refmap_start.push_back(read_ptr);
-        ra.refmap_code.push_back('D');
+        ra.refmap.start[refmap_pos] = read_ptr;
+        ra.refmap.code[refmap_pos++] = 'D';
       }
       ref_pos += cigar_len;
       ref_ptr += cigar_len;
     }
 
   } // end cigar iter loop
-  ra.refmap_start.push_back(read_ptr);
-  ra.refmap_code.push_back('N');
+  ra.refmap.start[refmap_pos] = read_ptr;
+  ra.refmap.code[refmap_pos] = 'N';
 
   // backtracking if we have too many mismatches or if there are no recorded alleles
   if (alleles.empty() or ra.alignment.QueryBases.size() == 0 or
@@ -296,14 +299,14 @@ void AlleleParser::UnpackReadAlleles(Alignment& ra) const
   for (deque<Allele>::iterator allele = alleles.begin(); allele != alleles.end(); ++allele) {
     if (allele->type == ALLELE_REFERENCE) {
       for (unsigned int i = 0; i < allele->ref_length; ++i) {
-        if ((unsigned int)(allele->position - ra.alignment.Position + i) >= ra.refmap_allele.size()) {break;}
-        ra.refmap_has_allele[allele->position - ra.alignment.Position + i] = 'R';
-        ra.refmap_allele[allele->position - ra.alignment.Position + i] = *allele;
+        if ((unsigned int)(allele->position - ra.alignment.Position + i) >= (unsigned int)ra.refmap.length) {break;}
+        ra.refmap.has_allele[allele->position - ra.alignment.Position + i] = 'R';
+        ra.refmap.allele[allele->position - ra.alignment.Position + i] = *allele;
       }
     } else {
-      if ((unsigned int)(allele->position - ra.alignment.Position) >= ra.refmap_allele.size()) {break;}
-      ra.refmap_has_allele[allele->position - ra.alignment.Position] = 'A';
-      ra.refmap_allele[allele->position - ra.alignment.Position] = *allele;
+      if ((unsigned int)(allele->position - ra.alignment.Position) >= (unsigned int)ra.refmap.length) {break;}
+      ra.refmap.has_allele[allele->position - ra.alignment.Position] = 'A';
+      ra.refmap.allele[allele->position - ra.alignment.Position] = *allele;
     }
   }
 }
@@ -510,16 +513,16 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
         continue;
 
       int read_pos = position_ticket->pos - rai->alignment.Position;
-      if (read_pos < 0 or read_pos >= (int)rai->refmap_has_allele.size())
+      if (read_pos < 0 or read_pos >= rai->refmap.length)
         continue;
 
-      if (rai->refmap_has_allele[read_pos] == 'R') {
+      if (rai->refmap.has_allele[read_pos] == 'R') {
         ref_pileup_.add_reference_observation(rai->sample_index, rai->alignment.IsReverseStrand(), position_ticket->chr, rai->read_count);
 
-      } else if (rai->refmap_has_allele[read_pos] == 'A') {
-	//const Allele& obs = rai->refmap_allele[read_pos];
+      } else if (rai->refmap.has_allele[read_pos] == 'A') {
+	//const Allele& obs = rai->refmap.allele[read_pos];
 	//string tmp1(obs.alt_sequence, obs.alt_length);
-        const Allele& allele = rai->refmap_allele[read_pos];
+        const Allele& allele = rai->refmap.allele[read_pos];
 	//string tmp(allele.alt_sequence, allele.alt_length);
 	//cout << "Adding observation at " << allele.position <<  ", read_pos " << read_pos << ", alt_length " << allele.alt_length << " from " << tmp1 << " to " << tmp << endl;
 	if (allele.position+allele.ref_length-position_ticket->pos > max_length) continue;
@@ -547,11 +550,11 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
         continue;
 
       int read_pos = position_ticket->pos - rai->alignment.Position;
-      if (read_pos < 0 or read_pos >= (int)rai->refmap_has_allele.size())
+      if (read_pos < 0 or read_pos >= rai->refmap.length)
         continue;
 
-      if (rai->refmap_has_allele[read_pos] == 'R') {
-        Allele& allele = rai->refmap_allele[read_pos];
+      if (rai->refmap.has_allele[read_pos] == 'R') {
+        Allele& allele = rai->refmap.allele[read_pos];
         long int start = allele.position;
         long int end = allele.position + allele.ref_length;
         if (start <= position_ticket->pos && end >= position_ticket->pos + haplotype_length) {
@@ -561,11 +564,11 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
       }
 
       for (int i = 0; i < haplotype_length; ++i, ++read_pos) {
-        if (read_pos >= (int)rai->refmap_has_allele.size())
+        if (read_pos >= rai->refmap.length)
           break;
 
-        if (rai->refmap_has_allele[read_pos] == 'A') {
-          Allele& allele = rai->refmap_allele[read_pos];
+        if (rai->refmap.has_allele[read_pos] == 'A') {
+          Allele& allele = rai->refmap.allele[read_pos];
 	  //string tmp(allele.alt_sequence, allele.alt_length);
 	  //cout << "2nd pass Adding observation at " << allele.position <<  ", ref_len " << allele.ref_length << ", alt_length " << allele.alt_length << " to " << tmp << endl; // ZZ
 	  if (allele.position+allele.ref_length-position_ticket->pos >= max_length) break; // out of boundary
@@ -599,11 +602,11 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
         continue;
 
       int read_start = position_ticket->pos - rai->alignment.Position;
-      if (rai->refmap_code[read_start] == 'D')    // isDividedIndel
+      if (rai->refmap.code[read_start] == 'D')    // isDividedIndel
         continue;
 
-      const char* start_ptr = rai->refmap_start[read_start];
-      const char* end_ptr = rai->refmap_start[read_start+haplotype_length];
+      const char* start_ptr = rai->refmap.start[read_start];
+      const char* end_ptr = rai->refmap.start[read_start+haplotype_length];
 
       Allele allele;
       allele.position = position_ticket->pos;
@@ -619,7 +622,7 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
       } else {
         allele.type = ALLELE_REFERENCE;
         for (int pos = 0; pos < haplotype_length; ++pos) {
-          if (rai->refmap_code[read_start+pos] != 'M') {
+          if (rai->refmap.code[read_start+pos] != 'M') {
             allele.type = ALLELE_COMPLEX; // anything non-reference will do
             break;
           }
@@ -634,12 +637,12 @@ void AlleleParser::PileUpAlleles(int allowed_allele_types, int haplotype_length,
 	// Generate raw cigar for non reference allele.
 	string raw_cigar;
 	for (int pos = 0; pos < haplotype_length; ++pos) {
-          if (rai->refmap_code[read_start+pos] == 'D') raw_cigar.push_back('D');
+          if (rai->refmap.code[read_start+pos] == 'D') raw_cigar.push_back('D');
 	  else {
 	    raw_cigar.push_back('M');
 	  }
 	    // innsertion
-	    int j = rai->refmap_start[read_start+pos+1]-rai->refmap_start[read_start+pos];
+	    int j = rai->refmap.start[read_start+pos+1]-rai->refmap.start[read_start+pos];
 	    j--;
 	    while (j > 0) {
 		j--;
@@ -2093,16 +2096,16 @@ void AlleleParser::PileUpAlleles(int pos, int haplotype_length,  list<PositionIn
       int rd = read_start;
       /*
       for (; rd <= read_start+haplotype_length; rd++) {
-	if (rai->refmap_code[rd] != 'D') break; 
+	if (rai->refmap.code[rd] != 'D') break; 
       }
       if (rd > read_start+haplotype_length) continue;
       */
       // this is to be consistent with novel
-      if (rai->refmap_code[read_start] == 'D')    // isDividedIndel
+      if (rai->refmap.code[read_start] == 'D')    // isDividedIndel
           continue;
       
-      const char* start_ptr = rai->refmap_start[rd];
-      const char* end_ptr = rai->refmap_start[read_start+haplotype_length];
+      const char* start_ptr = rai->refmap.start[rd];
+      const char* end_ptr = rai->refmap.start[read_start+haplotype_length];
 
       Allele allele;
       allele.position = pos;
@@ -2118,7 +2121,7 @@ void AlleleParser::PileUpAlleles(int pos, int haplotype_length,  list<PositionIn
       } else {
         allele.type = ALLELE_REFERENCE;
         for (int pos = 0; pos < haplotype_length; ++pos) {
-          if (rai->refmap_code[read_start+pos] != 'M') {
+          if (rai->refmap.code[read_start+pos] != 'M') {
             allele.type = ALLELE_COMPLEX; // anything non-reference will do
             break;
           }